@@ -5,10 +5,46 @@
  * and Part D (IPC Cache Process).
  *
  * Features:
- * - LRU (Least Recently Used) eviction policy
- * - Thread-safe operations
- * - Configurable maximum cache size
- * - Cache statistics for monitoring
+ * - LRU (Least Recently Used) eviction policy, or CLOCK (second chance),
+ *   where hits only set a reference bit and take no lock at all: lookups
+ *   run inside an epoch (epoch.h) and writers defer their frees
+ * - W-TinyLFU: a small window LRU in front of a segmented LRU, with a
+ *   frequency sketch deciding which entries may enter the main area
+ *   (scan-resistant)
+ * - ARC, 2Q and S3-FIFO; every policy sits behind cache_policy_ops_t,
+ *   so cache_get/cache_put do not depend on the policy chosen
+ * - GDSF (GreedyDual-Size-Frequency): evicts the entry with the lowest
+ *   frequency x refetch cost / size, from a per-shard heap in O(log n)
+ * - Thread-safe operations, lock-striped: the cache is split into shards
+ *   selected by key hash, each with its own lock, LRU list and size budget
+ * - Per-shard open-addressing key index (cache_index.h) that grows
+ *   incrementally with the number of entries
+ * - Configurable maximum cache size, charged with the memory really used:
+ *   payloads live in size-class slabs (slab.h) and an entry costs its
+ *   chunk size, not just its file size
+ * - Optional per-entry TTL and file validator (for revalidation); expired
+ *   entries are dropped on lookup, and cache_expire() / a background
+ *   sweeper reclaims the rest through a per-shard timer wheel
+ * - Zero-copy reads: payloads are refcounted, so a hit can pin the
+ *   buffer (cache_acquire) and send it after the lock is released
+ * - Warm restarts: cache_snapshot() writes the entries to a file that
+ *   cache_restore() maps and serves from without reading it up front
+ * - Optional disk tier (cache_attach_disk, cache_disk.h): evicted entries
+ *   are written to a log on local disk in the background and promoted
+ *   back to memory when hit
+ * - Optional compression (cache_set_compression, lz.h): payloads that
+ *   compress well are stored as LZ blocks and charged at their
+ *   compressed size; hits decode them outside the shard lock
+ * - Chunked files (cache_put_chunks): large files are cached as
+ *   CACHE_CHUNK_SIZE pieces, each an ordinary entry, so a file may be
+ *   partly resident, byte ranges are served from the chunks they touch,
+ *   and eviction drops a chunk at a time
+ * - Cache statistics for monitoring, counted per thread (stat_counters.h)
+ *   so that hits on different cores do not write a shared line
+ * - Predicted hit rates at 0.25x .. 4x max_size, estimated online from a
+ *   hash-sampled fraction of the keys (SHARDS, mrc.h)
+ * - Batched lookups and puts (cache_get_many, cache_put_many): keys are
+ *   grouped by shard, so each shard's lock is taken once per batch
  *
  * The cache stores file contents in memory to avoid repeated disk reads.
  */
@@ -19,7 +55,12 @@
 #include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <time.h>
+#include "cache_index.h"
+#include "epoch.h"
+#include "mrc.h"
+#include "stat_counters.h"
 
 /* ============================================================================
  * Constants
@@ -31,61 +72,405 @@
 /* Maximum number of cached entries */
 #define MAX_CACHE_ENTRIES       1024
 
-/* Maximum key length */
+/* Maximum key length (keys are stored at their real length) */
 #define MAX_KEY_LEN             512
 
+/* Entries per block of a shard's entry table (power of two) */
+#define CACHE_ENTRY_BLOCK       256
+
+/* cache_buf_t flags: the buffer lives in a restored snapshot mapping */
+#define CACHE_BUF_MAPPED        0x1
+
+/* cache_buf_t flags: the payload is an lz block (lz.h), not the file */
+#define CACHE_BUF_LZ            0x2
+
+/* Refetch cost (us) of entries put without one (GDSF) */
+#define CACHE_COST_DEFAULT      1000
+
+/* Compression (cache_set_compression): smaller payloads are stored as is */
+#define CACHE_COMPRESS_MIN      512
+
+/* Prefix compressed first to decide whether the rest is worth it */
+#define CACHE_COMPRESS_SAMPLE   4096
+
+/* A payload is stored compressed only if it shrinks to this many eighths */
+#define CACHE_COMPRESS_MAX_8THS 7
+
+/* Chunked files: bytes per chunk (the last chunk of a file may be shorter) */
+#define CACHE_CHUNK_SIZE        (256 * 1024)
+
+/* Chunk keys start with this character, file paths with '/' */
+#define CACHE_CHUNK_PREFIX      '#'
+
+/* Entry id meaning "no entry" (end of a list) */
+#define CACHE_ENTRY_NIL         UINT32_MAX
+
+/* TTL value meaning "never expires" */
+#define CACHE_TTL_NONE          0
+
+/* Expiry wheel: tick length and shape. CACHE_WHEEL_LEVELS levels of
+   CACHE_WHEEL_SLOTS slots span SLOTS^LEVELS ticks (about 46 hours);
+   later deadlines wait in the last slot and are re-filed from there */
+#define CACHE_WHEEL_TICK_MS     10
+#define CACHE_WHEEL_BITS        6
+#define CACHE_WHEEL_SLOTS       (1 << CACHE_WHEEL_BITS)
+#define CACHE_WHEEL_LEVELS      4
+
+/* Default deadline of a revalidation (cache_set_revalidate_timeout):
+   past it, the next stale lookup is elected to try again */
+#define CACHE_REVALIDATE_TIMEOUT_MS 10000
+
+/* Default period of the background sweeper (cache_start_sweeper) */
+#define CACHE_SWEEP_INTERVAL_MS 100
+
+/* Disk tier: evicted entries waiting for the writer thread, at most this
+   many and this many bytes; beyond that, evictions are not written */
+#define CACHE_DISK_QUEUE_LEN    256
+#define CACHE_DISK_QUEUE_BYTES  (8 * 1024 * 1024)
+
+/* Shard count used by cache_create for large caches */
+#define DEFAULT_CACHE_SHARDS    16
+
+/* Upper bound for cache_create_sharded */
+#define CACHE_MAX_SHARDS        256
+
+/* cache_create uses fewer shards rather than shards smaller than this */
+#define CACHE_MIN_SHARD_SIZE    (1024 * 1024)
+
+/* Predicted hit rates in cache_stats_t: max_size x 2^((i - 4) / 2),
+   i.e. 0.25x, 0.35x, 0.5x, 0.71x, 1x, 1.4x, 2x, 2.8x and 4x */
+#define CACHE_MRC_POINTS        9
+
+/* Keys cache_get_many / cache_put_many hash and group at a time */
+#define CACHE_BATCH             64
+
+/* Entry lists per shard (LRU and CLOCK use one, W-TinyLFU three) */
+#define CACHE_SEGMENTS          3
+
+/* W-TinyLFU: window share of a shard, protected share of the main area */
+#define TINYLFU_WINDOW_PERCENT      1
+#define TINYLFU_PROTECTED_PERCENT   80
+
+/* W-TinyLFU: one sketch counter per this many bytes of shard budget */
+#define TINYLFU_BYTES_PER_COUNTER   1024
+
 /* ============================================================================
  * Data Structures
  * ============================================================================ */
 
+/*
+ * Validator - identifies the version of a cached file
+ *
+ * Mirrors gf_validator_t in protocol.h so the cache does not depend
+ * on the wire protocol.
+ */
+typedef struct {
+    int64_t mtime_ns;               /* Last modification time (ns) */
+    uint64_t size;                  /* File size in bytes */
+} cache_validator_t;
+
+/*
+ * Replacement policy, chosen when the cache is created
+ */
+typedef enum {
+    CACHE_POLICY_LRU = 0,           /* Exact LRU: hits move the entry to the list head */
+    CACHE_POLICY_CLOCK,             /* Second chance: hits set a reference bit */
+    CACHE_POLICY_TINYLFU,           /* Window LRU + segmented LRU, frequency admission */
+    CACHE_POLICY_ARC,               /* Adaptive recency/frequency split with ghosts */
+    CACHE_POLICY_2Q,                /* FIFO for new keys, LRU for returning keys */
+    CACHE_POLICY_S3FIFO,            /* Small + main FIFO, hits bump a counter */
+    CACHE_POLICY_GDSF,              /* Lowest frequency x cost / size goes first */
+    CACHE_POLICY_COUNT
+} cache_policy_t;
+
+/*
+ * Per-thread counters of a cache (cache_t.counters)
+ */
+typedef enum {
+    CACHE_STAT_HITS = 0,            /* Cache hits */
+    CACHE_STAT_MISSES,              /* Cache misses */
+    CACHE_STAT_EVICTIONS,           /* Number of evictions */
+    CACHE_STAT_STALE_HITS,          /* Expired entries served while revalidating */
+    CACHE_STAT_EXPIRATIONS,         /* Entries dropped because they expired */
+    CACHE_STAT_ADMISSION_REJECTS,   /* Candidates the policy kept out (W-TinyLFU) */
+    CACHE_STAT_COMPRESS_SKIPPED,    /* Puts stored as is: the sample did not shrink */
+    CACHE_STAT_HIT_BYTES,           /* Payload bytes returned by hits */
+    CACHE_STAT_PUT_BYTES,           /* Payload bytes put, for any reason */
+    CACHE_STAT_MISS_BYTES,          /* Bytes fetched to answer misses (reported) */
+    CACHE_STAT_COUNT
+} cache_stat_t;
+
+/*
+ * Result of a freshness-aware lookup (cache_lookup_copy)
+ */
+typedef enum {
+    CACHE_LOOKUP_MISS = 0,          /* Not cached, or too stale to serve */
+    CACHE_LOOKUP_FRESH,             /* Within TTL */
+    CACHE_LOOKUP_STALE,             /* Expired, another caller is revalidating */
+    CACHE_LOOKUP_REVALIDATE         /* Expired, this caller must revalidate */
+} cache_lookup_t;
+
+/*
+ * Payload buffer - immutable once cached, shared by the entry and by
+ * every handle pinning it; freed when the last reference is dropped
+ *
+ * The entry's key is stored at the start of data, in the same cache
+ * line as the header, and the payload follows it; a key costs its own
+ * length rather than MAX_KEY_LEN. Snapshots store buffers in this same
+ * layout, so restored entries point straight into the mapped file.
+ */
+typedef struct cache_buf {
+    int refs;                       /* Cache's reference + pinned handles (atomic) */
+    uint16_t key_len;               /* Key bytes before the payload: NUL, padded to 8 */
+    uint16_t flags;                 /* CACHE_BUF_MAPPED, CACHE_BUF_LZ */
+    size_t size;                    /* Payload bytes (stored), at data + key_len */
+    char data[];
+} cache_buf_t;
+
+/*
+ * Pinned payload returned by cache_acquire / cache_lookup_acquire
+ *
+ * data stays valid and unchanged until cache_release(), even if the
+ * entry is replaced, evicted or the whole cache is cleared meanwhile.
+ */
+typedef struct {
+    const char *data;
+    size_t size;
+    cache_buf_t *buf;               /* Reference owned by the handle */
+    bool compressed;                /* data is an lz block (cache_lookup_acquire_packed) */
+} cache_handle_t;
+
 /*
  * Cache entry - one cached file
  *
- * Entries are stored in a hash table with LRU ordering.
+ * Exactly one cache line: everything a lookup, a hit and an eviction
+ * touch. Entries live in their shard's entry table and link to each
+ * other by 32-bit id (cache_entry_at); the rarely used validator is
+ * kept apart (cache_entry_cold).
  */
 typedef struct cache_entry {
-    char key[MAX_KEY_LEN];          /* Cache key (file path) */
-    char *data;                     /* File contents (malloc'd) */
-    size_t size;                    /* Size of data in bytes */
-    time_t last_access;             /* Timestamp of last access (for LRU) */
-    time_t created;                 /* When entry was cached */
+    uint64_t hash;                  /* cache_hash(key), the index's key */
+    const char *key;                /* Cache key (file path), inside buf */
+    cache_buf_t *buf;               /* Refcounted payload + key */
+    size_t size;                    /* Bytes charged: slab chunk holding buf */
+    uint64_t expires_ms;            /* Monotonic expiry, CACHE_TTL_NONE = never */
 
-    /* Linked list pointers for LRU ordering */
-    struct cache_entry *lru_prev;   /* More recently used */
-    struct cache_entry *lru_next;   /* Less recently used */
+    /* LRU list links (insertion order under CLOCK) */
+    uint32_t lru_prev;              /* More recently used, or CACHE_ENTRY_NIL */
+    uint32_t lru_next;              /* Less recently used, or CACHE_ENTRY_NIL */
+    uint32_t id;                    /* This entry's slot in the entry table */
+    int32_t clock_index;            /* Slot in the shard's clock array (CLOCK)
+                                       or priority heap (GDSF) */
 
-    /* Hash table chaining */
-    struct cache_entry *hash_next;  /* Next entry in hash bucket */
+    uint8_t freq;                   /* Hit bits, updated atomically (CLOCK: reference
+                                       bit; S3-FIFO: 0..3; GDSF: hit count) */
+    uint8_t segment;                /* Shard list the entry is on */
+    bool has_validator;             /* Validator known */
+    bool revalidating;              /* A revalidation is in flight */
+    bool timer_armed;               /* On the shard's expiry wheel */
+} __attribute__((aligned(64))) cache_entry_t;
 
-} cache_entry_t;
+/*
+ * Cold per-entry data, indexed by entry id
+ */
+typedef struct {
+    cache_validator_t validator;    /* File version (if has_validator) */
+    uint32_t validator_seq;         /* Odd while buf and validator change
+                                       (lock-free readers copy both) */
+    uint32_t cost;                  /* Refetch cost in us (GDSF) */
+    uint64_t revalidate_ms;         /* Start of the revalidation in flight */
+
+    /* Expiry wheel slot list (if timer_armed) */
+    uint32_t timer_prev;
+    uint32_t timer_next;
+    uint32_t timer_slot;            /* level * CACHE_WHEEL_SLOTS + slot */
+} cache_entry_cold_t;
 
 /*
- * Cache - the main cache structure
+ * Block of a shard's entry table; blocks never move, so entry pointers
+ * stay valid while the table grows
+ */
+typedef struct {
+    cache_entry_t entries[CACHE_ENTRY_BLOCK];
+    cache_entry_cold_t cold[CACHE_ENTRY_BLOCK];
+} cache_entry_block_t;
+
+/*
+ * Entry list - doubly linked through lru_prev / lru_next
+ */
+typedef struct {
+    cache_entry_t *head;            /* Most recently used */
+    cache_entry_t *tail;            /* Least recently used (evict first) */
+    size_t bytes;                   /* Sum of entry sizes */
+} cache_list_t;
+
+/*
+ * Expiry wheel - entries with a TTL, filed by the tick at which they may
+ * be reclaimed (expiry + stale window)
+ *
+ * Level 0 has a slot per tick; a level-l slot spans SLOTS^l ticks and is
+ * moved down a level when the wheel reaches it, so advancing the wheel
+ * costs the ticks passed plus the entries due, never a scan.
+ */
+typedef struct {
+    uint32_t slots[CACHE_WHEEL_LEVELS * CACHE_WHEEL_SLOTS]; /* First entry id, or NIL */
+    uint64_t tick;                  /* Last tick processed */
+    size_t timers;                  /* Entries on the wheel */
+} cache_wheel_t;
+
+/*
+ * Disk tier state (cache_attach_disk), private to cache.c
+ */
+typedef struct cache_l2 cache_l2_t;
+
+/*
+ * Cache shard - an independent LRU cache over a slice of the key space
  *
  * Uses a hash table for O(1) lookup and a doubly-linked list for LRU ordering.
+ * Aligned to a cache line so that shards locked by different threads
+ * do not share lines.
  */
 typedef struct {
-    /* Hash table for fast lookup */
-    cache_entry_t **buckets;        /* Array of bucket pointers */
-    int num_buckets;                /* Size of buckets array */
+    /* Key -> entry */
+    cache_index_t index;
 
-    /* LRU list (doubly linked) */
-    cache_entry_t *lru_head;        /* Most recently used */
-    cache_entry_t *lru_tail;        /* Least recently used (evict first) */
+    /* Entry table: blocks of entries, free slots chained through lru_next */
+    cache_entry_block_t **blocks;
+    uint32_t num_blocks;
+    uint32_t free_entries;          /* First free id, or CACHE_ENTRY_NIL */
+
+    /* LRU lists: segments[0] is the LRU list; W-TinyLFU uses
+       window (0), probation (1) and protected (2) */
+    cache_list_t segments[CACHE_SEGMENTS];
+
+    /* Replacement policy */
+    cache_policy_t policy;
+    const struct cache_policy_ops *ops;
+    void *policy_data;              /* Owned by the policy (ghosts, sketch, ...) */
 
     /* Size tracking */
     size_t current_size;            /* Total bytes currently cached */
-    size_t max_size;                /* Maximum cache size */
+    size_t max_size;                /* This shard's budget */
     int num_entries;                /* Number of cached files */
+    size_t payload_bytes;           /* Decoded payload bytes of the entries */
+    int num_compressed;             /* Entries stored as lz blocks */
+
+    /* Statistics: the cache's per-thread counters (cache_stat_t ids),
+       bumped under any lock or none */
+    stat_counters_t *counters;
 
-    /* Statistics */
-    unsigned long hits;             /* Cache hits */
-    unsigned long misses;           /* Cache misses */
-    unsigned long evictions;        /* Number of evictions */
+    /* Stale-while-revalidate window after expiry (ms, 0 = disabled),
+       and how long one revalidation may take before another is elected */
+    uint32_t stale_window_ms;
+    uint32_t revalidate_timeout_ms;
+
+    /* Entries with a TTL, by reclaim time */
+    cache_wheel_t wheel;
+
+    /* Disk tier shared by every shard (NULL if none) */
+    cache_l2_t *l2;
+
+    /* Lock-free hits (read_locked_hits policies): buffers and index
+       tables unlinked here are freed once no lookup can hold them */
+    bool lockfree_reads;            /* Lookups try the epoch path first */
+    epoch_list_t retired;
 
     /* Thread safety */
-    pthread_rwlock_t lock;          /* Read-write lock for concurrent access */
+    pthread_rwlock_t lock;          /* Read-write lock for this shard */
+
+} __attribute__((aligned(64))) cache_shard_t;
+
+/*
+ * cache_entry_at - Entry with a given id (NULL for CACHE_ENTRY_NIL)
+ */
+static inline cache_entry_t *cache_entry_at(const cache_shard_t *shard, uint32_t id) {
+    if (id == CACHE_ENTRY_NIL) {
+        return NULL;
+    }
+    return &shard->blocks[id / CACHE_ENTRY_BLOCK]->entries[id % CACHE_ENTRY_BLOCK];
+}
+
+/*
+ * cache_entry_cold - Cold data of an entry
+ */
+static inline cache_entry_cold_t *cache_entry_cold(const cache_shard_t *shard,
+                                                   const cache_entry_t *entry) {
+    return &shard->blocks[entry->id / CACHE_ENTRY_BLOCK]->cold[entry->id % CACHE_ENTRY_BLOCK];
+}
+
+/*
+ * Replacement policy interface
+ *
+ * cache.c keeps the hash table, sizes, TTLs and locking; the policy
+ * keeps entries on the shard's segment lists (and any private state in
+ * policy_data) and picks victims. All callbacks run under the shard's
+ * write lock, except on_hit when read_locked_hits is set: fresh hits
+ * then hold the read lock or no lock at all (lock-free reads), and
+ * on_hit must change nothing but the entry's freq, atomically. A
+ * lock-free hit may race with the entry's removal, so on_hit must not
+ * care whether the entry is still cached.
+ */
+typedef struct cache_policy_ops {
+    const char *name;
+    bool read_locked_hits;
+
+    /* Allocate / free policy_data (destroy must accept a failed init) */
+    bool (*init)(cache_shard_t *shard);
+    void (*destroy)(cache_shard_t *shard);
 
+    /* All entries are gone (cache_clear); reset private state */
+    void (*clear)(cache_shard_t *shard);
+
+    /* Every write-locked lookup, hit or miss (may be NULL) */
+    void (*on_access)(cache_shard_t *shard, unsigned long hash);
+
+    void (*on_hit)(cache_shard_t *shard, cache_entry_t *entry);
+
+    /* New entry (size set): put it on a segment list; false = no memory */
+    bool (*on_insert)(cache_shard_t *shard, cache_entry_t *entry, unsigned long hash);
+
+    /* Entry is leaving for any reason: unlink it */
+    void (*on_remove)(cache_shard_t *shard, cache_entry_t *entry);
+
+    /* Entry just inserted by cache_restore from a snapshot of this policy:
+       adopt its saved hit bits (may be NULL: freq is copied as is) */
+    void (*on_restore)(cache_shard_t *shard, cache_entry_t *entry, uint8_t freq);
+
+    /* Entry to evict next, never protect; NULL if none. The caller
+       frees the victim right away, so it may be remembered as a ghost. */
+    cache_entry_t *(*victim)(cache_shard_t *shard, cache_entry_t *protect);
+} cache_policy_ops_t;
+
+/*
+ * Cache - the main cache structure
+ *
+ * A key always maps to the same shard (cache_hash), so every operation
+ * on one key takes exactly one shard lock.
+ */
+typedef struct {
+    cache_shard_t *shards;          /* Array of num_shards shards */
+    int num_shards;
+    size_t max_size;                /* Sum of the shard budgets */
+    cache_policy_t policy;          /* Replacement policy of every shard */
+
+    /* Background expiry sweeper (cache_start_sweeper) */
+    pthread_t sweeper;
+    bool sweeper_running;
+    uint32_t sweep_interval_ms;
+    pthread_mutex_t sweeper_lock;
+    pthread_cond_t sweeper_wake;    /* Signalled to stop the sweeper */
+
+    /* Disk tier (cache_attach_disk), NULL if memory only */
+    cache_l2_t *l2;
+
+    /* Store compressible payloads as lz blocks (cache_set_compression) */
+    bool compress;
+
+    /* Statistics of every shard, one slot per thread (cache_stat_t ids) */
+    stat_counters_t counters;
+
+    /* Miss-ratio curve estimator, NULL if it could not be allocated */
+    mrc_t *mrc;
 } cache_t;
 
 /* ============================================================================
@@ -98,11 +483,69 @@ typedef struct {
  * @param max_size: Maximum cache size in bytes
  * @return: Pointer to cache, or NULL on error
  *
- * Allocate and initialize all structures.
- * Use a prime number for num_buckets (e.g., 1021).
+ * Uses DEFAULT_CACHE_SHARDS shards, halved until every shard gets at
+ * least CACHE_MIN_SHARD_SIZE bytes (small caches get a single shard and
+ * behave like one global LRU).
  */
 cache_t *cache_create(size_t max_size);
 
+/*
+ * cache_create_sharded - Create a cache with an explicit shard count
+ *
+ * @param max_size: Maximum cache size in bytes (split evenly across shards)
+ * @param num_shards: Number of shards (1 .. CACHE_MAX_SHARDS)
+ * @return: Pointer to cache, or NULL on error
+ *
+ * Each shard evicts on its own, so the largest cacheable entry is
+ * max_size / num_shards.
+ */
+cache_t *cache_create_sharded(size_t max_size, int num_shards);
+
+/*
+ * cache_create_with_policy - Create a cache with a replacement policy
+ *
+ * @param max_size: Maximum cache size in bytes
+ * @param num_shards: Number of shards (0 = choose like cache_create)
+ * @param policy: Replacement policy
+ * @return: Pointer to cache, or NULL on error
+ *
+ * With CACHE_POLICY_CLOCK, fresh hits take only the shard's read lock;
+ * eviction sweeps a circular array and gives referenced entries a
+ * second chance.
+ *
+ * With CACHE_POLICY_TINYLFU, new entries enter a window LRU (1% of each
+ * shard). An entry leaving the window only displaces the main area's
+ * eviction victim if the frequency sketch has seen it more often;
+ * otherwise it is dropped and counted in admission_rejects. The main
+ * area is a segmented LRU: probation, and protected for entries hit
+ * again.
+ *
+ * CACHE_POLICY_ARC, CACHE_POLICY_2Q and CACHE_POLICY_S3FIFO remember
+ * recently evicted keys (ghost lists) to recognise keys that come back.
+ * S3-FIFO hits, like CLOCK hits, only need the read lock.
+ *
+ * CACHE_POLICY_GDSF gives each entry the priority L + hits * cost /
+ * size, where cost is what cache_put_cost() was told refetching the
+ * entry takes, and evicts the lowest; L rises to each victim's priority,
+ * so entries that stop being hit age out. Large files have to be hit
+ * (or be slow to fetch) in proportion to their size to stay.
+ */
+cache_t *cache_create_with_policy(size_t max_size, int num_shards, cache_policy_t policy);
+
+/*
+ * cache_policy_name - Printable name of a policy (e.g. "LRU")
+ */
+const char *cache_policy_name(cache_policy_t policy);
+
+/*
+ * cache_policy_parse - Look up a policy by name (case-insensitive)
+ *
+ * @param name: Policy name as printed by cache_policy_name()
+ * @param policy: Output policy
+ * @return: true if the name is known
+ */
+bool cache_policy_parse(const char *name, cache_policy_t *policy);
+
 /*
  * cache_destroy - Destroy cache and free all memory
  *
@@ -123,17 +566,21 @@ void cache_destroy(cache_t *cache);
  *
  * On hit:
  * - Move entry to front of LRU list
- * - Update last_access timestamp
  * - Increment hits counter
  *
  * On miss:
  * - Increment misses counter
  *
+ * Expired entries (past their TTL) are removed and reported as a miss.
+ *
  * IMPORTANT: The returned data pointer is only valid while
- * holding the cache lock. For thread safety, consider returning
- * a copy of the data instead.
+ * holding the cache lock. For thread safety, use cache_acquire()
+ * (pinned, zero-copy) or cache_get_copy() instead. A compressed entry
+ * is decoded into a per-thread buffer, valid until the calling thread's
+ * next cache_get.
  *
- * Thread-safe: Uses read lock.
+ * Thread-safe: Uses the shard's write lock under LRU (the list is
+ * reordered on every hit); fresh CLOCK hits only need the read lock.
  */
 bool cache_get(cache_t *cache, const char *key, char **data, size_t *size);
 
@@ -151,6 +598,65 @@ bool cache_get(cache_t *cache, const char *key, char **data, size_t *size);
  */
 bool cache_get_copy(cache_t *cache, const char *key, char **data, size_t *size);
 
+/*
+ * cache_acquire - Look up and pin an entry's payload (zero-copy)
+ *
+ * @param cache: Cache
+ * @param key: Cache key
+ * @param handle: Output - pinned payload (release with cache_release!)
+ * @return: true if found, false otherwise (handle untouched)
+ *
+ * Counts as a hit or miss like cache_get. Instead of copying, the hit
+ * takes a reference on the payload, so the data can go straight to
+ * send()/writev() after the lock is released. If the entry is evicted,
+ * replaced or removed meanwhile, its memory is freed by the last
+ * cache_release() rather than by the cache (until then it is not
+ * counted in current_size).
+ */
+bool cache_acquire(cache_t *cache, const char *key, cache_handle_t *handle);
+
+/*
+ * cache_get_many - Look up and pin several entries (zero-copy)
+ *
+ * @param cache: Cache
+ * @param keys: Cache keys (NULL or too-long keys miss)
+ * @param n: Number of keys
+ * @param handles: Output - n handles; hits are pinned (release each
+ *                 with cache_release!), misses are zeroed
+ * @return: Number of hits
+ *
+ * Same as n cache_acquire calls, counted the same way, but the keys are
+ * taken CACHE_BATCH at a time and grouped by shard: each shard's lock is
+ * taken once per group, and every key's index group is prefetched
+ * before the first is probed. Expired entries on read-locked shards and
+ * misses with a disk tier fall back to the single-key path.
+ */
+size_t cache_get_many(cache_t *cache, const char *const *keys, size_t n,
+                      cache_handle_t *handles);
+
+/*
+ * cache_release - Unpin a payload
+ *
+ * @param handle: Handle filled by cache_acquire / cache_lookup_acquire
+ *
+ * Thread-safe, lock-free; the handle is cleared.
+ */
+void cache_release(cache_handle_t *handle);
+
+/*
+ * cache_contains - Check whether a fresh entry exists
+ *
+ * @param cache: Cache
+ * @param key: Cache key
+ * @return: true if cached and not expired
+ *
+ * Does not count as a hit or miss and does not change LRU order.
+ * Used by the prefetcher to skip files that are already cached.
+ *
+ * Thread-safe: Uses read lock.
+ */
+bool cache_contains(cache_t *cache, const char *key);
+
 /*
  * cache_put - Add an entry to the cache
  *
@@ -158,7 +664,8 @@ bool cache_get_copy(cache_t *cache, const char *key, char **data, size_t *size);
  * @param key: Cache key (file path)
  * @param data: File contents
  * @param size: Size of data
- * @return: true on success, false on error
+ * @return: true on success, false on error (including entries larger
+ *          than one shard's budget)
  *
  * Steps:
  * 1. If entry exists, update it
@@ -170,6 +677,378 @@ bool cache_get_copy(cache_t *cache, const char *key, char **data, size_t *size);
  */
 bool cache_put(cache_t *cache, const char *key, const char *data, size_t size);
 
+/*
+ * cache_put_ttl - Add an entry that expires after ttl_ms
+ *
+ * @param cache: Cache
+ * @param key: Cache key (file path)
+ * @param data: File contents
+ * @param size: Size of data
+ * @param ttl_ms: Lifetime in milliseconds (CACHE_TTL_NONE = never expires)
+ * @return: true on success, false on error
+ *
+ * cache_put_validated without a validator. Once expired, the entry is
+ * a miss for cache_get; its memory is reclaimed by that lookup or by
+ * cache_expire(), whichever comes first.
+ *
+ * Thread-safe: Uses write lock.
+ */
+bool cache_put_ttl(cache_t *cache, const char *key, const char *data, size_t size,
+                   uint32_t ttl_ms);
+
+/*
+ * cache_put_validated - Add an entry with a TTL and a validator
+ *
+ * @param cache: Cache
+ * @param key: Cache key (file path)
+ * @param data: File contents
+ * @param size: Size of data
+ * @param validator: File version (NULL if unknown)
+ * @param ttl_ms: Lifetime in milliseconds (CACHE_TTL_NONE = never expires)
+ * @return: true on success, false on error
+ *
+ * Same as cache_put, and also clears any in-flight revalidation flag.
+ *
+ * Thread-safe: Uses write lock.
+ */
+bool cache_put_validated(cache_t *cache, const char *key, const char *data,
+                         size_t size, const cache_validator_t *validator,
+                         uint32_t ttl_ms);
+
+/*
+ * cache_put_cost - Add an entry with a TTL, a validator and a refetch cost
+ *
+ * @param cache: Cache
+ * @param key: Cache key (file path)
+ * @param data: File contents
+ * @param size: Size of data
+ * @param validator: File version (NULL if unknown)
+ * @param ttl_ms: Lifetime in milliseconds (CACHE_TTL_NONE = never expires)
+ * @param cost_us: What fetching the file again would take, e.g. the
+ *                 measured backend latency (0 = CACHE_COST_DEFAULT)
+ * @return: true on success, false on error
+ *
+ * Same as cache_put_validated; the cost only matters to CACHE_POLICY_GDSF.
+ *
+ * Thread-safe: Uses write lock.
+ */
+bool cache_put_cost(cache_t *cache, const char *key, const char *data, size_t size,
+                    const cache_validator_t *validator, uint32_t ttl_ms, uint32_t cost_us);
+
+/*
+ * cache_put_many - Add several entries
+ *
+ * @param cache: Cache
+ * @param keys: Cache keys (NULL or too-long keys are skipped)
+ * @param data: Payloads
+ * @param sizes: Payload sizes
+ * @param n: Number of entries
+ * @return: Number of entries stored
+ *
+ * Same as n cache_put calls (of a repeated key, the last one wins), but
+ * the buffers are built before locking and each shard's write lock is
+ * taken once per CACHE_BATCH keys.
+ */
+size_t cache_put_many(cache_t *cache, const char *const *keys, const char *const *data,
+                      const size_t *sizes, size_t n);
+
+/*
+ * cache_lookup_copy - Freshness-aware lookup (stale-while-revalidate)
+ *
+ * @param cache: Cache
+ * @param key: Cache key
+ * @param data: Output - newly allocated copy of data (caller must free!)
+ * @param size: Output - size of data
+ * @param validator: Output - entry validator, zeroed if unknown (can be NULL)
+ * @return: FRESH, STALE or REVALIDATE with data filled; MISS otherwise
+ *
+ * An expired entry is still returned while it is inside the cache's
+ * stale window. Exactly one caller gets CACHE_LOOKUP_REVALIDATE and must
+ * finish with cache_put_validated(), cache_revalidated() or
+ * cache_revalidate_failed(); if it has not within the revalidate timeout,
+ * the next lookup is elected instead. Entries beyond the stale window are
+ * removed and reported as a miss, even while a revalidation is in
+ * flight, so staleness stays bounded.
+ *
+ * Thread-safe: Uses write lock.
+ */
+cache_lookup_t cache_lookup_copy(cache_t *cache, const char *key, char **data,
+                                 size_t *size, cache_validator_t *validator);
+
+/*
+ * cache_lookup_acquire - Freshness-aware lookup returning a pinned payload
+ *
+ * @param cache: Cache
+ * @param key: Cache key
+ * @param handle: Output - pinned payload (release with cache_release!)
+ * @param validator: Output - entry validator, zeroed if unknown (can be NULL)
+ * @return: Same as cache_lookup_copy
+ *
+ * cache_lookup_copy without the copy; see cache_acquire. A compressed
+ * entry is the exception: it is decoded (outside the shard lock) into a
+ * buffer owned by the handle.
+ */
+cache_lookup_t cache_lookup_acquire(cache_t *cache, const char *key, cache_handle_t *handle,
+                                    cache_validator_t *validator);
+
+/*
+ * cache_lookup_acquire_packed - cache_lookup_acquire without decoding
+ *
+ * @param cache: Cache
+ * @param key: Cache key
+ * @param handle: Output - pinned payload as stored; handle->compressed
+ *                tells whether data is an lz block (lz.h) or the file
+ * @param validator: Output - entry validator, zeroed if unknown (can be NULL)
+ * @return: Same as cache_lookup_copy
+ *
+ * For callers that can pass an lz block on as it is (the proxy, to
+ * clients that decode it themselves): nothing is copied or decoded.
+ */
+cache_lookup_t cache_lookup_acquire_packed(cache_t *cache, const char *key,
+                                           cache_handle_t *handle,
+                                           cache_validator_t *validator);
+
+/*
+ * cache_revalidated - Mark an entry fresh again (backend said NOT_MODIFIED)
+ *
+ * @param cache: Cache
+ * @param key: Cache key
+ * @param ttl_ms: New lifetime in milliseconds
+ * @return: true if the entry still exists
+ */
+bool cache_revalidated(cache_t *cache, const char *key, uint32_t ttl_ms);
+
+/*
+ * cache_revalidate_failed - Give up an in-flight revalidation
+ *
+ * @param cache: Cache
+ * @param key: Cache key
+ *
+ * The entry stays stale; a later lookup may try again.
+ */
+void cache_revalidate_failed(cache_t *cache, const char *key);
+
+/*
+ * cache_set_stale_window - Configure stale-while-revalidate
+ *
+ * @param cache: Cache
+ * @param window_ms: How long past expiry an entry may still be served
+ */
+void cache_set_stale_window(cache_t *cache, uint32_t window_ms);
+
+/*
+ * cache_set_revalidate_timeout - Bound the time one revalidation may take
+ *
+ * @param cache: Cache
+ * @param timeout_ms: Deadline after CACHE_LOOKUP_REVALIDATE (default
+ *                    CACHE_REVALIDATE_TIMEOUT_MS); a stale lookup past it
+ *                    gets CACHE_LOOKUP_REVALIDATE again
+ */
+void cache_set_revalidate_timeout(cache_t *cache, uint32_t timeout_ms);
+
+/*
+ * cache_expire - Reclaim every entry past its TTL and stale window
+ *
+ * @param cache: Cache
+ * @return: Number of entries removed (counted in expirations)
+ *
+ * Advances each shard's expiry wheel to the current time. The work is
+ * proportional to the time passed since the last call and to the
+ * entries reclaimed, not to the number of cached entries. Entries being
+ * revalidated are kept. Shrinking the stale window does not bring
+ * existing deadlines forward.
+ *
+ * Thread-safe: Takes each shard's write lock in turn.
+ */
+size_t cache_expire(cache_t *cache);
+
+/*
+ * cache_start_sweeper - Run cache_expire() periodically in a background thread
+ *
+ * @param cache: Cache
+ * @param interval_ms: Period (0 = CACHE_SWEEP_INTERVAL_MS)
+ * @return: true if the sweeper is running
+ *
+ * Stopped by cache_stop_sweeper() or cache_destroy().
+ */
+bool cache_start_sweeper(cache_t *cache, uint32_t interval_ms);
+
+/*
+ * cache_stop_sweeper - Stop the background sweeper and wait for it
+ *
+ * @param cache: Cache
+ */
+void cache_stop_sweeper(cache_t *cache);
+
+/*
+ * cache_snapshot - Write the cache's entries to a file for a warm restart
+ *
+ * @param cache: Cache
+ * @param path: File to write (built as path.tmp, then renamed over path)
+ * @return: Number of entries written, or -1 on error
+ *
+ * Stores each entry's key, payload, validator, remaining TTL and policy
+ * bits, shard by shard and hottest first. Payloads are written in the
+ * cache's own buffer layout, so cache_restore() can use them in place.
+ * Each shard is read-locked only while its buffers are pinned; the file
+ * is written afterwards, so lookups carry on meanwhile.
+ */
+long cache_snapshot(cache_t *cache, const char *path);
+
+/*
+ * cache_restore - Load a snapshot lazily
+ *
+ * @param cache: Cache (may already hold entries; those are kept)
+ * @param path: File written by cache_snapshot
+ * @return: Number of entries restored, or -1 if the file is missing or invalid
+ *
+ * Maps the file and indexes its entries without reading their payloads:
+ * hits are served straight from the mapping, and the OS pages each file
+ * in on first use. If the snapshot is larger than the cache, the entries
+ * that were hottest are restored. Recency order is kept, and CLOCK and
+ * S3-FIFO hit bits too when the cache uses the same policy. Expired
+ * entries come back expired and go through the usual stale handling.
+ *
+ * The mapping stays until the last restored buffer is released, so the
+ * file itself may be replaced (the next snapshot) right away.
+ */
+long cache_restore(cache_t *cache, const char *path);
+
+/*
+ * cache_attach_disk - Add a disk tier behind the memory cache
+ *
+ * @param cache: Cache (not yet shared with other threads)
+ * @param path: Log file on local disk (truncated; removed by cache_destroy)
+ * @param capacity: Bytes of disk to use
+ * @return: true if the tier is ready
+ *
+ * From then on, entries evicted from memory are handed to a writer
+ * thread by reference and appended to the log, so eviction never waits
+ * for the disk; if the writer falls more than CACHE_DISK_QUEUE_BYTES
+ * behind, further victims are dropped. A lookup that misses in memory
+ * checks the disk tier (and the writer's queue) before reporting a miss;
+ * a record found there is moved back to memory with its validator and
+ * expiry, and counts as a hit. A key lives in one tier at a time: puts,
+ * removes and promotions drop the disk copy.
+ */
+bool cache_attach_disk(cache_t *cache, const char *path, size_t capacity);
+
+/*
+ * cache_flush_disk - Wait until every queued eviction is on disk
+ *
+ * @param cache: Cache
+ */
+void cache_flush_disk(cache_t *cache);
+
+/*
+ * cache_set_compression - Store compressible payloads compressed
+ *
+ * @param cache: Cache
+ * @param enabled: true to compress later puts (off by default)
+ *
+ * Each put of at least CACHE_COMPRESS_MIN bytes compresses its first
+ * CACHE_COMPRESS_SAMPLE bytes; only if that shrinks to
+ * CACHE_COMPRESS_MAX_8THS eighths or less is the whole payload
+ * compressed, and it is kept compressed only if it meets the same
+ * bound. Images and archives thus cost one small sample and are stored
+ * as is. Compression runs before the shard lock is taken, and a
+ * compressed entry is charged at its compressed size, so the same
+ * max_size holds more files. Entries already cached keep their form;
+ * lookups decode transparently either way.
+ */
+void cache_set_compression(cache_t *cache, bool enabled);
+
+/*
+ * cache_set_lockfree_reads - Serve hits without taking the shard lock
+ *
+ * @param cache: Cache
+ * @param enabled: true to look up entries lock-free (the default)
+ *
+ * Only policies with read-locked hits (CLOCK, S3-FIFO) can: their hits
+ * change nothing but an entry's hit bits. A lookup then finds the entry
+ * inside an epoch section instead of under the read lock, so hits on
+ * one shard write no shared line but the hit counters. Writers still
+ * lock; whatever they unlink (payloads, index tables) is freed only
+ * after the lookups that may be using it have finished. Misses,
+ * expired entries and lookups that want the validator take the lock as
+ * before. Disabling it serves hits under the read lock again, e.g. for
+ * comparison.
+ */
+void cache_set_lockfree_reads(cache_t *cache, bool enabled);
+
+/*
+ * cache_chunk_key - Key of one chunk of a file
+ *
+ * @param buffer: Output buffer for the key
+ * @param buflen: Size of the buffer
+ * @param key: File key (path)
+ * @param index: Chunk number (byte offset / CACHE_CHUNK_SIZE)
+ * @return: Key length, or -1 if it does not fit
+ *
+ * Example output: "#3:/videos/big.mp4"
+ */
+int cache_chunk_key(char *buffer, size_t buflen, const char *key, uint64_t index);
+
+/*
+ * cache_put_chunks - Cache part of a large file as chunk entries
+ *
+ * @param cache: Cache
+ * @param key: File key (path)
+ * @param offset: File offset of data (a multiple of CACHE_CHUNK_SIZE)
+ * @param data: File bytes from offset on
+ * @param size: Number of bytes
+ * @param validator: File version; validator->size must be the file size
+ * @param ttl_ms: Lifetime of each chunk (CACHE_TTL_NONE = never expires)
+ * @param cost_us: Refetch cost of data (0 = unknown); each chunk is
+ *                 charged its share
+ * @return: Number of chunks stored
+ *
+ * Every chunk that data covers completely (or up to the end of the
+ * file) becomes an entry of its own, with the file's validator, so each
+ * chunk is admitted, hit, expired and evicted independently. A partial
+ * chunk at the end of data is not stored. Files need not fit in one
+ * shard's budget; only a chunk must.
+ */
+size_t cache_put_chunks(cache_t *cache, const char *key, uint64_t offset, const char *data,
+                        size_t size, const cache_validator_t *validator, uint32_t ttl_ms,
+                        uint32_t cost_us);
+
+/*
+ * cache_lookup_chunk - Freshness-aware lookup of one chunk, pinned
+ *
+ * @param cache: Cache
+ * @param key: File key (path)
+ * @param index: Chunk number
+ * @param handle: Output - pinned chunk bytes (release with cache_release!)
+ * @param validator: Output - the file version the chunk belongs to
+ *                   (validator->size is the file size; can be NULL)
+ * @return: Same as cache_lookup_acquire
+ *
+ * Chunks of one file may belong to different versions if the file
+ * changed while it was being cached; callers assembling a range compare
+ * the validators.
+ */
+cache_lookup_t cache_lookup_chunk(cache_t *cache, const char *key, uint64_t index,
+                                  cache_handle_t *handle, cache_validator_t *validator);
+
+/*
+ * cache_get_range - Copy a byte range of a chunked file out of the cache
+ *
+ * @param cache: Cache
+ * @param key: File key (path)
+ * @param offset: First byte wanted
+ * @param length: Bytes wanted (clipped at the end of the file)
+ * @param dst: Output buffer of length bytes
+ * @param validator: Output - version of the bytes copied (can be NULL)
+ * @return: Bytes copied: the longest prefix of the range whose chunks are
+ *          all cached, fresh and of one version
+ *
+ * Each chunk looked up counts as a hit or a miss; stale chunks count as
+ * missing (nobody is elected to revalidate them).
+ */
+size_t cache_get_range(cache_t *cache, const char *key, uint64_t offset, size_t length,
+                       char *dst, cache_validator_t *validator);
+
 /*
  * cache_remove - Remove an entry from the cache
  *
@@ -177,6 +1056,8 @@ bool cache_put(cache_t *cache, const char *key, const char *data, size_t size);
  * @param key: Cache key
  * @return: true if entry was found and removed, false if not found
  *
+ * Also drops the key from the disk tier, if any.
+ *
  * Thread-safe: Uses write lock.
  */
 bool cache_remove(cache_t *cache, const char *key);
@@ -187,6 +1068,7 @@ bool cache_remove(cache_t *cache, const char *key);
  * @param cache: Cache
  *
  * Reset to empty state, but keep the cache structure.
+ * Shards are cleared one at a time, not atomically.
  */
 void cache_clear(cache_t *cache);
 
@@ -201,58 +1083,122 @@ typedef struct {
     unsigned long hits;
     unsigned long misses;
     unsigned long evictions;
-    size_t current_size;
+    unsigned long stale_hits;
+    unsigned long expirations;
+    unsigned long admission_rejects;    /* W-TinyLFU candidates dropped */
+    size_t current_size;                /* Chunk bytes charged by entries */
     size_t max_size;
+    size_t payload_mapped;              /* Slab memory mapped (all caches) */
+    unsigned long disk_hits;            /* Memory misses served by the disk tier */
+    unsigned long disk_writes;          /* Evicted entries written to disk */
+    unsigned long disk_dropped;         /* Evicted entries not written (queue full) */
+    size_t disk_bytes;                  /* Bytes held by the disk tier */
+    size_t disk_entries;
+    size_t payload_size;                /* Decoded bytes of the cached payloads */
+    int compressed_entries;             /* Entries stored as lz blocks */
+    unsigned long compress_skipped;     /* Puts stored as is (incompressible) */
+    uint64_t hit_bytes;                 /* Payload bytes returned by hits */
+    uint64_t put_bytes;                 /* Payload bytes put: fills, prefetches, refreshes */
+    uint64_t miss_bytes;                /* Bytes fetched to answer misses, as reported
+                                           with cache_count_miss_bytes() */
     int num_entries;
+    int num_shards;
+    cache_policy_t policy;
     double hit_rate;            /* hits / (hits + misses) */
+    double byte_hit_rate;       /* hit_bytes / (hit_bytes + miss_bytes) */
+
+    /* Predicted LRU hit rate if max_size were mrc_size[i] (SHARDS) */
+    size_t mrc_size[CACHE_MRC_POINTS];
+    double mrc_hit_rate[CACHE_MRC_POINTS];
+    unsigned long mrc_samples;  /* Sampled requests behind the prediction */
 } cache_stats_t;
 
+/*
+ * cache_entry_charge - Bytes an entry counts against max_size
+ *
+ * @param key: Entry key
+ * @param size: Payload size
+ * @return: Size of the slab chunk holding the payload, key and header
+ */
+size_t cache_entry_charge(const char *key, size_t size);
+
 /*
  * cache_get_stats - Get cache statistics
  *
  * @param cache: Cache
  * @param stats: Output structure for statistics
+ *
+ * Sums the shards, locking one at a time. mrc_hit_rate[] covers the same
+ * requests as hit_rate (since creation or cache_reset_stats); it stays 0
+ * until a sampled key has been requested twice.
  */
 void cache_get_stats(cache_t *cache, cache_stats_t *stats);
 
 /*
- * cache_reset_stats - Reset hit/miss/eviction counters
+ * cache_reset_stats - Reset hit/miss/eviction counters and the
+ * miss-ratio curve
  *
  * @param cache: Cache
  */
 void cache_reset_stats(cache_t *cache);
 
+/*
+ * cache_count_miss_bytes - Record bytes fetched to answer a miss
+ *
+ * @param cache: Cache
+ * @param bytes: Payload bytes the caller had to fetch from elsewhere
+ *
+ * The cache cannot tell a fill that answers a miss from a prefetch or a
+ * refresh, so byte_hit_rate counts only what callers report here: the
+ * bytes a requester waited for, against hit_bytes served from memory.
+ */
+void cache_count_miss_bytes(cache_t *cache, size_t bytes);
+
 /* ============================================================================
  * Internal Functions
  * ============================================================================ */
 
 /*
- * cache_evict_lru - Evict the least recently used entry
+ * cache_evict_lru - Evict one entry of a shard
  *
- * @param cache: Cache (must hold write lock)
- * @return: true if an entry was evicted, false if cache was empty
+ * @param shard: Shard (must hold its write lock)
+ * @return: true if an entry was evicted, false if the shard was empty
  *
- * Remove the entry at LRU tail (least recently used).
+ * Asks the shard's policy for its victim: for LRU the list tail (least
+ * recently used), for CLOCK the first unreferenced entry under the hand,
+ * and so on.
  */
-bool cache_evict_lru(cache_t *cache);
+bool cache_evict_lru(cache_shard_t *shard);
 
 /*
- * cache_hash - Compute hash bucket index for a key
+ * cache_hash - Hash a key
  *
- * @param cache: Cache
  * @param key: Cache key
- * @return: Bucket index
+ * @return: Hash value; selects the shard and the bucket within it
+ *
+ * fast_hash_str(): seeded per process, so hashes are not comparable
+ * between processes.
  */
-int cache_hash(cache_t *cache, const char *key);
+unsigned long cache_hash(const char *key);
 
 /*
- * cache_move_to_front - Move entry to front of LRU list
+ * cache_move_to_front - Move entry to front of its shard's LRU list
  *
- * @param cache: Cache (must hold write lock)
+ * @param shard: Shard (must hold its write lock)
  * @param entry: Entry to move
  *
- * Called when an entry is accessed.
+ * Called when an entry is accessed; the policy's on_hit decides what
+ * "front" means (CLOCK only sets the reference bit, W-TinyLFU promotes
+ * probation entries to protected, ...).
+ */
+void cache_move_to_front(cache_shard_t *shard, cache_entry_t *entry);
+
+/*
+ * cache_policy_ops - Operations implementing a built-in policy
+ *
+ * @param policy: Policy
+ * @return: Operations table, or NULL for an unknown policy
  */
-void cache_move_to_front(cache_t *cache, cache_entry_t *entry);
+const cache_policy_ops_t *cache_policy_ops(cache_policy_t policy);
 
 #endif /* CACHE_H */
@@ -0,0 +1,201 @@
+/*
+ * cache_disk.h - Log-Structured Disk Tier
+ *
+ * This header defines the second cache level behind the in-memory cache
+ * (Part C). Entries evicted from RAM are appended to a log file on local
+ * disk instead of being dropped, so a working set much larger than
+ * DEFAULT_CACHE_SIZE is still served without a backend round trip.
+ *
+ * Features:
+ * - The log file is split into CACHE_DISK_SEGMENT_SIZE segments written
+ *   sequentially; when the log is full the oldest segment is reused and
+ *   everything in it is forgotten (FIFO, no compaction)
+ * - In-memory index (cache_index.h) from key hash to record position,
+ *   validator and expiry; records hold the payload buffer image, so a
+ *   read needs a single pread() and no parsing
+ * - Appending is split into cache_disk_append() (write the bytes) and
+ *   cache_disk_insert() (make them visible), so the caller decides when
+ *   a written record may be found
+ * - Reads check the segment generation after pread(), so a read racing
+ *   with the reuse of its segment reports a miss instead of wrong data
+ *
+ * The file is scratch space: it is truncated when opened and removed when
+ * closed. Thread-safe: one mutex for the index; disk I/O runs outside it.
+ */
+
+#ifndef CACHE_DISK_H
+#define CACHE_DISK_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "cache.h"
+#include "cache_index.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Log segment size: the unit of sequential writing and of reclaiming */
+#define CACHE_DISK_SEGMENT_SIZE     (8 * 1024 * 1024)
+
+/* Disk tier size used by the proxy (-d) */
+#define DEFAULT_DISK_CACHE_SIZE     (512 * 1024 * 1024)
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct cache_disk_item cache_disk_item_t;
+
+/*
+ * Where a record is, and what the cache needs to know about it
+ */
+typedef struct {
+    uint64_t offset;                /* Position in the log file */
+    size_t length;                  /* Record bytes */
+    uint32_t segment;
+    uint64_t generation;            /* Segment generation the record belongs to */
+    uint64_t expires_ms;            /* Monotonic expiry, CACHE_TTL_NONE = never */
+    cache_validator_t validator;
+    bool has_validator;
+} cache_disk_loc_t;
+
+/*
+ * One log segment
+ */
+typedef struct {
+    uint64_t generation;            /* Bumped every time the segment is reused */
+    cache_disk_item_t *items;       /* Indexed records in this segment */
+    size_t bytes;                   /* Bytes of indexed records */
+} cache_disk_segment_t;
+
+typedef struct {
+    int fd;
+    char *path;
+    size_t capacity;                /* num_segments * CACHE_DISK_SEGMENT_SIZE */
+
+    pthread_mutex_t lock;           /* Index, segments and counters */
+    cache_index_t index;            /* hash -> cache_disk_item_t */
+    cache_disk_segment_t *segments;
+    uint32_t num_segments;
+    uint32_t head_segment;          /* Segment being appended to */
+    size_t head_offset;             /* Next free byte in it */
+
+    /* Statistics */
+    size_t bytes;                   /* Bytes of indexed records */
+    unsigned long writes;           /* Records appended */
+    unsigned long reads;            /* Records read back */
+    unsigned long reclaimed;        /* Records lost to segment reuse */
+} cache_disk_t;
+
+/*
+ * Disk tier statistics
+ */
+typedef struct {
+    size_t capacity;
+    size_t bytes;
+    size_t entries;
+    unsigned long writes;
+    unsigned long reads;
+    unsigned long reclaimed;
+} cache_disk_stats_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/*
+ * cache_disk_open - Create an empty disk tier backed by a file
+ *
+ * @param path: Log file (created or truncated)
+ * @param capacity: Bytes of disk to use (at least two segments are used)
+ * @return: Pointer to disk tier, or NULL on error
+ */
+cache_disk_t *cache_disk_open(const char *path, size_t capacity);
+
+/*
+ * cache_disk_close - Close the tier and remove its file
+ *
+ * @param disk: Disk tier (NULL is ignored)
+ */
+void cache_disk_close(cache_disk_t *disk);
+
+/*
+ * cache_disk_append - Write a record at the head of the log
+ *
+ * @param disk: Disk tier
+ * @param head: First part of the record (e.g. a header copied by the caller)
+ * @param head_len: Its size
+ * @param body: Rest of the record
+ * @param body_len: Its size (the total is at most CACHE_DISK_SEGMENT_SIZE)
+ * @param loc: Output - where it was written (offset, length, segment)
+ * @return: true if written
+ *
+ * Moving to the next segment forgets whatever that segment held. The
+ * record cannot be found until cache_disk_insert(). Appends must not run
+ * concurrently with each other.
+ */
+bool cache_disk_append(cache_disk_t *disk, const void *head, size_t head_len,
+                       const void *body, size_t body_len, cache_disk_loc_t *loc);
+
+/*
+ * cache_disk_insert - Index an appended record under a key hash
+ *
+ * @param disk: Disk tier
+ * @param hash: Key hash (replaces any record with the same hash)
+ * @param loc: Filled by cache_disk_append, plus expiry and validator
+ * @return: true if indexed (false if its segment was reused meanwhile,
+ *          or out of memory)
+ */
+bool cache_disk_insert(cache_disk_t *disk, uint64_t hash, const cache_disk_loc_t *loc);
+
+/*
+ * cache_disk_find - Look up the record of a key hash
+ *
+ * @param disk: Disk tier
+ * @param hash: Key hash
+ * @param loc: Output - record location and metadata
+ * @return: true if indexed
+ *
+ * Hash-only: the caller checks the key stored in the record.
+ */
+bool cache_disk_find(cache_disk_t *disk, uint64_t hash, cache_disk_loc_t *loc);
+
+/*
+ * cache_disk_read - Read a record found by cache_disk_find
+ *
+ * @param disk: Disk tier
+ * @param loc: Record
+ * @param dst: Output buffer of loc->length bytes
+ * @return: true if read and its segment was not reused meanwhile
+ */
+bool cache_disk_read(cache_disk_t *disk, const cache_disk_loc_t *loc, void *dst);
+
+/*
+ * cache_disk_remove - Forget the record of a key hash
+ *
+ * @param disk: Disk tier
+ * @param hash: Key hash
+ * @param expected: Only remove the record at this location (NULL = any)
+ * @return: true if a record was removed
+ */
+bool cache_disk_remove(cache_disk_t *disk, uint64_t hash, const cache_disk_loc_t *expected);
+
+/*
+ * cache_disk_clear - Forget every record (the file is kept)
+ *
+ * @param disk: Disk tier
+ */
+void cache_disk_clear(cache_disk_t *disk);
+
+/*
+ * cache_disk_get_stats - Snapshot disk tier statistics
+ *
+ * @param disk: Disk tier
+ * @param stats: Output
+ */
+void cache_disk_get_stats(cache_disk_t *disk, cache_disk_stats_t *stats);
+
+#endif /* CACHE_DISK_H */
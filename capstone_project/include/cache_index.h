@@ -0,0 +1,169 @@
+/*
+ * cache_index.h - Open-Addressing Key Index
+ *
+ * This header defines the hash index used by each cache shard (Part C)
+ * to find entries by key. It replaces the fixed-size chained table,
+ * whose chains grew with the number of entries and whose every step
+ * chased a pointer into an entry to compare a key.
+ *
+ * Features:
+ * - Swiss-table layout: one control byte per slot (empty, deleted, or a
+ *   7-bit tag of the hash), probed a group of CACHE_INDEX_GROUP slots at a
+ *   time (SSE2 when available)
+ * - Each slot keeps the full 64-bit hash, so the caller's key comparison
+ *   only runs when the hashes are equal
+ * - Incremental resize: when the table fills up a larger one is
+ *   allocated and the old one is drained a few groups per insert or
+ *   remove, so no single operation pays for rehashing everything
+ *
+ * Items are opaque pointers. Updates need exclusion. Lookups never
+ * modify the index, so they may run concurrently with each other, and
+ * also with an update when the owner sets 'retired' (epoch.h): tables
+ * are published by pointer and replaced ones are retired, not freed.
+ * Such a lock-free lookup can miss an item that an update is moving
+ * between tables, so the owner confirms its misses under the lock.
+ */
+
+#ifndef CACHE_INDEX_H
+#define CACHE_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "epoch.h"
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Slots probed together (one SSE2 register of control bytes) */
+#define CACHE_INDEX_GROUP           16
+
+/* Maximum fill (full + deleted slots), in eighths of the capacity */
+#define CACHE_INDEX_MAX_LOAD_8THS   7
+
+/* Old-table groups moved to the new table per update while resizing */
+#define CACHE_INDEX_MIGRATE_GROUPS  2
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct {
+    uint64_t hash;                  /* Full hash, as given by the caller */
+    void *item;
+} cache_index_slot_t;
+
+/*
+ * One open-addressing table, allocated in one piece with its arrays
+ */
+typedef struct {
+    uint8_t *ctrl;                  /* Control byte per slot (16-byte aligned) */
+    cache_index_slot_t *slots;
+    size_t capacity;                /* Slots; power of two, >= CACHE_INDEX_GROUP */
+    size_t used;                    /* Full slots */
+    size_t deleted;                 /* Tombstones */
+} cache_index_table_t;
+
+typedef struct {
+    cache_index_table_t *cur;       /* Receives every insert */
+    cache_index_table_t *old;       /* Being drained (NULL if not resizing) */
+    size_t migrate_group;           /* Next group of 'old' to move */
+    size_t count;                   /* Items in both tables */
+    unsigned long resizes;
+    epoch_list_t *retired;          /* Drained tables go here (NULL: freed at once) */
+} cache_index_t;
+
+/*
+ * Key comparison callback: does 'item' have key 'key'?
+ */
+typedef bool (*cache_index_match_fn)(const void *item, const void *key);
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/*
+ * cache_index_init - Initialize an empty index
+ *
+ * @param index: Index to initialize
+ * @param capacity: Initial slots (rounded up to a power of two)
+ * @return: true on success, false if out of memory
+ */
+bool cache_index_init(cache_index_t *index, size_t capacity);
+
+/*
+ * cache_index_destroy - Free an index's tables (not the items)
+ *
+ * @param index: Index
+ */
+void cache_index_destroy(cache_index_t *index);
+
+/*
+ * cache_index_clear - Remove every item, keeping the current capacity
+ *
+ * @param index: Index
+ */
+void cache_index_clear(cache_index_t *index);
+
+/*
+ * cache_index_find - Find the item with a key
+ *
+ * @param index: Index
+ * @param hash: Hash of the key
+ * @param match: Called for items whose full hash equals 'hash'
+ * @param key: Passed to match
+ * @return: The item, or NULL
+ *
+ * Does not modify the index. Without the owner's lock (see above), call
+ * it inside an epoch section; match may then see items being changed.
+ */
+void *cache_index_find(const cache_index_t *index, uint64_t hash,
+                       cache_index_match_fn match, const void *key);
+
+/*
+ * cache_index_prefetch - Start loading the slots a lookup of 'hash' probes first
+ *
+ * @param index: Index
+ * @param hash: Hash of the key
+ *
+ * Issues prefetches for the control bytes and slots of the key's first
+ * group, so that several lookups can wait on memory at the same time.
+ * Reads the table like cache_index_find, with the same locking rules.
+ */
+void cache_index_prefetch(const cache_index_t *index, uint64_t hash);
+
+/*
+ * cache_index_peek - The item a lookup of 'hash' would most likely return
+ *
+ * @param index: Index
+ * @param hash: Hash of the key
+ * @return: The first item in the key's first group with this full hash,
+ *          or NULL; match is not called, so it may not be the key's
+ *
+ * For prefetching the item before the real lookup. Same locking rules
+ * as cache_index_find.
+ */
+void *cache_index_peek(const cache_index_t *index, uint64_t hash);
+
+/*
+ * cache_index_insert - Add an item (the caller ensures its key is absent)
+ *
+ * @param index: Index
+ * @param hash: Hash of the item's key
+ * @param item: Item
+ * @return: true on success, false if a resize ran out of memory
+ */
+bool cache_index_insert(cache_index_t *index, uint64_t hash, void *item);
+
+/*
+ * cache_index_remove - Remove an item
+ *
+ * @param index: Index
+ * @param hash: Hash the item was inserted with
+ * @param item: Item (compared by pointer)
+ * @return: true if it was found
+ */
+bool cache_index_remove(cache_index_t *index, uint64_t hash, const void *item);
+
+#endif /* CACHE_INDEX_H */
@@ -0,0 +1,38 @@
+/*
+ * cache_sim.h - Cache Hooks for the Simulator
+ *
+ * This header declares the parts of cache.c that only the trace-driven
+ * simulator (cache_sim) and the tests use. They are kept out of cache.h
+ * because they break what cache.h promises: an entry put here has no
+ * payload, so reading it returns whatever the memory held before.
+ */
+
+#ifndef CACHE_SIM_H
+#define CACHE_SIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "cache.h"
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/*
+ * cache_put_sized - Add an entry of a given size without copying a payload
+ *
+ * @param cache: Cache
+ * @param key: Cache key (file path)
+ * @param size: Payload size to account for
+ * @return: true on success, false on error
+ *
+ * Same as cache_put, charged and evicted exactly like a real payload of
+ * size bytes, but the payload is never written: lookups report the size
+ * and the data are whatever the memory held. Replays measure policies,
+ * not contents, so they skip the copy; nothing may read these entries.
+ *
+ * Thread-safe: Uses write lock.
+ */
+bool cache_put_sized(cache_t *cache, const char *key, size_t size);
+
+#endif /* CACHE_SIM_H */
@@ -0,0 +1,122 @@
+/*
+ * epoch.h - Epoch-Based Reclamation
+ *
+ * This header defines the deferred-free scheme behind the cache's
+ * lock-free lookups (Part C). Even a read lock is a write: every
+ * rdlock/unlock is an atomic update of the lock word, whose cache line
+ * then bounces between all the cores serving hits. A reader that takes
+ * no lock at all must instead be sure that nothing it is looking at is
+ * freed under it; epochs provide that guarantee.
+ *
+ * A reader brackets its traversal with epoch_enter() / epoch_exit().
+ * A writer that unlinks something a reader may still hold passes it to
+ * epoch_retire() instead of freeing it; it is freed once every reader
+ * that could have seen it has left its section.
+ *
+ * Features:
+ * - Process-wide, like the payload slabs: every cache shares one global
+ *   epoch, and a thread registers on its first epoch_enter()
+ * - Readers only write their own cache-line-sized record, so readers on
+ *   different cores never touch a common line
+ * - The global epoch advances when every thread inside a section has
+ *   seen the current one; an object retired in epoch e is freed once
+ *   the epoch reaches e + 2
+ * - Retired objects wait on a list owned by the writer (epoch_list_t),
+ *   so writers that already hold a lock need no other lock to retire
+ *
+ * epoch_enter / epoch_exit are thread-safe and may nest. An epoch_list_t
+ * is not thread-safe: its owner serializes access (a cache shard's write
+ * lock). A thread inside a section must not wait for a writer, or the
+ * writer's frees can be delayed indefinitely.
+ */
+
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* A list tries to free its objects each time this many more are retired */
+#define EPOCH_RECLAIM_BATCH     16
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+/*
+ * An object waiting for its readers to leave
+ */
+typedef struct {
+    void *ptr;
+    void (*free_fn)(void *ptr);
+    uint64_t epoch;                 /* Global epoch when it was retired */
+} epoch_retired_t;
+
+/*
+ * Retired objects of one owner, oldest first (zero-initialize)
+ */
+typedef struct {
+    epoch_retired_t *items;
+    size_t count;
+    size_t capacity;
+    unsigned long freed;            /* Objects freed so far */
+} epoch_list_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/*
+ * epoch_enter - Start a read-side section
+ *
+ * @return: true on success; false if the thread's record could not be
+ *          allocated, and the caller must take its lock instead
+ *
+ * Objects reachable once this returns are not freed before the matching
+ * epoch_exit(). Writes only the calling thread's record.
+ */
+bool epoch_enter(void);
+
+/*
+ * epoch_exit - End a read-side section (after a successful epoch_enter)
+ */
+void epoch_exit(void);
+
+/*
+ * epoch_retire - Free an unlinked object once no reader can hold it
+ *
+ * @param list: Owner's list of retired objects
+ * @param free_fn: Called with ptr when it is safe
+ * @param ptr: Object, already unreachable for new readers
+ *
+ * Every EPOCH_RECLAIM_BATCH objects this runs epoch_reclaim(). If the
+ * list cannot grow, it waits for the current readers instead and frees
+ * ptr at once.
+ */
+void epoch_retire(epoch_list_t *list, void (*free_fn)(void *ptr), void *ptr);
+
+/*
+ * epoch_reclaim - Free the retired objects no reader can hold any more
+ *
+ * @param list: Owner's list
+ * @return: Objects freed
+ *
+ * Advances the global epoch first, if every reader has caught up.
+ */
+size_t epoch_reclaim(epoch_list_t *list);
+
+/*
+ * epoch_drain - Free every retired object of a list and the list itself
+ *
+ * @param list: Owner's list
+ *
+ * For teardown: the caller guarantees no reader can reach the objects.
+ */
+void epoch_drain(epoch_list_t *list);
+
+#endif /* EPOCH_H */
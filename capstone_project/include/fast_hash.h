@@ -0,0 +1,73 @@
+/*
+ * fast_hash.h - Seeded 64-bit Hashing
+ *
+ * This header defines the hash behind the cache's keys, the proxy's
+ * hash tables and compute_file_hash (Parts C and D). It replaces djb2,
+ * which reads one byte per step through a chain of dependent multiplies
+ * and, with its fixed start value, lets anyone who can choose request
+ * paths compute colliding keys offline and pile them into one bucket.
+ *
+ * Features:
+ * - wyhash-style core: 16 bytes per step, folded with a 64x64->128 bit
+ *   multiply, three independent chains for inputs over 48 bytes
+ * - Long inputs (FAST_HASH_LONG bytes and up) go through an xxh3-style
+ *   accumulator of eight 64-bit lanes; with SSE2 two lanes are updated
+ *   per instruction. Both paths compute the same value
+ * - Per-process random seed (fast_hash_seed): values change from one run
+ *   to the next, so collisions cannot be precomputed. Anything that
+ *   stores hashes (snapshots) must recompute them on load. FAST_HASH_SEED
+ *   fixes it for reproducible runs
+ *
+ * Not a cryptographic hash: it resists accidental and blind collisions,
+ * not an attacker who can observe hash values.
+ */
+
+#ifndef FAST_HASH_H
+#define FAST_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Inputs this long or longer use the lane accumulator */
+#define FAST_HASH_LONG          1024
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/*
+ * fast_hash - Hash a buffer
+ *
+ * @param data: Bytes to hash
+ * @param len: Number of bytes
+ * @param seed: Any value; different seeds give unrelated hashes
+ * @return: 64-bit hash
+ */
+uint64_t fast_hash(const void *data, size_t len, uint64_t seed);
+
+/*
+ * fast_hash_seed - This process's random seed
+ *
+ * @return: A value drawn from the kernel's random source on first use,
+ *          fixed for the rest of the process
+ *
+ * If the FAST_HASH_SEED environment variable is set (strtoull syntax)
+ * when the first hash is computed, it is used instead: runs that depend
+ * on which keys collide or are sampled (tests, cache_sim) become
+ * reproducible. Never set it on a proxy facing clients.
+ */
+uint64_t fast_hash_seed(void);
+
+/*
+ * fast_hash_str - Hash a string with the process seed
+ *
+ * @param str: NUL-terminated string
+ * @return: fast_hash(str, strlen(str), fast_hash_seed())
+ */
+uint64_t fast_hash_str(const char *str);
+
+#endif /* FAST_HASH_H */
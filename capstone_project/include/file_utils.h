@@ -9,6 +9,7 @@
 #define FILE_UTILS_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 /* ============================================================================
@@ -92,6 +93,19 @@ int file_exists(const char *filepath);
  */
 int is_regular_file(const char *filepath);
 
+/*
+ * get_file_version - Get the modification time and size of a file
+ *
+ * @param filepath: Path to file
+ * @param mtime_ns: Output - last modification time in nanoseconds
+ * @param size: Output - file size in bytes
+ * @return: 0 on success, -1 on error
+ *
+ * Together these form the validator sent with GETFILE responses.
+ * Uses a single stat() so both values describe the same version.
+ */
+int get_file_version(const char *filepath, int64_t *mtime_ns, size_t *size);
+
 /* ============================================================================
  * File I/O Functions
  * ============================================================================ */
@@ -135,8 +149,9 @@ int write_buffer_to_file(const char *filepath, const char *buffer, size_t size);
  * @param path: File path
  * @return: Hash value
  *
- * This is used to index into the cache hash table.
- * A simple hash like djb2 is sufficient.
+ * This is used to index into the cache hash table. The hash is seeded
+ * per process (fast_hash.h): do not store it or send it to another
+ * process.
  */
 unsigned long compute_file_hash(const char *path);
 
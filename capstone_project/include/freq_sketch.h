@@ -0,0 +1,94 @@
+/*
+ * freq_sketch.h - Count-Min Frequency Sketch
+ *
+ * This header defines the approximate access-frequency filter used by the
+ * cache's W-TinyLFU admission policy (Part C). It answers "roughly how
+ * often has this key been requested recently?" in a few bytes per key.
+ *
+ * Features:
+ * - FREQ_SKETCH_DEPTH rows of saturating counters (max FREQ_SKETCH_MAX);
+ *   the estimate is the smallest of the key's counters
+ * - Aging: after sample_size increments every counter is halved, so
+ *   keys that were popular long ago fade out
+ *
+ * Not thread-safe: the owner (a cache shard) serializes access.
+ */
+
+#ifndef FREQ_SKETCH_H
+#define FREQ_SKETCH_H
+
+#include <stdint.h>
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Counter rows (independent hash functions) */
+#define FREQ_SKETCH_DEPTH       4
+
+/* Counters saturate here (4-bit counters, as in TinyLFU) */
+#define FREQ_SKETCH_MAX         15
+
+/* Aging period, in increments per counter of one row */
+#define FREQ_SKETCH_SAMPLE_MULT 10
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct {
+    uint8_t *counters;              /* FREQ_SKETCH_DEPTH rows of width counters */
+    uint32_t width;                 /* Counters per row (power of two) */
+    uint32_t additions;             /* Increments since the last aging */
+    uint32_t sample_size;           /* Age when additions reaches this */
+    unsigned long resets;           /* Number of agings so far */
+} freq_sketch_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/*
+ * freq_sketch_create - Create a sketch
+ *
+ * @param width: Counters per row; rounded up to a power of two. About the
+ *               number of distinct keys the owner can hold is a good size.
+ * @return: Pointer to sketch, or NULL on error
+ */
+freq_sketch_t *freq_sketch_create(uint32_t width);
+
+/*
+ * freq_sketch_destroy - Free a sketch
+ *
+ * @param sketch: Sketch
+ */
+void freq_sketch_destroy(freq_sketch_t *sketch);
+
+/*
+ * freq_sketch_increment - Record one access to a key
+ *
+ * @param sketch: Sketch
+ * @param hash: Hash of the key
+ *
+ * May halve all counters (aging) when the sample size is reached.
+ */
+void freq_sketch_increment(freq_sketch_t *sketch, uint64_t hash);
+
+/*
+ * freq_sketch_estimate - Estimated recent accesses of a key
+ *
+ * @param sketch: Sketch
+ * @param hash: Hash of the key
+ * @return: Estimate (0 .. FREQ_SKETCH_MAX); never below the true count
+ *          since the last aging, but may be above it on collisions
+ */
+uint8_t freq_sketch_estimate(const freq_sketch_t *sketch, uint64_t hash);
+
+/*
+ * freq_sketch_clear - Forget all frequencies
+ *
+ * @param sketch: Sketch
+ */
+void freq_sketch_clear(freq_sketch_t *sketch);
+
+#endif /* FREQ_SKETCH_H */
@@ -0,0 +1,162 @@
+/*
+ * hedge.h - Hedged Backend Requests
+ *
+ * This header defines the bookkeeping for request hedging in the proxy
+ * (Part C). If the first backend has not answered within a delay derived
+ * from recent latencies (p95), the proxy sends the same request to a
+ * second replica and uses whichever answers first.
+ *
+ * Features:
+ * - Sliding window of recent backend latencies, p95 recomputed lazily
+ * - Hedge budget: every request earns a fraction of a token, every hedge
+ *   spends a whole one, so hedges stay below max_ratio of requests
+ * - Statistics on how often hedges were sent and how often they won
+ *
+ * The sockets themselves are handled by the proxy; this module only
+ * decides when to hedge.
+ */
+
+#ifndef HEDGE_H
+#define HEDGE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Latency samples kept for the percentile */
+#define HEDGE_WINDOW            512
+
+/* Samples needed before the p95 is trusted */
+#define HEDGE_MIN_SAMPLES       20
+
+/* Recompute the p95 after this many new samples */
+#define HEDGE_RECOMPUTE_EVERY   32
+
+/* Delay used until enough samples exist (milliseconds) */
+#define DEFAULT_HEDGE_DELAY_MS  50
+
+/* Default cap on hedges as a share of requests */
+#define DEFAULT_HEDGE_RATIO     0.05
+
+/* Unused budget that may accumulate (tokens = hedges) */
+#define HEDGE_MAX_TOKENS        10.0
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct {
+    /* Latency window (microseconds, ring buffer) */
+    uint32_t samples[HEDGE_WINDOW];
+    int next_sample;                /* Ring position */
+    int num_samples;                /* Valid samples (<= HEDGE_WINDOW) */
+    int since_recompute;            /* Samples since p95 was updated */
+    uint32_t p95_us;                /* Cached percentile */
+
+    /* Configuration */
+    double max_ratio;               /* Hedges per request allowed */
+    uint32_t default_delay_ms;      /* Delay before the window fills */
+
+    /* Budget */
+    double tokens;                  /* Hedges currently allowed */
+
+    /* Statistics */
+    unsigned long requests;         /* Backend fetches */
+    unsigned long hedges_sent;      /* Duplicate requests issued */
+    unsigned long hedges_won;       /* Duplicate answered first */
+    unsigned long hedges_denied;    /* Slow requests not hedged (budget) */
+
+    pthread_mutex_t lock;
+
+} hedge_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/*
+ * hedge_create - Create hedging state
+ *
+ * @param max_ratio: Upper bound on hedges / requests (e.g. 0.05)
+ * @param default_delay_ms: Hedge delay until the latency window fills
+ * @return: Pointer to state, or NULL on error
+ */
+hedge_t *hedge_create(double max_ratio, uint32_t default_delay_ms);
+
+/*
+ * hedge_destroy - Free hedging state
+ *
+ * @param h: Hedging state
+ */
+void hedge_destroy(hedge_t *h);
+
+/*
+ * hedge_begin_request - Note a backend fetch and get the hedge delay
+ *
+ * @param h: Hedging state
+ * @return: Milliseconds to wait for the first backend before hedging
+ *
+ * Also earns max_ratio of a hedge token.
+ *
+ * Thread-safe.
+ */
+uint32_t hedge_begin_request(hedge_t *h);
+
+/*
+ * hedge_try_acquire - Spend budget on one hedge
+ *
+ * @param h: Hedging state
+ * @return: true if a duplicate request may be sent
+ *
+ * Thread-safe.
+ */
+bool hedge_try_acquire(hedge_t *h);
+
+/*
+ * hedge_record_latency - Add one backend response time
+ *
+ * @param h: Hedging state
+ * @param latency_us: Time from sending the request to the first response byte
+ *
+ * Thread-safe.
+ */
+void hedge_record_latency(hedge_t *h, uint64_t latency_us);
+
+/*
+ * hedge_record_win - The hedged duplicate answered first
+ *
+ * @param h: Hedging state
+ *
+ * Thread-safe.
+ */
+void hedge_record_win(hedge_t *h);
+
+/* ============================================================================
+ * Statistics Functions
+ * ============================================================================ */
+
+/*
+ * Hedging statistics structure
+ */
+typedef struct {
+    unsigned long requests;
+    unsigned long hedges_sent;
+    unsigned long hedges_won;
+    unsigned long hedges_denied;
+    uint32_t p95_us;
+    double hedge_rate;          /* hedges_sent / requests */
+} hedge_stats_t;
+
+/*
+ * hedge_get_stats - Get hedging statistics
+ *
+ * @param h: Hedging state
+ * @param stats: Output structure for statistics
+ */
+void hedge_get_stats(hedge_t *h, hedge_stats_t *stats);
+
+#endif /* HEDGE_H */
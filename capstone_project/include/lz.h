@@ -0,0 +1,96 @@
+/*
+ * lz.h - Byte-Oriented LZ Compression
+ *
+ * This header defines the small block codec the cache (Part C) uses to
+ * store payloads compressed. It is built in rather than linked from a
+ * library, and it is tuned for decode speed: a cached file is compressed
+ * once and decompressed on every hit.
+ *
+ * Features:
+ * - LZ77 with a 64 KB window and a single-probe hash table; no entropy
+ *   coding, so decoding is a loop of memcpy() calls
+ * - Self-describing blocks: a block starts with the decoded length, so
+ *   the receiver of a block needs nothing else to decode it
+ * - Incompressible input is detected cheaply: the compressor gives up
+ *   as soon as the output would exceed the capacity the caller allows,
+ *   and skips ahead faster the longer it finds no match
+ * - The decoder checks every length and offset, so a corrupt block is
+ *   reported instead of read or written out of bounds
+ *
+ * Block format (all integers little-endian):
+ *   u32 decoded_length
+ *   sequences, each:
+ *     token: high nibble = literal count, low nibble = match length - 4
+ *            (15 in either nibble: more length bytes follow, each added,
+ *            until one below 255)
+ *     [literal count extra bytes] literals
+ *     u16 match offset (1..65535) [match length extra bytes]
+ *   The last sequence has literals only and ends the block.
+ *
+ * Thread-safe: no shared state.
+ */
+
+#ifndef LZ_H
+#define LZ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Block header: the decoded length */
+#define LZ_HEADER_SIZE      4
+
+/* Shortest match worth encoding */
+#define LZ_MIN_MATCH        4
+
+/* Largest input accepted (the header holds 32 bits) */
+#define LZ_MAX_INPUT        UINT32_MAX
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/*
+ * lz_bound - Largest block lz_compress() can produce
+ *
+ * @param size: Input bytes
+ * @return: Worst-case block size (input that does not compress at all)
+ */
+size_t lz_bound(size_t size);
+
+/*
+ * lz_compress - Compress a buffer into a block
+ *
+ * @param src: Input
+ * @param size: Input bytes (at most LZ_MAX_INPUT)
+ * @param dst: Output
+ * @param capacity: Output bytes available; use lz_bound(size) to always
+ *                  succeed, or less to give up on poorly compressible data
+ * @return: Block size, or 0 if the block would not fit in capacity
+ */
+size_t lz_compress(const void *src, size_t size, void *dst, size_t capacity);
+
+/*
+ * lz_decoded_size - Decoded length announced by a block
+ *
+ * @param block: Block
+ * @param size: Block bytes
+ * @return: Decoded length, or SIZE_MAX if too short to be a block
+ */
+size_t lz_decoded_size(const void *block, size_t size);
+
+/*
+ * lz_decompress - Decode a block
+ *
+ * @param block: Block
+ * @param size: Block bytes
+ * @param dst: Output of lz_decoded_size(block, size) bytes
+ * @return: true if the block was well formed and filled dst exactly
+ */
+bool lz_decompress(const void *block, size_t size, void *dst);
+
+#endif /* LZ_H */
@@ -0,0 +1,178 @@
+/*
+ * mrc.h - Online Miss-Ratio Curve Estimation (SHARDS)
+ *
+ * This header defines the estimator behind the cache's predicted hit
+ * rates (Part C). It answers "what would the hit rate be if max_size
+ * were 0.5x or 2x what it is?" from the live request stream, so a proxy
+ * can be sized from its own traffic instead of by guessing.
+ *
+ * An LRU cache of C bytes hits a request exactly when the bytes of the
+ * distinct objects requested since the previous request for the same key
+ * (its reuse distance, counting the object itself) are at most C. One
+ * histogram of reuse distances therefore gives the hit rate of every
+ * size at once. Tracking every key would cost as much as the cache, so
+ * the estimator follows SHARDS (Waldspurger et al., FAST '15):
+ *
+ * Features:
+ * - Spatial sampling: a key is tracked iff its hash falls below a
+ *   threshold, i.e. a fixed fraction R of the keys and all of their
+ *   requests. Distances measured among sampled keys are scaled by 1/R
+ * - Fixed size: at most MRC_MAX_KEYS keys are tracked; when the sample
+ *   outgrows that, the threshold is lowered, the keys above it dropped,
+ *   and the histogram rescaled to the new rate
+ * - Reuse distances in O(log n): keys are stamped with their last access
+ *   and a Fenwick tree sums the bytes of the keys stamped after it
+ * - SHARDS-adj: given the number of requests of all keys, the gap between
+ *   the sampled requests expected at rate R and those seen is credited
+ *   to the shortest distances. Under skew a few hot keys carry much of
+ *   the traffic, and whether they fall in the sample would otherwise
+ *   swing the whole curve
+ *
+ * The histogram covers every request since creation or mrc_reset().
+ * Unsampled requests cost one multiply and a compare; sampled ones take
+ * the estimator's mutex. The curve is that of LRU: other policies (ARC,
+ * S3-FIFO, W-TinyLFU) usually do somewhat better at the same size.
+ */
+
+#ifndef MRC_H
+#define MRC_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Sample values are this many bits of the mixed key hash */
+#define MRC_SAMPLE_BITS         24
+
+/* Initial sampling rate: 1 key in MRC_START_RATE_DIV */
+#define MRC_START_RATE_DIV      16
+
+/* Most keys tracked at once */
+#define MRC_MAX_KEYS            8192
+
+/* Histogram buckets, spanning 0 .. MRC_SPAN x the reference size */
+#define MRC_BUCKETS             256
+#define MRC_SPAN                4
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+/* A tracked key */
+typedef struct {
+    uint64_t hash;                  /* Key hash; 0 = empty slot */
+    uint64_t bytes;                 /* Charge of its last put (0 = none yet) */
+    uint32_t stamp;                 /* Position of its last access */
+} mrc_key_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t threshold;             /* Sample iff value < threshold (atomic) */
+
+    /* Tracked keys: open addressing on hash, twice MRC_MAX_KEYS slots */
+    mrc_key_t *keys;
+    uint32_t key_mask;
+    uint32_t num_keys;
+
+    /* Bytes per access stamp (Fenwick tree, 1-based) */
+    uint64_t *tree;
+    uint32_t stamps;                /* Capacity of the tree */
+    uint32_t next_stamp;
+    uint64_t tracked_bytes;         /* Sum of the tracked keys' bytes */
+
+    /* Reuse distance histogram, in sampled requests */
+    double hist[MRC_BUCKETS];
+    double far;                     /* Beyond the last bucket */
+    double cold;                    /* First requests of a key */
+    double total;
+    size_t bucket_bytes;
+    unsigned long samples;          /* Sampled requests since the reset */
+
+    mrc_key_t *scratch;             /* Rebuild buffer, MRC_MAX_KEYS + 1 keys */
+} mrc_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/*
+ * mrc_create - Create an estimator
+ *
+ * @param reference_size: Size the curve is read around (the cache's
+ *                        max_size); distances up to MRC_SPAN times it
+ *                        are resolved
+ * @return: Pointer to estimator, or NULL on error
+ */
+mrc_t *mrc_create(size_t reference_size);
+
+/*
+ * mrc_destroy - Free an estimator
+ *
+ * @param mrc: Estimator (NULL is ignored)
+ */
+void mrc_destroy(mrc_t *mrc);
+
+/*
+ * mrc_sampled - Whether a key is in the sample
+ *
+ * @param mrc: Estimator
+ * @param hash: Key hash
+ * @return: true if mrc_access() / mrc_update() must be called for it
+ */
+static inline bool mrc_sampled(mrc_t *mrc, uint64_t hash) {
+    uint32_t value = (uint32_t)((hash * 0xD6E8FEB86659FD93ULL) >> (64 - MRC_SAMPLE_BITS));
+    return value < __atomic_load_n(&mrc->threshold, __ATOMIC_RELAXED);
+}
+
+/*
+ * mrc_access - Record a request for a key
+ *
+ * @param mrc: Estimator
+ * @param hash: Key hash (any key; unsampled keys are ignored)
+ *
+ * Thread-safe.
+ */
+void mrc_access(mrc_t *mrc, uint64_t hash);
+
+/*
+ * mrc_update - Record the bytes a key now takes
+ *
+ * @param mrc: Estimator
+ * @param hash: Key hash (any key; unsampled keys are ignored)
+ * @param bytes: The key's charge after a put
+ *
+ * A put is not a request: it sizes the key (and starts tracking it if
+ * no request did) without adding a reuse distance. Thread-safe.
+ */
+void mrc_update(mrc_t *mrc, uint64_t hash, size_t bytes);
+
+/*
+ * mrc_hit_rate - Predicted LRU hit rate of a cache of a given size
+ *
+ * @param mrc: Estimator
+ * @param size: Cache size in bytes (resolved up to MRC_SPAN x the
+ *              reference size, in steps of MRC_SPAN / MRC_BUCKETS of it)
+ * @param requests: Requests of all keys since the last reset, for the
+ *                  SHARDS-adj correction (0 = no correction)
+ * @param samples: Output - sampled requests behind the estimate (can be NULL)
+ * @return: Fraction of the requests since the last reset that would have
+ *          hit, 0 before any sample
+ *
+ * Thread-safe.
+ */
+double mrc_hit_rate(mrc_t *mrc, size_t size, unsigned long requests,
+                    unsigned long *samples);
+
+/*
+ * mrc_reset - Forget the histogram (tracked keys are kept)
+ *
+ * @param mrc: Estimator
+ */
+void mrc_reset(mrc_t *mrc);
+
+#endif /* MRC_H */
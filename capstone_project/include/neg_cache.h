@@ -0,0 +1,201 @@
+/*
+ * neg_cache.h - Negative Cache for Missing Files
+ *
+ * This header defines a small cache of paths the backend reported as
+ * FILE_NOT_FOUND. It is used by the proxy (Part C) so that repeated
+ * requests for missing files are answered without a backend round trip.
+ *
+ * Features:
+ * - Short per-entry TTL (missing files may be created later)
+ * - Bounded number of entries
+ * - Segmented LRU (probation + protected) so a flood of unique
+ *   missing keys cannot evict entries that are actually being reused
+ * - Separate hit/miss statistics from the main cache
+ *
+ * Only the key is stored - there is no payload.
+ */
+
+#ifndef NEG_CACHE_H
+#define NEG_CACHE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Default number of negative entries */
+#define DEFAULT_NEG_CACHE_ENTRIES   4096
+
+/* Default time-to-live for a negative entry (milliseconds) */
+#define DEFAULT_NEG_CACHE_TTL_MS    5000
+
+/* Share of capacity reserved for the protected segment (percent) */
+#define NEG_CACHE_PROTECTED_PCT     80
+
+/* Maximum key length */
+#define NEG_CACHE_MAX_KEY_LEN       512
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+/*
+ * Segment an entry currently lives in
+ *
+ * New keys enter PROBATION. Only a key that is looked up again while
+ * still fresh is promoted to PROTECTED. A scan of unique keys therefore
+ * only churns the probation segment.
+ */
+typedef enum {
+    NEG_SEG_PROBATION = 0,
+    NEG_SEG_PROTECTED
+} neg_segment_t;
+
+/*
+ * Negative cache entry - one path known to be missing
+ */
+typedef struct neg_entry {
+    char key[NEG_CACHE_MAX_KEY_LEN];    /* Cache key (file path) */
+    uint64_t expires_ms;                /* Monotonic expiry time */
+    neg_segment_t segment;              /* Which LRU list holds it */
+
+    /* Linked list pointers for segment LRU ordering */
+    struct neg_entry *lru_prev;         /* More recently used */
+    struct neg_entry *lru_next;         /* Less recently used */
+
+    /* Hash table chaining */
+    struct neg_entry *hash_next;        /* Next entry in hash bucket */
+
+} neg_entry_t;
+
+/*
+ * One LRU segment (doubly linked list with a size bound)
+ */
+typedef struct {
+    neg_entry_t *head;                  /* Most recently used */
+    neg_entry_t *tail;                  /* Least recently used */
+    int count;                          /* Entries in this segment */
+    int capacity;                       /* Maximum entries */
+} neg_segment_list_t;
+
+/*
+ * Negative cache - the main structure
+ */
+typedef struct {
+    /* Hash table for fast lookup */
+    neg_entry_t **buckets;              /* Array of bucket pointers */
+    int num_buckets;                    /* Size of buckets array */
+
+    /* Segmented LRU */
+    neg_segment_list_t probation;       /* First-time misses */
+    neg_segment_list_t protected_seg;   /* Keys seen more than once */
+
+    /* Configuration */
+    uint32_t ttl_ms;                    /* Lifetime of each entry */
+
+    /* Statistics */
+    unsigned long hits;                 /* Lookups answered as missing */
+    unsigned long misses;               /* Lookups not in the cache */
+    unsigned long inserts;              /* New negative entries */
+    unsigned long expirations;          /* Entries dropped due to TTL */
+    unsigned long evictions;            /* Entries dropped due to size */
+    unsigned long promotions;           /* Probation -> protected moves */
+
+    /* Thread safety (every lookup may reorder the lists) */
+    pthread_mutex_t lock;
+
+} neg_cache_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/*
+ * neg_cache_create - Create a negative cache
+ *
+ * @param max_entries: Maximum number of entries (both segments)
+ * @param ttl_ms: Lifetime of each entry in milliseconds
+ * @return: Pointer to cache, or NULL on error
+ */
+neg_cache_t *neg_cache_create(int max_entries, uint32_t ttl_ms);
+
+/*
+ * neg_cache_destroy - Destroy the cache and free all memory
+ *
+ * @param nc: Cache to destroy
+ */
+void neg_cache_destroy(neg_cache_t *nc);
+
+/*
+ * neg_cache_lookup - Check whether a path is known to be missing
+ *
+ * @param nc: Negative cache
+ * @param key: Cache key (file path)
+ * @return: true if a fresh negative entry exists (negative hit)
+ *
+ * An expired entry is removed and counted as a miss.
+ * A hit in probation promotes the entry to the protected segment.
+ *
+ * Thread-safe.
+ */
+bool neg_cache_lookup(neg_cache_t *nc, const char *key);
+
+/*
+ * neg_cache_insert - Record that a path is missing
+ *
+ * @param nc: Negative cache
+ * @param key: Cache key (file path)
+ * @return: true on success, false on error
+ *
+ * If the key already exists its TTL is refreshed in place.
+ * New keys enter the probation segment.
+ *
+ * Thread-safe.
+ */
+bool neg_cache_insert(neg_cache_t *nc, const char *key);
+
+/*
+ * neg_cache_remove - Forget a negative entry
+ *
+ * @param nc: Negative cache
+ * @param key: Cache key
+ * @return: true if an entry was removed
+ *
+ * Call this when the file is known to exist again.
+ *
+ * Thread-safe.
+ */
+bool neg_cache_remove(neg_cache_t *nc, const char *key);
+
+/* ============================================================================
+ * Statistics Functions
+ * ============================================================================ */
+
+/*
+ * Negative cache statistics structure
+ */
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long inserts;
+    unsigned long expirations;
+    unsigned long evictions;
+    unsigned long promotions;
+    int probation_entries;
+    int protected_entries;
+    double hit_rate;            /* hits / (hits + misses) */
+} neg_cache_stats_t;
+
+/*
+ * neg_cache_get_stats - Get negative cache statistics
+ *
+ * @param nc: Negative cache
+ * @param stats: Output structure for statistics
+ */
+void neg_cache_get_stats(neg_cache_t *nc, neg_cache_stats_t *stats);
+
+#endif /* NEG_CACHE_H */
@@ -0,0 +1,221 @@
+/*
+ * prefetch.h - Access-Pattern Prefetcher
+ *
+ * This header defines a small successor predictor used by the proxy
+ * (Part C). It watches the request stream and learns rules of the form
+ * "after X, the same client asks for Y within T ms". When X is requested
+ * again, Y can be fetched into the cache before the client asks for it.
+ *
+ * Features:
+ * - Fixed-size tables (memory does not grow with the request stream)
+ * - Per-client history, so interleaved clients do not pollute each other
+ * - Byte budget (token bucket) limiting how much is prefetched
+ * - Accuracy and wasted-bytes accounting
+ */
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Number of predecessor keys tracked (direct-mapped table) */
+#define PREFETCH_TABLE_SIZE         1024
+
+/* Successor candidates kept per predecessor */
+#define PREFETCH_MAX_SUCCESSORS     4
+
+/* Number of clients whose last request is remembered */
+#define PREFETCH_CLIENT_SLOTS       256
+
+/* Prefetched-but-not-yet-used files tracked for accuracy */
+#define PREFETCH_OUTSTANDING        256
+
+/* Maximum key length (longer paths are not learned) */
+#define PREFETCH_MAX_KEY_LEN        256
+
+/* A successor must be seen this often ... */
+#define PREFETCH_MIN_COUNT          2
+
+/* ... and make up at least this share of X's successors (percent) */
+#define PREFETCH_MIN_CONFIDENCE     50
+
+/* Default "within T ms" window */
+#define DEFAULT_PREFETCH_WINDOW_MS  2000
+
+/* A prefetched file not requested within window * this factor is wasted */
+#define PREFETCH_USE_FACTOR         10
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+/*
+ * One learned successor of a key
+ */
+typedef struct {
+    char key[PREFETCH_MAX_KEY_LEN];     /* Successor path ("" = empty slot) */
+    uint32_t count;                     /* Times seen after the predecessor */
+} prefetch_succ_t;
+
+/*
+ * Predictor node - everything learned about one predecessor key
+ */
+typedef struct {
+    char key[PREFETCH_MAX_KEY_LEN];     /* Predecessor path ("" = empty slot) */
+    uint32_t total;                     /* Transitions observed from this key */
+    prefetch_succ_t succ[PREFETCH_MAX_SUCCESSORS];
+} prefetch_node_t;
+
+/*
+ * Last request seen from one client
+ */
+typedef struct {
+    uint32_t client_id;                 /* Client identifier (e.g. IPv4 address) */
+    bool used;                          /* Slot holds a request */
+    uint64_t when_ms;                   /* When it was requested */
+    char key[PREFETCH_MAX_KEY_LEN];     /* What was requested */
+} prefetch_client_t;
+
+/*
+ * A file that was prefetched and has not been requested yet
+ */
+typedef struct {
+    char key[PREFETCH_MAX_KEY_LEN];     /* "" = empty slot */
+    size_t bytes;                       /* Size fetched */
+    uint64_t fetched_ms;                /* When the prefetch completed */
+} prefetch_outstanding_t;
+
+/*
+ * Prefetcher - the main structure
+ */
+typedef struct {
+    prefetch_node_t *nodes;             /* PREFETCH_TABLE_SIZE predictor nodes */
+    prefetch_client_t *clients;         /* PREFETCH_CLIENT_SLOTS histories */
+    prefetch_outstanding_t *outstanding;/* PREFETCH_OUTSTANDING slots */
+
+    /* Configuration */
+    uint32_t window_ms;                 /* "within T ms" */
+    size_t budget_bytes_per_sec;        /* Token bucket refill rate */
+    int max_inflight;                   /* Concurrent prefetches allowed */
+
+    /* Budget state */
+    double tokens;                      /* Bytes that may still be prefetched */
+    uint64_t last_refill_ms;            /* Last token bucket refill */
+    int inflight;                       /* Prefetches currently running */
+
+    /* Statistics */
+    unsigned long issued;               /* Prefetches started */
+    unsigned long completed;            /* Prefetches that stored a file */
+    unsigned long used;                 /* Prefetched files later requested */
+    unsigned long wasted;               /* Prefetched files never requested */
+    unsigned long skipped_budget;       /* Predictions dropped by the budget */
+    size_t bytes_prefetched;            /* Total bytes prefetched */
+    size_t wasted_bytes;                /* Bytes of wasted prefetches */
+
+    pthread_mutex_t lock;
+
+} prefetcher_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/*
+ * prefetcher_create - Create a prefetcher
+ *
+ * @param window_ms: Learn X -> Y only if Y follows X within this many ms
+ * @param budget_bytes_per_sec: Prefetch byte budget (also the burst size)
+ * @param max_inflight: Maximum concurrent prefetches
+ * @return: Pointer to prefetcher, or NULL on error
+ */
+prefetcher_t *prefetcher_create(uint32_t window_ms, size_t budget_bytes_per_sec,
+                                int max_inflight);
+
+/*
+ * prefetcher_destroy - Free the prefetcher
+ *
+ * @param pf: Prefetcher
+ */
+void prefetcher_destroy(prefetcher_t *pf);
+
+/*
+ * prefetcher_record - Feed one client request and get predictions
+ *
+ * @param pf: Prefetcher
+ * @param client_id: Identifies the requesting client
+ * @param key: Requested path
+ * @param out: Output - predicted successor paths
+ * @param max_out: Capacity of out
+ * @return: Number of predictions written to out
+ *
+ * Learns the transition from this client's previous request (if it was
+ * within the window), marks a matching outstanding prefetch as used,
+ * and returns confident successors of key.
+ *
+ * Thread-safe.
+ */
+int prefetcher_record(prefetcher_t *pf, uint32_t client_id, const char *key,
+                      char out[][PREFETCH_MAX_KEY_LEN], int max_out);
+
+/*
+ * prefetcher_begin - Ask the budget whether a prefetch may start
+ *
+ * @param pf: Prefetcher
+ * @return: true if the caller should prefetch now (must call
+ *          prefetcher_complete later), false if over budget
+ *
+ * Thread-safe.
+ */
+bool prefetcher_begin(prefetcher_t *pf);
+
+/*
+ * prefetcher_complete - Report the outcome of a prefetch
+ *
+ * @param pf: Prefetcher
+ * @param key: Prefetched path
+ * @param bytes: Bytes fetched (0 if the fetch failed)
+ * @param stored: true if the file was put into the cache
+ *
+ * Charges the byte budget and starts tracking whether the file is used.
+ *
+ * Thread-safe.
+ */
+void prefetcher_complete(prefetcher_t *pf, const char *key, size_t bytes, bool stored);
+
+/* ============================================================================
+ * Statistics Functions
+ * ============================================================================ */
+
+/*
+ * Prefetcher statistics structure
+ */
+typedef struct {
+    unsigned long issued;
+    unsigned long completed;
+    unsigned long used;
+    unsigned long wasted;
+    unsigned long skipped_budget;
+    size_t bytes_prefetched;
+    size_t wasted_bytes;
+    double accuracy;            /* used / (used + wasted) */
+} prefetch_stats_t;
+
+/*
+ * prefetcher_get_stats - Get prefetcher statistics
+ *
+ * @param pf: Prefetcher
+ * @param stats: Output structure for statistics
+ *
+ * Outstanding prefetches older than the use horizon are counted
+ * as wasted at this point.
+ */
+void prefetcher_get_stats(prefetcher_t *pf, prefetch_stats_t *stats);
+
+#endif /* PREFETCH_H */
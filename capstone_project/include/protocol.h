@@ -21,6 +21,37 @@
  * Proxy Extensions (Part C):
  *   GETFILE CACHED <length>\r\n\r\n<file_content>  (served from cache)
  *
+ * Validators (Part C revalidation):
+ *   A response may carry an optional second header line describing the
+ *   file version, and a request may carry the same line to ask
+ *   "only send the file if it changed":
+ *
+ *   GETFILE OK <length>\r\nVALIDATOR <mtime_ns> <size>\r\n\r\n<file_content>
+ *   GETFILE GET <path>\r\nVALIDATOR <mtime_ns> <size>\r\n\r\n
+ *   GETFILE NOT_MODIFIED\r\nVALIDATOR <mtime_ns> <size>\r\n\r\n
+ *
+ * Content coding (Part C compression):
+ *   A request may list the codings the client can decode; the proxy may
+ *   then send a cached compressed file as it is stored, naming the
+ *   coding and the file's real length. The body is one lz block (lz.h),
+ *   <length> is its size. Clients that send no ACCEPT-ENCODING line
+ *   always get the plain file.
+ *
+ *   GETFILE GET <path>\r\nACCEPT-ENCODING lz\r\n\r\n
+ *   GETFILE CACHED <length>\r\nENCODING lz <decoded_length>\r\n\r\n<lz_block>
+ *
+ * Byte ranges (Part C chunked caching):
+ *   A request may ask for part of a file. The answer names the range it
+ *   holds and the file size; <length> is the number of bytes sent. A
+ *   range past the end of the file is clipped (to nothing if it starts
+ *   beyond it). A server that ignores RANGE sends the whole file without
+ *   a RANGE line, which a client must accept as the range 0..size.
+ *   With a VALIDATOR line as well, the request is conditional: the
+ *   server answers NOT_MODIFIED if the file is unchanged.
+ *
+ *   GETFILE GET <path>\r\nRANGE <offset> <length>\r\n\r\n
+ *   GETFILE OK <length>\r\nRANGE <offset> <file_size>\r\n\r\n<bytes>
+ *
  * IPC Protocol (Part D):
  *   Uses separate message format for inter-process communication
  */
@@ -52,6 +83,19 @@
 /* Protocol delimiters */
 #define HEADER_DELIM        "\r\n\r\n"
 #define HEADER_DELIM_LEN    4
+#define LINE_DELIM          "\r\n"
+#define LINE_DELIM_LEN      2
+
+/* Optional header line carrying a file validator */
+#define VALIDATOR_TAG       "VALIDATOR"
+
+/* Optional header lines negotiating a content coding */
+#define ACCEPT_ENCODING_TAG "ACCEPT-ENCODING"
+#define ENCODING_TAG        "ENCODING"
+#define ENCODING_LZ         "lz"
+
+/* Optional header line asking for / describing a byte range */
+#define RANGE_TAG           "RANGE"
 
 /* ============================================================================
  * Status Codes
@@ -62,7 +106,8 @@ typedef enum {
     STATUS_FILE_NOT_FOUND,
     STATUS_ERROR,
     STATUS_INVALID,
-    STATUS_CACHED          /* Extension for proxy */
+    STATUS_CACHED,         /* Extension for proxy */
+    STATUS_NOT_MODIFIED    /* Conditional request: validator still matches */
 } gf_status_t;
 
 /* String representations of status codes */
@@ -71,9 +116,27 @@ static const char *STATUS_STRINGS[] = {
     "FILE_NOT_FOUND",
     "ERROR",
     "INVALID",
-    "CACHED"
+    "CACHED",
+    "NOT_MODIFIED"
 };
 
+#define NUM_STATUS_CODES    (sizeof(STATUS_STRINGS) / sizeof(STATUS_STRINGS[0]))
+
+/* ============================================================================
+ * Validator
+ * ============================================================================ */
+
+/*
+ * File version identifier
+ *
+ * Two validators are equal if the file was not modified in between.
+ * Modification time has nanosecond resolution where the OS supports it.
+ */
+typedef struct {
+    int64_t mtime_ns;           /* Last modification time (ns since epoch) */
+    uint64_t size;              /* File size in bytes */
+} gf_validator_t;
+
 /* ============================================================================
  * Request Structure
  * ============================================================================ */
@@ -85,6 +148,12 @@ typedef struct {
     char path[MAX_PATH_LEN];    /* Requested file path */
     size_t path_len;            /* Length of path string */
     int valid;                  /* 1 if request is valid, 0 otherwise */
+    int has_validator;          /* 1 if this is a conditional request */
+    gf_validator_t validator;   /* Version the client already has */
+    int accept_lz;              /* 1 if the client decodes lz bodies */
+    int has_range;              /* 1 if only part of the file is wanted */
+    uint64_t range_offset;      /* First byte wanted (if has_range) */
+    uint64_t range_length;      /* Bytes wanted (if has_range) */
 } gf_request_t;
 
 /* ============================================================================
@@ -98,6 +167,13 @@ typedef struct {
     gf_status_t status;         /* Response status */
     size_t content_length;      /* File size (only valid if status == OK/CACHED) */
     int header_complete;        /* 1 if full header received */
+    int has_validator;          /* 1 if a VALIDATOR line was present */
+    gf_validator_t validator;   /* Version of the file being described */
+    int lz_encoded;             /* 1 if the body is an lz block (ENCODING line) */
+    size_t decoded_length;      /* File size once decoded (if lz_encoded) */
+    int has_range;              /* 1 if the body is part of the file (RANGE line) */
+    uint64_t range_offset;      /* File offset of the body (if has_range) */
+    uint64_t total_length;      /* File size (if has_range) */
 } gf_response_t;
 
 /* ============================================================================
@@ -105,7 +181,7 @@ typedef struct {
  * ============================================================================ */
 
 /*
- * TODO: Implement these functions in src/protocol.c
+ * Implemented in src/protocol.c
  */
 
 /* ---- Request Functions ---- */
@@ -122,6 +198,53 @@ typedef struct {
  */
 int gf_create_request(char *buffer, size_t buflen, const char *path);
 
+/*
+ * gf_create_conditional_request - Build a GETFILE request with a validator
+ *
+ * @param buffer: Output buffer for the request
+ * @param buflen: Size of the buffer
+ * @param path: File path to request
+ * @param validator: Version the caller already has
+ * @return: Number of bytes written, or -1 on error
+ *
+ * The server answers NOT_MODIFIED (no content) if the validator matches.
+ *
+ * Example output: "GETFILE GET /a.txt\r\nVALIDATOR 1700000000000000000 42\r\n\r\n"
+ */
+int gf_create_conditional_request(char *buffer, size_t buflen, const char *path,
+                                  const gf_validator_t *validator);
+
+/*
+ * gf_create_lz_request - Build a GETFILE request that accepts lz bodies
+ *
+ * @param buffer: Output buffer for the request
+ * @param buflen: Size of the buffer
+ * @param path: File path to request (must start with /)
+ * @param validator: Version the caller already has (NULL if none)
+ * @return: Number of bytes written, or -1 on error
+ *
+ * Example output: "GETFILE GET /a.txt\r\nACCEPT-ENCODING lz\r\n\r\n"
+ */
+int gf_create_lz_request(char *buffer, size_t buflen, const char *path,
+                         const gf_validator_t *validator);
+
+/*
+ * gf_create_range_request - Build a GETFILE request for a byte range
+ *
+ * @param buffer: Output buffer for the request
+ * @param buflen: Size of the buffer
+ * @param path: File path to request (must start with /)
+ * @param offset: First byte wanted
+ * @param length: Bytes wanted
+ * @param validator: Version the caller already has (NULL if none)
+ * @return: Number of bytes written, or -1 on error
+ *
+ * Example output: "GETFILE GET /big.iso\r\nRANGE 262144 524288\r\n\r\n"
+ */
+int gf_create_range_request(char *buffer, size_t buflen, const char *path,
+                            uint64_t offset, uint64_t length,
+                            const gf_validator_t *validator);
+
 /*
  * gf_parse_request - Parse a GETFILE request
  *
@@ -134,6 +257,10 @@ int gf_create_request(char *buffer, size_t buflen, const char *path);
  * - Partial headers (return 0)
  * - Invalid format (return -1, set request->valid = 0)
  * - Valid request (return bytes consumed, set request->valid = 1)
+ * - Optional VALIDATOR line (sets request->has_validator)
+ * - Optional ACCEPT-ENCODING line (sets request->accept_lz if it lists lz)
+ * - Optional RANGE line (sets request->has_range, range_offset, range_length;
+ *   an empty range is invalid)
  */
 int gf_parse_request(const char *buffer, size_t buflen, gf_request_t *request);
 
@@ -153,6 +280,60 @@ int gf_parse_request(const char *buffer, size_t buflen, gf_request_t *request);
 int gf_create_response_header(char *buffer, size_t buflen,
                                gf_status_t status, size_t content_length);
 
+/*
+ * gf_create_response_header_validated - Build a response header with a validator
+ *
+ * @param buffer: Output buffer for the header
+ * @param buflen: Size of the buffer
+ * @param status: Response status code
+ * @param content_length: File size (ignored if status != OK/CACHED)
+ * @param validator: File version to advertise (NULL to omit)
+ * @return: Number of bytes written, or -1 on error
+ *
+ * Example output: "GETFILE OK 42\r\nVALIDATOR 1700000000000000000 42\r\n\r\n"
+ */
+int gf_create_response_header_validated(char *buffer, size_t buflen,
+                                        gf_status_t status, size_t content_length,
+                                        const gf_validator_t *validator);
+
+/*
+ * gf_create_response_header_lz - Build a response header for an lz body
+ *
+ * @param buffer: Output buffer for the header
+ * @param buflen: Size of the buffer
+ * @param status: Response status code
+ * @param content_length: Size of the lz block that follows
+ * @param validator: File version to advertise (NULL to omit)
+ * @param decoded_length: File size once decoded (0 = plain body, no
+ *                        ENCODING line)
+ * @return: Number of bytes written, or -1 on error
+ *
+ * Only send it to a client whose request had accept_lz set.
+ * Example output: "GETFILE CACHED 812\r\nENCODING lz 4096\r\n\r\n"
+ */
+int gf_create_response_header_lz(char *buffer, size_t buflen,
+                                 gf_status_t status, size_t content_length,
+                                 const gf_validator_t *validator, size_t decoded_length);
+
+/*
+ * gf_create_response_header_range - Build a response header for a byte range
+ *
+ * @param buffer: Output buffer for the header
+ * @param buflen: Size of the buffer
+ * @param status: Response status code (OK or CACHED)
+ * @param content_length: Bytes of the range that follow
+ * @param validator: File version to advertise (NULL to omit)
+ * @param offset: File offset of the first byte sent
+ * @param total_length: File size
+ * @return: Number of bytes written, or -1 on error
+ *
+ * Example output: "GETFILE CACHED 1000\r\nRANGE 5000 1048576\r\n\r\n"
+ */
+int gf_create_response_header_range(char *buffer, size_t buflen,
+                                    gf_status_t status, size_t content_length,
+                                    const gf_validator_t *validator,
+                                    uint64_t offset, uint64_t total_length);
+
 /*
  * gf_parse_response_header - Parse a GETFILE response header
  *
@@ -165,6 +346,10 @@ int gf_create_response_header(char *buffer, size_t buflen,
  * - Partial headers (return 0)
  * - Invalid format (return -1)
  * - All valid status codes
+ * - Optional VALIDATOR line (sets response->has_validator)
+ * - Optional ENCODING line (sets response->lz_encoded, decoded_length)
+ * - Optional RANGE line (sets response->has_range, range_offset, total_length;
+ *   invalid if the body would extend past the end of the file)
  */
 int gf_parse_response_header(const char *buffer, size_t buflen,
                               gf_response_t *response);
@@ -196,4 +381,11 @@ gf_status_t gf_string_to_status(const char *str);
  */
 size_t gf_find_header_end(const char *buffer, size_t buflen);
 
+/*
+ * gf_validator_equal - Compare two validators
+ *
+ * @return: 1 if both describe the same file version, 0 otherwise
+ */
+int gf_validator_equal(const gf_validator_t *a, const gf_validator_t *b);
+
 #endif /* PROTOCOL_H */
@@ -0,0 +1,145 @@
+/*
+ * slab.h - Size-Class Slab Allocator
+ *
+ * This header defines the allocator behind the cache's payload buffers
+ * (Part C). malloc'ing every file at its exact size and freeing it on
+ * eviction fragments the heap over time, so a long-running proxy ends up
+ * with an RSS well above the bytes it actually caches.
+ *
+ * Features:
+ * - Size classes 64 B .. SLAB_MAX_CHUNK, four per power of two, so a
+ *   chunk wastes at most a quarter of its size
+ * - Chunks are carved from SLAB_SIZE slabs mapped with mmap(); each slab
+ *   serves one class and keeps its own free list
+ * - A slab whose chunks are all free again is unmapped (one empty slab per
+ *   class is kept to absorb churn), and large free chunks release their
+ *   pages, so memory returns to the OS
+ * - Larger requests get their own page-rounded mapping
+ * - slab_chunk_size() tells the owner what an allocation really costs,
+ *   so the cache can charge that against its budget
+ *
+ * Thread-safe: one mutex per size class.
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Bytes per slab (mapped SLAB_SIZE-aligned so a chunk finds its slab) */
+#define SLAB_SIZE               (1024 * 1024)
+
+/* Smallest chunk */
+#define SLAB_MIN_CHUNK          64
+
+/* Largest chunk served from slabs; bigger requests are mapped directly */
+#define SLAB_MAX_CHUNK          (128 * 1024)
+
+/* Freed chunks at least this large release their pages (MADV_DONTNEED)... */
+#define SLAB_RELEASE_CHUNK      (16 * 1024)
+
+/* ...once their class already holds this many free bytes */
+#define SLAB_RELEASE_KEEP       (256 * 1024)
+
+/* Size classes per power of two */
+#define SLAB_CLASSES_PER_DOUBLING 4
+
+/* Number of size classes (64 B .. 128 KB) */
+#define SLAB_NUM_CLASSES        45
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct slab slab_t;
+
+/*
+ * One size class: the slabs that still have free chunks
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    size_t chunk_size;
+    slab_t *partial;                /* Slabs with at least one free chunk */
+    slab_t *empty;                  /* One fully free slab kept in reserve */
+    size_t slabs;                   /* Slabs mapped for this class */
+    size_t live;                    /* Chunks handed out */
+    size_t free_chunks;             /* On the slabs' free lists (atomic) */
+} slab_class_t;
+
+typedef struct {
+    slab_class_t classes[SLAB_NUM_CLASSES];
+    size_t large_bytes;             /* Bytes in direct mappings (atomic) */
+    size_t large_count;             /* Live direct mappings (atomic) */
+} slab_allocator_t;
+
+/*
+ * Allocator statistics
+ */
+typedef struct {
+    size_t mapped_bytes;            /* Slabs + direct mappings */
+    size_t used_bytes;              /* Chunk sizes of live allocations */
+    size_t slabs;                   /* Slabs currently mapped */
+    size_t large_allocs;            /* Live direct mappings */
+} slab_stats_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/*
+ * slab_create - Create an allocator
+ *
+ * @return: Pointer to allocator, or NULL on error
+ */
+slab_allocator_t *slab_create(void);
+
+/*
+ * slab_destroy - Unmap every slab
+ *
+ * @param alloc: Allocator
+ *
+ * Every allocation must have been freed.
+ */
+void slab_destroy(slab_allocator_t *alloc);
+
+/*
+ * slab_alloc - Allocate 'size' bytes (16-byte aligned)
+ *
+ * @param alloc: Allocator
+ * @param size: Requested bytes
+ * @return: Pointer, or NULL if no memory could be mapped
+ */
+void *slab_alloc(slab_allocator_t *alloc, size_t size);
+
+/*
+ * slab_free - Return an allocation
+ *
+ * @param alloc: Allocator
+ * @param ptr: Pointer from slab_alloc (NULL is ignored)
+ * @param size: The size passed to slab_alloc
+ */
+void slab_free(slab_allocator_t *alloc, void *ptr, size_t size);
+
+/*
+ * slab_chunk_size - Memory really used by an allocation of 'size' bytes
+ *
+ * @param size: Requested bytes
+ * @return: Chunk size of its class, or the page-rounded mapping size
+ */
+size_t slab_chunk_size(size_t size);
+
+/*
+ * slab_get_stats - Snapshot allocator statistics
+ *
+ * @param alloc: Allocator
+ * @param stats: Output
+ */
+void slab_get_stats(slab_allocator_t *alloc, slab_stats_t *stats);
+
+#endif /* SLAB_H */
@@ -0,0 +1,147 @@
+/*
+ * stat_counters.h - Per-Thread Statistics Counters
+ *
+ * This header defines the counters behind the cache and thread pool
+ * statistics (Parts B and C). A shared counter bumped on every request
+ * is a write to one cache line from every core: with a mutex it
+ * serializes the threads, and even an atomic add makes the line bounce
+ * between cores on each hit. This is Approach 5 of
+ * 03_concurrency_ipc/03_mutex/counter_benchmark.c ("local counters +
+ * final merge") made reusable: each thread adds to its own slot, and a
+ * reader merges the slots.
+ *
+ * Features:
+ * - A group holds several counters (hits, misses, ...); one slot holds
+ *   all of a thread's counters, padded to whole cache lines, so a
+ *   request that bumps three counters dirties one line of its own
+ * - Threads get slots round robin on first use; there are at least as
+ *   many slots as CPUs, so busy threads rarely share one
+ * - Adds are relaxed atomics: threads that do share a slot never lose
+ *   updates, and on a line no other core writes they cost no transfer
+ * - Reads sum every slot: reads are the rare side (statistics, tests)
+ *
+ * A sum is not a snapshot: adds made while it runs may or may not be
+ * counted, and two counters read one after the other may disagree by
+ * the requests in flight. Gauges (counts that go down as well as up)
+ * work too: the slot sums wrap, and so does their total.
+ */
+
+#ifndef STAT_COUNTERS_H
+#define STAT_COUNTERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Slots per group: the CPU count rounded up to a power of two, within */
+#define STAT_COUNTERS_MIN_SLOTS     8
+#define STAT_COUNTERS_MAX_SLOTS     256
+
+/* Slot padding */
+#define STAT_COUNTERS_LINE          64
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+/*
+ * A group of counters
+ */
+typedef struct {
+    uint64_t *slots;                /* nslots slots of stride counters */
+    unsigned ncounters;             /* Counters per slot in use */
+    unsigned stride;                /* Counters per slot, whole lines */
+    unsigned nslots;                /* Power of two */
+} stat_counters_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/*
+ * stat_counters_init - Allocate a group of zeroed counters
+ *
+ * @param counters: Group to initialize
+ * @param ncounters: Number of counters (ids 0 .. ncounters - 1)
+ * @return: true on success, false if out of memory
+ */
+bool stat_counters_init(stat_counters_t *counters, unsigned ncounters);
+
+/*
+ * stat_counters_destroy - Free a group (accepts a failed or repeated init)
+ *
+ * @param counters: Group to free
+ */
+void stat_counters_destroy(stat_counters_t *counters);
+
+/*
+ * stat_counters_sum - Total of one counter over every slot
+ *
+ * @param counters: Group
+ * @param id: Counter
+ * @return: The merged value
+ */
+uint64_t stat_counters_sum(const stat_counters_t *counters, unsigned id);
+
+/*
+ * stat_counters_reset - Set every counter of a group to zero
+ *
+ * @param counters: Group
+ *
+ * Adds racing with the reset may survive it.
+ */
+void stat_counters_reset(stat_counters_t *counters);
+
+/* The calling thread's slot number plus one, 0 before its first add */
+extern __thread unsigned stat_counters_slot_plus1;
+
+/*
+ * stat_counters_assign_slot - Give the calling thread its slot number
+ *
+ * @return: The number, fixed for the thread's lifetime
+ */
+unsigned stat_counters_assign_slot(void);
+
+/*
+ * stat_counters_thread_slot - Slot number of the calling thread
+ *
+ * @return: A number fixed for the thread's lifetime; groups reduce it
+ *          modulo their slot count
+ */
+static inline unsigned stat_counters_thread_slot(void) {
+    unsigned slot = stat_counters_slot_plus1;
+    return slot != 0 ? slot - 1 : stat_counters_assign_slot();
+}
+
+/*
+ * stat_counters_add - Add to a counter from the calling thread's slot
+ *
+ * @param counters: Group
+ * @param id: Counter
+ * @param n: Amount (wraps: add (uint64_t)-1 to decrement a gauge)
+ */
+static inline void stat_counters_add(stat_counters_t *counters, unsigned id, uint64_t n) {
+    unsigned slot = stat_counters_thread_slot() & (counters->nslots - 1);
+    __atomic_fetch_add(&counters->slots[(size_t)slot * counters->stride + id], n,
+                       __ATOMIC_RELAXED);
+}
+
+/*
+ * stat_counters_inc - Add one to a counter
+ */
+static inline void stat_counters_inc(stat_counters_t *counters, unsigned id) {
+    stat_counters_add(counters, id, 1);
+}
+
+/*
+ * stat_counters_dec - Subtract one from a counter (gauges)
+ */
+static inline void stat_counters_dec(stat_counters_t *counters, unsigned id) {
+    stat_counters_add(counters, id, (uint64_t)-1);
+}
+
+#endif /* STAT_COUNTERS_H */
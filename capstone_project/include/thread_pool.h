@@ -14,6 +14,7 @@
 
 #include <pthread.h>
 #include <stdbool.h>
+#include "stat_counters.h"
 #include "work_queue.h"
 
 /* ============================================================================
@@ -23,6 +24,11 @@
 /* Default number of worker threads */
 #define DEFAULT_NUM_THREADS     4
 
+/* Statistics counters (thread_pool_t.stats) */
+#define THREAD_POOL_STAT_TASKS      0   /* Total tasks handled */
+#define THREAD_POOL_STAT_ACTIVE     1   /* Currently busy workers (gauge) */
+#define THREAD_POOL_STAT_COUNT      2
+
 /* ============================================================================
  * Thread Pool Structure
  * ============================================================================ */
@@ -46,10 +52,9 @@ typedef struct {
     bool shutdown;              /* Signal workers to exit */
     pthread_mutex_t lock;       /* Protects shutdown flag */
 
-    /* Statistics (optional, for Part E) */
-    int tasks_completed;        /* Total tasks handled */
-    int active_workers;         /* Currently busy workers */
-    pthread_mutex_t stats_lock; /* Protects statistics */
+    /* Statistics (optional, for Part E): one slot per worker, so
+       workers finishing tasks at the same time do not contend */
+    stat_counters_t stats;      /* THREAD_POOL_STAT_* counters */
 
 } thread_pool_t;
 
@@ -114,7 +119,8 @@ void thread_pool_destroy(thread_pool_t *pool);
  * @param tasks_completed: Output for completed task count
  * @param active_workers: Output for currently active workers
  *
- * Used for monitoring in Part E.
+ * Used for monitoring in Part E. Sums the workers' counters without
+ * stopping them, so the two values may be a task apart.
  */
 void thread_pool_get_stats(thread_pool_t *pool, int *tasks_completed, int *active_workers);
 
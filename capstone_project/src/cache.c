@@ -5,400 +5,3198 @@ This implements a thread-safe LRU (Least Recently Used) cache
 for storing file contents in memory.
 
 Key concepts:
-- Hash table for O(1) lookup
-- Doubly-linked list for LRU ordering
-- Read-write lock for concurrent access
+- Open-addressing hash index for O(1) lookup (cache_index.c), keyed by
+  a seeded 64-bit hash of the key (fast_hash.c)
+- Replacement policy behind an interface (cache_policy.c): LRU by
+  default, or CLOCK, W-TinyLFU, ARC, 2Q, S3-FIFO, GDSF. Policies whose hits are
+  atomic-only (CLOCK, S3-FIFO) serve fresh hits without the write lock
+- Lock-free hits (epoch.c): for those policies a lookup first searches
+  the index inside an epoch section, taking no lock; writers retire the
+  buffers and index tables they unlink instead of freeing them
+- Lock striping: keys are spread over shards by hash; each shard is a
+  complete LRU cache with its own read-write lock and size budget, so
+  threads working on different shards never contend
+- Optional per-entry TTL with stale-while-revalidate
+- Payloads come from a process-wide slab allocator (slab.c); each entry
+  is charged its chunk size, so max_size bounds the memory really used
+- Compact entries: one cache line each, in a per-shard entry table
+  linked by 32-bit ids; the key is stored in front of the payload
+- Expired entries are reclaimed by a per-shard timer wheel
+- Snapshots: buffers are written in their in-memory layout, so a restore
+  maps the file and points entries into it
+- Disk tier (cache_disk.c): eviction queues the victim's buffer for a
+  writer thread; a miss in memory is retried after promoting the key
+  from the writer's queue or the log
+- Compression (lz.c): a put compresses before locking, a hit pins the
+  compressed buffer under the lock and decodes it after unlocking
+- Chunked files: a large file is stored as one entry per chunk, keyed by
+  chunk number and path, so everything above works per chunk unchanged
+- Statistics are per-thread counters shared by the shards
+  (stat_counters.c): a hit writes only its own thread's slot
 
 Used in Part C (Proxy) and Part D (IPC Cache Process).
 */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "../include/cache.h"
+#include "../include/cache_disk.h"
+#include "../include/cache_sim.h"
+#include "../include/fast_hash.h"
+#include "../include/lz.h"
+#include "../include/slab.h"
 
-/* Number of hash buckets (prime number for better distribution) */
-#define NUM_BUCKETS     1021
+/* Initial index slots per shard (the index grows on demand) */
+#define INDEX_INITIAL_SLOTS     64
+
+/* The hot fields of an entry must share one cache line */
+_Static_assert(sizeof(cache_entry_t) == 64, "cache_entry_t must stay one cache line");
 
 /* ============================================================================
 Internal Helper Functions
 ============================================================================ */
 
 /*
-Simple djb2 hash function
+cache_hash - Hash a key (selects shard and bucket)
+
+Seeded per process, so a client cannot choose paths that collide; a
+snapshot from another process has its hashes recomputed on restore.
+*/
+unsigned long cache_hash(const char *key) {
+    return fast_hash_str(key);
+}
+
+/*
+shard_for - Shard owning a hash
+
+The hash is scrambled with a Fibonacci multiply and its top bits pick
+the shard. The index applies its own mixer to the same hash, and the
+two scramblings keep the shard choice and the slot within the shard
+independent.
+*/
+static cache_shard_t *shard_for(cache_t *cache, unsigned long hash) {
+    uint64_t mixed = (uint64_t)hash * 0x9E3779B97F4A7C15ULL;
+    return &cache->shards[(mixed >> 32) % cache->num_shards];
+}
+
+/*
+now_ms - Current monotonic time in milliseconds (for TTLs)
+*/
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/*
+expiry_for - Absolute expiry time for a TTL (CACHE_TTL_NONE = never)
+*/
+static uint64_t expiry_for(uint32_t ttl_ms) {
+    return ttl_ms == CACHE_TTL_NONE ? CACHE_TTL_NONE : now_ms() + ttl_ms;
+}
+
+static bool is_expired(const cache_entry_t *entry, uint64_t now) {
+    return entry->expires_ms != CACHE_TTL_NONE && entry->expires_ms <= now;
+}
+
+static bool entry_has_key(const void *item, const void *key) {
+    return strcmp(((const cache_entry_t *)item)->key, key) == 0;
+}
+
+/*
+entry_buf_has_key - Index match for lock-free lookups (internal)
+
+The entry may be freed or reused meanwhile, so the key is read from
+the buffer the entry holds right now, which the epoch keeps alive.
+*/
+static bool entry_buf_has_key(const void *item, const void *key) {
+    cache_buf_t *buf = __atomic_load_n(&((const cache_entry_t *)item)->buf, __ATOMIC_ACQUIRE);
+    return buf != NULL && strcmp(buf->data, key) == 0;
+}
+
+/*
+find_entry - Find an entry by key (internal, caller holds the shard lock)
+
+Read-only, so it is safe under the read lock.
+*/
+static cache_entry_t *find_entry(cache_shard_t *shard, const char *key, unsigned long hash) {
+    return cache_index_find(&shard->index, hash, entry_has_key, key);
+}
+
+/*
+remove_from_hash - Remove an entry from the shard's index (internal)
+*/
+static void remove_from_hash(cache_shard_t *shard, cache_entry_t *entry) {
+    cache_index_remove(&shard->index, entry->hash, entry);
+}
+
+/* ============================================================================
+Policy Hooks
+============================================================================ */
+
+/*
+cache_move_to_front - Move entry to front of LRU list (most recently used)
+*/
+void cache_move_to_front(cache_shard_t *shard, cache_entry_t *entry) {
+    if (shard == NULL || entry == NULL) {
+        return;
+    }
+
+    shard->ops->on_hit(shard, entry);
+}
+
+/*
+record_access - Tell the policy about a write-locked lookup (internal)
+*/
+static void record_access(cache_shard_t *shard, unsigned long hash) {
+    if (shard->ops->on_access != NULL) {
+        shard->ops->on_access(shard, hash);
+    }
+}
+
+/* ============================================================================
+Payload Buffers
+============================================================================ */
+
+/*
+Process-wide payload allocator. Shared by every cache because a pinned
+buffer may outlive the cache it came from.
+*/
+static slab_allocator_t *payload_slabs = NULL;
+static pthread_once_t payload_slabs_once = PTHREAD_ONCE_INIT;
+
+static void payload_slabs_init(void) {
+    payload_slabs = slab_create();
+}
+
+/*
+key_space - Bytes a key takes in its buffer: with its NUL, padded to 8 so
+the payload after it stays aligned (internal)
+*/
+static size_t key_space(const char *key) {
+    return (strlen(key) + 1 + 7) & ~(size_t)7;
+}
+
+/*
+cache_entry_charge - Bytes an entry counts against max_size
+*/
+size_t cache_entry_charge(const char *key, size_t size) {
+    return slab_chunk_size(sizeof(cache_buf_t) + key_space(key) + size);
+}
+
+/*
+buf_payload - Start of a buffer's payload (internal)
+*/
+static inline char *buf_payload(cache_buf_t *buf) {
+    return buf->data + buf->key_len;
+}
+
+/*
+buf_create - Refcounted copy of a payload and its key, owned by the
+caller (internal)
+
+data NULL leaves the payload unwritten (cache_put_sized).
+*/
+static cache_buf_t *buf_create(const char *key, const char *data, size_t size) {
+    pthread_once(&payload_slabs_once, payload_slabs_init);
+    if (payload_slabs == NULL) {
+        return NULL;
+    }
+    size_t key_len = key_space(key);
+    cache_buf_t *buf = slab_alloc(payload_slabs, sizeof(cache_buf_t) + key_len + size);
+    if (buf == NULL) {
+        return NULL;
+    }
+    buf->refs = 1;
+    buf->key_len = (uint16_t)key_len;
+    buf->flags = 0;
+    buf->size = size;
+    strncpy(buf->data, key, key_len);
+    if (data != NULL) {
+        memcpy(buf_payload(buf), data, size);
+    }
+    return buf;
+}
+
+/*
+buf_pack - Compressed buffer for a payload, or NULL to store it as is
+(internal)
+
+The sample decides cheaply: data that does not shrink in its first
+CACHE_COMPRESS_SAMPLE bytes (already compressed formats) is not
+compressed in full. The whole block must then meet the same ratio,
+which lz_compress() checks as it goes by giving up at the capacity.
+*/
+static cache_buf_t *buf_pack(cache_shard_t *shard, const char *key, const char *data,
+                             size_t size) {
+    if (size < CACHE_COMPRESS_MIN || size > LZ_MAX_INPUT) {
+        return NULL;
+    }
+    if (size > CACHE_COMPRESS_SAMPLE) {
+        char probe[CACHE_COMPRESS_SAMPLE];
+        if (lz_compress(data, CACHE_COMPRESS_SAMPLE, probe,
+                        CACHE_COMPRESS_SAMPLE * CACHE_COMPRESS_MAX_8THS / 8) == 0) {
+            stat_counters_inc(shard->counters, CACHE_STAT_COMPRESS_SKIPPED);
+            return NULL;
+        }
+    }
+
+    size_t capacity = size * CACHE_COMPRESS_MAX_8THS / 8;
+    char *block = malloc(capacity);
+    if (block == NULL) {
+        return NULL;
+    }
+    size_t packed = lz_compress(data, size, block, capacity);
+    cache_buf_t *buf = NULL;
+    if (packed == 0) {
+        stat_counters_inc(shard->counters, CACHE_STAT_COMPRESS_SKIPPED);
+    } else {
+        buf = buf_create(key, block, packed);
+        if (buf != NULL) {
+            buf->flags = CACHE_BUF_LZ;
+        }
+    }
+    free(block);
+    return buf;
+}
+
+/*
+buf_decoded_size - Payload bytes a buffer stands for (internal)
+
+For a compressed buffer this reads the block header, which faults in
+the first payload page of a restored entry.
+*/
+static size_t buf_decoded_size(cache_buf_t *buf) {
+    if (buf->flags & CACHE_BUF_LZ) {
+        size_t decoded = lz_decoded_size(buf_payload(buf), buf->size);
+        return decoded != SIZE_MAX ? decoded : 0;
+    }
+    return buf->size;
+}
+
+/*
+buf_unpack - Decoded copy of a compressed buffer, owned by the caller
+(internal; it has no key)
+*/
+static cache_buf_t *buf_unpack(cache_buf_t *packed) {
+    size_t decoded = lz_decoded_size(buf_payload(packed), packed->size);
+    pthread_once(&payload_slabs_once, payload_slabs_init);
+    if (decoded == SIZE_MAX || payload_slabs == NULL) {
+        return NULL;
+    }
+    cache_buf_t *buf = slab_alloc(payload_slabs, sizeof(cache_buf_t) + decoded);
+    if (buf == NULL) {
+        return NULL;
+    }
+    buf->refs = 1;
+    buf->key_len = 0;
+    buf->flags = 0;
+    buf->size = decoded;
+    if (!lz_decompress(buf_payload(packed), packed->size, buf->data)) {
+        fprintf(stderr, "cache: corrupt compressed payload for %s\n", packed->data);
+        slab_free(payload_slabs, buf, sizeof(cache_buf_t) + decoded);
+        return NULL;
+    }
+    return buf;
+}
+
+/*
+Per-thread buffer that cache_get() decodes compressed entries into
+*/
+static pthread_key_t unpack_scratch_key;
+static pthread_once_t unpack_scratch_once = PTHREAD_ONCE_INIT;
+
+typedef struct {
+    size_t capacity;
+    char data[];
+} unpack_scratch_t;
+
+static void unpack_scratch_init(void) {
+    pthread_key_create(&unpack_scratch_key, free);
+}
+
+/*
+unpack_scratch - The calling thread's buffer, grown to hold size bytes
+(internal)
+*/
+static char *unpack_scratch(size_t size) {
+    pthread_once(&unpack_scratch_once, unpack_scratch_init);
+    unpack_scratch_t *scratch = pthread_getspecific(unpack_scratch_key);
+    if (scratch == NULL || scratch->capacity < size) {
+        unpack_scratch_t *grown = realloc(scratch, sizeof(unpack_scratch_t) + size);
+        if (grown == NULL) {
+            return NULL;
+        }
+        grown->capacity = size;
+        pthread_setspecific(unpack_scratch_key, grown);
+        scratch = grown;
+    }
+    return scratch->data;
+}
+
+/*
+Restored snapshots. A mapping stays until the last of its buffers is
+released, which may be after the cache that restored it is destroyed.
+*/
+typedef struct snapshot_map {
+    struct snapshot_map *next;
+    char *base;
+    size_t length;
+    size_t live;                    /* Buffers still referenced (+1 while restoring) */
+} snapshot_map_t;
+
+static snapshot_map_t *snapshot_maps;
+static pthread_mutex_t snapshot_maps_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+snapshot_map_put - Drop 'count' references on a mapping; unmap it at zero
+(internal)
+*/
+static void snapshot_map_put(snapshot_map_t *map, size_t count) {
+    pthread_mutex_lock(&snapshot_maps_lock);
+    map->live -= count;
+    bool last = map->live == 0;
+    if (last) {
+        snapshot_map_t **link = &snapshot_maps;
+        while (*link != map) {
+            link = &(*link)->next;
+        }
+        *link = map->next;
+    }
+    pthread_mutex_unlock(&snapshot_maps_lock);
+
+    if (last) {
+        munmap(map->base, map->length);
+        free(map);
+    }
+}
+
+/*
+mapped_release - A restored buffer's last reference is gone (internal)
+*/
+static void mapped_release(cache_buf_t *buf) {
+    pthread_mutex_lock(&snapshot_maps_lock);
+    snapshot_map_t *map = snapshot_maps;
+    while (map != NULL && ((char *)buf < map->base || (char *)buf >= map->base + map->length)) {
+        map = map->next;
+    }
+    pthread_mutex_unlock(&snapshot_maps_lock);
+    if (map != NULL) {
+        snapshot_map_put(map, 1);
+    }
+}
+
+/*
+buf_release - Drop one reference; the last one frees the buffer (internal)
+
+Called by the cache (entry replaced or freed) and by cache_release(),
+in any order and without the shard lock. A holder that sees refs == 1
+owns the last reference: new ones are only taken through the cache's,
+which a shard with lock-free reads drops only after every lookup that
+could still take one has finished (retire_buf). Skipping the write
+then keeps a restored buffer's page clean.
+*/
+static void buf_release(cache_buf_t *buf) {
+    if (buf == NULL) {
+        return;
+    }
+    if (__atomic_load_n(&buf->refs, __ATOMIC_ACQUIRE) != 1 &&
+        __atomic_sub_fetch(&buf->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+    if (buf->flags & CACHE_BUF_MAPPED) {
+        mapped_release(buf);
+    } else {
+        slab_free(payload_slabs, buf, sizeof(cache_buf_t) + buf->key_len + buf->size);
+    }
+}
+
+static void buf_release_retired(void *buf) {
+    buf_release(buf);
+}
+
+/*
+retire_buf - Drop the cache's reference on a buffer an entry no longer
+holds (internal)
+
+With lock-free reads a lookup may still be reading it, so the release
+waits for the epoch to move on. Caller must hold the shard's write lock.
+*/
+static void retire_buf(cache_shard_t *shard, cache_buf_t *buf) {
+    if (shard->ops->read_locked_hits) {
+        epoch_retire(&shard->retired, buf_release_retired, buf);
+    } else {
+        buf_release(buf);
+    }
+}
+
+/* ============================================================================
+Expiry Wheel
+============================================================================ */
+
+/* Ticks the whole wheel spans */
+#define WHEEL_SPAN  (1ULL << (CACHE_WHEEL_BITS * CACHE_WHEEL_LEVELS))
+
+static cache_entry_cold_t *cold_at(const cache_shard_t *shard, uint32_t id) {
+    return &shard->blocks[id / CACHE_ENTRY_BLOCK]->cold[id % CACHE_ENTRY_BLOCK];
+}
+
+/*
+reclaim_tick - First tick at which an entry is past its stale window (internal)
+*/
+static uint64_t reclaim_tick(const cache_shard_t *shard, const cache_entry_t *entry) {
+    uint64_t due = entry->expires_ms + shard->stale_window_ms;
+    return (due + CACHE_WHEEL_TICK_MS - 1) / CACHE_WHEEL_TICK_MS;
+}
+
+/*
+wheel_reset - Empty the wheel and set its clock to 'now' (internal)
+*/
+static void wheel_reset(cache_wheel_t *wheel, uint64_t now) {
+    for (int i = 0; i < CACHE_WHEEL_LEVELS * CACHE_WHEEL_SLOTS; i++) {
+        wheel->slots[i] = CACHE_ENTRY_NIL;
+    }
+    wheel->tick = now / CACHE_WHEEL_TICK_MS;
+    wheel->timers = 0;
+}
+
+/*
+wheel_link - File an entry under the slot for tick 'deadline' (internal)
+
+Slots are chosen relative to the next tick to process: level l takes
+deadlines fewer than SLOTS^(l+1) ticks away, in the slot given by the
+deadline's l-th base-SLOTS digit. That slot comes up (and is cascaded)
+no later than the deadline's own span starts.
+*/
+static void wheel_link(cache_shard_t *shard, cache_entry_t *entry, uint64_t deadline) {
+    cache_wheel_t *wheel = &shard->wheel;
+    uint64_t base = wheel->tick + 1;
+    if (deadline < base) {
+        deadline = base;
+    }
+    if (deadline - base >= WHEEL_SPAN) {
+        deadline = base + WHEEL_SPAN - 1;  /* re-filed when this slot comes up */
+    }
+
+    int level = 0;
+    while (level < CACHE_WHEEL_LEVELS - 1 &&
+           deadline - base >= 1ULL << (CACHE_WHEEL_BITS * (level + 1))) {
+        level++;
+    }
+    uint32_t pos = (uint32_t)level * CACHE_WHEEL_SLOTS +
+                   (uint32_t)((deadline >> (CACHE_WHEEL_BITS * level)) & (CACHE_WHEEL_SLOTS - 1));
+
+    cache_entry_cold_t *cold = cache_entry_cold(shard, entry);
+    cold->timer_slot = pos;
+    cold->timer_prev = CACHE_ENTRY_NIL;
+    cold->timer_next = wheel->slots[pos];
+    if (cold->timer_next != CACHE_ENTRY_NIL) {
+        cold_at(shard, cold->timer_next)->timer_prev = entry->id;
+    }
+    wheel->slots[pos] = entry->id;
+    entry->timer_armed = true;
+    wheel->timers++;
+}
+
+/*
+wheel_unlink - Take an entry off the wheel, if it is on it (internal)
+*/
+static void wheel_unlink(cache_shard_t *shard, cache_entry_t *entry) {
+    if (!entry->timer_armed) {
+        return;
+    }
+    cache_entry_cold_t *cold = cache_entry_cold(shard, entry);
+    if (cold->timer_prev != CACHE_ENTRY_NIL) {
+        cold_at(shard, cold->timer_prev)->timer_next = cold->timer_next;
+    } else {
+        shard->wheel.slots[cold->timer_slot] = cold->timer_next;
+    }
+    if (cold->timer_next != CACHE_ENTRY_NIL) {
+        cold_at(shard, cold->timer_next)->timer_prev = cold->timer_prev;
+    }
+    entry->timer_armed = false;
+    shard->wheel.timers--;
+}
+
+/*
+wheel_schedule - Re-file an entry after its expiry changed (internal)
+*/
+static void wheel_schedule(cache_shard_t *shard, cache_entry_t *entry) {
+    wheel_unlink(shard, entry);
+    if (entry->expires_ms == CACHE_TTL_NONE) {
+        return;
+    }
+    if (shard->wheel.timers == 0) {
+        /* Nothing pending: skip the idle ticks instead of walking them later */
+        uint64_t tick = now_ms() / CACHE_WHEEL_TICK_MS;
+        if (tick > shard->wheel.tick) {
+            shard->wheel.tick = tick;
+        }
+    }
+    wheel_link(shard, entry, reclaim_tick(shard, entry));
+}
+
+/* ============================================================================
+Entry Table
+============================================================================ */
+
+/*
+chain_free_block - Put every entry of a block on the free list (internal)
+*/
+static void chain_free_block(cache_shard_t *shard, uint32_t block) {
+    cache_entry_t *entries = shard->blocks[block]->entries;
+    for (int i = CACHE_ENTRY_BLOCK - 1; i >= 0; i--) {
+        /* Same value on a re-chain (cache_clear), but lock-free readers
+           may be reading it (entry_cold_unlocked) */
+        __atomic_store_n(&entries[i].id, block * CACHE_ENTRY_BLOCK + (uint32_t)i,
+                         __ATOMIC_RELAXED);
+        entries[i].lru_next = shard->free_entries;
+        shard->free_entries = entries[i].id;
+    }
+}
+
+/*
+entry_alloc - Take a zeroed entry from the shard's table (internal)
+
+Grows the table by one block when no slot is free.
+*/
+static cache_entry_t *entry_alloc(cache_shard_t *shard) {
+    if (shard->free_entries == CACHE_ENTRY_NIL) {
+        if (shard->num_blocks >= CACHE_ENTRY_NIL / CACHE_ENTRY_BLOCK) {
+            return NULL;
+        }
+        cache_entry_block_t **blocks = realloc(shard->blocks,
+                                               (shard->num_blocks + 1) * sizeof(*blocks));
+        if (blocks == NULL) {
+            return NULL;
+        }
+        shard->blocks = blocks;
+        blocks[shard->num_blocks] = aligned_alloc(64, sizeof(cache_entry_block_t));
+        if (blocks[shard->num_blocks] == NULL) {
+            return NULL;
+        }
+        chain_free_block(shard, shard->num_blocks++);
+    }
+
+    uint32_t id = shard->free_entries;
+    cache_entry_t *entry = cache_entry_at(shard, id);
+    shard->free_entries = entry->lru_next;
+
+    /* Everything but id: a lock-free reader still on the old entry finds
+       the cold data through it (entry_cold_unlocked) */
+    memset(entry, 0, offsetof(cache_entry_t, lru_prev));
+    memset(&entry->clock_index, 0, sizeof(*entry) - offsetof(cache_entry_t, clock_index));
+    memset(cold_at(shard, id), 0, sizeof(cache_entry_cold_t));
+    entry->lru_prev = CACHE_ENTRY_NIL;
+    entry->lru_next = CACHE_ENTRY_NIL;
+    return entry;
+}
+
+/*
+entry_free - Return an (unlinked) entry's slot to the table (internal)
+*/
+static void entry_free(cache_shard_t *shard, cache_entry_t *entry) {
+    __atomic_store_n(&entry->buf, NULL, __ATOMIC_RELEASE);
+    entry->key = NULL;
+    entry->lru_next = shard->free_entries;
+    shard->free_entries = entry->id;
+}
+
+/*
+count_payload - Add an installed payload to the shard's payload
+statistics (internal)
+
+Callers pass what they know rather than have the buffer read: a
+restored buffer is not faulted in until it is used.
+*/
+static void count_payload(cache_shard_t *shard, size_t decoded, bool compressed) {
+    shard->payload_bytes += decoded;
+    shard->num_compressed += compressed ? 1 : 0;
+}
+
+/*
+uncount_payload - Remove a buffer leaving the shard from its payload
+statistics (internal)
+*/
+static void uncount_payload(cache_shard_t *shard, cache_buf_t *buf) {
+    shard->payload_bytes -= buf_decoded_size(buf);
+    shard->num_compressed -= (buf->flags & CACHE_BUF_LZ) ? 1 : 0;
+}
+
+/*
+free_entry - Unlink an entry from all structures and free it (internal)
+
+Caller must hold the shard's write lock.
+*/
+static void free_entry(cache_shard_t *shard, cache_entry_t *entry) {
+    remove_from_hash(shard, entry);
+    wheel_unlink(shard, entry);
+    shard->ops->on_remove(shard, entry);
+    shard->current_size -= entry->size;
+    shard->num_entries--;
+    uncount_payload(shard, entry->buf);
+    retire_buf(shard, entry->buf);
+    entry_free(shard, entry);
+}
+
+/*
+free_all_entries - Release every entry's payload and free all slots (internal)
+*/
+static void free_all_entries(cache_shard_t *shard) {
+    for (int i = 0; i < CACHE_SEGMENTS; i++) {
+        cache_entry_t *entry = shard->segments[i].head;
+        while (entry != NULL) {
+            retire_buf(shard, entry->buf);
+            entry = cache_entry_at(shard, entry->lru_next);
+        }
+    }
+    shard->free_entries = CACHE_ENTRY_NIL;
+    for (uint32_t b = shard->num_blocks; b > 0; b--) {
+        chain_free_block(shard, b - 1);
+    }
+    wheel_reset(&shard->wheel, now_ms());
+}
+
+/*
+free_entry_table - Free the blocks of a shard's entry table (internal)
+*/
+static void free_entry_table(cache_shard_t *shard) {
+    for (uint32_t b = 0; b < shard->num_blocks; b++) {
+        free(shard->blocks[b]);
+    }
+    free(shard->blocks);
+    shard->blocks = NULL;
+    shard->num_blocks = 0;
+    shard->free_entries = CACHE_ENTRY_NIL;
+}
+
+/* ============================================================================
+Disk Tier
+============================================================================ */
+
+/*
+An evicted entry waiting for the disk writer. It holds a reference on
+the buffer, so queueing copies nothing and a lookup can still promote
+the payload from the queue.
+*/
+typedef struct {
+    cache_buf_t *buf;               /* NULL for an empty slot */
+    unsigned long hash;
+    uint64_t expires_ms;
+    cache_validator_t validator;
+    bool has_validator;
+    bool cancelled;                 /* Key put, removed or promoted meanwhile */
+} disk_write_t;
+
+struct cache_l2 {
+    cache_disk_t *disk;
+    pthread_t writer;
+    pthread_mutex_t lock;           /* Queue, writing and counters */
+    pthread_cond_t wake;            /* Work queued, or stopping */
+    pthread_cond_t idle;            /* Queue drained (cache_flush_disk) */
+    disk_write_t queue[CACHE_DISK_QUEUE_LEN];   /* Ring */
+    size_t queue_head;
+    size_t queue_count;
+    size_t queue_bytes;             /* Images queued or being written */
+    disk_write_t writing;           /* Popped by the writer (buf NULL if none) */
+    bool stopping;
+    unsigned long dropped;          /* Victims not queued */
+    unsigned long hits;             /* Lookups answered by promotion */
+};
+
+/*
+buf_image_size - Bytes of a buffer's image: header, key and payload (internal)
+*/
+static size_t buf_image_size(const cache_buf_t *buf) {
+    return sizeof(cache_buf_t) + buf->key_len + buf->size;
+}
+
+/*
+pending_write - Queued or in-flight write of a key, or NULL (internal)
+
+Caller must hold l2->lock.
+*/
+static disk_write_t *pending_write(cache_l2_t *l2, const char *key, unsigned long hash) {
+    for (size_t i = 0; i <= l2->queue_count; i++) {
+        disk_write_t *w = i < l2->queue_count
+                          ? &l2->queue[(l2->queue_head + i) % CACHE_DISK_QUEUE_LEN]
+                          : &l2->writing;
+        if (w->buf != NULL && !w->cancelled && w->hash == hash &&
+            strcmp(w->buf->data, key) == 0) {
+            return w;
+        }
+    }
+    return NULL;
+}
+
+/*
+demote - Queue an entry that is leaving memory for the disk writer (internal)
+
+Never blocks on I/O: with the queue full the victim is simply dropped.
+Caller must hold the shard's write lock.
+*/
+static void demote(cache_shard_t *shard, cache_entry_t *victim) {
+    cache_l2_t *l2 = shard->l2;
+    if (l2 == NULL || is_expired(victim, now_ms())) {
+        return;
+    }
+    size_t length = buf_image_size(victim->buf);
+    if (length > CACHE_DISK_SEGMENT_SIZE) {
+        return;
+    }
+
+    pthread_mutex_lock(&l2->lock);
+    if (l2->stopping || l2->queue_count == CACHE_DISK_QUEUE_LEN ||
+        l2->queue_bytes + length > CACHE_DISK_QUEUE_BYTES) {
+        l2->dropped++;
+        pthread_mutex_unlock(&l2->lock);
+        return;
+    }
+    disk_write_t *w = &l2->queue[(l2->queue_head + l2->queue_count) % CACHE_DISK_QUEUE_LEN];
+    __atomic_add_fetch(&victim->buf->refs, 1, __ATOMIC_RELAXED);
+    w->buf = victim->buf;
+    w->hash = victim->hash;
+    w->expires_ms = victim->expires_ms;
+    w->has_validator = victim->has_validator;
+    if (victim->has_validator) {
+        w->validator = cache_entry_cold(shard, victim)->validator;
+    }
+    w->cancelled = false;
+    l2->queue_count++;
+    l2->queue_bytes += length;
+    pthread_cond_signal(&l2->wake);
+    pthread_mutex_unlock(&l2->lock);
+}
+
+/*
+disk_forget - Drop the disk tier's copy of a key, queued or written (internal)
+
+Called when memory gets a newer version, or none at all.
+
+Returns: true if there was a copy.
+*/
+static bool disk_forget(cache_l2_t *l2, const char *key, unsigned long hash) {
+    if (l2 == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&l2->lock);
+    bool found = false;
+    disk_write_t *w;
+    while ((w = pending_write(l2, key, hash)) != NULL) {
+        w->cancelled = true;
+        found = true;
+    }
+    found = cache_disk_remove(l2->disk, hash, NULL) || found;
+    pthread_mutex_unlock(&l2->lock);
+    return found;
+}
+
+/*
+disk_writer_main - Append queued victims to the log (disk writer thread)
+
+The record is indexed under l2->lock, after checking that the key was
+not put or removed while it was being written.
+*/
+static void *disk_writer_main(void *arg) {
+    cache_l2_t *l2 = arg;
+
+    pthread_mutex_lock(&l2->lock);
+    while (true) {
+        while (l2->queue_count == 0 && !l2->stopping) {
+            pthread_cond_wait(&l2->wake, &l2->lock);
+        }
+        if (l2->stopping) {
+            break;
+        }
+        disk_write_t *next = &l2->queue[l2->queue_head];
+        l2->writing = *next;
+        next->buf = NULL;
+        l2->queue_head = (l2->queue_head + 1) % CACHE_DISK_QUEUE_LEN;
+        l2->queue_count--;
+
+        cache_buf_t *buf = l2->writing.buf;
+        size_t length = buf_image_size(buf);
+        if (!l2->writing.cancelled) {
+            pthread_mutex_unlock(&l2->lock);
+            /* The header is copied: refs keeps changing while we write */
+            cache_buf_t header = { 0, buf->key_len, buf->flags & CACHE_BUF_LZ, buf->size };
+            cache_disk_loc_t loc;
+            bool written = cache_disk_append(l2->disk, &header, sizeof(header), buf->data,
+                                             length - sizeof(header), &loc);
+            pthread_mutex_lock(&l2->lock);
+
+            if (written && !l2->writing.cancelled) {
+                loc.expires_ms = l2->writing.expires_ms;
+                loc.has_validator = l2->writing.has_validator;
+                loc.validator = l2->writing.validator;
+                cache_disk_insert(l2->disk, l2->writing.hash, &loc);
+            }
+        }
+
+        l2->writing.buf = NULL;
+        l2->queue_bytes -= length;
+        if (l2->queue_count == 0) {
+            pthread_cond_broadcast(&l2->idle);
+        }
+        pthread_mutex_unlock(&l2->lock);
+        buf_release(buf);
+        pthread_mutex_lock(&l2->lock);
+    }
+    pthread_mutex_unlock(&l2->lock);
+    return NULL;
+}
+
+/*
+disk_fetch - Take a key's payload out of the disk tier (internal)
+
+Looks in the writer's queue first (sharing the buffer), then reads the
+record into a new slab buffer and checks that it holds this key.
+Either way the disk tier's copy is dropped: the caller moves the entry
+to memory. No shard lock is held.
+
+Returns: The buffer (one reference, owned by the caller), or NULL.
+*/
+static cache_buf_t *disk_fetch(cache_l2_t *l2, const char *key, unsigned long hash,
+                               cache_validator_t *validator, bool *has_validator,
+                               uint64_t *expires_ms) {
+    pthread_mutex_lock(&l2->lock);
+    disk_write_t *w = pending_write(l2, key, hash);
+    if (w != NULL) {
+        __atomic_add_fetch(&w->buf->refs, 1, __ATOMIC_RELAXED);
+        w->cancelled = true;
+        *validator = w->validator;
+        *has_validator = w->has_validator;
+        *expires_ms = w->expires_ms;
+        cache_buf_t *buf = w->buf;
+        pthread_mutex_unlock(&l2->lock);
+        return buf;
+    }
+    pthread_mutex_unlock(&l2->lock);
+
+    cache_disk_loc_t loc;
+    if (!cache_disk_find(l2->disk, hash, &loc) || loc.length < sizeof(cache_buf_t)) {
+        return NULL;
+    }
+    pthread_once(&payload_slabs_once, payload_slabs_init);
+    cache_buf_t *buf = payload_slabs != NULL ? slab_alloc(payload_slabs, loc.length) : NULL;
+    if (buf == NULL) {
+        return NULL;
+    }
+
+    bool valid = cache_disk_read(l2->disk, &loc, buf) &&
+                 buf->key_len > 0 && buf_image_size(buf) == loc.length &&
+                 buf->data[buf->key_len - 1] == '\0' && strcmp(buf->data, key) == 0;
+    if (!valid) {
+        slab_free(payload_slabs, buf, loc.length);
+        return NULL;
+    }
+    buf->refs = 1;
+    buf->flags &= CACHE_BUF_LZ;
+
+    /* Taken only if no newer version was written meanwhile */
+    pthread_mutex_lock(&l2->lock);
+    bool taken = cache_disk_remove(l2->disk, hash, &loc);
+    pthread_mutex_unlock(&l2->lock);
+    if (!taken) {
+        slab_free(payload_slabs, buf, loc.length);
+        return NULL;
+    }
+
+    *validator = loc.validator;
+    *has_validator = loc.has_validator;
+    *expires_ms = loc.expires_ms;
+    return buf;
+}
+
+/*
+disk_holds - Does the disk tier have a copy of a key? After disk_fetch
+took ours, any copy is a newer version evicted meanwhile (internal)
+*/
+static bool disk_holds(cache_l2_t *l2, const char *key, unsigned long hash) {
+    cache_disk_loc_t loc;
+    pthread_mutex_lock(&l2->lock);
+    bool held = pending_write(l2, key, hash) != NULL || cache_disk_find(l2->disk, hash, &loc);
+    pthread_mutex_unlock(&l2->lock);
+    return held;
+}
+
+static cache_entry_t *install_locked(cache_shard_t *shard, const char *key, unsigned long hash,
+                                     cache_buf_t *buf, size_t charge,
+                                     const cache_validator_t *validator, uint64_t expires_ms,
+                                     uint32_t cost);
+
+/*
+promote - Move a key from the disk tier back to memory after a miss (internal)
+
+Returns: true if memory now holds the key (the caller looks again).
+*/
+static bool promote(cache_shard_t *shard, const char *key, unsigned long hash) {
+    cache_l2_t *l2 = shard->l2;
+    cache_validator_t validator;
+    bool has_validator;
+    uint64_t expires_ms;
+    cache_buf_t *buf = disk_fetch(l2, key, hash, &validator, &has_validator, &expires_ms);
+    if (buf == NULL) {
+        return false;
+    }
+
+    pthread_rwlock_wrlock(&shard->lock);
+    bool stored = false;
+    size_t charge = slab_chunk_size(buf_image_size(buf));
+    bool too_stale = expires_ms != CACHE_TTL_NONE &&
+                     expires_ms + shard->stale_window_ms <= now_ms();
+    if (find_entry(shard, key, hash) != NULL) {
+        buf_release(buf);           /* A put beat us to it: that one is newer */
+        stored = true;
+    } else if (too_stale || charge > shard->max_size || disk_holds(l2, key, hash)) {
+        buf_release(buf);
+    } else {
+        size_t decoded = buf_decoded_size(buf);
+        bool compressed = (buf->flags & CACHE_BUF_LZ) != 0;
+        stored = install_locked(shard, buf->data, hash, buf, charge,
+                                has_validator ? &validator : NULL, expires_ms,
+                                CACHE_COST_DEFAULT) != NULL;
+        if (stored) {
+            count_payload(shard, decoded, compressed);
+        }
+    }
+    pthread_rwlock_unlock(&shard->lock);
+
+    if (stored) {
+        __atomic_fetch_add(&l2->hits, 1, __ATOMIC_RELAXED);
+    }
+    return stored;
+}
+
+/*
+cache_attach_disk - Add a disk tier behind the memory cache
+*/
+bool cache_attach_disk(cache_t *cache, const char *path, size_t capacity) {
+    if (cache == NULL || path == NULL || cache->l2 != NULL) {
+        return false;
+    }
+    cache_l2_t *l2 = calloc(1, sizeof(cache_l2_t));
+    if (l2 == NULL) {
+        perror("calloc disk tier");
+        return false;
+    }
+    l2->disk = cache_disk_open(path, capacity);
+    if (l2->disk == NULL) {
+        free(l2);
+        return false;
+    }
+    pthread_mutex_init(&l2->lock, NULL);
+    pthread_cond_init(&l2->wake, NULL);
+    pthread_cond_init(&l2->idle, NULL);
+    if (pthread_create(&l2->writer, NULL, disk_writer_main, l2) != 0) {
+        perror("pthread_create disk writer");
+        pthread_cond_destroy(&l2->idle);
+        pthread_cond_destroy(&l2->wake);
+        pthread_mutex_destroy(&l2->lock);
+        cache_disk_close(l2->disk);
+        free(l2);
+        return false;
+    }
+
+    for (int i = 0; i < cache->num_shards; i++) {
+        cache->shards[i].l2 = l2;
+    }
+    cache->l2 = l2;
+    return true;
+}
+
+/*
+cache_flush_disk - Wait until every queued eviction is on disk
+*/
+void cache_flush_disk(cache_t *cache) {
+    if (cache == NULL || cache->l2 == NULL) {
+        return;
+    }
+    cache_l2_t *l2 = cache->l2;
+    pthread_mutex_lock(&l2->lock);
+    while (l2->queue_count > 0 || l2->writing.buf != NULL) {
+        pthread_cond_wait(&l2->idle, &l2->lock);
+    }
+    pthread_mutex_unlock(&l2->lock);
+}
+
+/*
+detach_disk - Stop the writer, drop what it had not written and close
+the log (internal)
+*/
+static void detach_disk(cache_t *cache) {
+    cache_l2_t *l2 = cache->l2;
+    if (l2 == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&l2->lock);
+    l2->stopping = true;
+    pthread_cond_signal(&l2->wake);
+    pthread_mutex_unlock(&l2->lock);
+    pthread_join(l2->writer, NULL);
+
+    while (l2->queue_count > 0) {
+        buf_release(l2->queue[l2->queue_head].buf);
+        l2->queue_head = (l2->queue_head + 1) % CACHE_DISK_QUEUE_LEN;
+        l2->queue_count--;
+    }
+    for (int i = 0; i < cache->num_shards; i++) {
+        cache->shards[i].l2 = NULL;
+    }
+    cache_disk_close(l2->disk);
+    pthread_cond_destroy(&l2->idle);
+    pthread_cond_destroy(&l2->wake);
+    pthread_mutex_destroy(&l2->lock);
+    free(l2);
+    cache->l2 = NULL;
+}
+
+/* ============================================================================
+Cache Lifecycle
+============================================================================ */
+
+/*
+cache_create - Create a new cache
+*/
+cache_t *cache_create(size_t max_size) {
+    return cache_create_with_policy(max_size, 0, CACHE_POLICY_LRU);
+}
+
+/*
+cache_create_sharded - Create a cache with an explicit shard count
+*/
+cache_t *cache_create_sharded(size_t max_size, int num_shards) {
+    if (num_shards < 1) {
+        fprintf(stderr, "cache_create_sharded: invalid shard count %d\n", num_shards);
+        return NULL;
+    }
+    return cache_create_with_policy(max_size, num_shards, CACHE_POLICY_LRU);
+}
+
+/*
+cache_create_with_policy - Create a cache with a replacement policy
+*/
+cache_t *cache_create_with_policy(size_t max_size, int num_shards, cache_policy_t policy) {
+    if (num_shards == 0) {
+        num_shards = DEFAULT_CACHE_SHARDS;
+        while (num_shards > 1 && max_size / num_shards < CACHE_MIN_SHARD_SIZE) {
+            num_shards /= 2;
+        }
+    }
+    if (num_shards < 1 || num_shards > CACHE_MAX_SHARDS) {
+        fprintf(stderr, "cache_create_sharded: invalid shard count %d\n", num_shards);
+        return NULL;
+    }
+    const cache_policy_ops_t *ops = cache_policy_ops(policy);
+    if (ops == NULL) {
+        fprintf(stderr, "cache_create_with_policy: unknown policy %d\n", policy);
+        return NULL;
+    }
+
+    cache_t *cache = malloc(sizeof(cache_t));
+    if (cache == NULL) {
+        perror("malloc cache");
+        return NULL;
+    }
+    if (!stat_counters_init(&cache->counters, CACHE_STAT_COUNT)) {
+        free(cache);
+        return NULL;
+    }
+
+    void *shards;
+    if (posix_memalign(&shards, __alignof__(cache_shard_t),
+                       num_shards * sizeof(cache_shard_t)) != 0) {
+        perror("posix_memalign cache shards");
+        stat_counters_destroy(&cache->counters);
+        free(cache);
+        return NULL;
+    }
+    memset(shards, 0, num_shards * sizeof(cache_shard_t));
+    cache->shards = shards;
+    cache->num_shards = num_shards;
+    cache->max_size = max_size;
+    cache->policy = policy;
+
+    for (int i = 0; i < num_shards; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+
+        /* Spread the budget; the first shards take the remainder */
+        shard->max_size = max_size / num_shards + ((size_t)i < max_size % num_shards ? 1 : 0);
+        shard->policy = policy;
+        shard->ops = ops;
+        shard->free_entries = CACHE_ENTRY_NIL;
+        shard->counters = &cache->counters;
+        shard->revalidate_timeout_ms = CACHE_REVALIDATE_TIMEOUT_MS;
+        wheel_reset(&shard->wheel, now_ms());
+        bool index_ok = cache_index_init(&shard->index, INDEX_INITIAL_SLOTS);
+        if (ops->read_locked_hits) {
+            shard->index.retired = &shard->retired;
+            shard->lockfree_reads = true;
+        }
+
+        bool policy_ok = ops->init(shard);
+        if (!index_ok || !policy_ok ||
+            pthread_rwlock_init(&shard->lock, NULL) != 0) {
+            perror("cache shard init");
+            cache_index_destroy(&shard->index);
+            ops->destroy(shard);
+            for (int j = 0; j < i; j++) {
+                cache_index_destroy(&cache->shards[j].index);
+                ops->destroy(&cache->shards[j]);
+                pthread_rwlock_destroy(&cache->shards[j].lock);
+            }
+            free(cache->shards);
+            stat_counters_destroy(&cache->counters);
+            free(cache);
+            return NULL;
+        }
+    }
+
+    /* The sweeper sleeps on the monotonic clock, like the TTLs */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cache->sweeper_wake, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&cache->sweeper_lock, NULL);
+    cache->sweeper_running = false;
+    cache->sweep_interval_ms = CACHE_SWEEP_INTERVAL_MS;
+    cache->l2 = NULL;
+    cache->compress = false;
+    cache->mrc = mrc_create(max_size);
+
+    return cache;
+}
+
+/*
+cache_destroy - Destroy cache and free all memory
+*/
+void cache_destroy(cache_t *cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    cache_stop_sweeper(cache);
+    detach_disk(cache);
+    pthread_cond_destroy(&cache->sweeper_wake);
+    pthread_mutex_destroy(&cache->sweeper_lock);
+
+    for (int i = 0; i < cache->num_shards; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        free_all_entries(shard);
+        free_entry_table(shard);
+        cache_index_destroy(&shard->index);
+        epoch_drain(&shard->retired);
+        shard->ops->destroy(shard);
+        pthread_rwlock_destroy(&shard->lock);
+    }
+
+    free(cache->shards);
+    stat_counters_destroy(&cache->counters);
+    mrc_destroy(cache->mrc);
+    free(cache);
+}
+
+/* ============================================================================
+Cache Operations
+============================================================================ */
+
+/*
+past_stale_window - Whether an expired entry may no longer be served
+(internal)
+*/
+static bool past_stale_window(const cache_shard_t *shard, const cache_entry_t *entry,
+                              uint64_t now) {
+    return now - entry->expires_ms >= shard->stale_window_ms;
+}
+
+/*
+lookup_live - Find a non-expired entry, dropping it if expired (internal)
+
+Caller must hold the shard's write lock.
+*/
+static cache_entry_t *lookup_live(cache_shard_t *shard, const char *key, unsigned long hash) {
+    cache_entry_t *entry = find_entry(shard, key, hash);
+    uint64_t now = now_ms();
+    if (entry != NULL && is_expired(entry, now) &&
+        (!entry->revalidating || past_stale_window(shard, entry, now))) {
+        free_entry(shard, entry);
+        stat_counters_inc(shard->counters, CACHE_STAT_EXPIRATIONS);
+        return NULL;
+    }
+    if (entry != NULL && is_expired(entry, now)) {
+        return NULL;  /* Being revalidated - plain lookups still miss */
+    }
+    return entry;
+}
+
+/*
+entry_cold_unlocked - Cold data of an entry found without the shard lock
+(internal)
+
+shard->blocks may be reallocated meanwhile, so the block is found from
+the entry's address instead: entries[] starts the block, and an entry's
+id never changes once its block exists.
+*/
+static cache_entry_cold_t *entry_cold_unlocked(cache_entry_t *entry) {
+    uint32_t slot = __atomic_load_n(&entry->id, __ATOMIC_RELAXED) % CACHE_ENTRY_BLOCK;
+    cache_entry_block_t *block = (cache_entry_block_t *)(entry - slot);
+    return &block->cold[slot];
+}
+
+/*
+set_validator - Record an entry's validator (internal; write lock held)
+
+Stored field by field with atomics: lock-free hits copy it concurrently
+and tell a torn copy by validator_seq.
+*/
+static void set_validator(cache_shard_t *shard, cache_entry_t *entry,
+                          const cache_validator_t *validator) {
+    cache_entry_cold_t *cold = cache_entry_cold(shard, entry);
+    __atomic_store_n(&entry->has_validator, validator != NULL, __ATOMIC_RELAXED);
+    if (validator != NULL) {
+        __atomic_store_n(&cold->validator.mtime_ns, validator->mtime_ns, __ATOMIC_RELAXED);
+        __atomic_store_n(&cold->validator.size, validator->size, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+copy_validator - Report an entry's validator, zeroed if unknown (internal)
+*/
+static void copy_validator(const cache_shard_t *shard, const cache_entry_t *entry,
+                           cache_validator_t *validator) {
+    if (validator == NULL) {
+        return;
+    }
+    if (entry->has_validator) {
+        *validator = cache_entry_cold(shard, entry)->validator;
+    } else {
+        memset(validator, 0, sizeof(*validator));
+    }
+}
+
+/*
+How a hit is handed to the caller
+*/
+typedef enum {
+    HIT_RAW,        /* The cached payload itself (cache_get) */
+    HIT_COPY,       /* malloc'd copy (cache_get_copy, cache_lookup_copy) */
+    HIT_PIN,        /* handle holding a reference (cache_acquire, ...) */
+    HIT_PACKED      /* HIT_PIN, but compressed payloads stay compressed */
+} hit_mode_t;
+
+/*
+deliver - Fill the caller's outputs for a hit on buffer buf (internal)
+
+Caller holds the shard lock (read or write) or is in an epoch section.
+For HIT_PIN only data is filled from the handle; the payload stays
+valid after the lock is dropped because the handle owns a reference.
+
+A compressed payload is not decoded here: it is pinned into *packed
+and the caller decodes it with unpack_hit() once the lock is dropped,
+so decompression never holds up the shard.
+
+Returns: false if a copy could not be allocated.
+*/
+static bool deliver(cache_buf_t *buf, hit_mode_t mode, char **data,
+                    size_t *size, cache_handle_t *handle, cache_buf_t **packed) {
+    *packed = NULL;
+    if ((buf->flags & CACHE_BUF_LZ) && mode != HIT_PACKED) {
+        __atomic_add_fetch(&buf->refs, 1, __ATOMIC_RELAXED);
+        *packed = buf;
+        return true;
+    }
+
+    switch (mode) {
+    case HIT_RAW:
+        if (data) *data = buf_payload(buf);
+        break;
+    case HIT_COPY: {
+        char *copy = malloc(buf->size > 0 ? buf->size : 1);
+        if (copy == NULL) {
+            return false;
+        }
+        memcpy(copy, buf_payload(buf), buf->size);
+        *data = copy;
+        break;
+    }
+    case HIT_PIN:
+    case HIT_PACKED:
+        __atomic_add_fetch(&buf->refs, 1, __ATOMIC_RELAXED);
+        handle->buf = buf;
+        handle->data = buf_payload(buf);
+        handle->size = buf->size;
+        handle->compressed = (buf->flags & CACHE_BUF_LZ) != 0;
+        break;
+    }
+    if (size) *size = buf->size;
+    return true;
+}
+
+/*
+unpack_hit - Decode a compressed hit pinned by deliver() (internal)
+
+No lock is held. Releases 'packed' (NULL: the hit was not compressed
+and deliver() already filled the outputs).
+
+Returns: false if out of memory or the block is corrupt.
+*/
+static bool unpack_hit(cache_buf_t *packed, hit_mode_t mode, char **data, size_t *size,
+                       cache_handle_t *handle) {
+    if (packed == NULL) {
+        return true;
+    }
+    const char *block = buf_payload(packed);
+    size_t decoded = lz_decoded_size(block, packed->size);
+    bool ok = false;
+
+    switch (mode) {
+    case HIT_RAW: {
+        char *scratch = unpack_scratch(decoded);
+        ok = scratch != NULL && lz_decompress(block, packed->size, scratch);
+        if (ok && data) *data = scratch;
+        break;
+    }
+    case HIT_COPY: {
+        char *copy = malloc(decoded > 0 ? decoded : 1);
+        ok = copy != NULL && lz_decompress(block, packed->size, copy);
+        if (ok) {
+            *data = copy;
+        } else {
+            free(copy);
+        }
+        break;
+    }
+    case HIT_PIN:
+    case HIT_PACKED: {
+        cache_buf_t *buf = buf_unpack(packed);
+        ok = buf != NULL;
+        if (ok) {
+            handle->buf = buf;
+            handle->data = buf_payload(buf);
+            handle->size = buf->size;
+            handle->compressed = false;
+        }
+        break;
+    }
+    }
+
+    buf_release(packed);
+    if (ok && size) *size = decoded;
+    return ok;
+}
+
+/*
+lockfree_hit - Answer a fresh hit without the shard lock (internal)
+
+Only for shards with lockfree_reads. The entry found may be freed, or
+reused for another key, at any moment; its buffer cannot be freed
+before epoch_exit(). So the buffer is loaded once and its key checked,
+and the entry must still hold it after the expiry is read. Losing a
+race with a writer costs nothing worse than a hit bit landing on the
+slot's next entry.
+
+Returns: true on a hit (outputs filled). false leaves the lookup to the
+locked path: a miss (a lookup racing with an index resize can overlook
+an entry, so misses are only trusted under the lock), an expired
+entry, or a lost race.
+*/
+static bool lockfree_hit(cache_shard_t *shard, const char *key, unsigned long hash,
+                         hit_mode_t mode, char **data, size_t *size, cache_handle_t *handle,
+                         cache_validator_t *validator) {
+    if (!epoch_enter()) {
+        return false;
+    }
+
+    cache_entry_t *entry = cache_index_find(&shard->index, hash, entry_buf_has_key, key);
+    cache_entry_cold_t *cold = NULL;
+    uint32_t seq = 0;
+    if (entry != NULL && validator != NULL) {
+        cold = entry_cold_unlocked(entry);
+        seq = __atomic_load_n(&cold->validator_seq, __ATOMIC_ACQUIRE);
+    }
+    cache_buf_t *buf = entry != NULL ? __atomic_load_n(&entry->buf, __ATOMIC_ACQUIRE) : NULL;
+    if (buf == NULL || (seq & 1) != 0 || strcmp(buf->data, key) != 0) {
+        epoch_exit();
+        return false;
+    }
+    uint64_t expires_ms = __atomic_load_n(&entry->expires_ms, __ATOMIC_ACQUIRE);
+    if (expires_ms != CACHE_TTL_NONE && expires_ms <= now_ms()) {
+        epoch_exit();
+        return false;
+    }
+    /* The validator of this very buffer: no writer may have run meanwhile */
+    if (validator != NULL) {
+        bool known = __atomic_load_n(&entry->has_validator, __ATOMIC_RELAXED);
+        validator->mtime_ns = known ? __atomic_load_n(&cold->validator.mtime_ns,
+                                                      __ATOMIC_RELAXED) : 0;
+        validator->size = known ? __atomic_load_n(&cold->validator.size, __ATOMIC_RELAXED) : 0;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    }
+    if (__atomic_load_n(&entry->buf, __ATOMIC_ACQUIRE) != buf ||
+        (validator != NULL && __atomic_load_n(&cold->validator_seq, __ATOMIC_RELAXED) != seq)) {
+        epoch_exit();
+        return false;
+    }
+
+    cache_buf_t *packed;
+    if (!deliver(buf, mode, data, size, handle, &packed)) {
+        epoch_exit();
+        return false;
+    }
+    shard->ops->on_hit(shard, entry);
+    stat_counters_inc(shard->counters, CACHE_STAT_HITS);
+    stat_counters_add(shard->counters, CACHE_STAT_HIT_BYTES, buf_decoded_size(buf));
+    epoch_exit();
+
+    return unpack_hit(packed, mode, data, size, handle);
+}
+
+/*
+read_hit - Answer a lookup without the write lock
+
+Only for policies with read_locked_hits (CLOCK, S3-FIFO): a fresh hit
+only updates the entry's hit bits, and the counters are per thread,
+so concurrent hits never exclude each other. Hits are
+served lock-free when the shard allows it, validator included (copied
+under the entry's validator_seq); the rest is answered under the read
+lock.
+
+Returns: 1 on a hit (outputs filled), 0 on a miss (counted if
+count_miss), -1 if the entry has expired and the caller must retry on
+the write-locked path (which may drop it or elect a revalidator).
+*/
+static int read_hit(cache_shard_t *shard, const char *key, unsigned long hash, hit_mode_t mode,
+                    char **data, size_t *size, cache_handle_t *handle,
+                    cache_validator_t *validator, bool count_miss) {
+    if (__atomic_load_n(&shard->lockfree_reads, __ATOMIC_RELAXED) &&
+        lockfree_hit(shard, key, hash, mode, data, size, handle, validator)) {
+        return 1;
+    }
+
+    pthread_rwlock_rdlock(&shard->lock);
+
+    cache_entry_t *entry = find_entry(shard, key, hash);
+    if (entry == NULL) {
+        if (count_miss) {
+            stat_counters_inc(shard->counters, CACHE_STAT_MISSES);
+        }
+        pthread_rwlock_unlock(&shard->lock);
+        return 0;
+    }
+    if (is_expired(entry, now_ms())) {
+        pthread_rwlock_unlock(&shard->lock);
+        return -1;
+    }
+
+    cache_buf_t *packed;
+    if (!deliver(entry->buf, mode, data, size, handle, &packed)) {
+        pthread_rwlock_unlock(&shard->lock);
+        return 0;
+    }
+    copy_validator(shard, entry, validator);
+    shard->ops->on_hit(shard, entry);
+    stat_counters_inc(shard->counters, CACHE_STAT_HITS);
+    stat_counters_add(shard->counters, CACHE_STAT_HIT_BYTES, buf_decoded_size(entry->buf));
+
+    pthread_rwlock_unlock(&shard->lock);
+    return unpack_hit(packed, mode, data, size, handle) ? 1 : 0;
+}
+
+/*
+get_once - One memory lookup for get_common (internal)
+
+A miss is only counted if count_miss: with a disk tier, the caller
+counts it once the disk tier has missed too.
+*/
+static bool get_once(cache_shard_t *shard, const char *key, unsigned long hash, hit_mode_t mode,
+                     char **data, size_t *size, cache_handle_t *handle, bool count_miss) {
+    if (shard->ops->read_locked_hits) {
+        int found = read_hit(shard, key, hash, mode, data, size, handle, NULL, count_miss);
+        if (found >= 0) {
+            return found == 1;
+        }
+    }
+
+    /* LRU hits reorder the list, so even lookups need the write lock */
+    pthread_rwlock_wrlock(&shard->lock);
+    record_access(shard, hash);
+
+    cache_entry_t *entry = lookup_live(shard, key, hash);
+    if (entry == NULL) {
+        if (count_miss) {
+            stat_counters_inc(shard->counters, CACHE_STAT_MISSES);
+        }
+        pthread_rwlock_unlock(&shard->lock);
+        return false;
+    }
+    cache_buf_t *packed;
+    if (!deliver(entry->buf, mode, data, size, handle, &packed)) {
+        pthread_rwlock_unlock(&shard->lock);
+        return false;
+    }
+
+    stat_counters_inc(shard->counters, CACHE_STAT_HITS);
+    stat_counters_add(shard->counters, CACHE_STAT_HIT_BYTES, buf_decoded_size(entry->buf));
+    cache_move_to_front(shard, entry);
+
+    pthread_rwlock_unlock(&shard->lock);
+    return unpack_hit(packed, mode, data, size, handle);
+}
+
+/*
+sample_request - Feed a lookup to the miss-ratio curve estimator (internal)
+
+Only the hash-sampled keys get past the inline check.
+*/
+static inline void sample_request(cache_t *cache, unsigned long hash) {
+    if (cache->mrc != NULL && mrc_sampled(cache->mrc, hash)) {
+        mrc_access(cache->mrc, hash);
+    }
+}
+
+/*
+get_hashed - One get of a key already hashed and sampled (internal)
+
+A memory miss is retried once after promoting the key from the disk tier.
+*/
+static bool get_hashed(cache_shard_t *shard, const char *key, unsigned long hash,
+                       hit_mode_t mode, char **data, size_t *size, cache_handle_t *handle) {
+    if (get_once(shard, key, hash, mode, data, size, handle, shard->l2 == NULL)) {
+        return true;
+    }
+    if (shard->l2 == NULL) {
+        return false;
+    }
+    if (promote(shard, key, hash)) {
+        return get_once(shard, key, hash, mode, data, size, handle, true);
+    }
+    stat_counters_inc(shard->counters, CACHE_STAT_MISSES);
+    return false;
+}
+
+/*
+get_common - cache_get / cache_get_copy / cache_acquire (internal)
+*/
+static bool get_common(cache_t *cache, const char *key, hit_mode_t mode,
+                       char **data, size_t *size, cache_handle_t *handle) {
+    unsigned long hash = cache_hash(key);
+    sample_request(cache, hash);
+    return get_hashed(shard_for(cache, hash), key, hash, mode, data, size, handle);
+}
+
+/*
+cache_get - Look up an entry in the cache
+*/
+bool cache_get(cache_t *cache, const char *key, char **data, size_t *size) {
+    if (cache == NULL || key == NULL) {
+        return false;
+    }
+    return get_common(cache, key, HIT_RAW, data, size, NULL);
+}
+
+/*
+cache_get_copy - Look up and return a copy of cached data
+*/
+bool cache_get_copy(cache_t *cache, const char *key, char **data, size_t *size) {
+    if (cache == NULL || key == NULL || data == NULL) {
+        return false;
+    }
+    return get_common(cache, key, HIT_COPY, data, size, NULL);
+}
+
+/*
+cache_acquire - Look up and pin an entry's payload (zero-copy)
+*/
+bool cache_acquire(cache_t *cache, const char *key, cache_handle_t *handle) {
+    if (cache == NULL || key == NULL || handle == NULL) {
+        return false;
+    }
+    return get_common(cache, key, HIT_PIN, NULL, NULL, handle);
+}
+
+/*
+cache_release - Unpin a payload returned by cache_acquire / cache_lookup_acquire
+*/
+void cache_release(cache_handle_t *handle) {
+    if (handle == NULL) {
+        return;
+    }
+    buf_release(handle->buf);
+    handle->buf = NULL;
+    handle->data = NULL;
+    handle->size = 0;
+    handle->compressed = false;
+}
+
+/*
+lookup_once - One memory lookup for lookup_common (internal)
+
+Misses are counted like in get_once.
+*/
+static cache_lookup_t lookup_once(cache_shard_t *shard, const char *key, unsigned long hash,
+                                  hit_mode_t mode, char **data, size_t *size,
+                                  cache_handle_t *handle, cache_validator_t *validator,
+                                  bool count_miss) {
+    /* Only expired entries need the write lock with read-locked hits */
+    if (shard->ops->read_locked_hits) {
+        int found = read_hit(shard, key, hash, mode, data, size, handle, validator, count_miss);
+        if (found >= 0) {
+            return found == 1 ? CACHE_LOOKUP_FRESH : CACHE_LOOKUP_MISS;
+        }
+    }
+
+    pthread_rwlock_wrlock(&shard->lock);
+    record_access(shard, hash);
+
+    cache_entry_t *entry = find_entry(shard, key, hash);
+    cache_lookup_t result = CACHE_LOOKUP_FRESH;
+    uint64_t now = now_ms();
+
+    if (entry != NULL && is_expired(entry, now)) {
+        cache_entry_cold_t *cold = cache_entry_cold(shard, entry);
+        if (past_stale_window(shard, entry, now)) {
+            /* Too stale to serve, even if a revalidation is still in
+               flight - drop it and make the caller fetch */
+            free_entry(shard, entry);
+            stat_counters_inc(shard->counters, CACHE_STAT_EXPIRATIONS);
+            entry = NULL;
+        } else if (entry->revalidating &&
+                   now - cold->revalidate_ms < shard->revalidate_timeout_ms) {
+            result = CACHE_LOOKUP_STALE;
+        } else {
+            /* None in flight, or the last one is presumed lost */
+            entry->revalidating = true;
+            cold->revalidate_ms = now;
+            result = CACHE_LOOKUP_REVALIDATE;
+        }
+    }
+
+    if (entry == NULL) {
+        if (count_miss) {
+            stat_counters_inc(shard->counters, CACHE_STAT_MISSES);
+        }
+        pthread_rwlock_unlock(&shard->lock);
+        return CACHE_LOOKUP_MISS;
+    }
+
+    cache_buf_t *packed;
+    if (!deliver(entry->buf, mode, data, size, handle, &packed)) {
+        if (result == CACHE_LOOKUP_REVALIDATE) {
+            entry->revalidating = false;
+        }
+        pthread_rwlock_unlock(&shard->lock);
+        return CACHE_LOOKUP_MISS;
+    }
+    copy_validator(shard, entry, validator);
+
+    stat_counters_inc(shard->counters, CACHE_STAT_HITS);
+    stat_counters_add(shard->counters, CACHE_STAT_HIT_BYTES, buf_decoded_size(entry->buf));
+    if (result != CACHE_LOOKUP_FRESH) {
+        stat_counters_inc(shard->counters, CACHE_STAT_STALE_HITS);
+    }
+    cache_move_to_front(shard, entry);
+
+    pthread_rwlock_unlock(&shard->lock);
+
+    if (!unpack_hit(packed, mode, data, size, handle)) {
+        /* Hand back the revalidation this caller was elected for */
+        if (result == CACHE_LOOKUP_REVALIDATE) {
+            pthread_rwlock_wrlock(&shard->lock);
+            entry = find_entry(shard, key, hash);
+            if (entry != NULL) {
+                entry->revalidating = false;
+            }
+            pthread_rwlock_unlock(&shard->lock);
+        }
+        return CACHE_LOOKUP_MISS;
+    }
+    return result;
+}
+
+/*
+lookup_common - cache_lookup_copy / cache_lookup_acquire (internal)
+*/
+static cache_lookup_t lookup_common(cache_t *cache, const char *key, hit_mode_t mode,
+                                    char **data, size_t *size, cache_handle_t *handle,
+                                    cache_validator_t *validator) {
+    unsigned long hash = cache_hash(key);
+    cache_shard_t *shard = shard_for(cache, hash);
+    sample_request(cache, hash);
+
+    cache_lookup_t result = lookup_once(shard, key, hash, mode, data, size, handle,
+                                        validator, shard->l2 == NULL);
+    if (result != CACHE_LOOKUP_MISS || shard->l2 == NULL) {
+        return result;
+    }
+    if (promote(shard, key, hash)) {
+        return lookup_once(shard, key, hash, mode, data, size, handle, validator, true);
+    }
+    stat_counters_inc(shard->counters, CACHE_STAT_MISSES);
+    return CACHE_LOOKUP_MISS;
+}
+
+/*
+cache_lookup_copy - Freshness-aware lookup (stale-while-revalidate)
+*/
+cache_lookup_t cache_lookup_copy(cache_t *cache, const char *key, char **data,
+                                 size_t *size, cache_validator_t *validator) {
+    if (cache == NULL || key == NULL || data == NULL) {
+        return CACHE_LOOKUP_MISS;
+    }
+    return lookup_common(cache, key, HIT_COPY, data, size, NULL, validator);
+}
+
+/*
+cache_lookup_acquire - Freshness-aware lookup returning a pinned payload
+*/
+cache_lookup_t cache_lookup_acquire(cache_t *cache, const char *key, cache_handle_t *handle,
+                                    cache_validator_t *validator) {
+    if (cache == NULL || key == NULL || handle == NULL) {
+        return CACHE_LOOKUP_MISS;
+    }
+    return lookup_common(cache, key, HIT_PIN, NULL, NULL, handle, validator);
+}
+
+/*
+cache_lookup_acquire_packed - cache_lookup_acquire without decoding
+*/
+cache_lookup_t cache_lookup_acquire_packed(cache_t *cache, const char *key,
+                                           cache_handle_t *handle,
+                                           cache_validator_t *validator) {
+    if (cache == NULL || key == NULL || handle == NULL) {
+        return CACHE_LOOKUP_MISS;
+    }
+    return lookup_common(cache, key, HIT_PACKED, NULL, NULL, handle, validator);
+}
+
+/*
+cache_contains - Check whether a fresh entry exists
+*/
+bool cache_contains(cache_t *cache, const char *key) {
+    if (cache == NULL || key == NULL) {
+        return false;
+    }
+
+    unsigned long hash = cache_hash(key);
+    cache_shard_t *shard = shard_for(cache, hash);
+
+    pthread_rwlock_rdlock(&shard->lock);
+    cache_entry_t *entry = find_entry(shard, key, hash);
+    bool found = entry != NULL && !is_expired(entry, now_ms());
+    pthread_rwlock_unlock(&shard->lock);
+
+    return found;
+}
+
+/*
+install_locked - Insert or replace an entry holding 'buf' (internal)
+
+Takes over the caller's reference on buf, also on failure. key must
+be buf's key; neither is read unless the index holds an entry with
+the same hash, so a restored buffer is not faulted in. For the same
+reason the caller does the count_payload() once it is installed.
+
+Caller must hold the shard's write lock.
+
+Returns: The entry, or NULL if out of memory.
+*/
+static cache_entry_t *install_locked(cache_shard_t *shard, const char *key, unsigned long hash,
+                                     cache_buf_t *buf, size_t charge,
+                                     const cache_validator_t *validator, uint64_t expires_ms,
+                                     uint32_t cost) {
+    /* Existing entry: swap the buffer; pinned readers keep the old one */
+    cache_entry_t *entry = find_entry(shard, key, hash);
+    if (entry != NULL) {
+        /* Lock-free hits must not pair the new buffer with the old
+           validator, or the reverse: validator_seq is odd meanwhile */
+        cache_entry_cold_t *cold = cache_entry_cold(shard, entry);
+        uint32_t seq = cold->validator_seq;
+        __atomic_store_n(&cold->validator_seq, seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        shard->current_size -= entry->size;
+        shard->segments[entry->segment].bytes -= entry->size;
+        uncount_payload(shard, entry->buf);
+        retire_buf(shard, entry->buf);
+        __atomic_store_n(&entry->buf, buf, __ATOMIC_RELEASE);
+        set_validator(shard, entry, validator);
+        __atomic_store_n(&cold->validator_seq, seq + 2, __ATOMIC_RELEASE);
+        entry->key = buf->data;
+        entry->size = charge;
+        shard->current_size += charge;
+        shard->segments[entry->segment].bytes += charge;
+        cache_entry_cold(shard, entry)->cost = cost;
+        cache_move_to_front(shard, entry);
+    } else {
+        entry = entry_alloc(shard);
+        if (entry == NULL) {
+            buf_release(buf);
+            return NULL;
+        }
+        entry->hash = hash;
+        entry->key = buf->data;
+        entry->buf = buf;
+        entry->size = charge;
+        cache_entry_cold(shard, entry)->cost = cost;
+        set_validator(shard, entry, validator);  /* Before the index publishes it */
+
+        if (!cache_index_insert(&shard->index, hash, entry)) {
+            buf_release(buf);
+            entry_free(shard, entry);
+            return NULL;
+        }
+        if (!shard->ops->on_insert(shard, entry, hash)) {
+            cache_index_remove(&shard->index, hash, entry);
+            retire_buf(shard, buf);
+            entry_free(shard, entry);
+            return NULL;
+        }
+
+        shard->current_size += charge;
+        shard->num_entries++;
+    }
+
+    __atomic_store_n(&entry->expires_ms, expires_ms, __ATOMIC_RELEASE);
+    entry->revalidating = false;
+    wheel_schedule(shard, entry);
+
+    /* Make room; never evict the entry we just inserted */
+    while (shard->current_size > shard->max_size) {
+        cache_entry_t *victim = shard->ops->victim(shard, entry);
+        if (victim == NULL) {
+            break;
+        }
+        demote(shard, victim);
+        free_entry(shard, victim);
+        stat_counters_inc(shard->counters, CACHE_STAT_EVICTIONS);
+    }
+
+    return entry;
+}
+
+/*
+put_locked - Insert or replace an entry holding 'buf' (internal)
+
+Takes over the caller's reference on buf. Caller must hold the shard's
+write lock.
+*/
+static bool put_locked(cache_shard_t *shard, unsigned long hash, cache_buf_t *buf,
+                       const cache_validator_t *validator, uint32_t ttl_ms, uint32_t cost) {
+    size_t charge = slab_chunk_size(buf_image_size(buf));
+    size_t decoded = buf_decoded_size(buf);
+    bool compressed = (buf->flags & CACHE_BUF_LZ) != 0;
+    disk_forget(shard->l2, buf->data, hash);
+    if (install_locked(shard, buf->data, hash, buf, charge, validator,
+                       expiry_for(ttl_ms), cost) == NULL) {
+        return false;
+    }
+    count_payload(shard, decoded, compressed);
+    stat_counters_add(shard->counters, CACHE_STAT_PUT_BYTES, decoded);
+    return true;
+}
+
+/*
+cache_put - Add an entry to the cache
+*/
+bool cache_put(cache_t *cache, const char *key, const char *data, size_t size) {
+    return cache_put_validated(cache, key, data, size, NULL, CACHE_TTL_NONE);
+}
+
+/*
+cache_put_ttl - Add an entry that expires after ttl_ms
+*/
+bool cache_put_ttl(cache_t *cache, const char *key, const char *data, size_t size,
+                   uint32_t ttl_ms) {
+    return cache_put_validated(cache, key, data, size, NULL, ttl_ms);
+}
+
+/*
+cache_put_validated - Add an entry with a TTL and a validator
+*/
+bool cache_put_validated(cache_t *cache, const char *key, const char *data,
+                         size_t size, const cache_validator_t *validator,
+                         uint32_t ttl_ms) {
+    return cache_put_cost(cache, key, data, size, validator, ttl_ms, CACHE_COST_DEFAULT);
+}
+
+/*
+prepare_buf - Buffer for a put into 'shard', built before locking: only
+the swap is locked (internal)
+
+Copies (and maybe compresses) the payload; data NULL leaves it unwritten
+(cache_put_sized).
+
+Returns: The buffer, with its charge in *charge; NULL if the entry is
+too large for the shard or out of memory.
+*/
+static cache_buf_t *prepare_buf(cache_t *cache, cache_shard_t *shard, const char *key,
+                                const char *data, size_t size, size_t *charge) {
+    bool compress = __atomic_load_n(&cache->compress, __ATOMIC_RELAXED);
+    cache_buf_t *buf = compress && data != NULL ? buf_pack(shard, key, data, size) : NULL;
+    *charge = buf != NULL ? slab_chunk_size(buf_image_size(buf))
+                          : cache_entry_charge(key, size);
+
+    /* Check if the entry's real footprint exceeds what the key's shard can hold */
+    if (*charge > shard->max_size) {
+        fprintf(stderr, "Item too large for cache: %zu > %zu\n", *charge, shard->max_size);
+        buf_release(buf);
+        return NULL;
+    }
+    return buf != NULL ? buf : buf_create(key, data, size);
+}
+
+/*
+put_payload - Copy a payload into a buffer and install it (internal)
+
+data NULL installs an entry of the given size whose payload is never
+written (cache_put_sized).
+*/
+static bool put_payload(cache_t *cache, const char *key, const char *data, size_t size,
+                        const cache_validator_t *validator, uint32_t ttl_ms, uint32_t cost_us) {
+    /* Check key length */
+    if (strlen(key) >= MAX_KEY_LEN) {
+        fprintf(stderr, "Key too long: %s\n", key);
+        return false;
+    }
+
+    unsigned long hash = cache_hash(key);
+    cache_shard_t *shard = shard_for(cache, hash);
+    size_t charge;
+    cache_buf_t *buf = prepare_buf(cache, shard, key, data, size, &charge);
+    if (buf == NULL) {
+        return false;
+    }
+
+    pthread_rwlock_wrlock(&shard->lock);
+    bool ok = put_locked(shard, hash, buf, validator, ttl_ms,
+                         cost_us != 0 ? cost_us : CACHE_COST_DEFAULT);
+    pthread_rwlock_unlock(&shard->lock);
+
+    if (ok && cache->mrc != NULL) {
+        mrc_update(cache->mrc, hash, charge);
+    }
+    return ok;
+}
+
+/*
+cache_put_cost - Add an entry with a TTL, a validator and a refetch cost
+*/
+bool cache_put_cost(cache_t *cache, const char *key, const char *data, size_t size,
+                    const cache_validator_t *validator, uint32_t ttl_ms, uint32_t cost_us) {
+    if (cache == NULL || key == NULL || data == NULL) {
+        return false;
+    }
+    return put_payload(cache, key, data, size, validator, ttl_ms, cost_us);
+}
+
+/*
+cache_put_sized - Add an entry of a given size without copying a payload
+*/
+bool cache_put_sized(cache_t *cache, const char *key, size_t size) {
+    if (cache == NULL || key == NULL) {
+        return false;
+    }
+    return put_payload(cache, key, NULL, size, NULL, CACHE_TTL_NONE, CACHE_COST_DEFAULT);
+}
+
+/* ============================================================================
+Batched Operations
+============================================================================ */
+
+/* Shard number of a key a batch skips (NULL or too long) */
+#define BATCH_SKIP      UINT16_MAX
+
+/* Chunks cache_put_chunks hands to one put_batch */
+#define CHUNK_BATCH     16
+
+/*
+batch_order - Hash a batch and group it by shard (internal)
+
+Fills hashes[] and shards[] for each key, and order[] with the key
+indices sorted by shard; keys of one shard keep their batch order, so
+the last put of a repeated key wins. Skipped keys sort last.
+*/
+static void batch_order(cache_t *cache, const char *const *keys, size_t count,
+                        unsigned long *hashes, uint16_t *shards, uint8_t *order) {
+    for (size_t i = 0; i < count; i++) {
+        if (keys[i] == NULL || strnlen(keys[i], MAX_KEY_LEN) >= MAX_KEY_LEN) {
+            hashes[i] = 0;
+            shards[i] = BATCH_SKIP;
+        } else {
+            hashes[i] = cache_hash(keys[i]);
+            shards[i] = (uint16_t)(shard_for(cache, hashes[i]) - cache->shards);
+        }
+        /* Insertion sort: a batch is small */
+        size_t j = i;
+        while (j > 0 && shards[order[j - 1]] > shards[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = (uint8_t)i;
+    }
+}
+
+/*
+batch_group_end - End of the run of order[] that shares order[start]'s
+shard (internal)
+*/
+static size_t batch_group_end(const uint16_t *shards, const uint8_t *order, size_t start,
+                              size_t count) {
+    size_t end = start + 1;
+    while (end < count && shards[order[end]] == shards[order[start]]) {
+        end++;
+    }
+    return end;
+}
+
+/*
+get_group - Look up one shard's keys of a batch under one lock (internal)
+
+Every key's index group is prefetched before any is probed, so their
+cache misses overlap. Hits are pinned into handles[]; compressed ones
+are left in packed[] for the caller to decode after unlocking. retry[]
+marks the keys the single-key path must finish: expired entries on a
+read-locked shard (only the write lock may drop them) and memory misses
+the disk tier may answer.
+
+Returns: Hits found.
+*/
+static size_t get_group(cache_shard_t *shard, const char *const *keys,
+                        const unsigned long *hashes, const uint8_t *order, size_t count,
+                        cache_handle_t *handles, cache_buf_t **packed, bool *retry) {
+    bool read_locked = shard->ops->read_locked_hits;
+    if (read_locked) {
+        pthread_rwlock_rdlock(&shard->lock);
+    } else {
+        pthread_rwlock_wrlock(&shard->lock);
+    }
+    /* Each pass waits on one level of the chain for all keys at once:
+       index group, then entry, then the key inside the buffer */
+    cache_entry_t *peeked[CACHE_BATCH];
+    for (size_t i = 0; i < count; i++) {
+        cache_index_prefetch(&shard->index, hashes[order[i]]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        peeked[i] = cache_index_peek(&shard->index, hashes[order[i]]);
+        if (peeked[i] != NULL) {
+            __builtin_prefetch(peeked[i]);
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (peeked[i] != NULL) {
+            __builtin_prefetch(peeked[i]->key);
+            if (!read_locked) {
+                /* Write-locked hits relink the entry in its list */
+                __builtin_prefetch(cache_entry_at(shard, peeked[i]->lru_prev), 1);
+                __builtin_prefetch(cache_entry_at(shard, peeked[i]->lru_next), 1);
+            }
+        }
+    }
+
+    uint64_t now = now_ms();
+    size_t hits = 0, misses = 0;
+    uint64_t hit_bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t k = order[i];
+        cache_entry_t *entry;
+        if (read_locked) {
+            entry = find_entry(shard, keys[k], hashes[k]);
+            if (entry != NULL && is_expired(entry, now)) {
+                retry[k] = true;
+                continue;
+            }
+        } else {
+            record_access(shard, hashes[k]);
+            entry = lookup_live(shard, keys[k], hashes[k]);
+        }
+        if (entry == NULL) {
+            if (shard->l2 != NULL) {
+                retry[k] = true;
+            } else {
+                misses++;
+            }
+            continue;
+        }
+
+        /* HIT_PIN only takes a reference: it cannot fail */
+        deliver(entry->buf, HIT_PIN, NULL, NULL, &handles[k], &packed[k]);
+        hit_bytes += buf_decoded_size(entry->buf);
+        if (read_locked) {
+            shard->ops->on_hit(shard, entry);
+        } else {
+            cache_move_to_front(shard, entry);
+        }
+        hits++;
+    }
+    stat_counters_add(shard->counters, CACHE_STAT_HITS, hits);
+    stat_counters_add(shard->counters, CACHE_STAT_MISSES, misses);
+    stat_counters_add(shard->counters, CACHE_STAT_HIT_BYTES, hit_bytes);
+
+    pthread_rwlock_unlock(&shard->lock);
+    return hits;
+}
+
+/*
+get_batch - cache_get_many for at most CACHE_BATCH keys (internal)
+*/
+static size_t get_batch(cache_t *cache, const char *const *keys, size_t count,
+                        cache_handle_t *handles) {
+    unsigned long hashes[CACHE_BATCH];
+    uint16_t shards[CACHE_BATCH];
+    uint8_t order[CACHE_BATCH];
+    cache_buf_t *packed[CACHE_BATCH] = { NULL };
+    bool retry[CACHE_BATCH] = { false };
+
+    batch_order(cache, keys, count, hashes, shards, order);
+    memset(handles, 0, count * sizeof(cache_handle_t));
+    for (size_t i = 0; i < count; i++) {
+        if (shards[i] != BATCH_SKIP) {
+            sample_request(cache, hashes[i]);
+        }
+    }
+
+    size_t hits = 0;
+    for (size_t g = 0; g < count && shards[order[g]] != BATCH_SKIP; ) {
+        size_t end = batch_group_end(shards, order, g, count);
+        hits += get_group(&cache->shards[shards[order[g]]], keys, hashes, order + g, end - g,
+                          handles, packed, retry);
+        g = end;
+    }
+
+    /* No lock held from here on */
+    for (size_t i = 0; i < count; i++) {
+        if (packed[i] != NULL && !unpack_hit(packed[i], HIT_PIN, NULL, NULL, &handles[i])) {
+            hits--;
+        }
+        if (retry[i] && get_hashed(&cache->shards[shards[i]], keys[i], hashes[i], HIT_PIN,
+                                   NULL, NULL, &handles[i])) {
+            hits++;
+        }
+    }
+    return hits;
+}
+
+/*
+cache_get_many - Look up and pin several entries, one lock per shard
+*/
+size_t cache_get_many(cache_t *cache, const char *const *keys, size_t n,
+                      cache_handle_t *handles) {
+    if (cache == NULL || keys == NULL || handles == NULL) {
+        return 0;
+    }
+
+    size_t hits = 0;
+    for (size_t base = 0; base < n; base += CACHE_BATCH) {
+        size_t count = n - base < CACHE_BATCH ? n - base : CACHE_BATCH;
+        hits += get_batch(cache, keys + base, count, handles + base);
+    }
+    return hits;
+}
+
+/*
+put_batch - Put at most CACHE_BATCH entries, one lock per shard (internal)
+
+Buffers are built before any lock is taken, like in put_payload. All
+entries share the validator and TTL; costs may be NULL (default cost).
+
+Returns: Entries stored.
+*/
+static size_t put_batch(cache_t *cache, const char *const *keys, const char *const *data,
+                        const size_t *sizes, size_t count, const cache_validator_t *validator,
+                        uint32_t ttl_ms, const uint32_t *costs) {
+    unsigned long hashes[CACHE_BATCH];
+    uint16_t shards[CACHE_BATCH];
+    uint8_t order[CACHE_BATCH];
+    cache_buf_t *bufs[CACHE_BATCH];
+    size_t charges[CACHE_BATCH];
+    bool stored[CACHE_BATCH] = { false };
+
+    batch_order(cache, keys, count, hashes, shards, order);
+    for (size_t i = 0; i < count; i++) {
+        bufs[i] = NULL;
+        if (shards[i] != BATCH_SKIP && data[i] != NULL) {
+            bufs[i] = prepare_buf(cache, &cache->shards[shards[i]], keys[i], data[i], sizes[i],
+                                  &charges[i]);
+        }
+    }
+
+    size_t count_stored = 0;
+    for (size_t g = 0; g < count && shards[order[g]] != BATCH_SKIP; ) {
+        size_t end = batch_group_end(shards, order, g, count);
+        cache_shard_t *shard = &cache->shards[shards[order[g]]];
+
+        pthread_rwlock_wrlock(&shard->lock);
+        for (size_t i = g; i < end; i++) {
+            cache_index_prefetch(&shard->index, hashes[order[i]]);
+        }
+        for (size_t i = g; i < end; i++) {
+            size_t k = order[i];
+            if (bufs[k] == NULL) {
+                continue;
+            }
+            uint32_t cost = costs != NULL && costs[k] != 0 ? costs[k] : CACHE_COST_DEFAULT;
+            stored[k] = put_locked(shard, hashes[k], bufs[k], validator, ttl_ms, cost);
+            count_stored += stored[k] ? 1 : 0;
+        }
+        pthread_rwlock_unlock(&shard->lock);
+        g = end;
+    }
+
+    for (size_t i = 0; i < count && cache->mrc != NULL; i++) {
+        if (stored[i]) {
+            mrc_update(cache->mrc, hashes[i], charges[i]);
+        }
+    }
+    return count_stored;
+}
+
+/*
+cache_put_many - Add several entries, one lock per shard
 */
-static unsigned long hash_string(const char *str) {
-    unsigned long hash = 5381;
-    int c;
-    while ((c = *str++)) {
-        hash = ((hash << 5) + hash) + c;  /* hash * 33 + c */
+size_t cache_put_many(cache_t *cache, const char *const *keys, const char *const *data,
+                      const size_t *sizes, size_t n) {
+    if (cache == NULL || keys == NULL || data == NULL || sizes == NULL) {
+        return 0;
     }
-    return hash;
+
+    size_t stored = 0;
+    for (size_t base = 0; base < n; base += CACHE_BATCH) {
+        size_t count = n - base < CACHE_BATCH ? n - base : CACHE_BATCH;
+        stored += put_batch(cache, keys + base, data + base, sizes + base, count, NULL,
+                            CACHE_TTL_NONE, NULL);
+    }
+    return stored;
 }
 
 /*
-cache_hash - Get bucket index for a key
+cache_revalidated - Mark an entry fresh again (backend said NOT_MODIFIED)
 */
-int cache_hash(cache_t *cache, const char *key) {
-    return hash_string(key) % cache->num_buckets;
+bool cache_revalidated(cache_t *cache, const char *key, uint32_t ttl_ms) {
+    if (cache == NULL || key == NULL) {
+        return false;
+    }
+
+    unsigned long hash = cache_hash(key);
+    cache_shard_t *shard = shard_for(cache, hash);
+    pthread_rwlock_wrlock(&shard->lock);
+
+    cache_entry_t *entry = find_entry(shard, key, hash);
+    if (entry != NULL) {
+        entry->expires_ms = expiry_for(ttl_ms);
+        entry->revalidating = false;
+        wheel_schedule(shard, entry);
+    }
+
+    pthread_rwlock_unlock(&shard->lock);
+    return entry != NULL;
 }
 
 /*
-find_entry - Find an entry by key (internal, no locking)
+cache_revalidate_failed - Give up an in-flight revalidation
 */
-static cache_entry_t *find_entry(cache_t *cache, const char *key) {
-    int bucket = cache_hash(cache, key);
-    cache_entry_t *entry = cache->buckets[bucket];
+void cache_revalidate_failed(cache_t *cache, const char *key) {
+    if (cache == NULL || key == NULL) {
+        return;
+    }
 
-    while (entry != NULL) {
-        if (strcmp(entry->key, key) == 0) {
-            return entry;
-        }
-        entry = entry->hash_next;
+    unsigned long hash = cache_hash(key);
+    cache_shard_t *shard = shard_for(cache, hash);
+    pthread_rwlock_wrlock(&shard->lock);
+
+    cache_entry_t *entry = find_entry(shard, key, hash);
+    if (entry != NULL) {
+        entry->revalidating = false;
     }
-    return NULL;
-}
 
-/* ============================================================================
-LRU List Management
-============================================================================ */
+    pthread_rwlock_unlock(&shard->lock);
+}
 
 /*
-cache_move_to_front - Move entry to front of LRU list (most recently used)
+cache_set_stale_window - Configure stale-while-revalidate
 */
-void cache_move_to_front(cache_t *cache, cache_entry_t *entry) {
-    /*
-     * TODO: Implement LRU list manipulation
-     *
-     * Steps:
-     * 1. If entry is already at front, do nothing
-     * 2. Remove entry from current position:
-     *    - Update prev->next to point to entry->next
-     *    - Update next->prev to point to entry->prev
-     *    - Handle edge case: entry is tail
-     * 3. Insert at front:
-     *    - entry->lru_prev = NULL
-     *    - entry->lru_next = cache->lru_head
-     *    - old_head->lru_prev = entry
-     *    - cache->lru_head = entry
-     * 4. Update entry->last_access = time(NULL)
-     *
-     * This is a classic doubly-linked list operation!
-     */
-
-    if (cache == NULL || entry == NULL) {
+void cache_set_stale_window(cache_t *cache, uint32_t window_ms) {
+    if (cache == NULL) {
         return;
     }
 
-    /* Already at front? */
-    if (entry == cache->lru_head) {
-        entry->last_access = time(NULL);
+    for (int i = 0; i < cache->num_shards; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        pthread_rwlock_wrlock(&shard->lock);
+        shard->stale_window_ms = window_ms;
+        pthread_rwlock_unlock(&shard->lock);
+    }
+}
+
+/*
+cache_set_revalidate_timeout - Bound the time one revalidation may take
+*/
+void cache_set_revalidate_timeout(cache_t *cache, uint32_t timeout_ms) {
+    if (cache == NULL) {
         return;
     }
 
-    /* YOUR CODE HERE */
+    for (int i = 0; i < cache->num_shards; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        pthread_rwlock_wrlock(&shard->lock);
+        shard->revalidate_timeout_ms = timeout_ms;
+        pthread_rwlock_unlock(&shard->lock);
+    }
+}
+
+/*
+cache_set_compression - Store compressible payloads compressed
+*/
+void cache_set_compression(cache_t *cache, bool enabled) {
+    if (cache != NULL) {
+        __atomic_store_n(&cache->compress, enabled, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+cache_set_lockfree_reads - Serve hits without taking the shard lock
+*/
+void cache_set_lockfree_reads(cache_t *cache, bool enabled) {
+    if (cache == NULL) {
+        return;
+    }
+    for (int i = 0; i < cache->num_shards; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        __atomic_store_n(&shard->lockfree_reads, enabled && shard->ops->read_locked_hits,
+                         __ATOMIC_RELAXED);
+    }
 }
 
 /*
-remove_from_lru - Remove entry from LRU list (internal)
+cache_remove - Remove an entry from the cache
 */
-static void remove_from_lru(cache_t *cache, cache_entry_t *entry) {
-    /*
-     * TODO: Implement removal from LRU list
-     *
-     * Handle all cases:
-     * - Entry is head
-     * - Entry is tail
-     * - Entry is in middle
-     * - Entry is only item
-     */
+bool cache_remove(cache_t *cache, const char *key) {
+    if (cache == NULL || key == NULL) {
+        return false;
+    }
+
+    unsigned long hash = cache_hash(key);
+    cache_shard_t *shard = shard_for(cache, hash);
+    pthread_rwlock_wrlock(&shard->lock);
+
+    cache_entry_t *entry = find_entry(shard, key, hash);
+    if (entry != NULL) {
+        free_entry(shard, entry);
+    }
+    bool on_disk = disk_forget(shard->l2, key, hash);
+
+    pthread_rwlock_unlock(&shard->lock);
+    return entry != NULL || on_disk;
+}
+
+/*
+cache_evict_lru - Evict the least recently used entry of a shard
 
-    (void)cache;
-    (void)entry;
+Caller must hold the shard's write lock!
+*/
+bool cache_evict_lru(cache_shard_t *shard) {
+    if (shard == NULL || shard->num_entries == 0) {
+        return false;
+    }
 
-    /* YOUR CODE HERE */
+    cache_entry_t *victim = shard->ops->victim(shard, NULL);
+    if (victim == NULL) {
+        return false;
+    }
+    demote(shard, victim);
+    free_entry(shard, victim);
+    stat_counters_inc(shard->counters, CACHE_STAT_EVICTIONS);
+    return true;
 }
 
 /*
-add_to_front_lru - Add entry to front of LRU list (internal)
+cache_clear - Remove all entries from the cache
 */
-static void add_to_front_lru(cache_t *cache, cache_entry_t *entry) {
-    /*
-     * TODO: Add entry to front of LRU list
-     */
+void cache_clear(cache_t *cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < cache->num_shards; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        pthread_rwlock_wrlock(&shard->lock);
 
-    (void)cache;
-    (void)entry;
+        free_all_entries(shard);
+        cache_index_clear(&shard->index);
+        memset(shard->segments, 0, sizeof(shard->segments));
+        shard->ops->clear(shard);
+        shard->current_size = 0;
+        shard->num_entries = 0;
+        shard->payload_bytes = 0;
+        shard->num_compressed = 0;
 
-    /* YOUR CODE HERE */
+        pthread_rwlock_unlock(&shard->lock);
+    }
+
+    if (cache->l2 != NULL) {
+        cache_l2_t *l2 = cache->l2;
+        pthread_mutex_lock(&l2->lock);
+        for (size_t i = 0; i < l2->queue_count; i++) {
+            l2->queue[(l2->queue_head + i) % CACHE_DISK_QUEUE_LEN].cancelled = true;
+        }
+        l2->writing.cancelled = true;
+        cache_disk_clear(l2->disk);
+        pthread_mutex_unlock(&l2->lock);
+    }
 }
 
 /* ============================================================================
-Cache Lifecycle
+Chunked Files
 ============================================================================ */
 
 /*
-cache_create - Create a new cache
+cache_chunk_key - Key of one chunk of a file
 */
-cache_t *cache_create(size_t max_size) {
-    /*
-     * TODO: Implement cache creation
-     *
-     * Steps:
-     * 1. Allocate cache_t structure
-     * 2. Set max_size, num_buckets = NUM_BUCKETS
-     * 3. Allocate bucket array: calloc(num_buckets, sizeof(cache_entry_t *))
-     * 4. Initialize LRU list (head = tail = NULL)
-     * 5. Initialize statistics (current_size = 0, hits = misses = evictions = 0)
-     * 6. Initialize read-write lock: pthread_rwlock_init(&cache->lock, NULL)
-     * 7. Return cache
-     *
-     * Use calloc for buckets to initialize all pointers to NULL.
-     */
-
-    cache_t *cache = malloc(sizeof(cache_t));
-    if (cache == NULL) {
-        perror("malloc cache");
-        return NULL;
+int cache_chunk_key(char *buffer, size_t buflen, const char *key, uint64_t index) {
+    if (buffer == NULL || key == NULL || buflen == 0) {
+        return -1;
     }
+    int n = snprintf(buffer, buflen, "%c%llu:%s", CACHE_CHUNK_PREFIX,
+                     (unsigned long long)index, key);
+    if (n < 0 || (size_t)n >= buflen) {
+        return -1;
+    }
+    return n;
+}
 
-    /* YOUR CODE HERE */
+/*
+chunk_length - Bytes in chunk 'index' of a file of file_size bytes (internal)
+*/
+static size_t chunk_length(uint64_t file_size, uint64_t index) {
+    uint64_t start = index * CACHE_CHUNK_SIZE;
+    if (start >= file_size) {
+        return 0;
+    }
+    uint64_t left = file_size - start;
+    return left < CACHE_CHUNK_SIZE ? (size_t)left : CACHE_CHUNK_SIZE;
+}
 
-    /* Placeholder initialization */
-    cache->buckets = NULL;
-    cache->num_buckets = 0;
-    cache->lru_head = NULL;
-    cache->lru_tail = NULL;
-    cache->current_size = 0;
-    cache->max_size = max_size;
-    cache->num_entries = 0;
-    cache->hits = 0;
-    cache->misses = 0;
-    cache->evictions = 0;
+/*
+cache_put_chunks - Cache part of a large file as chunk entries
+*/
+size_t cache_put_chunks(cache_t *cache, const char *key, uint64_t offset, const char *data,
+                        size_t size, const cache_validator_t *validator, uint32_t ttl_ms,
+                        uint32_t cost_us) {
+    if (cache == NULL || key == NULL || data == NULL || validator == NULL ||
+        offset % CACHE_CHUNK_SIZE != 0) {
+        return 0;
+    }
 
-    return cache;
+    /* Chunks go in batches, so each takes its shard's lock once */
+    char keys[CHUNK_BATCH][MAX_KEY_LEN];
+    const char *key_ptrs[CHUNK_BATCH];
+    const char *chunk_data[CHUNK_BATCH];
+    size_t lengths[CHUNK_BATCH];
+    uint32_t costs[CHUNK_BATCH];
+    size_t stored = 0;
+    uint64_t index = offset / CACHE_CHUNK_SIZE;
+    size_t done = 0;
+    bool more = true;
+    while (more) {
+        size_t count = 0;
+        while (count < CHUNK_BATCH) {
+            size_t length = chunk_length(validator->size, index);
+            if (length == 0 || done + length > size ||
+                cache_chunk_key(keys[count], MAX_KEY_LEN, key, index) < 0) {
+                more = false;
+                break;
+            }
+            uint32_t cost = (uint32_t)((uint64_t)cost_us * length / size);
+            key_ptrs[count] = keys[count];
+            chunk_data[count] = data + done;
+            lengths[count] = length;
+            costs[count] = cost_us != 0 && cost == 0 ? 1 : cost;
+            count++;
+            done += length;
+            index++;
+        }
+        stored += put_batch(cache, key_ptrs, chunk_data, lengths, count, validator, ttl_ms,
+                            costs);
+    }
+    return stored;
 }
 
 /*
-cache_destroy - Destroy cache and free all memory
+cache_lookup_chunk - Freshness-aware lookup of one chunk, pinned
 */
-void cache_destroy(cache_t *cache) {
-    /*
-     * TODO: Implement cache destruction
-     *
-     * Steps:
-     * 1. If cache is NULL, return
-     * 2. Acquire write lock (or just proceed if single-threaded)
-     * 3. Free all entries:
-     *    - Walk through LRU list (or iterate buckets)
-     *    - Free entry->data for each entry
-     *    - Free each entry
-     * 4. Free bucket array
-     * 5. Destroy rwlock
-     * 6. Free cache structure
-     */
+cache_lookup_t cache_lookup_chunk(cache_t *cache, const char *key, uint64_t index,
+                                  cache_handle_t *handle, cache_validator_t *validator) {
+    char chunk_key[MAX_KEY_LEN];
+    if (cache == NULL || handle == NULL ||
+        cache_chunk_key(chunk_key, sizeof(chunk_key), key, index) < 0) {
+        return CACHE_LOOKUP_MISS;
+    }
+    return lookup_common(cache, chunk_key, HIT_PIN, NULL, NULL, handle, validator);
+}
 
-    if (cache == NULL) {
-        return;
+/*
+cache_get_range - Copy a byte range of a chunked file out of the cache
+
+The first chunk fixes the version (and so the file size); a chunk of
+any other version ends the copy like a missing one.
+*/
+size_t cache_get_range(cache_t *cache, const char *key, uint64_t offset, size_t length,
+                       char *dst, cache_validator_t *validator) {
+    if (cache == NULL || key == NULL || dst == NULL) {
+        return 0;
     }
 
-    /* YOUR CODE HERE */
+    cache_validator_t version = { 0, 0 };
+    size_t copied = 0;
+    while (copied < length) {
+        uint64_t pos = offset + copied;
+        uint64_t index = pos / CACHE_CHUNK_SIZE;
+        cache_handle_t chunk;
+        cache_validator_t cv;
+        cache_lookup_t result = cache_lookup_chunk(cache, key, index, &chunk, &cv);
+        if (result == CACHE_LOOKUP_MISS) {
+            break;
+        }
+        if (result == CACHE_LOOKUP_REVALIDATE) {
+            char chunk_key[MAX_KEY_LEN];
+            cache_chunk_key(chunk_key, sizeof(chunk_key), key, index);
+            cache_revalidate_failed(cache, chunk_key);
+        }
+        bool usable = result == CACHE_LOOKUP_FRESH &&
+                      (copied == 0 || (cv.mtime_ns == version.mtime_ns &&
+                                       cv.size == version.size));
+        size_t skip = (size_t)(pos - index * CACHE_CHUNK_SIZE);
+        if (!usable || chunk.size <= skip || cv.size <= pos) {
+            cache_release(&chunk);
+            break;
+        }
+        version = cv;
+        uint64_t available = version.size - offset;    /* > copied, as pos < size */
+        if (length > available) {
+            length = (size_t)available;
+        }
+
+        size_t n = chunk.size - skip;
+        if (n > length - copied) {
+            n = length - copied;
+        }
+        memcpy(dst + copied, chunk.data + skip, n);
+        copied += n;
+        cache_release(&chunk);
+    }
 
-    free(cache);
+    if (validator != NULL) {
+        *validator = version;
+    }
+    return copied;
 }
 
 /* ============================================================================
-Cache Operations
+Expiry Sweeping
 ============================================================================ */
 
 /*
-cache_get - Look up an entry in the cache
-*/
-bool cache_get(cache_t *cache, const char *key, char **data, size_t *size) {
-    /*
-     * TODO: Implement cache lookup
-     *
-     * Steps:
-     * 1. Acquire read lock: pthread_rwlock_rdlock(&cache->lock)
-     * 2. Find entry by key
-     * 3. If found:
-     *    - *data = entry->data
-     *    - *size = entry->size
-     *    - cache->hits++
-     *    - Move to front (needs write lock - may need to upgrade)
-     *    - Release lock, return true
-     * 4. If not found:
-     *    - cache->misses++
-     *    - Release lock, return false
-     *
-     * Note: The returned data pointer is only valid while holding the lock!
-     * For thread safety, consider using cache_get_copy instead.
-     */
+wheel_cascade - Re-file the entries of a higher-level slot (internal)
 
-    if (cache == NULL || key == NULL) {
-        return false;
+They land in lower levels, or in level 0 if their tick is next.
+*/
+static void wheel_cascade(cache_shard_t *shard, uint32_t pos) {
+    uint32_t id = shard->wheel.slots[pos];
+    shard->wheel.slots[pos] = CACHE_ENTRY_NIL;
+    while (id != CACHE_ENTRY_NIL) {
+        cache_entry_t *entry = cache_entry_at(shard, id);
+        id = cold_at(shard, id)->timer_next;
+        entry->timer_armed = false;
+        shard->wheel.timers--;
+        wheel_link(shard, entry, reclaim_tick(shard, entry));
     }
+}
+
+/*
+wheel_advance - Process every tick up to 'now', freeing due entries (internal)
 
-    /* YOUR CODE HERE */
+Caller must hold the shard's write lock.
 
-    (void)data;
-    (void)size;
+Returns: Number of entries freed.
+*/
+static size_t wheel_advance(cache_shard_t *shard, uint64_t now) {
+    cache_wheel_t *wheel = &shard->wheel;
+    uint64_t target = now / CACHE_WHEEL_TICK_MS;
+    size_t freed = 0;
+
+    while (wheel->tick < target) {
+        if (wheel->timers == 0) {
+            wheel->tick = target;
+            break;
+        }
+        uint64_t tick = wheel->tick + 1;
+
+        /* Starting a new span of level l: bring its slot down (top first,
+           so entries cascaded from above are cascaded again below) */
+        int top = 0;
+        while (top < CACHE_WHEEL_LEVELS - 1 &&
+               (tick & ((1ULL << (CACHE_WHEEL_BITS * (top + 1))) - 1)) == 0) {
+            top++;
+        }
+        for (int level = top; level >= 1; level--) {
+            wheel_cascade(shard, (uint32_t)level * CACHE_WHEEL_SLOTS +
+                          (uint32_t)((tick >> (CACHE_WHEEL_BITS * level)) &
+                                     (CACHE_WHEEL_SLOTS - 1)));
+        }
 
-    return false;  /* Placeholder - cache miss */
+        uint32_t pos = (uint32_t)(tick & (CACHE_WHEEL_SLOTS - 1));
+        uint32_t id = wheel->slots[pos];
+        wheel->slots[pos] = CACHE_ENTRY_NIL;
+        wheel->tick = tick;
+
+        while (id != CACHE_ENTRY_NIL) {
+            cache_entry_t *entry = cache_entry_at(shard, id);
+            id = cold_at(shard, id)->timer_next;
+            entry->timer_armed = false;
+            wheel->timers--;
+
+            if (entry->expires_ms + shard->stale_window_ms > now) {
+                /* TTL extended or stale window grown since it was filed */
+                wheel_link(shard, entry, reclaim_tick(shard, entry));
+            } else {
+                /* Past its stale window: a revalidation still in flight
+                   finds it gone and stores a fresh copy, if any */
+                free_entry(shard, entry);
+                stat_counters_inc(shard->counters, CACHE_STAT_EXPIRATIONS);
+                freed++;
+            }
+        }
+    }
+    return freed;
 }
 
 /*
-cache_get_copy - Look up and return a copy of cached data
+cache_expire - Reclaim every entry past its TTL and stale window
 */
-bool cache_get_copy(cache_t *cache, const char *key, char **data, size_t *size) {
-    /*
-     * TODO: Implement cache lookup with copy
-     *
-     * Similar to cache_get, but:
-     * - Allocate new buffer: malloc(entry->size)
-     * - Copy data: memcpy(new_buffer, entry->data, entry->size)
-     * - *data = new_buffer (caller must free!)
-     *
-     * This is safer for multithreaded use.
-     */
+size_t cache_expire(cache_t *cache) {
+    if (cache == NULL) {
+        return 0;
+    }
 
-    if (cache == NULL || key == NULL || data == NULL) {
+    size_t freed = 0;
+    for (int i = 0; i < cache->num_shards; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        pthread_rwlock_wrlock(&shard->lock);
+        freed += wheel_advance(shard, now_ms());
+        epoch_reclaim(&shard->retired);
+        pthread_rwlock_unlock(&shard->lock);
+    }
+    return freed;
+}
+
+/*
+sweeper_main - Background thread: cache_expire() every interval (internal)
+*/
+static void *sweeper_main(void *arg) {
+    cache_t *cache = arg;
+
+    pthread_mutex_lock(&cache->sweeper_lock);
+    while (cache->sweeper_running) {
+        struct timespec wake;
+        clock_gettime(CLOCK_MONOTONIC, &wake);
+        uint64_t ns = (uint64_t)wake.tv_nsec + (uint64_t)cache->sweep_interval_ms * 1000000;
+        wake.tv_sec += (time_t)(ns / 1000000000);
+        wake.tv_nsec = (long)(ns % 1000000000);
+
+        int rc = 0;
+        while (cache->sweeper_running && rc != ETIMEDOUT) {
+            rc = pthread_cond_timedwait(&cache->sweeper_wake, &cache->sweeper_lock, &wake);
+        }
+        if (!cache->sweeper_running) {
+            break;
+        }
+
+        pthread_mutex_unlock(&cache->sweeper_lock);
+        cache_expire(cache);
+        pthread_mutex_lock(&cache->sweeper_lock);
+    }
+    pthread_mutex_unlock(&cache->sweeper_lock);
+    return NULL;
+}
+
+/*
+cache_start_sweeper - Run cache_expire() periodically in a background thread
+*/
+bool cache_start_sweeper(cache_t *cache, uint32_t interval_ms) {
+    if (cache == NULL) {
         return false;
     }
 
-    /* YOUR CODE HERE */
+    pthread_mutex_lock(&cache->sweeper_lock);
+    if (cache->sweeper_running) {
+        pthread_mutex_unlock(&cache->sweeper_lock);
+        return true;
+    }
+    cache->sweep_interval_ms = interval_ms != 0 ? interval_ms : CACHE_SWEEP_INTERVAL_MS;
+    cache->sweeper_running = true;
+    if (pthread_create(&cache->sweeper, NULL, sweeper_main, cache) != 0) {
+        perror("pthread_create sweeper");
+        cache->sweeper_running = false;
+    }
+    bool running = cache->sweeper_running;
+    pthread_mutex_unlock(&cache->sweeper_lock);
+    return running;
+}
+
+/*
+cache_stop_sweeper - Stop the background sweeper and wait for it
+*/
+void cache_stop_sweeper(cache_t *cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->sweeper_lock);
+    bool running = cache->sweeper_running;
+    cache->sweeper_running = false;
+    pthread_cond_signal(&cache->sweeper_wake);
+    pthread_mutex_unlock(&cache->sweeper_lock);
+
+    if (running) {
+        pthread_join(cache->sweeper, NULL);
+    }
+}
+
+/* ============================================================================
+Snapshots
+============================================================================ */
+
+/*
+Snapshot file layout (host byte order; only read back on the same host):
+
+    snapshot_header_t
+    buffer images       cache_buf_t header + key + payload, 16-byte aligned,
+                        with refs = 1 and flags = CACHE_BUF_MAPPED, plus
+                        CACHE_BUF_LZ for a compressed payload
+    snapshot_record_t[count]   at table_offset, hottest entry of a shard first
+
+The header is written last, so an interrupted snapshot never validates.
+*/
+#define SNAPSHOT_MAGIC      "GFCSNAP"
+#define SNAPSHOT_VERSION    2
+#define SNAPSHOT_ALIGN      16
+
+/* Key hashed into hash_check: restore recomputes hashes if the hash changed */
+#define SNAPSHOT_HASH_PROBE "/snapshot/hash-check"
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t policy;                /* Policy of the cache that wrote it */
+    uint64_t count;                 /* Records */
+    uint64_t table_offset;
+    uint64_t file_size;
+    uint64_t hash_check;            /* cache_hash(SNAPSHOT_HASH_PROBE) */
+} snapshot_header_t;
+
+typedef struct {
+    uint64_t hash;
+    uint64_t offset;                /* Buffer image */
+    uint64_t size;                  /* Payload bytes */
+    int64_t expires_wall_ms;        /* Realtime expiry, 0 = never */
+    cache_validator_t validator;
+    uint64_t decoded_size;          /* Payload bytes once decoded */
+    uint16_t key_len;               /* As in the buffer header */
+    uint8_t has_validator;
+    uint8_t freq;
+    uint8_t compressed;             /* CACHE_BUF_LZ is set */
+    uint8_t pad[3];
+} snapshot_record_t;
 
-    (void)size;
+/*
+wall_ms - Current realtime clock in milliseconds (internal)
 
-    return false;  /* Placeholder */
+TTLs are monotonic, which means nothing after a restart; snapshots store
+expiry times on the wall clock instead.
+*/
+static int64_t wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
 /*
-cache_put - Add an entry to the cache
+pin_shard - Record and pin every entry of a shard, hottest first (internal)
+
+Returns: Number of entries (records/bufs allocated by this function), or
+-1 if out of memory.
 */
-bool cache_put(cache_t *cache, const char *key, const char *data, size_t size) {
-    /*
-     * TODO: Implement cache insertion
-     *
-     * Steps:
-     * 1. Acquire write lock
-     * 2. Check if entry already exists:
-     *    - If yes, update it (free old data, allocate new, copy)
-     *    - Move to front of LRU
-     *    - Update current_size
-     *    - Release lock, return true
-     * 3. Check if new entry fits:
-     *    - While (current_size + size > max_size && num_entries > 0):
-     *      - Evict LRU entry (tail)
-     * 4. Create new entry:
-     *    - Allocate cache_entry_t
-     *    - Copy key (strncpy)
-     *    - Allocate and copy data
-     *    - Set size, timestamps
-     * 5. Add to hash table:
-     *    - bucket = hash(key)
-     *    - entry->hash_next = buckets[bucket]
-     *    - buckets[bucket] = entry
-     * 6. Add to front of LRU list
-     * 7. Update current_size, num_entries
-     * 8. Release lock, return true
-     */
+static long pin_shard(cache_shard_t *shard, snapshot_record_t **records, cache_buf_t ***bufs) {
+    pthread_rwlock_rdlock(&shard->lock);
+
+    long count = 0;
+    *records = malloc((shard->num_entries + 1) * sizeof(snapshot_record_t));
+    *bufs = malloc((shard->num_entries + 1) * sizeof(cache_buf_t *));
+    if (*records == NULL || *bufs == NULL) {
+        pthread_rwlock_unlock(&shard->lock);
+        free(*records);
+        free(*bufs);
+        return -1;
+    }
 
-    if (cache == NULL || key == NULL || data == NULL) {
-        return false;
+    int64_t wall_now = wall_ms();
+    uint64_t now = now_ms();
+    for (int seg = CACHE_SEGMENTS - 1; seg >= 0; seg--) {
+        for (cache_entry_t *entry = shard->segments[seg].head; entry != NULL;
+             entry = cache_entry_at(shard, entry->lru_next)) {
+            snapshot_record_t *rec = &(*records)[count];
+            memset(rec, 0, sizeof(*rec));
+            rec->hash = entry->hash;
+            rec->size = entry->buf->size;
+            rec->decoded_size = buf_decoded_size(entry->buf);
+            rec->compressed = (entry->buf->flags & CACHE_BUF_LZ) != 0;
+            rec->key_len = entry->buf->key_len;
+            if (entry->expires_ms != CACHE_TTL_NONE) {
+                rec->expires_wall_ms = wall_now + ((int64_t)entry->expires_ms - (int64_t)now);
+                if (rec->expires_wall_ms == 0) {
+                    rec->expires_wall_ms = -1;
+                }
+            }
+            rec->has_validator = entry->has_validator;
+            if (entry->has_validator) {
+                rec->validator = cache_entry_cold(shard, entry)->validator;
+            }
+            rec->freq = __atomic_load_n(&entry->freq, __ATOMIC_RELAXED);
+
+            __atomic_add_fetch(&entry->buf->refs, 1, __ATOMIC_RELAXED);
+            (*bufs)[count++] = entry->buf;
+        }
     }
 
-    /* Check key length */
-    if (strlen(key) >= MAX_KEY_LEN) {
-        fprintf(stderr, "Key too long: %s\n", key);
+    pthread_rwlock_unlock(&shard->lock);
+    return count;
+}
+
+/*
+write_buffer - Append one buffer image, padded to SNAPSHOT_ALIGN (internal)
+*/
+static bool write_buffer(FILE *file, const cache_buf_t *buf, uint64_t *offset) {
+    static const char zeros[SNAPSHOT_ALIGN];
+    cache_buf_t header = { 1, buf->key_len, CACHE_BUF_MAPPED | (buf->flags & CACHE_BUF_LZ),
+                           buf->size };
+    size_t bytes = sizeof(header) + buf->key_len + buf->size;
+    size_t pad = (SNAPSHOT_ALIGN - bytes % SNAPSHOT_ALIGN) % SNAPSHOT_ALIGN;
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+        fwrite(buf->data, 1, buf->key_len + buf->size, file) != buf->key_len + buf->size ||
+        fwrite(zeros, 1, pad, file) != pad) {
         return false;
     }
+    *offset += bytes + pad;
+    return true;
+}
 
-    /* Check if size exceeds max cache size */
-    if (size > cache->max_size) {
-        fprintf(stderr, "Item too large for cache: %zu > %zu\n", size, cache->max_size);
-        return false;
+/*
+cache_snapshot - Write the cache's entries to a file for a warm restart
+*/
+long cache_snapshot(cache_t *cache, const char *path) {
+    if (cache == NULL || path == NULL) {
+        return -1;
+    }
+
+    char tmp_path[PATH_MAX];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) {
+        fprintf(stderr, "cache_snapshot: path too long: %s\n", path);
+        return -1;
+    }
+    FILE *file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        perror("cache_snapshot: fopen");
+        return -1;
+    }
+
+    /* Placeholder header; the real one goes in once everything is written */
+    snapshot_header_t header;
+    memset(&header, 0, sizeof(header));
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    uint64_t offset = sizeof(header);
+
+    snapshot_record_t *table = NULL;
+    size_t count = 0;
+    for (int i = 0; ok && i < cache->num_shards; i++) {
+        snapshot_record_t *records;
+        cache_buf_t **bufs;
+        long n = pin_shard(&cache->shards[i], &records, &bufs);
+        if (n < 0) {
+            ok = false;
+            break;
+        }
+
+        snapshot_record_t *grown = realloc(table, (count + (size_t)n + 1) * sizeof(*table));
+        ok = grown != NULL;
+        if (ok) {
+            table = grown;
+        }
+        for (long j = 0; j < n; j++) {
+            if (ok) {
+                records[j].offset = offset;
+                ok = write_buffer(file, bufs[j], &offset);
+                table[count++] = records[j];
+            }
+            buf_release(bufs[j]);
+        }
+        free(records);
+        free(bufs);
     }
 
-    /* YOUR CODE HERE */
+    if (ok) {
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.policy = (uint32_t)cache->policy;
+        header.count = count;
+        header.table_offset = offset;
+        header.file_size = offset + count * sizeof(snapshot_record_t);
+        header.hash_check = cache_hash(SNAPSHOT_HASH_PROBE);
+        ok = fwrite(table, sizeof(snapshot_record_t), count, file) == count &&
+             fseek(file, 0, SEEK_SET) == 0 &&
+             fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fflush(file) == 0 && fsync(fileno(file)) == 0;
+    }
+    free(table);
 
-    return false;  /* Placeholder */
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    if (!ok || rename(tmp_path, path) != 0) {
+        perror("cache_snapshot");
+        unlink(tmp_path);
+        return -1;
+    }
+    return (long)count;
 }
 
 /*
-cache_remove - Remove an entry from the cache
+snapshot_record_valid - Check a record and the buffer image it points at
+(internal)
+
+The buffer header is used as is once restored, so it must say what the
+snapshot writer puts there: one reference, CACHE_BUF_MAPPED (otherwise
+the last release would hand mapped memory to the slab allocator) and
+the record's key length and size. The key must end inside key_len.
+Bounds are checked by subtraction, so no sum can wrap.
+
+The image is read with pread rather than through the mapping: touching
+one byte of a mapped page maps its neighbours in too (fault-around), so
+checking every header in place would fault in most of the payloads.
+For the same reason a key is rehashed here, from the image, when rehash
+is not NULL.
 */
-bool cache_remove(cache_t *cache, const char *key) {
-    /*
-     * TODO: Implement cache removal
-     *
-     * Steps:
-     * 1. Acquire write lock
-     * 2. Find entry
-     * 3. If not found, release lock, return false
-     * 4. Remove from hash table (update chain)
-     * 5. Remove from LRU list
-     * 6. Update current_size, num_entries
-     * 7. Free entry->data and entry
-     * 8. Release lock, return true
-     */
-
-    if (cache == NULL || key == NULL) {
+static bool snapshot_record_valid(int fd, const snapshot_header_t *header,
+                                  const snapshot_record_t *rec, uint64_t *rehash) {
+    if (rec->offset < sizeof(*header) || rec->offset % SNAPSHOT_ALIGN != 0 ||
+        rec->offset > header->table_offset ||
+        header->table_offset - rec->offset < sizeof(cache_buf_t) ||
+        rec->key_len == 0 || rec->key_len > MAX_KEY_LEN + 8 || rec->compressed > 1 ||
+        header->table_offset - rec->offset - sizeof(cache_buf_t) < rec->key_len ||
+        header->table_offset - rec->offset - sizeof(cache_buf_t) - rec->key_len < rec->size) {
         return false;
     }
 
-    /* YOUR CODE HERE */
+    /* Header, key and, if compressed, the block header for the decoded size */
+    uint64_t image[(sizeof(cache_buf_t) + MAX_KEY_LEN + 8 + LZ_HEADER_SIZE) / 8 + 1];
+    size_t want = sizeof(cache_buf_t) + rec->key_len +
+                  (rec->compressed && rec->size >= LZ_HEADER_SIZE ? LZ_HEADER_SIZE : 0);
+    if (pread(fd, image, want, (off_t)rec->offset) != (ssize_t)want) {
+        return false;
+    }
 
-    return false;  /* Placeholder */
+    cache_buf_t *buf = (cache_buf_t *)image;
+    uint32_t flags = CACHE_BUF_MAPPED | (rec->compressed ? CACHE_BUF_LZ : 0);
+    if (buf->refs != 1 || buf->flags != flags || buf->key_len != rec->key_len ||
+        buf->size != rec->size) {
+        return false;
+    }
+    const char *end = memchr(buf->data, '\0', rec->key_len);
+    if (end == NULL || end - buf->data >= MAX_KEY_LEN || key_space(buf->data) != rec->key_len ||
+        buf_decoded_size(buf) != rec->decoded_size) {
+        return false;
+    }
+    if (rehash != NULL) {
+        *rehash = cache_hash(buf->data);
+    }
+    return true;
 }
 
 /*
-cache_evict_lru - Evict the least recently used entry
+map_snapshot - Map and validate a snapshot file (internal)
+
+Returns: The header at the start of the mapping, or NULL (with nothing
+mapped) if the file cannot be used. *hashes gets each record's key hash
+(malloc'd, count + 1 of them): the stored one, or recomputed if the
+snapshot was written with another hash function or seed.
 */
-bool cache_evict_lru(cache_t *cache) {
-    /*
-     * TODO: Implement LRU eviction
-     *
-     * Evict the entry at LRU tail (least recently used).
-     *
-     * Steps:
-     * 1. Get tail entry
-     * 2. If NULL (empty cache), return false
-     * 3. Remove from hash table
-     * 4. Remove from LRU list
-     * 5. Update current_size, num_entries
-     * 6. Increment evictions counter
-     * 7. Free entry->data and entry
-     * 8. Return true
-     *
-     * Caller must hold write lock!
-     */
+static const snapshot_header_t *map_snapshot(const char *path, size_t *length,
+                                             uint64_t **hashes) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            perror("cache_restore: open");
+        }
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(snapshot_header_t)) {
+        close(fd);
+        fprintf(stderr, "cache_restore: %s is not a snapshot\n", path);
+        return NULL;
+    }
 
-    if (cache == NULL || cache->lru_tail == NULL) {
-        return false;
+    /* Private and writable: taking a reference writes refs, in a copy */
+    *length = (size_t)st.st_size;
+    char *base = mmap(NULL, *length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+        perror("cache_restore: mmap");
+        close(fd);
+        return NULL;
     }
 
-    /* YOUR CODE HERE */
+    const snapshot_header_t *header = (const snapshot_header_t *)base;
+    bool valid = memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == SNAPSHOT_VERSION &&
+                 header->file_size == *length &&
+                 header->table_offset >= sizeof(*header) &&
+                 header->table_offset % SNAPSHOT_ALIGN == 0 &&
+                 header->table_offset <= *length &&
+                 (*length - header->table_offset) / sizeof(snapshot_record_t) == header->count &&
+                 (*length - header->table_offset) % sizeof(snapshot_record_t) == 0;
+
+    *hashes = valid ? malloc((header->count + 1) * sizeof(uint64_t)) : NULL;
+    if (valid && *hashes == NULL) {
+        perror("cache_restore");
+        close(fd);
+        munmap(base, *length);
+        return NULL;
+    }
 
-    return false;  /* Placeholder */
+    const snapshot_record_t *records = (const snapshot_record_t *)(base + header->table_offset);
+    bool same_hash = valid && header->hash_check == cache_hash(SNAPSHOT_HASH_PROBE);
+    for (uint64_t i = 0; valid && i < header->count; i++) {
+        (*hashes)[i] = records[i].hash;
+        valid = snapshot_record_valid(fd, header, &records[i], same_hash ? NULL : &(*hashes)[i]);
+    }
+    close(fd);
+    if (!valid) {
+        fprintf(stderr, "cache_restore: %s is not a valid snapshot\n", path);
+        free(*hashes);
+        munmap(base, *length);
+        return NULL;
+    }
+    return header;
 }
 
 /*
-cache_clear - Remove all entries from the cache
+cache_restore - Load a snapshot lazily
 */
-void cache_clear(cache_t *cache) {
-    /*
-     * TODO: Implement cache clearing
-     *
-     * Remove all entries but keep the cache structure.
-     */
+long cache_restore(cache_t *cache, const char *path) {
+    if (cache == NULL || path == NULL) {
+        return -1;
+    }
 
-    if (cache == NULL) {
-        return;
+    size_t length;
+    uint64_t *hashes;
+    const snapshot_header_t *header = map_snapshot(path, &length, &hashes);
+    if (header == NULL) {
+        return -1;
+    }
+    char *base = (char *)header;
+    const snapshot_record_t *records = (const snapshot_record_t *)(base + header->table_offset);
+    size_t count = header->count;
+
+    /* Payloads are read on demand and in no particular order */
+    madvise(base, header->table_offset, MADV_RANDOM);
+
+    snapshot_map_t *map = malloc(sizeof(snapshot_map_t));
+    size_t *budget = calloc(cache->num_shards, sizeof(size_t));
+    bool *keep = calloc(count + 1, sizeof(bool));
+    if (map == NULL || budget == NULL || keep == NULL) {
+        perror("cache_restore");
+        free(map);
+        free(hashes);
+        free(budget);
+        free(keep);
+        munmap(base, length);
+        return -1;
+    }
+
+    /* Hottest first: keep what fits each shard's budget */
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        cache_shard_t *shard = shard_for(cache, hashes[i]);
+        size_t charge = slab_chunk_size(sizeof(cache_buf_t) + records[i].key_len + records[i].size);
+        size_t s = (size_t)(shard - cache->shards);
+        if (budget[s] + charge <= shard->max_size) {
+            budget[s] += charge;
+            keep[i] = true;
+            kept++;
+        }
+    }
+
+    map->base = base;
+    map->length = length;
+    map->live = kept + 1;
+    pthread_mutex_lock(&snapshot_maps_lock);
+    map->next = snapshot_maps;
+    snapshot_maps = map;
+    pthread_mutex_unlock(&snapshot_maps_lock);
+
+    /* Coldest first, so the hottest entries end up most recently used */
+    bool same_policy = header->policy == (uint32_t)cache->policy;
+    int64_t wall_now = wall_ms();
+    uint64_t now = now_ms();
+    size_t restored = 0, skipped = 0;
+    for (size_t i = count; i-- > 0; ) {
+        if (!keep[i]) {
+            continue;
+        }
+        const snapshot_record_t *rec = &records[i];
+        cache_buf_t *buf = (cache_buf_t *)(base + rec->offset);
+        uint64_t expires = CACHE_TTL_NONE;
+        if (rec->expires_wall_ms != 0) {
+            int64_t left = rec->expires_wall_ms - wall_now;
+            expires = left > 0 ? now + (uint64_t)left : (now > 1 ? now - 1 : 1);
+        }
+        size_t charge = slab_chunk_size(sizeof(cache_buf_t) + rec->key_len + rec->size);
+
+        cache_shard_t *shard = shard_for(cache, hashes[i]);
+        pthread_rwlock_wrlock(&shard->lock);
+        if (find_entry(shard, buf->data, hashes[i]) != NULL) {
+            skipped++;  /* Cached since the snapshot: newer */
+        } else {
+            disk_forget(shard->l2, buf->data, hashes[i]);
+            cache_entry_t *entry = install_locked(shard, buf->data, hashes[i], buf, charge,
+                                                  rec->has_validator ? &rec->validator : NULL,
+                                                  expires, CACHE_COST_DEFAULT);
+            if (entry != NULL) {
+                if (same_policy && shard->ops->on_restore != NULL) {
+                    shard->ops->on_restore(shard, entry, rec->freq);
+                } else if (same_policy) {
+                    entry->freq = rec->freq;
+                }
+                count_payload(shard, rec->decoded_size, rec->compressed);
+                restored++;
+            }
+        }
+        pthread_rwlock_unlock(&shard->lock);
     }
 
-    /* YOUR CODE HERE */
+    free(hashes);
+    free(budget);
+    free(keep);
+    snapshot_map_put(map, skipped + 1);
+    return (long)restored;
 }
 
 /* ============================================================================
@@ -409,28 +3207,81 @@ Statistics
 cache_get_stats - Get cache statistics
 */
 void cache_get_stats(cache_t *cache, cache_stats_t *stats) {
-    /*
-     * TODO: Implement statistics retrieval
-     *
-     * Copy all statistics fields.
-     * Calculate hit_rate = hits / (hits + misses)
-     * Handle division by zero!
-     */
-
     if (cache == NULL || stats == NULL) {
         return;
     }
 
-    /* YOUR CODE HERE */
+    memset(stats, 0, sizeof(*stats));
+    stats->max_size = cache->max_size;
+    stats->num_shards = cache->num_shards;
+    stats->policy = cache->policy;
+
+    for (int i = 0; i < cache->num_shards; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        pthread_rwlock_rdlock(&shard->lock);
+
+        stats->current_size += shard->current_size;
+        stats->num_entries += shard->num_entries;
+        stats->payload_size += shard->payload_bytes;
+        stats->compressed_entries += shard->num_compressed;
+
+        pthread_rwlock_unlock(&shard->lock);
+    }
+
+    /* Merged without any lock: hits keep counting meanwhile */
+    stat_counters_t *counters = &cache->counters;
+    stats->hits = stat_counters_sum(counters, CACHE_STAT_HITS);
+    stats->misses = stat_counters_sum(counters, CACHE_STAT_MISSES);
+    stats->evictions = stat_counters_sum(counters, CACHE_STAT_EVICTIONS);
+    stats->stale_hits = stat_counters_sum(counters, CACHE_STAT_STALE_HITS);
+    stats->expirations = stat_counters_sum(counters, CACHE_STAT_EXPIRATIONS);
+    stats->admission_rejects = stat_counters_sum(counters, CACHE_STAT_ADMISSION_REJECTS);
+    stats->compress_skipped = stat_counters_sum(counters, CACHE_STAT_COMPRESS_SKIPPED);
+    stats->hit_bytes = stat_counters_sum(counters, CACHE_STAT_HIT_BYTES);
+    stats->put_bytes = stat_counters_sum(counters, CACHE_STAT_PUT_BYTES);
+    stats->miss_bytes = stat_counters_sum(counters, CACHE_STAT_MISS_BYTES);
+
+    if (cache->l2 != NULL) {
+        cache_disk_stats_t disk_stats;
+        cache_disk_get_stats(cache->l2->disk, &disk_stats);
+        pthread_mutex_lock(&cache->l2->lock);
+        stats->disk_hits = __atomic_load_n(&cache->l2->hits, __ATOMIC_RELAXED);
+        stats->disk_dropped = cache->l2->dropped;
+        pthread_mutex_unlock(&cache->l2->lock);
+        stats->disk_writes = disk_stats.writes;
+        stats->disk_bytes = disk_stats.bytes;
+        stats->disk_entries = disk_stats.entries;
+    }
+
+    if (payload_slabs != NULL) {
+        slab_stats_t slab_stats;
+        slab_get_stats(payload_slabs, &slab_stats);
+        stats->payload_mapped = slab_stats.mapped_bytes;
+    }
+
+    unsigned long total = stats->hits + stats->misses;
+    stats->hit_rate = (total > 0) ? (double)stats->hits / total : 0.0;
+    uint64_t bytes = stats->hit_bytes + stats->miss_bytes;
+    stats->byte_hit_rate = (bytes > 0) ? (double)stats->hit_bytes / bytes : 0.0;
+
+    /* max_size x 2^((i - 4) / 2), without libm */
+    static const double mrc_scale[CACHE_MRC_POINTS] = {
+        0.25, 0.35355339, 0.5, 0.70710678, 1.0, 1.41421356, 2.0, 2.82842712, 4.0
+    };
+    for (int i = 0; i < CACHE_MRC_POINTS && cache->mrc != NULL; i++) {
+        stats->mrc_size[i] = (size_t)(cache->max_size * mrc_scale[i]);
+        stats->mrc_hit_rate[i] = mrc_hit_rate(cache->mrc, stats->mrc_size[i], total,
+                                              &stats->mrc_samples);
+    }
+}
 
-    /* Placeholder */
-    stats->hits = 0;
-    stats->misses = 0;
-    stats->evictions = 0;
-    stats->current_size = 0;
-    stats->max_size = 0;
-    stats->num_entries = 0;
-    stats->hit_rate = 0.0;
+/*
+cache_count_miss_bytes - Record bytes fetched to answer a miss
+*/
+void cache_count_miss_bytes(cache_t *cache, size_t bytes) {
+    if (cache != NULL) {
+        stat_counters_add(&cache->counters, CACHE_STAT_MISS_BYTES, bytes);
+    }
 }
 
 /*
@@ -441,5 +3292,15 @@ void cache_reset_stats(cache_t *cache) {
         return;
     }
 
-    /* YOUR CODE HERE */
+    stat_counters_reset(&cache->counters);
+    if (cache->mrc != NULL) {
+        mrc_reset(cache->mrc);
+    }
+
+    if (cache->l2 != NULL) {
+        pthread_mutex_lock(&cache->l2->lock);
+        __atomic_store_n(&cache->l2->hits, 0, __ATOMIC_RELAXED);
+        cache->l2->dropped = 0;
+        pthread_mutex_unlock(&cache->l2->lock);
+    }
 }
@@ -0,0 +1,340 @@
+/*
+cache_disk.c - Log-Structured Disk Tier
+
+Second cache level: entries evicted from RAM are appended to a log file
+and found again through an in-memory index.
+
+Key concepts:
+- The file is a ring of fixed-size segments. Records are appended at the
+  head; when the head moves into a segment, every record it held is
+  dropped from the index at once. Writes are sequential and nothing is
+  ever compacted or rewritten in place
+- Each segment keeps a list of its indexed records (to drop them when it
+  is reused) and a generation number (bumped at reuse). A location
+  carries the generation it was found with, so a read that raced with
+  the reuse notices and is discarded
+- The index only knows key hashes; records start with their key, which
+  the caller compares after reading
+- The mutex covers the index and segment lists, never pread/pwrite
+
+Used in Part C (Proxy) through cache.c.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/cache_disk.h"
+
+/* Initial index slots (the index grows on demand) */
+#define DISK_INDEX_INITIAL_SLOTS    1024
+
+struct cache_disk_item {
+    uint64_t hash;
+    cache_disk_loc_t loc;
+    cache_disk_item_t *prev, *next;    /* Segment's record list */
+};
+
+/* ============================================================================
+Internal Helper Functions
+============================================================================ */
+
+/*
+any_item - Index match callback: the index is keyed by hash alone (internal)
+*/
+static bool any_item(const void *item, const void *key) {
+    (void)item;
+    (void)key;
+    return true;
+}
+
+static cache_disk_item_t *find_item(cache_disk_t *disk, uint64_t hash) {
+    return cache_index_find(&disk->index, hash, any_item, NULL);
+}
+
+/*
+item_free - Drop a record from the index and its segment (internal)
+
+Caller must hold disk->lock.
+*/
+static void item_free(cache_disk_t *disk, cache_disk_item_t *item) {
+    cache_disk_segment_t *segment = &disk->segments[item->loc.segment];
+    cache_index_remove(&disk->index, item->hash, item);
+    if (item->prev != NULL) {
+        item->prev->next = item->next;
+    } else {
+        segment->items = item->next;
+    }
+    if (item->next != NULL) {
+        item->next->prev = item->prev;
+    }
+    segment->bytes -= item->loc.length;
+    disk->bytes -= item->loc.length;
+    free(item);
+}
+
+/*
+forget_segment - Drop every record of a segment and start a new
+generation (internal)
+
+Caller must hold disk->lock.
+*/
+static void forget_segment(cache_disk_t *disk, uint32_t index, bool reclaim) {
+    cache_disk_segment_t *segment = &disk->segments[index];
+    while (segment->items != NULL) {
+        item_free(disk, segment->items);
+        if (reclaim) {
+            disk->reclaimed++;
+        }
+    }
+    segment->generation++;
+}
+
+/*
+full_io - pread / pwrite the whole range, retrying short transfers (internal)
+*/
+static bool full_io(int fd, void *buf, size_t length, uint64_t offset, bool write) {
+    char *p = buf;
+    while (length > 0) {
+        ssize_t n = write ? pwrite(fd, p, length, (off_t)offset)
+                          : pread(fd, p, length, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        length -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return true;
+}
+
+/* ============================================================================
+Lifecycle
+============================================================================ */
+
+/*
+cache_disk_open - Create an empty disk tier backed by a file
+*/
+cache_disk_t *cache_disk_open(const char *path, size_t capacity) {
+    cache_disk_t *disk = calloc(1, sizeof(cache_disk_t));
+    if (disk == NULL) {
+        perror("calloc disk tier");
+        return NULL;
+    }
+
+    disk->num_segments = (uint32_t)(capacity / CACHE_DISK_SEGMENT_SIZE);
+    if (disk->num_segments < 2) {
+        disk->num_segments = 2;
+    }
+    disk->capacity = (size_t)disk->num_segments * CACHE_DISK_SEGMENT_SIZE;
+    disk->segments = calloc(disk->num_segments, sizeof(cache_disk_segment_t));
+    disk->path = strdup(path);
+    if (disk->segments == NULL || disk->path == NULL ||
+        !cache_index_init(&disk->index, DISK_INDEX_INITIAL_SLOTS)) {
+        perror("disk tier alloc");
+        cache_index_destroy(&disk->index);
+        free(disk->segments);
+        free(disk->path);
+        free(disk);
+        return NULL;
+    }
+
+    disk->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (disk->fd < 0) {
+        perror(path);
+        cache_index_destroy(&disk->index);
+        free(disk->segments);
+        free(disk->path);
+        free(disk);
+        return NULL;
+    }
+
+    pthread_mutex_init(&disk->lock, NULL);
+    return disk;
+}
+
+/*
+cache_disk_close - Close the tier and remove its file
+*/
+void cache_disk_close(cache_disk_t *disk) {
+    if (disk == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < disk->num_segments; i++) {
+        forget_segment(disk, i, false);
+    }
+    cache_index_destroy(&disk->index);
+    close(disk->fd);
+    unlink(disk->path);
+    pthread_mutex_destroy(&disk->lock);
+    free(disk->segments);
+    free(disk->path);
+    free(disk);
+}
+
+/* ============================================================================
+Operations
+============================================================================ */
+
+/*
+cache_disk_append - Write a record at the head of the log
+*/
+bool cache_disk_append(cache_disk_t *disk, const void *head, size_t head_len,
+                       const void *body, size_t body_len, cache_disk_loc_t *loc) {
+    size_t length = head_len + body_len;
+    if (length == 0 || length > CACHE_DISK_SEGMENT_SIZE) {
+        return false;
+    }
+
+    pthread_mutex_lock(&disk->lock);
+    if (disk->head_offset + length > CACHE_DISK_SEGMENT_SIZE) {
+        disk->head_segment = (disk->head_segment + 1) % disk->num_segments;
+        disk->head_offset = 0;
+        forget_segment(disk, disk->head_segment, true);
+    }
+    memset(loc, 0, sizeof(*loc));
+    loc->segment = disk->head_segment;
+    loc->generation = disk->segments[disk->head_segment].generation;
+    loc->offset = (uint64_t)disk->head_segment * CACHE_DISK_SEGMENT_SIZE + disk->head_offset;
+    loc->length = length;
+    disk->head_offset += length;
+    pthread_mutex_unlock(&disk->lock);
+
+    /* Only the appender writes, and only past what is indexed */
+    if (!full_io(disk->fd, (void *)head, head_len, loc->offset, true) ||
+        !full_io(disk->fd, (void *)body, body_len, loc->offset + head_len, true)) {
+        perror("disk tier write");
+        return false;
+    }
+
+    pthread_mutex_lock(&disk->lock);
+    disk->writes++;
+    pthread_mutex_unlock(&disk->lock);
+    return true;
+}
+
+/*
+cache_disk_insert - Index an appended record under a key hash
+*/
+bool cache_disk_insert(cache_disk_t *disk, uint64_t hash, const cache_disk_loc_t *loc) {
+    cache_disk_item_t *item = malloc(sizeof(cache_disk_item_t));
+    if (item == NULL) {
+        return false;
+    }
+    item->hash = hash;
+    item->loc = *loc;
+
+    pthread_mutex_lock(&disk->lock);
+    cache_disk_segment_t *segment = &disk->segments[loc->segment];
+    if (segment->generation != loc->generation) {
+        pthread_mutex_unlock(&disk->lock);
+        free(item);
+        return false;
+    }
+
+    cache_disk_item_t *old = find_item(disk, hash);
+    if (old != NULL) {
+        item_free(disk, old);
+    }
+    if (!cache_index_insert(&disk->index, hash, item)) {
+        pthread_mutex_unlock(&disk->lock);
+        free(item);
+        return false;
+    }
+    item->prev = NULL;
+    item->next = segment->items;
+    if (segment->items != NULL) {
+        segment->items->prev = item;
+    }
+    segment->items = item;
+    segment->bytes += loc->length;
+    disk->bytes += loc->length;
+
+    pthread_mutex_unlock(&disk->lock);
+    return true;
+}
+
+/*
+cache_disk_find - Look up the record of a key hash
+*/
+bool cache_disk_find(cache_disk_t *disk, uint64_t hash, cache_disk_loc_t *loc) {
+    pthread_mutex_lock(&disk->lock);
+    cache_disk_item_t *item = find_item(disk, hash);
+    if (item != NULL) {
+        *loc = item->loc;
+    }
+    pthread_mutex_unlock(&disk->lock);
+    return item != NULL;
+}
+
+/*
+cache_disk_read - Read a record found by cache_disk_find
+
+The generation is checked after the read: the appender bumps it before
+writing anything into a reused segment, so a read that overlapped such
+a write always sees the new generation.
+*/
+bool cache_disk_read(cache_disk_t *disk, const cache_disk_loc_t *loc, void *dst) {
+    if (!full_io(disk->fd, dst, loc->length, loc->offset, false)) {
+        return false;
+    }
+
+    pthread_mutex_lock(&disk->lock);
+    bool valid = disk->segments[loc->segment].generation == loc->generation;
+    if (valid) {
+        disk->reads++;
+    }
+    pthread_mutex_unlock(&disk->lock);
+    return valid;
+}
+
+/*
+cache_disk_remove - Forget the record of a key hash
+*/
+bool cache_disk_remove(cache_disk_t *disk, uint64_t hash, const cache_disk_loc_t *expected) {
+    pthread_mutex_lock(&disk->lock);
+    cache_disk_item_t *item = find_item(disk, hash);
+    if (item != NULL && expected != NULL &&
+        (item->loc.offset != expected->offset || item->loc.generation != expected->generation)) {
+        item = NULL;
+    }
+    if (item != NULL) {
+        item_free(disk, item);
+    }
+    pthread_mutex_unlock(&disk->lock);
+    return item != NULL;
+}
+
+/*
+cache_disk_clear - Forget every record (the file is kept)
+*/
+void cache_disk_clear(cache_disk_t *disk) {
+    pthread_mutex_lock(&disk->lock);
+    for (uint32_t i = 0; i < disk->num_segments; i++) {
+        forget_segment(disk, i, false);
+    }
+    pthread_mutex_unlock(&disk->lock);
+}
+
+/* ============================================================================
+Statistics
+============================================================================ */
+
+/*
+cache_disk_get_stats - Snapshot disk tier statistics
+*/
+void cache_disk_get_stats(cache_disk_t *disk, cache_disk_stats_t *stats) {
+    pthread_mutex_lock(&disk->lock);
+    stats->capacity = disk->capacity;
+    stats->bytes = disk->bytes;
+    stats->entries = disk->index.count;
+    stats->writes = disk->writes;
+    stats->reads = disk->reads;
+    stats->reclaimed = disk->reclaimed;
+    pthread_mutex_unlock(&disk->lock);
+}
@@ -0,0 +1,409 @@
+/*
+cache_index.c - Open-Addressing Key Index
+
+Swiss-table style hash index behind every cache shard.
+
+Key concepts:
+- Control bytes: each slot has one byte that is EMPTY, DELETED, or the
+  low 7 bits of the (mixed) hash. A lookup compares 16 control bytes at
+  once and only looks at the slots whose tag matches - usually just the
+  one it wants
+- Groups are aligned runs of CACHE_INDEX_GROUP slots, probed in
+  triangular order, so every group is visited once. A group that still
+  has an EMPTY slot ends the probe
+- Full hashes in the slots: a tag collision costs one integer compare,
+  not a key comparison
+- Incremental resize: 'old' is drained into 'cur' a few groups per
+  update; lookups check both until it is empty
+- Lock-free lookups: a slot is filled before its control byte says so,
+  and a table is one allocation switched by pointer, so a lookup racing
+  with an update sees a consistent table; with 'retired' set, a drained
+  table is freed only after such lookups are done
+
+Used in Part C (Proxy) through cache.c.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "../include/cache_index.h"
+
+#define CTRL_EMPTY      0x80
+#define CTRL_DELETED    0xFE
+
+/* ============================================================================
+Internal Helper Functions
+============================================================================ */
+
+/*
+mix - Scramble the caller's hash so low and high bits are both usable
+(internal; murmur3 finalizer)
+*/
+static uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint8_t tag_of(uint64_t mixed) {
+    return (uint8_t)(mixed & 0x7F);
+}
+
+#ifdef __SSE2__
+
+/*
+match_byte - Bit i set if control byte i of the group equals b (internal)
+*/
+static uint32_t match_byte(const uint8_t *group, uint8_t b) {
+    __m128i ctrl = _mm_load_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)b)));
+}
+
+/*
+match_free - Bit i set if slot i is EMPTY or DELETED (high bit set) (internal)
+*/
+static uint32_t match_free(const uint8_t *group) {
+    return (uint32_t)_mm_movemask_epi8(_mm_load_si128((const __m128i *)group));
+}
+
+#else
+
+static uint32_t match_byte(const uint8_t *group, uint8_t b) {
+    uint32_t mask = 0;
+    for (int i = 0; i < CACHE_INDEX_GROUP; i++) {
+        mask |= (uint32_t)(group[i] == b) << i;
+    }
+    return mask;
+}
+
+static uint32_t match_free(const uint8_t *group) {
+    uint32_t mask = 0;
+    for (int i = 0; i < CACHE_INDEX_GROUP; i++) {
+        mask |= (uint32_t)(group[i] >> 7) << i;
+    }
+    return mask;
+}
+
+#endif
+
+/*
+table_alloc - Allocate an empty table of 'capacity' slots (internal)
+
+Header, control bytes and slots share one allocation, so a table is
+published, and freed, as a single pointer.
+*/
+static cache_index_table_t *table_alloc(size_t capacity) {
+    size_t header = (sizeof(cache_index_table_t) + CACHE_INDEX_GROUP - 1) &
+                    ~(size_t)(CACHE_INDEX_GROUP - 1);
+    char *block = aligned_alloc(CACHE_INDEX_GROUP,
+                                header + capacity + capacity * sizeof(cache_index_slot_t));
+    if (block == NULL) {
+        perror("cache index alloc");
+        return NULL;
+    }
+    cache_index_table_t *table = (cache_index_table_t *)block;
+    table->ctrl = (uint8_t *)block + header;
+    table->slots = (cache_index_slot_t *)(table->ctrl + capacity);
+    memset(table->ctrl, CTRL_EMPTY, capacity);
+    table->capacity = capacity;
+    table->used = 0;
+    table->deleted = 0;
+    return table;
+}
+
+/*
+table_retire - Free a table no longer published, once lock-free
+lookups are done with it (internal)
+*/
+static void table_retire(cache_index_t *index, cache_index_table_t *table) {
+    if (index->retired != NULL) {
+        epoch_retire(index->retired, free, table);
+    } else {
+        free(table);
+    }
+}
+
+/*
+table_find - Look up a key in one table (internal)
+*/
+static void *table_find(const cache_index_table_t *table, uint64_t hash, uint64_t mixed,
+                        cache_index_match_fn match, const void *key) {
+    if (table == NULL) {
+        return NULL;
+    }
+    size_t groups = table->capacity / CACHE_INDEX_GROUP;
+    size_t group = (mixed >> 7) & (groups - 1);
+    uint8_t tag = tag_of(mixed);
+
+    for (size_t step = 1; step <= groups; step++) {
+        const uint8_t *ctrl = table->ctrl + group * CACHE_INDEX_GROUP;
+        uint32_t hits = match_byte(ctrl, tag);
+        /* Pairs with the release in table_put: a tagged slot is filled */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        while (hits != 0) {
+            size_t slot = group * CACHE_INDEX_GROUP + (size_t)__builtin_ctz(hits);
+            void *item = __atomic_load_n(&table->slots[slot].item, __ATOMIC_RELAXED);
+            if (__atomic_load_n(&table->slots[slot].hash, __ATOMIC_RELAXED) == hash &&
+                match(item, key)) {
+                return item;
+            }
+            hits &= hits - 1;
+        }
+        if (match_byte(ctrl, CTRL_EMPTY) != 0) {
+            return NULL;
+        }
+        group = (group + step) & (groups - 1);
+    }
+    return NULL;
+}
+
+/*
+table_put - Store an item in the first free slot of its probe sequence
+(internal; the table must have a free slot)
+*/
+static void table_put(cache_index_table_t *table, uint64_t hash, uint64_t mixed, void *item) {
+    size_t groups = table->capacity / CACHE_INDEX_GROUP;
+    size_t group = (mixed >> 7) & (groups - 1);
+
+    for (size_t step = 1; ; step++) {
+        uint32_t free_slots = match_free(table->ctrl + group * CACHE_INDEX_GROUP);
+        if (free_slots != 0) {
+            size_t slot = group * CACHE_INDEX_GROUP + (size_t)__builtin_ctz(free_slots);
+            if (table->ctrl[slot] == CTRL_DELETED) {
+                table->deleted--;
+            }
+            __atomic_store_n(&table->slots[slot].hash, hash, __ATOMIC_RELAXED);
+            __atomic_store_n(&table->slots[slot].item, item, __ATOMIC_RELAXED);
+            __atomic_store_n(&table->ctrl[slot], tag_of(mixed), __ATOMIC_RELEASE);
+            table->used++;
+            return;
+        }
+        group = (group + step) & (groups - 1);
+    }
+}
+
+/*
+table_remove - Remove an item from one table (internal)
+
+A group that still has an EMPTY slot never ended a probe for another
+key, so the slot can become EMPTY again; otherwise it is a tombstone.
+*/
+static bool table_remove(cache_index_table_t *table, uint64_t hash, uint64_t mixed,
+                         const void *item) {
+    if (table == NULL) {
+        return false;
+    }
+    size_t groups = table->capacity / CACHE_INDEX_GROUP;
+    size_t group = (mixed >> 7) & (groups - 1);
+    uint8_t tag = tag_of(mixed);
+
+    for (size_t step = 1; step <= groups; step++) {
+        uint8_t *ctrl = table->ctrl + group * CACHE_INDEX_GROUP;
+        uint32_t hits = match_byte(ctrl, tag);
+        while (hits != 0) {
+            size_t slot = group * CACHE_INDEX_GROUP + (size_t)__builtin_ctz(hits);
+            if (table->slots[slot].item == item && table->slots[slot].hash == hash) {
+                if (match_byte(ctrl, CTRL_EMPTY) != 0) {
+                    table->ctrl[slot] = CTRL_EMPTY;
+                } else {
+                    table->ctrl[slot] = CTRL_DELETED;
+                    table->deleted++;
+                }
+                table->used--;
+                return true;
+            }
+            hits &= hits - 1;
+        }
+        if (match_byte(ctrl, CTRL_EMPTY) != 0) {
+            return false;
+        }
+        group = (group + step) & (groups - 1);
+    }
+    return false;
+}
+
+/*
+migrate - Move up to 'groups' groups of the old table into cur (internal)
+
+Moved slots become tombstones, so probes through them still continue to
+the items not moved yet.
+*/
+static void migrate(cache_index_t *index, size_t groups) {
+    cache_index_table_t *old = index->old;
+
+    while (old != NULL && groups-- > 0) {
+        size_t base = index->migrate_group * CACHE_INDEX_GROUP;
+        for (size_t slot = base; slot < base + CACHE_INDEX_GROUP; slot++) {
+            if (old->ctrl[slot] < CTRL_EMPTY) {
+                table_put(index->cur, old->slots[slot].hash,
+                          mix(old->slots[slot].hash), old->slots[slot].item);
+                old->ctrl[slot] = CTRL_DELETED;
+                old->used--;
+            }
+        }
+        if (++index->migrate_group == old->capacity / CACHE_INDEX_GROUP) {
+            __atomic_store_n(&index->old, NULL, __ATOMIC_RELEASE);
+            table_retire(index, old);
+            index->migrate_group = 0;
+            old = NULL;
+        }
+    }
+}
+
+/*
+start_resize - cur is too full: replace it and start draining it (internal)
+
+The new size keeps the live items under half the maximum load, so a
+table full of tombstones is rebuilt at the same size.
+*/
+static bool start_resize(cache_index_t *index) {
+    migrate(index, SIZE_MAX);
+
+    size_t capacity = index->cur->capacity;
+    while (index->cur->used * 16 > capacity * CACHE_INDEX_MAX_LOAD_8THS) {
+        capacity *= 2;
+    }
+
+    cache_index_table_t *fresh = table_alloc(capacity);
+    if (fresh == NULL) {
+        return false;
+    }
+    /* A lookup checks cur, then old: publish old first so none misses both */
+    __atomic_store_n(&index->old, index->cur, __ATOMIC_RELEASE);
+    __atomic_store_n(&index->cur, fresh, __ATOMIC_RELEASE);
+    index->migrate_group = 0;
+    index->resizes++;
+    return true;
+}
+
+/* ============================================================================
+Lifecycle
+============================================================================ */
+
+/*
+cache_index_init - Initialize an empty index
+*/
+bool cache_index_init(cache_index_t *index, size_t capacity) {
+    memset(index, 0, sizeof(*index));
+    size_t rounded = CACHE_INDEX_GROUP;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+    index->cur = table_alloc(rounded);
+    return index->cur != NULL;
+}
+
+/*
+cache_index_destroy - Free an index's tables (not the items)
+*/
+void cache_index_destroy(cache_index_t *index) {
+    free(index->cur);
+    free(index->old);
+    index->cur = NULL;
+    index->old = NULL;
+    index->count = 0;
+}
+
+/*
+cache_index_clear - Remove every item, keeping the current capacity
+*/
+void cache_index_clear(cache_index_t *index) {
+    if (index->old != NULL) {
+        cache_index_table_t *old = index->old;
+        __atomic_store_n(&index->old, NULL, __ATOMIC_RELEASE);
+        table_retire(index, old);
+    }
+    index->migrate_group = 0;
+    memset(index->cur->ctrl, CTRL_EMPTY, index->cur->capacity);
+    index->cur->used = 0;
+    index->cur->deleted = 0;
+    index->count = 0;
+}
+
+/* ============================================================================
+Operations
+============================================================================ */
+
+/*
+cache_index_find - Find the item with a key
+*/
+void *cache_index_find(const cache_index_t *index, uint64_t hash,
+                       cache_index_match_fn match, const void *key) {
+    uint64_t mixed = mix(hash);
+    void *item = table_find(__atomic_load_n(&index->cur, __ATOMIC_ACQUIRE), hash, mixed,
+                            match, key);
+    if (item == NULL) {
+        item = table_find(__atomic_load_n(&index->old, __ATOMIC_ACQUIRE), hash, mixed,
+                          match, key);
+    }
+    return item;
+}
+
+/*
+cache_index_prefetch - Start loading the slots a lookup of 'hash' probes first
+*/
+void cache_index_prefetch(const cache_index_t *index, uint64_t hash) {
+    const cache_index_table_t *table = __atomic_load_n(&index->cur, __ATOMIC_ACQUIRE);
+    size_t group = (mix(hash) >> 7) & (table->capacity / CACHE_INDEX_GROUP - 1);
+    const cache_index_slot_t *slots = &table->slots[group * CACHE_INDEX_GROUP];
+    __builtin_prefetch(table->ctrl + group * CACHE_INDEX_GROUP);
+    for (size_t line = 0; line < sizeof(cache_index_slot_t) * CACHE_INDEX_GROUP; line += 64) {
+        __builtin_prefetch((const char *)slots + line);
+    }
+}
+
+/*
+cache_index_peek - The item a lookup of 'hash' would most likely return
+*/
+void *cache_index_peek(const cache_index_t *index, uint64_t hash) {
+    const cache_index_table_t *table = __atomic_load_n(&index->cur, __ATOMIC_ACQUIRE);
+    uint64_t mixed = mix(hash);
+    size_t group = (mixed >> 7) & (table->capacity / CACHE_INDEX_GROUP - 1);
+    uint32_t hits = match_byte(table->ctrl + group * CACHE_INDEX_GROUP, tag_of(mixed));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    while (hits != 0) {
+        size_t slot = group * CACHE_INDEX_GROUP + (size_t)__builtin_ctz(hits);
+        if (__atomic_load_n(&table->slots[slot].hash, __ATOMIC_RELAXED) == hash) {
+            return __atomic_load_n(&table->slots[slot].item, __ATOMIC_RELAXED);
+        }
+        hits &= hits - 1;
+    }
+    return NULL;
+}
+
+/*
+cache_index_insert - Add an item (the caller ensures its key is absent)
+*/
+bool cache_index_insert(cache_index_t *index, uint64_t hash, void *item) {
+    migrate(index, CACHE_INDEX_MIGRATE_GROUPS);
+
+    cache_index_table_t *cur = index->cur;
+    if ((cur->used + cur->deleted + 1) * 8 > cur->capacity * CACHE_INDEX_MAX_LOAD_8THS &&
+        !start_resize(index)) {
+        return false;
+    }
+
+    table_put(index->cur, hash, mix(hash), item);
+    index->count++;
+    return true;
+}
+
+/*
+cache_index_remove - Remove an item
+*/
+bool cache_index_remove(cache_index_t *index, uint64_t hash, const void *item) {
+    uint64_t mixed = mix(hash);
+    bool found = table_remove(index->cur, hash, mixed, item) ||
+                 table_remove(index->old, hash, mixed, item);
+    if (found) {
+        index->count--;
+    }
+    migrate(index, CACHE_INDEX_MIGRATE_GROUPS);
+    return found;
+}
@@ -0,0 +1,1124 @@
+/*
+cache_policy.c - Cache Replacement Policies
+
+The replacement policies behind cache_t. cache.c owns the hash table,
+locking and TTLs; it tells the shard's policy about lookups, hits,
+inserts and removals, and asks it for a victim when a shard is over
+budget (see cache_policy_ops_t in cache.h).
+
+Policies:
+- LRU: one list, hits move to the head, the tail is evicted
+- CLOCK: second chance over a circular array; hits set a bit atomically
+- W-TinyLFU: window LRU + segmented LRU, frequency-sketch admission
+- ARC: recency list T1 and frequency list T2, with ghost lists of
+  recently evicted keys steering the split between them
+- 2Q: FIFO for first-time keys, LRU for keys seen again after leaving it
+- S3-FIFO: small FIFO filtering one-hit wonders, main FIFO with
+  reinsertion; hits only bump a 2-bit counter atomically
+- GDSF: binary min-heap on L + hits * cost / size, where L (the
+  "inflation" value) is the priority of the last victim
+
+Budgets are in bytes, not entries, since cached files vary in size.
+Every function here runs under the shard's write lock, except on_hit of
+policies with read_locked_hits, which must only touch the entry
+atomically.
+
+Used in Part C (Proxy) and Part D (IPC Cache Process) through cache.c.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "../include/cache.h"
+#include "../include/freq_sketch.h"
+
+/* First allocation of a shard's CLOCK ring */
+#define CLOCK_INITIAL_SLOTS 64
+
+/* Sketch size limits (counters per row) */
+#define SKETCH_MIN_WIDTH    1024
+#define SKETCH_MAX_WIDTH    (1u << 20)
+
+/* Ghost list limits (remembered keys) */
+#define GHOST_INITIAL_SLOTS 64
+#define GHOST_MAX_SLOTS     (1u << 20)
+
+/* 2Q: A1in share of the shard, A1out ghost share */
+#define TWOQ_IN_PERCENT     25
+#define TWOQ_OUT_PERCENT    50
+
+/* S3-FIFO: small FIFO share, frequency cap */
+#define S3FIFO_SMALL_PERCENT    10
+#define S3FIFO_MAX_FREQ         3
+
+/* GDSF: first allocation of a shard's heap */
+#define GDSF_INITIAL_SLOTS  64
+
+/* GDSF: hit counts saturate here (entry->freq is a byte) */
+#define GDSF_MAX_FREQ       255
+
+/* ============================================================================
+List Management
+============================================================================ */
+
+/*
+list_remove - Unlink entry from the shard list it is on (internal)
+*/
+static void list_remove(cache_shard_t *shard, cache_entry_t *entry) {
+    cache_list_t *list = &shard->segments[entry->segment];
+    cache_entry_t *prev = cache_entry_at(shard, entry->lru_prev);
+    cache_entry_t *next = cache_entry_at(shard, entry->lru_next);
+
+    if (prev != NULL) {
+        prev->lru_next = entry->lru_next;
+    } else {
+        list->head = next;
+    }
+
+    if (next != NULL) {
+        next->lru_prev = entry->lru_prev;
+    } else {
+        list->tail = prev;
+    }
+
+    list->bytes -= entry->size;
+    entry->lru_prev = CACHE_ENTRY_NIL;
+    entry->lru_next = CACHE_ENTRY_NIL;
+}
+
+/*
+list_push_front - Add entry to the head of one of the shard's lists (internal)
+*/
+static void list_push_front(cache_shard_t *shard, cache_entry_t *entry, int segment) {
+    cache_list_t *list = &shard->segments[segment];
+
+    entry->segment = segment;
+    entry->lru_prev = CACHE_ENTRY_NIL;
+    entry->lru_next = list->head != NULL ? list->head->id : CACHE_ENTRY_NIL;
+
+    if (list->head != NULL) {
+        list->head->lru_prev = entry->id;
+    }
+    list->head = entry;
+
+    if (list->tail == NULL) {
+        list->tail = entry;
+    }
+    list->bytes += entry->size;
+}
+
+/*
+list_move_front - Move entry to the head of a list (internal)
+*/
+static void list_move_front(cache_shard_t *shard, cache_entry_t *entry, int segment) {
+    if (entry->segment == segment && shard->segments[segment].head == entry) {
+        return;
+    }
+    list_remove(shard, entry);
+    list_push_front(shard, entry, segment);
+}
+
+/*
+tail_except - Least recently used entry of a list other than protect (internal)
+*/
+static cache_entry_t *tail_except(cache_shard_t *shard, int segment, cache_entry_t *protect) {
+    cache_entry_t *tail = shard->segments[segment].tail;
+    return (tail == NULL || tail != protect) ? tail : cache_entry_at(shard, tail->lru_prev);
+}
+
+/*
+entry_hash - Hash of an entry's key, as passed to on_insert (internal)
+*/
+static unsigned long entry_hash(const cache_entry_t *entry) {
+    return entry->hash;
+}
+
+/* ============================================================================
+Ghost Lists
+============================================================================ */
+
+/*
+A ghost list remembers the hashes (and sizes) of recently evicted keys,
+oldest first, up to max_bytes of would-be data. A ring keeps the order;
+an open-addressing index maps hash -> ring sequence number, so lookups
+and removals from the middle are O(1). A ring slot whose index entry
+points elsewhere is dead and skipped when it reaches the head.
+*/
+typedef struct {
+    unsigned long *ring_hash;       /* FIFO of hashes (slot = seq % cap) */
+    uint32_t *ring_size;
+    uint32_t cap;                   /* Ring slots (power of two) */
+    uint64_t head;                  /* Sequence number of the oldest slot */
+    uint64_t tail;                  /* Next sequence number */
+
+    unsigned long *index_hash;      /* 2 * cap slots, linear probing */
+    uint64_t *index_seq;            /* seq + 1, 0 = empty */
+
+    size_t bytes;                   /* Sizes of live entries */
+    size_t max_bytes;
+} ghost_t;
+
+static uint32_t ghost_home(const ghost_t *g, unsigned long hash) {
+    uint64_t mixed = (uint64_t)hash * 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(mixed >> 32) & (2 * g->cap - 1);
+}
+
+/*
+ghost_find - Index slot holding hash, or -1 (internal)
+*/
+static int64_t ghost_find(const ghost_t *g, unsigned long hash) {
+    uint32_t mask = 2 * g->cap - 1;
+    for (uint32_t i = ghost_home(g, hash); g->index_seq[i] != 0; i = (i + 1) & mask) {
+        if (g->index_hash[i] == hash) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void ghost_index_put(ghost_t *g, unsigned long hash, uint64_t seq) {
+    uint32_t mask = 2 * g->cap - 1;
+    uint32_t i = ghost_home(g, hash);
+    while (g->index_seq[i] != 0 && g->index_hash[i] != hash) {
+        i = (i + 1) & mask;
+    }
+    g->index_hash[i] = hash;
+    g->index_seq[i] = seq + 1;
+}
+
+/*
+ghost_index_delete - Remove an index slot (backward-shift deletion)
+*/
+static void ghost_index_delete(ghost_t *g, uint32_t hole) {
+    uint32_t mask = 2 * g->cap - 1;
+    for (uint32_t j = (hole + 1) & mask; g->index_seq[j] != 0; j = (j + 1) & mask) {
+        uint32_t home = ghost_home(g, g->index_hash[j]);
+        /* Entry j may fill the hole unless its home lies in (hole, j] */
+        bool stays = (hole < j) ? (home > hole && home <= j) : (home > hole || home <= j);
+        if (!stays) {
+            g->index_hash[hole] = g->index_hash[j];
+            g->index_seq[hole] = g->index_seq[j];
+            hole = j;
+        }
+    }
+    g->index_seq[hole] = 0;
+}
+
+static bool ghost_init(ghost_t *g, size_t max_bytes) {
+    memset(g, 0, sizeof(*g));
+    g->cap = GHOST_INITIAL_SLOTS;
+    g->max_bytes = max_bytes;
+    g->ring_hash = malloc(g->cap * sizeof(unsigned long));
+    g->ring_size = malloc(g->cap * sizeof(uint32_t));
+    g->index_hash = calloc(2 * g->cap, sizeof(unsigned long));
+    g->index_seq = calloc(2 * g->cap, sizeof(uint64_t));
+    return g->ring_hash && g->ring_size && g->index_hash && g->index_seq;
+}
+
+static void ghost_free(ghost_t *g) {
+    free(g->ring_hash);
+    free(g->ring_size);
+    free(g->index_hash);
+    free(g->index_seq);
+}
+
+static void ghost_clear(ghost_t *g) {
+    memset(g->index_seq, 0, 2 * g->cap * sizeof(uint64_t));
+    g->head = g->tail = 0;
+    g->bytes = 0;
+}
+
+/*
+ghost_pop - Forget the oldest slot (internal)
+*/
+static void ghost_pop(ghost_t *g) {
+    uint32_t slot = g->head % g->cap;
+    int64_t i = ghost_find(g, g->ring_hash[slot]);
+    if (i >= 0 && g->index_seq[i] == g->head + 1) {
+        g->bytes -= g->ring_size[slot];
+        ghost_index_delete(g, (uint32_t)i);
+    }
+    g->head++;
+}
+
+/*
+ghost_grow - Double the ring and rebuild the index (internal)
+*/
+static bool ghost_grow(ghost_t *g) {
+    uint32_t cap = g->cap * 2;
+    unsigned long *ring_hash = malloc(cap * sizeof(unsigned long));
+    uint32_t *ring_size = malloc(cap * sizeof(uint32_t));
+    unsigned long *index_hash = calloc(2 * cap, sizeof(unsigned long));
+    uint64_t *index_seq = calloc(2 * cap, sizeof(uint64_t));
+    if (!ring_hash || !ring_size || !index_hash || !index_seq) {
+        free(ring_hash);
+        free(ring_size);
+        free(index_hash);
+        free(index_seq);
+        return false;
+    }
+
+    ghost_t old = *g;
+    g->ring_hash = ring_hash;
+    g->ring_size = ring_size;
+    g->index_hash = index_hash;
+    g->index_seq = index_seq;
+    g->cap = cap;
+
+    for (uint64_t seq = old.head; seq < old.tail; seq++) {
+        uint32_t slot = seq % old.cap;
+        int64_t i = ghost_find(&old, old.ring_hash[slot]);
+        g->ring_hash[seq % cap] = old.ring_hash[slot];
+        g->ring_size[seq % cap] = old.ring_size[slot];
+        if (i >= 0 && old.index_seq[i] == seq + 1) {
+            ghost_index_put(g, old.ring_hash[slot], seq);
+        }
+    }
+
+    ghost_free(&old);
+    return true;
+}
+
+/*
+ghost_remove - Forget a key if remembered
+
+Returns: true if the key was on the ghost list.
+*/
+static bool ghost_remove(ghost_t *g, unsigned long hash) {
+    int64_t i = ghost_find(g, hash);
+    if (i < 0) {
+        return false;
+    }
+    g->bytes -= g->ring_size[(g->index_seq[i] - 1) % g->cap];
+    ghost_index_delete(g, (uint32_t)i);
+    return true;
+}
+
+/*
+ghost_add - Remember an evicted key, dropping the oldest as needed
+*/
+static void ghost_add(ghost_t *g, unsigned long hash, size_t size) {
+    if (size > g->max_bytes) {
+        return;
+    }
+    ghost_remove(g, hash);
+
+    while (g->head < g->tail && g->bytes + size > g->max_bytes) {
+        ghost_pop(g);
+    }
+    if (g->tail - g->head == g->cap &&
+        (g->cap >= GHOST_MAX_SLOTS || !ghost_grow(g))) {
+        ghost_pop(g);
+    }
+
+    uint32_t slot = g->tail % g->cap;
+    g->ring_hash[slot] = hash;
+    g->ring_size[slot] = size > UINT32_MAX ? UINT32_MAX : (uint32_t)size;
+    ghost_index_put(g, hash, g->tail);
+    g->tail++;
+    g->bytes += g->ring_size[slot];
+}
+
+/* ============================================================================
+LRU
+============================================================================ */
+
+#define LRU_LIST    0
+
+static bool lru_init(cache_shard_t *shard) {
+    (void)shard;
+    return true;
+}
+
+static void lru_noop(cache_shard_t *shard) {
+    (void)shard;
+}
+
+static void lru_on_hit(cache_shard_t *shard, cache_entry_t *entry) {
+    list_move_front(shard, entry, LRU_LIST);
+}
+
+static bool lru_on_insert(cache_shard_t *shard, cache_entry_t *entry, unsigned long hash) {
+    (void)hash;
+    list_push_front(shard, entry, LRU_LIST);
+    return true;
+}
+
+static cache_entry_t *lru_victim(cache_shard_t *shard, cache_entry_t *protect) {
+    cache_entry_t *tail = shard->segments[LRU_LIST].tail;
+    return tail != protect ? tail : NULL;
+}
+
+static const cache_policy_ops_t lru_ops = {
+    .name = "LRU",
+    .read_locked_hits = false,
+    .init = lru_init,
+    .destroy = lru_noop,
+    .clear = lru_noop,
+    .on_access = NULL,
+    .on_hit = lru_on_hit,
+    .on_insert = lru_on_insert,
+    .on_remove = list_remove,
+    .on_restore = NULL,
+    .victim = lru_victim,
+};
+
+/* ============================================================================
+CLOCK
+============================================================================ */
+
+/*
+The list keeps insertion order only (for iteration); the ring is what
+the hand sweeps. entry->freq is the reference bit.
+*/
+typedef struct {
+    cache_entry_t **ring;
+    int size;                       /* Slots in use */
+    int cap;                        /* Slots allocated */
+    int hand;                       /* Next slot the eviction hand looks at */
+} clock_state_t;
+
+static bool clock_init(cache_shard_t *shard) {
+    shard->policy_data = calloc(1, sizeof(clock_state_t));
+    return shard->policy_data != NULL;
+}
+
+static void clock_destroy(cache_shard_t *shard) {
+    clock_state_t *clock = shard->policy_data;
+    if (clock != NULL) {
+        free(clock->ring);
+        free(clock);
+    }
+}
+
+static void clock_clear(cache_shard_t *shard) {
+    clock_state_t *clock = shard->policy_data;
+    clock->size = 0;
+    clock->hand = 0;
+}
+
+static void clock_on_hit(cache_shard_t *shard, cache_entry_t *entry) {
+    (void)shard;
+    /* Hot entries already have it: skip the store, keep the line shared */
+    if (__atomic_load_n(&entry->freq, __ATOMIC_RELAXED) == 0) {
+        __atomic_store_n(&entry->freq, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+clock_on_insert - Append an entry to the shard's ring
+*/
+static bool clock_on_insert(cache_shard_t *shard, cache_entry_t *entry, unsigned long hash) {
+    clock_state_t *clock = shard->policy_data;
+    (void)hash;
+
+    if (clock->size == clock->cap) {
+        int cap = clock->cap > 0 ? clock->cap * 2 : CLOCK_INITIAL_SLOTS;
+        cache_entry_t **slots = realloc(clock->ring, cap * sizeof(cache_entry_t *));
+        if (slots == NULL) {
+            return false;
+        }
+        clock->ring = slots;
+        clock->cap = cap;
+    }
+    entry->clock_index = clock->size;
+    entry->freq = 0;
+    clock->ring[clock->size++] = entry;
+    list_push_front(shard, entry, LRU_LIST);
+    return true;
+}
+
+/*
+clock_on_remove - Take an entry out of the ring
+
+The last slot moves into the hole, so the ring never has gaps.
+*/
+static void clock_on_remove(cache_shard_t *shard, cache_entry_t *entry) {
+    clock_state_t *clock = shard->policy_data;
+    cache_entry_t *last = clock->ring[--clock->size];
+    clock->ring[entry->clock_index] = last;
+    last->clock_index = entry->clock_index;
+    if (clock->hand >= clock->size) {
+        clock->hand = 0;
+    }
+    list_remove(shard, entry);
+}
+
+static cache_entry_t *clock_victim(cache_shard_t *shard, cache_entry_t *protect) {
+    clock_state_t *clock = shard->policy_data;
+
+    /* Two sweeps at most: the first clears every reference bit */
+    for (int step = 0; step < 2 * clock->size + 1; step++) {
+        cache_entry_t *entry = clock->ring[clock->hand];
+        clock->hand = (clock->hand + 1) % clock->size;
+        if (entry == protect) {
+            continue;
+        }
+        if (__atomic_exchange_n(&entry->freq, 0, __ATOMIC_RELAXED) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static const cache_policy_ops_t clock_ops = {
+    .name = "CLOCK",
+    .read_locked_hits = true,
+    .init = clock_init,
+    .destroy = clock_destroy,
+    .clear = clock_clear,
+    .on_access = NULL,
+    .on_hit = clock_on_hit,
+    .on_insert = clock_on_insert,
+    .on_remove = clock_on_remove,
+    .on_restore = NULL,
+    .victim = clock_victim,
+};
+
+/* ============================================================================
+W-TinyLFU
+============================================================================ */
+
+#define TLFU_WINDOW     0           /* Admission window (LRU) */
+#define TLFU_PROBATION  1           /* Main: not hit since entering main */
+#define TLFU_PROTECTED  2           /* Main: hit again in main */
+
+typedef struct {
+    freq_sketch_t *sketch;          /* Access frequencies */
+    size_t window_max;              /* Window budget in bytes */
+    size_t protected_max;           /* Protected segment budget in bytes */
+} tinylfu_state_t;
+
+static bool tinylfu_init(cache_shard_t *shard) {
+    tinylfu_state_t *t = calloc(1, sizeof(tinylfu_state_t));
+    if (t == NULL) {
+        return false;
+    }
+
+    t->window_max = shard->max_size * TINYLFU_WINDOW_PERCENT / 100;
+    t->protected_max = (shard->max_size - t->window_max) * TINYLFU_PROTECTED_PERCENT / 100;
+
+    size_t width = shard->max_size / TINYLFU_BYTES_PER_COUNTER;
+    width = width < SKETCH_MIN_WIDTH ? SKETCH_MIN_WIDTH : width;
+    width = width > SKETCH_MAX_WIDTH ? SKETCH_MAX_WIDTH : width;
+    t->sketch = freq_sketch_create((uint32_t)width);
+    if (t->sketch == NULL) {
+        free(t);
+        return false;
+    }
+
+    shard->policy_data = t;
+    return true;
+}
+
+static void tinylfu_destroy(cache_shard_t *shard) {
+    tinylfu_state_t *t = shard->policy_data;
+    if (t != NULL) {
+        freq_sketch_destroy(t->sketch);
+        free(t);
+    }
+}
+
+static void tinylfu_clear(cache_shard_t *shard) {
+    tinylfu_state_t *t = shard->policy_data;
+    freq_sketch_clear(t->sketch);
+}
+
+/*
+tinylfu_on_access - Count a lookup in the frequency sketch
+
+Hits and misses both count: a miss is usually followed by a put, and
+that candidate's history is what admission looks at.
+*/
+static void tinylfu_on_access(cache_shard_t *shard, unsigned long hash) {
+    tinylfu_state_t *t = shard->policy_data;
+    freq_sketch_increment(t->sketch, hash);
+}
+
+/*
+tinylfu_on_hit - Window hits stay in the window; a probation hit is
+promoted to protected, whose overflow goes back to probation
+*/
+static void tinylfu_on_hit(cache_shard_t *shard, cache_entry_t *entry) {
+    tinylfu_state_t *t = shard->policy_data;
+
+    if (entry->segment == TLFU_WINDOW) {
+        list_move_front(shard, entry, TLFU_WINDOW);
+        return;
+    }
+
+    list_move_front(shard, entry, TLFU_PROTECTED);
+
+    cache_list_t *protected = &shard->segments[TLFU_PROTECTED];
+    while (protected->bytes > t->protected_max && protected->tail != entry) {
+        list_move_front(shard, protected->tail, TLFU_PROBATION);
+    }
+}
+
+static bool tinylfu_on_insert(cache_shard_t *shard, cache_entry_t *entry, unsigned long hash) {
+    (void)hash;
+    list_push_front(shard, entry, TLFU_WINDOW);
+    return true;
+}
+
+static uint8_t tinylfu_frequency(tinylfu_state_t *t, const cache_entry_t *entry) {
+    return freq_sketch_estimate(t->sketch, entry_hash(entry));
+}
+
+/*
+tinylfu_victim - Next entry to evict
+
+While the window is over its budget, its LRU entry is a candidate for
+the main area. It moves in for free while main has room; otherwise it
+duels main's victim (probation first) and the less frequent one is
+returned for eviction. Ties go to the incumbent, so one-off scans lose.
+Once the window fits, main is trimmed, then the window itself.
+*/
+static cache_entry_t *tinylfu_victim(cache_shard_t *shard, cache_entry_t *protect) {
+    tinylfu_state_t *t = shard->policy_data;
+    cache_list_t *window = &shard->segments[TLFU_WINDOW];
+    size_t main_max = shard->max_size - t->window_max;
+
+    while (window->bytes > t->window_max && window->tail != NULL &&
+           window->tail != protect) {
+        cache_entry_t *candidate = window->tail;
+        size_t main_bytes = shard->segments[TLFU_PROBATION].bytes +
+                            shard->segments[TLFU_PROTECTED].bytes;
+
+        cache_entry_t *victim = tail_except(shard, TLFU_PROBATION, protect);
+        if (victim == NULL) {
+            victim = tail_except(shard, TLFU_PROTECTED, protect);
+        }
+
+        if (main_bytes + candidate->size <= main_max || victim == NULL) {
+            list_move_front(shard, candidate, TLFU_PROBATION);
+            continue;
+        }
+
+        if (tinylfu_frequency(t, candidate) > tinylfu_frequency(t, victim)) {
+            list_move_front(shard, candidate, TLFU_PROBATION);
+            return victim;
+        }
+        stat_counters_inc(shard->counters, CACHE_STAT_ADMISSION_REJECTS);
+        return candidate;
+    }
+
+    int order[] = { TLFU_PROBATION, TLFU_PROTECTED, TLFU_WINDOW };
+    for (int i = 0; i < 3; i++) {
+        cache_entry_t *victim = tail_except(shard, order[i], protect);
+        if (victim != NULL) {
+            return victim;
+        }
+    }
+    return NULL;
+}
+
+static const cache_policy_ops_t tinylfu_ops = {
+    .name = "TINYLFU",
+    .read_locked_hits = false,
+    .init = tinylfu_init,
+    .destroy = tinylfu_destroy,
+    .clear = tinylfu_clear,
+    .on_access = tinylfu_on_access,
+    .on_hit = tinylfu_on_hit,
+    .on_insert = tinylfu_on_insert,
+    .on_remove = list_remove,
+    .on_restore = NULL,
+    .victim = tinylfu_victim,
+};
+
+/* ============================================================================
+ARC (Adaptive Replacement Cache)
+============================================================================ */
+
+#define ARC_T1      0               /* Seen once recently (recency) */
+#define ARC_T2      1               /* Seen at least twice (frequency) */
+
+/*
+p is the target size of T1 in bytes. A miss on a key in ghost B1 means
+T1 was too small, so p grows; a miss on a key in B2 shrinks it. Each
+ghost list holds up to one shard budget of keys.
+*/
+typedef struct {
+    ghost_t b1;                     /* Evicted from T1 */
+    ghost_t b2;                     /* Evicted from T2 */
+    size_t p;                       /* Target T1 size (bytes) */
+} arc_state_t;
+
+static bool arc_init(cache_shard_t *shard) {
+    arc_state_t *a = calloc(1, sizeof(arc_state_t));
+    if (a == NULL) {
+        return false;
+    }
+    shard->policy_data = a;
+    return ghost_init(&a->b1, shard->max_size) && ghost_init(&a->b2, shard->max_size);
+}
+
+static void arc_destroy(cache_shard_t *shard) {
+    arc_state_t *a = shard->policy_data;
+    if (a != NULL) {
+        ghost_free(&a->b1);
+        ghost_free(&a->b2);
+        free(a);
+    }
+}
+
+static void arc_clear(cache_shard_t *shard) {
+    arc_state_t *a = shard->policy_data;
+    ghost_clear(&a->b1);
+    ghost_clear(&a->b2);
+    a->p = 0;
+}
+
+static void arc_on_hit(cache_shard_t *shard, cache_entry_t *entry) {
+    list_move_front(shard, entry, ARC_T2);
+}
+
+static bool arc_on_insert(cache_shard_t *shard, cache_entry_t *entry, unsigned long hash) {
+    arc_state_t *a = shard->policy_data;
+    size_t b1 = a->b1.bytes, b2 = a->b2.bytes;
+
+    if (ghost_remove(&a->b1, hash)) {
+        size_t delta = (b2 > b1 && b1 > 0) ? entry->size * (b2 / b1) : entry->size;
+        a->p = (a->p + delta > shard->max_size) ? shard->max_size : a->p + delta;
+        list_push_front(shard, entry, ARC_T2);
+    } else if (ghost_remove(&a->b2, hash)) {
+        size_t delta = (b1 > b2 && b2 > 0) ? entry->size * (b1 / b2) : entry->size;
+        a->p = (a->p > delta) ? a->p - delta : 0;
+        list_push_front(shard, entry, ARC_T2);
+    } else {
+        list_push_front(shard, entry, ARC_T1);
+    }
+    return true;
+}
+
+/*
+arc_victim - Evict from T1 while it exceeds p, otherwise from T2; the
+victim's key goes to the matching ghost list
+*/
+static cache_entry_t *arc_victim(cache_shard_t *shard, cache_entry_t *protect) {
+    arc_state_t *a = shard->policy_data;
+    cache_entry_t *t1 = tail_except(shard, ARC_T1, protect);
+    cache_entry_t *t2 = tail_except(shard, ARC_T2, protect);
+
+    if (t1 != NULL && (shard->segments[ARC_T1].bytes > a->p || t2 == NULL)) {
+        ghost_add(&a->b1, entry_hash(t1), t1->size);
+        return t1;
+    }
+    if (t2 != NULL) {
+        ghost_add(&a->b2, entry_hash(t2), t2->size);
+    }
+    return t2;
+}
+
+static const cache_policy_ops_t arc_ops = {
+    .name = "ARC",
+    .read_locked_hits = false,
+    .init = arc_init,
+    .destroy = arc_destroy,
+    .clear = arc_clear,
+    .on_access = NULL,
+    .on_hit = arc_on_hit,
+    .on_insert = arc_on_insert,
+    .on_remove = list_remove,
+    .on_restore = NULL,
+    .victim = arc_victim,
+};
+
+/* ============================================================================
+2Q
+============================================================================ */
+
+#define TWOQ_A1IN   0               /* First-time keys (FIFO) */
+#define TWOQ_AM     1               /* Keys that came back (LRU) */
+
+typedef struct {
+    ghost_t a1out;                  /* Evicted from A1in */
+    size_t in_max;                  /* A1in budget (bytes) */
+} twoq_state_t;
+
+static bool twoq_init(cache_shard_t *shard) {
+    twoq_state_t *q = calloc(1, sizeof(twoq_state_t));
+    if (q == NULL) {
+        return false;
+    }
+    shard->policy_data = q;
+    q->in_max = shard->max_size * TWOQ_IN_PERCENT / 100;
+    return ghost_init(&q->a1out, shard->max_size * TWOQ_OUT_PERCENT / 100);
+}
+
+static void twoq_destroy(cache_shard_t *shard) {
+    twoq_state_t *q = shard->policy_data;
+    if (q != NULL) {
+        ghost_free(&q->a1out);
+        free(q);
+    }
+}
+
+static void twoq_clear(cache_shard_t *shard) {
+    twoq_state_t *q = shard->policy_data;
+    ghost_clear(&q->a1out);
+}
+
+/*
+twoq_on_hit - Only Am is reordered; A1in stays FIFO so a burst of hits
+right after insertion does not make a key look popular
+*/
+static void twoq_on_hit(cache_shard_t *shard, cache_entry_t *entry) {
+    if (entry->segment == TWOQ_AM) {
+        list_move_front(shard, entry, TWOQ_AM);
+    }
+}
+
+static bool twoq_on_insert(cache_shard_t *shard, cache_entry_t *entry, unsigned long hash) {
+    twoq_state_t *q = shard->policy_data;
+    bool returning = ghost_remove(&q->a1out, hash);
+    list_push_front(shard, entry, returning ? TWOQ_AM : TWOQ_A1IN);
+    return true;
+}
+
+static cache_entry_t *twoq_victim(cache_shard_t *shard, cache_entry_t *protect) {
+    twoq_state_t *q = shard->policy_data;
+    cache_entry_t *in = tail_except(shard, TWOQ_A1IN, protect);
+    cache_entry_t *am = tail_except(shard, TWOQ_AM, protect);
+
+    if (in != NULL && (shard->segments[TWOQ_A1IN].bytes > q->in_max || am == NULL)) {
+        ghost_add(&q->a1out, entry_hash(in), in->size);
+        return in;
+    }
+    return am;
+}
+
+static const cache_policy_ops_t twoq_ops = {
+    .name = "2Q",
+    .read_locked_hits = false,
+    .init = twoq_init,
+    .destroy = twoq_destroy,
+    .clear = twoq_clear,
+    .on_access = NULL,
+    .on_hit = twoq_on_hit,
+    .on_insert = twoq_on_insert,
+    .on_remove = list_remove,
+    .on_restore = NULL,
+    .victim = twoq_victim,
+};
+
+/* ============================================================================
+S3-FIFO
+============================================================================ */
+
+#define S3_SMALL    0               /* New keys (FIFO) */
+#define S3_MAIN     1               /* Keys hit while in small (FIFO + reinsertion) */
+
+typedef struct {
+    ghost_t ghost;                  /* Evicted from small without a hit */
+    size_t small_max;               /* Small FIFO budget (bytes) */
+} s3fifo_state_t;
+
+static bool s3fifo_init(cache_shard_t *shard) {
+    s3fifo_state_t *s = calloc(1, sizeof(s3fifo_state_t));
+    if (s == NULL) {
+        return false;
+    }
+    shard->policy_data = s;
+    s->small_max = shard->max_size * S3FIFO_SMALL_PERCENT / 100;
+    return ghost_init(&s->ghost, shard->max_size - s->small_max);
+}
+
+static void s3fifo_destroy(cache_shard_t *shard) {
+    s3fifo_state_t *s = shard->policy_data;
+    if (s != NULL) {
+        ghost_free(&s->ghost);
+        free(s);
+    }
+}
+
+static void s3fifo_clear(cache_shard_t *shard) {
+    s3fifo_state_t *s = shard->policy_data;
+    ghost_clear(&s->ghost);
+}
+
+/*
+s3fifo_on_hit - Saturating increment; safe under the read lock
+*/
+static void s3fifo_on_hit(cache_shard_t *shard, cache_entry_t *entry) {
+    (void)shard;
+    uint8_t freq = __atomic_load_n(&entry->freq, __ATOMIC_RELAXED);
+    while (freq < S3FIFO_MAX_FREQ &&
+           !__atomic_compare_exchange_n(&entry->freq, &freq, freq + 1, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static bool s3fifo_on_insert(cache_shard_t *shard, cache_entry_t *entry, unsigned long hash) {
+    s3fifo_state_t *s = shard->policy_data;
+    entry->freq = 0;
+    list_push_front(shard, entry, ghost_remove(&s->ghost, hash) ? S3_MAIN : S3_SMALL);
+    return true;
+}
+
+/*
+s3fifo_victim - Quick demotion from small, lazy promotion in main
+
+Small's oldest key moves to main if it was hit, else it is evicted (and
+remembered in the ghost). Main's oldest key is reinserted with one less
+hit while it has any, else evicted. Each step either evicts or spends a
+hit, so the loop ends.
+*/
+static cache_entry_t *s3fifo_victim(cache_shard_t *shard, cache_entry_t *protect) {
+    s3fifo_state_t *s = shard->policy_data;
+
+    for (;;) {
+        cache_entry_t *small = tail_except(shard, S3_SMALL, protect);
+        cache_entry_t *main = tail_except(shard, S3_MAIN, protect);
+
+        if (small != NULL && (shard->segments[S3_SMALL].bytes > s->small_max || main == NULL)) {
+            if (__atomic_exchange_n(&small->freq, 0, __ATOMIC_RELAXED) > 0) {
+                list_move_front(shard, small, S3_MAIN);
+                continue;
+            }
+            ghost_add(&s->ghost, entry_hash(small), small->size);
+            return small;
+        }
+        if (main == NULL) {
+            return NULL;
+        }
+
+        uint8_t freq = __atomic_load_n(&main->freq, __ATOMIC_RELAXED);
+        if (freq > 0) {
+            __atomic_store_n(&main->freq, freq - 1, __ATOMIC_RELAXED);
+            list_move_front(shard, main, S3_MAIN);
+            continue;
+        }
+        return main;
+    }
+}
+
+static const cache_policy_ops_t s3fifo_ops = {
+    .name = "S3FIFO",
+    .read_locked_hits = true,
+    .init = s3fifo_init,
+    .destroy = s3fifo_destroy,
+    .clear = s3fifo_clear,
+    .on_access = NULL,
+    .on_hit = s3fifo_on_hit,
+    .on_insert = s3fifo_on_insert,
+    .on_remove = list_remove,
+    .on_restore = NULL,
+    .victim = s3fifo_victim,
+};
+
+/* ============================================================================
+GDSF
+============================================================================ */
+
+/*
+GreedyDual-Size-Frequency. Each entry's priority is L + hits * cost /
+size, kept in a binary min-heap (entry->clock_index is the heap slot);
+the root is the victim and L becomes its priority, so the priorities of
+entries that are no longer hit fall behind the new ones. The LRU list
+only keeps recency order for iteration (snapshots).
+*/
+typedef struct {
+    double priority;
+    cache_entry_t *entry;
+} gdsf_node_t;
+
+typedef struct {
+    gdsf_node_t *heap;
+    int size;                       /* Slots in use */
+    int cap;                        /* Slots allocated */
+    double inflation;               /* L: priority of the last victim */
+} gdsf_state_t;
+
+static bool gdsf_init(cache_shard_t *shard) {
+    shard->policy_data = calloc(1, sizeof(gdsf_state_t));
+    return shard->policy_data != NULL;
+}
+
+static void gdsf_destroy(cache_shard_t *shard) {
+    gdsf_state_t *g = shard->policy_data;
+    if (g != NULL) {
+        free(g->heap);
+        free(g);
+    }
+}
+
+static void gdsf_clear(cache_shard_t *shard) {
+    gdsf_state_t *g = shard->policy_data;
+    g->size = 0;
+    g->inflation = 0;
+}
+
+/*
+gdsf_priority - L + hits * cost / size for an entry
+*/
+static double gdsf_priority(const cache_shard_t *shard, const gdsf_state_t *g,
+                            const cache_entry_t *entry) {
+    double cost = cache_entry_cold(shard, entry)->cost;
+    return g->inflation + entry->freq * cost / (entry->size > 0 ? entry->size : 1);
+}
+
+static void gdsf_place(gdsf_state_t *g, int i, gdsf_node_t node) {
+    g->heap[i] = node;
+    node.entry->clock_index = i;
+}
+
+/*
+gdsf_sift - Restore heap order around slot i after its priority changed
+*/
+static void gdsf_sift(gdsf_state_t *g, int i) {
+    gdsf_node_t node = g->heap[i];
+    while (i > 0 && g->heap[(i - 1) / 2].priority > node.priority) {
+        gdsf_place(g, i, g->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= g->size) {
+            break;
+        }
+        if (child + 1 < g->size && g->heap[child + 1].priority < g->heap[child].priority) {
+            child++;
+        }
+        if (g->heap[child].priority >= node.priority) {
+            break;
+        }
+        gdsf_place(g, i, g->heap[child]);
+        i = child;
+    }
+    gdsf_place(g, i, node);
+}
+
+static void gdsf_on_hit(cache_shard_t *shard, cache_entry_t *entry) {
+    gdsf_state_t *g = shard->policy_data;
+    if (entry->freq < GDSF_MAX_FREQ) {
+        entry->freq++;
+    }
+    g->heap[entry->clock_index].priority = gdsf_priority(shard, g, entry);
+    gdsf_sift(g, entry->clock_index);
+    list_move_front(shard, entry, LRU_LIST);
+}
+
+static bool gdsf_on_insert(cache_shard_t *shard, cache_entry_t *entry, unsigned long hash) {
+    gdsf_state_t *g = shard->policy_data;
+    (void)hash;
+
+    if (g->size == g->cap) {
+        int cap = g->cap > 0 ? g->cap * 2 : GDSF_INITIAL_SLOTS;
+        gdsf_node_t *heap = realloc(g->heap, cap * sizeof(gdsf_node_t));
+        if (heap == NULL) {
+            return false;
+        }
+        g->heap = heap;
+        g->cap = cap;
+    }
+    entry->freq = 1;
+    gdsf_node_t node = { gdsf_priority(shard, g, entry), entry };
+    gdsf_place(g, g->size++, node);
+    gdsf_sift(g, g->size - 1);
+    list_push_front(shard, entry, LRU_LIST);
+    return true;
+}
+
+/*
+gdsf_on_restore - Re-key a restored entry by its saved hit count
+*/
+static void gdsf_on_restore(cache_shard_t *shard, cache_entry_t *entry, uint8_t freq) {
+    gdsf_state_t *g = shard->policy_data;
+    entry->freq = freq < GDSF_MAX_FREQ ? freq : GDSF_MAX_FREQ;
+    g->heap[entry->clock_index].priority = gdsf_priority(shard, g, entry);
+    gdsf_sift(g, entry->clock_index);
+}
+
+/*
+gdsf_on_remove - Take an entry out of the heap
+
+The last slot moves into the hole and is sifted from there.
+*/
+static void gdsf_on_remove(cache_shard_t *shard, cache_entry_t *entry) {
+    gdsf_state_t *g = shard->policy_data;
+    int i = entry->clock_index;
+    gdsf_node_t last = g->heap[--g->size];
+    if (i < g->size) {
+        gdsf_place(g, i, last);
+        gdsf_sift(g, i);
+    }
+    list_remove(shard, entry);
+}
+
+/*
+gdsf_victim - Lowest priority; if that is protect, the lower of its children
+*/
+static cache_entry_t *gdsf_victim(cache_shard_t *shard, cache_entry_t *protect) {
+    gdsf_state_t *g = shard->policy_data;
+    int i = 0;
+    if (g->size > 0 && g->heap[0].entry == protect) {
+        i = (g->size > 2 && g->heap[2].priority < g->heap[1].priority) ? 2 : 1;
+    }
+    if (i >= g->size) {
+        return NULL;
+    }
+    g->inflation = g->heap[i].priority;
+    return g->heap[i].entry;
+}
+
+static const cache_policy_ops_t gdsf_ops = {
+    .name = "GDSF",
+    .read_locked_hits = false,
+    .init = gdsf_init,
+    .destroy = gdsf_destroy,
+    .clear = gdsf_clear,
+    .on_access = NULL,
+    .on_hit = gdsf_on_hit,
+    .on_insert = gdsf_on_insert,
+    .on_remove = gdsf_on_remove,
+    .on_restore = gdsf_on_restore,
+    .victim = gdsf_victim,
+};
+
+/* ============================================================================
+Policy Registry
+============================================================================ */
+
+static const cache_policy_ops_t *const POLICIES[CACHE_POLICY_COUNT] = {
+    [CACHE_POLICY_LRU] = &lru_ops,
+    [CACHE_POLICY_CLOCK] = &clock_ops,
+    [CACHE_POLICY_TINYLFU] = &tinylfu_ops,
+    [CACHE_POLICY_ARC] = &arc_ops,
+    [CACHE_POLICY_2Q] = &twoq_ops,
+    [CACHE_POLICY_S3FIFO] = &s3fifo_ops,
+    [CACHE_POLICY_GDSF] = &gdsf_ops,
+};
+
+/*
+cache_policy_ops - Operations implementing a policy
+*/
+const cache_policy_ops_t *cache_policy_ops(cache_policy_t policy) {
+    if ((unsigned)policy >= CACHE_POLICY_COUNT) {
+        return NULL;
+    }
+    return POLICIES[policy];
+}
+
+/*
+cache_policy_name - Printable name of a policy
+*/
+const char *cache_policy_name(cache_policy_t policy) {
+    const cache_policy_ops_t *ops = cache_policy_ops(policy);
+    return ops != NULL ? ops->name : "UNKNOWN";
+}
+
+/*
+cache_policy_parse - Look up a policy by name (case-insensitive)
+*/
+bool cache_policy_parse(const char *name, cache_policy_t *policy) {
+    for (int i = 0; i < CACHE_POLICY_COUNT; i++) {
+        if (strcasecmp(name, POLICIES[i]->name) == 0) {
+            *policy = (cache_policy_t)i;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,724 @@
+/*
+cache_sim.c - Trace-Driven Cache Simulator
+
+Replays a request trace through cache.c for a grid of cache sizes and
+replacement policies, and reports what each configuration would have
+achieved. Sweeping the size gives the miss-ratio curve used to choose
+DEFAULT_CACHE_SIZE and the proxy's -p policy.
+
+Features:
+- Trace files: one request per line, "path size [timestamp]"; '#'
+  starts a comment. Paths are interned once, so replay does no parsing
+- Synthetic traces: Zipf popularity (-z), a cyclic scan (-s), or a mix
+  of both (scan-resistance); -w writes them out in the trace format
+- Every request goes through the real cache: a lookup pins the entry
+  (cache_acquire, no copy) and a miss puts the object's size
+  (cache_put_sized, no payload). A hit on an entry of another size
+  counts as a miss and replaces it, like a file that changed
+- Reports hit ratio, byte hit ratio, evictions and replay speed for
+  each (policy, size); -j replays configurations on several threads
+- Reproducible: the hash seed picks each key's shard and whether the
+  miss-ratio estimator samples it, so it is fixed (FAST_HASH_SEED, 1
+  unless set) rather than drawn per process, and printed
+
+Usage: ./cache_sim [options] [trace_file]
+*/
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/cache.h"
+#include "../include/cache_sim.h"
+#include "../include/fast_hash.h"
+
+/* ============================================================================
+Configuration
+============================================================================ */
+
+#define DEFAULT_REQUESTS        1000000
+#define DEFAULT_OBJECT_SIZE     (16 * 1024)
+#define DEFAULT_ZIPF_ALPHA      0.9
+#define DEFAULT_SCAN_FRACTION   0.2     /* Share of scan requests when mixed */
+#define DEFAULT_SIZES           "1M,4M,16M,64M"
+#define DEFAULT_HASH_SEED       "1"     /* FAST_HASH_SEED when unset */
+#define MAX_CONFIGS             256
+#define MIN_OBJECT_SIZE         64
+#define SYNTHETIC_RATE          1000.0  /* Generated requests per second */
+
+/* ============================================================================
+Trace
+============================================================================ */
+
+/* One request: an interned path and the object's size at that time */
+typedef struct {
+    uint32_t key;
+    uint32_t size;
+} sim_request_t;
+
+typedef struct {
+    sim_request_t *requests;
+    size_t num_requests;
+    size_t req_capacity;
+
+    char **keys;                    /* Interned paths, by id */
+    uint32_t num_keys;
+    uint32_t key_capacity;
+
+    /* Path -> id + 1 (0 = empty), open addressing */
+    uint32_t *slots;
+    uint32_t slot_mask;
+
+    double first_ts, last_ts;       /* Timestamps seen, if any */
+    bool has_ts;
+    uint64_t requested_bytes;
+    size_t skipped;                 /* Malformed lines */
+} sim_trace_t;
+
+/* A configuration and what its replay measured */
+typedef struct {
+    cache_policy_t policy;
+    size_t max_size;
+    unsigned long hits;
+    uint64_t hit_bytes;
+    unsigned long evictions;
+    unsigned long rejected;         /* Puts the cache refused (too large) */
+    double seconds;
+    bool failed;                    /* The cache could not be created */
+} sim_config_t;
+
+static int num_shards = 0;
+
+/* ============================================================================
+Helper Functions
+============================================================================ */
+
+/*
+xorshift64 - Next value of a 64-bit xorshift generator
+*/
+static uint64_t xorshift64(uint64_t *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+    return *x;
+}
+
+static double uniform(uint64_t *x) {
+    return (double)(xorshift64(x) >> 11) / 9007199254740992.0;
+}
+
+/*
+parse_size - Parse a byte count with an optional K/M/G suffix
+
+Returns: The count, or 0 if the text is not one.
+*/
+static size_t parse_size(const char *text) {
+    char *end;
+    double value = strtod(text, &end);
+    switch (*end) {
+    case 'k': case 'K': value *= 1024; end++; break;
+    case 'm': case 'M': value *= 1024 * 1024; end++; break;
+    case 'g': case 'G': value *= 1024.0 * 1024 * 1024; end++; break;
+    default: break;
+    }
+    if (end == text || (*end != '\0' && *end != ',' && *end != ':') || value < 1) {
+        return 0;
+    }
+    return (size_t)value;
+}
+
+static void format_size(char *buf, size_t len, double bytes) {
+    const char *units[] = { "B", "KB", "MB", "GB", "TB" };
+    int u = 0;
+    while (bytes >= 1024 && u < 4) {
+        bytes /= 1024;
+        u++;
+    }
+    snprintf(buf, len, "%.1f %s", bytes, units[u]);
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+trace_intern - Id of a path, added on first sight
+
+Returns: The id, or UINT32_MAX if out of memory.
+*/
+static uint32_t trace_intern(sim_trace_t *t, const char *path, size_t len) {
+    if ((size_t)t->num_keys * 2 >= (size_t)t->slot_mask + 1) {
+        uint32_t capacity = (t->slot_mask + 1) * 2;
+        uint32_t *slots = calloc(capacity, sizeof(uint32_t));
+        if (slots == NULL) {
+            return UINT32_MAX;
+        }
+        for (uint32_t i = 0; i <= t->slot_mask; i++) {
+            if (t->slots[i] != 0) {
+                const char *key = t->keys[t->slots[i] - 1];
+                uint32_t s = (uint32_t)fast_hash(key, strlen(key), 0) & (capacity - 1);
+                while (slots[s] != 0) {
+                    s = (s + 1) & (capacity - 1);
+                }
+                slots[s] = t->slots[i];
+            }
+        }
+        free(t->slots);
+        t->slots = slots;
+        t->slot_mask = capacity - 1;
+    }
+
+    uint32_t s = (uint32_t)fast_hash(path, len, 0) & t->slot_mask;
+    while (t->slots[s] != 0) {
+        const char *key = t->keys[t->slots[s] - 1];
+        if (strncmp(key, path, len) == 0 && key[len] == '\0') {
+            return t->slots[s] - 1;
+        }
+        s = (s + 1) & t->slot_mask;
+    }
+
+    if (t->num_keys == t->key_capacity) {
+        uint32_t capacity = t->key_capacity > 0 ? t->key_capacity * 2 : 1024;
+        char **keys = realloc(t->keys, capacity * sizeof(char *));
+        if (keys == NULL) {
+            return UINT32_MAX;
+        }
+        t->keys = keys;
+        t->key_capacity = capacity;
+    }
+    char *key = strndup(path, len);
+    if (key == NULL) {
+        return UINT32_MAX;
+    }
+    t->keys[t->num_keys] = key;
+    t->slots[s] = ++t->num_keys;
+    return t->num_keys - 1;
+}
+
+/*
+trace_add - Append a request
+
+Returns: true on success, false if out of memory.
+*/
+static bool trace_add(sim_trace_t *t, uint32_t key, uint32_t size) {
+    if (t->num_requests == t->req_capacity) {
+        size_t capacity = t->req_capacity > 0 ? t->req_capacity * 2 : 65536;
+        sim_request_t *requests = realloc(t->requests, capacity * sizeof(sim_request_t));
+        if (requests == NULL) {
+            return false;
+        }
+        t->requests = requests;
+        t->req_capacity = capacity;
+    }
+    t->requests[t->num_requests++] = (sim_request_t){ key, size };
+    t->requested_bytes += size;
+    return true;
+}
+
+static bool trace_init(sim_trace_t *t) {
+    memset(t, 0, sizeof(*t));
+    t->slots = calloc(1024, sizeof(uint32_t));
+    t->slot_mask = 1023;
+    return t->slots != NULL;
+}
+
+static void trace_free(sim_trace_t *t) {
+    for (uint32_t i = 0; i < t->num_keys; i++) {
+        free(t->keys[i]);
+    }
+    free(t->keys);
+    free(t->slots);
+    free(t->requests);
+}
+
+/* ============================================================================
+Trace Sources
+============================================================================ */
+
+/*
+trace_load - Read a trace file ("path size [timestamp]" per line)
+
+Returns: 0 on success, -1 on error.
+*/
+static int trace_load(sim_trace_t *t, const char *filename) {
+    FILE *fp = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
+    if (fp == NULL) {
+        perror(filename);
+        return -1;
+    }
+
+    char line[MAX_KEY_LEN + 128];
+    int rc = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char *p = line;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == '#' || *p == '\n' || *p == '\0') {
+            continue;
+        }
+        char *path = p;
+        while (*p != ' ' && *p != '\t' && *p != '\n' && *p != '\0') {
+            p++;
+        }
+        size_t path_len = (size_t)(p - path);
+        char *end;
+        unsigned long long size = strtoull(p, &end, 10);
+        if (end == p || path_len >= MAX_KEY_LEN || size == 0 || size > UINT32_MAX) {
+            t->skipped++;
+            continue;
+        }
+        p = end;
+        double ts = strtod(p, &end);
+        if (end != p) {
+            if (!t->has_ts) {
+                t->first_ts = ts;
+                t->has_ts = true;
+            }
+            t->last_ts = ts;
+        }
+
+        uint32_t key = trace_intern(t, path, path_len);
+        if (key == UINT32_MAX || !trace_add(t, key, (uint32_t)size)) {
+            fprintf(stderr, "Out of memory after %zu requests\n", t->num_requests);
+            rc = -1;
+            break;
+        }
+    }
+
+    if (fp != stdin) {
+        fclose(fp);
+    }
+    return rc;
+}
+
+/*
+object_size - Size of synthetic object i
+
+Log-normal around mean (sigma 1): mostly small files and a long tail of
+large ones, fixed per object.
+*/
+static uint32_t object_size(uint32_t i, size_t mean) {
+    uint64_t x = 0x9E3779B97F4A7C15ULL * (i + 1);
+    xorshift64(&x);
+    double u1 = uniform(&x), u2 = uniform(&x);
+    double normal = sqrt(-2.0 * log(u1 + 1e-300)) * cos(2 * M_PI * u2);
+    double size = (double)mean * exp(normal - 0.5);
+    if (size < MIN_OBJECT_SIZE) {
+        size = MIN_OBJECT_SIZE;
+    }
+    if (size > 64.0 * mean) {
+        size = 64.0 * mean;
+    }
+    return (uint32_t)size;
+}
+
+/*
+trace_generate - Build a synthetic trace
+
+zipf_keys objects requested with Zipf(alpha) popularity, scan_keys
+objects requested in order and over again, or both: each request is a
+scan request with probability scan_fraction.
+
+Returns: 0 on success, -1 on error.
+*/
+static int trace_generate(sim_trace_t *t, uint32_t zipf_keys, double alpha,
+                          uint32_t scan_keys, double scan_fraction, size_t count,
+                          size_t mean_size) {
+    char path[64];
+    uint32_t zipf_base = t->num_keys;
+    for (uint32_t i = 0; i < zipf_keys; i++) {
+        int len = snprintf(path, sizeof(path), "/sim/zipf/%u", i);
+        if (trace_intern(t, path, (size_t)len) == UINT32_MAX) {
+            return -1;
+        }
+    }
+    uint32_t scan_base = t->num_keys;
+    for (uint32_t i = 0; i < scan_keys; i++) {
+        int len = snprintf(path, sizeof(path), "/sim/scan/%u", i);
+        if (trace_intern(t, path, (size_t)len) == UINT32_MAX) {
+            return -1;
+        }
+    }
+
+    double *cdf = NULL;
+    if (zipf_keys > 0) {
+        cdf = malloc(zipf_keys * sizeof(double));
+        if (cdf == NULL) {
+            return -1;
+        }
+        double sum = 0.0;
+        for (uint32_t i = 0; i < zipf_keys; i++) {
+            sum += 1.0 / pow(i + 1, alpha);
+            cdf[i] = sum;
+        }
+        for (uint32_t i = 0; i < zipf_keys; i++) {
+            cdf[i] /= sum;
+        }
+    }
+    if (zipf_keys == 0) {
+        scan_fraction = 1.0;
+    } else if (scan_keys == 0) {
+        scan_fraction = 0.0;
+    }
+
+    uint64_t x = 88172645463325252ULL;
+    uint32_t scan_pos = 0;
+    for (size_t n = 0; n < count; n++) {
+        uint32_t key;
+        if (uniform(&x) < scan_fraction) {
+            key = scan_base + scan_pos;
+            scan_pos = (scan_pos + 1) % scan_keys;
+        } else {
+            double u = uniform(&x);
+            uint32_t lo = 0, hi = zipf_keys - 1;
+            while (lo < hi) {
+                uint32_t mid = lo + (hi - lo) / 2;
+                if (cdf[mid] < u) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            key = zipf_base + lo;
+        }
+        if (!trace_add(t, key, object_size(key, mean_size))) {
+            free(cdf);
+            return -1;
+        }
+    }
+    free(cdf);
+
+    t->has_ts = true;
+    t->first_ts = 0;
+    t->last_ts = (count - 1) / SYNTHETIC_RATE;
+    return 0;
+}
+
+/*
+trace_write - Print a trace in the file format
+*/
+static void trace_write(const sim_trace_t *t, FILE *out) {
+    for (size_t n = 0; n < t->num_requests; n++) {
+        fprintf(out, "%s %u %.3f\n", t->keys[t->requests[n].key], t->requests[n].size,
+                n / SYNTHETIC_RATE);
+    }
+}
+
+/* ============================================================================
+Replay
+============================================================================ */
+
+/*
+replay - Run a trace through one cache configuration
+
+Misses put with cache_put_sized(): entries are charged and evicted as
+real payloads, but no bytes are copied, so a replay costs the cache's
+bookkeeping and not the memory bandwidth of the traffic.
+*/
+static void replay(const sim_trace_t *t, sim_config_t *config) {
+    cache_t *cache = cache_create_with_policy(config->max_size, num_shards, config->policy);
+    if (cache == NULL) {
+        fprintf(stderr, "Cannot create a %zu-byte %s cache\n", config->max_size,
+                cache_policy_name(config->policy));
+        config->failed = true;
+        return;
+    }
+
+    size_t shard_budget = cache->shards[0].max_size;
+    double start = now_sec();
+    unsigned long hits = 0, rejected = 0;
+    uint64_t hit_bytes = 0;
+    for (size_t n = 0; n < t->num_requests; n++) {
+        const sim_request_t *r = &t->requests[n];
+        const char *key = t->keys[r->key];
+        cache_handle_t handle;
+        if (cache_acquire(cache, key, &handle)) {
+            bool same = handle.size == r->size;
+            cache_release(&handle);
+            if (same) {
+                hits++;
+                hit_bytes += r->size;
+                continue;
+            }
+        }
+        /* Objects above a shard's budget are refused; skip the error message */
+        if (cache_entry_charge(key, r->size) > shard_budget ||
+            !cache_put_sized(cache, key, r->size)) {
+            rejected++;
+        }
+    }
+    config->seconds = now_sec() - start;
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    config->hits = hits;
+    config->hit_bytes = hit_bytes;
+    config->evictions = stats.evictions;
+    config->rejected = rejected;
+    cache_destroy(cache);
+}
+
+typedef struct {
+    const sim_trace_t *trace;
+    sim_config_t *configs;
+    int num_configs;
+    int next;                       /* Next configuration to claim (atomic) */
+} sim_jobs_t;
+
+static void *replay_worker(void *arg) {
+    sim_jobs_t *jobs = arg;
+    int i;
+    while ((i = __atomic_fetch_add(&jobs->next, 1, __ATOMIC_RELAXED)) < jobs->num_configs) {
+        replay(jobs->trace, &jobs->configs[i]);
+    }
+    return NULL;
+}
+
+/* ============================================================================
+Main Entry Point
+============================================================================ */
+
+static void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [options] [trace_file]\n", prog);
+    fprintf(stderr, "\nTrace (a file, '-' for stdin, or synthetic):\n");
+    fprintf(stderr, "  trace_file:  lines of \"path size [timestamp]\"\n");
+    fprintf(stderr, "  -z keys:     Zipf popularity over this many objects\n");
+    fprintf(stderr, "  -a alpha:    Zipf skew (default %.1f)\n", DEFAULT_ZIPF_ALPHA);
+    fprintf(stderr, "  -s keys:     cyclic scan over this many objects\n");
+    fprintf(stderr, "  -f fraction: share of scan requests when both -z and -s are given "
+                    "(default %.1f)\n", DEFAULT_SCAN_FRACTION);
+    fprintf(stderr, "  -r count:    requests to generate (default %d)\n", DEFAULT_REQUESTS);
+    fprintf(stderr, "  -b bytes:    mean object size, log-normal (default %dK)\n",
+            DEFAULT_OBJECT_SIZE / 1024);
+    fprintf(stderr, "  -w:          write the trace to stdout instead of replaying it\n");
+    fprintf(stderr, "\nConfigurations (every policy x every size):\n");
+    fprintf(stderr, "  -c sizes:    cache sizes, comma-separated, K/M/G suffixes; lo:hi doubles\n"
+                    "               from lo to hi (default %s)\n", DEFAULT_SIZES);
+    fprintf(stderr, "  -p policies: comma-separated: lru, clock, tinylfu, arc, 2q, s3fifo, gdsf,\n"
+                    "               or all (default lru)\n");
+    fprintf(stderr, "  -n shards:   shards per cache (default: as cache_create)\n");
+    fprintf(stderr, "  -j threads:  configurations replayed in parallel (default 1)\n");
+    fprintf(stderr, "\nFAST_HASH_SEED picks the hash seed (default %s), so runs repeat.\n",
+            DEFAULT_HASH_SEED);
+}
+
+/*
+parse_sizes - Parse the -c list into sizes
+
+Returns: Number of sizes, or -1 on a bad list.
+*/
+static int parse_sizes(const char *text, size_t *sizes, int max) {
+    int n = 0;
+    const char *p = text;
+    while (*p != '\0') {
+        size_t lo = parse_size(p);
+        if (lo == 0) {
+            return -1;
+        }
+        p += strcspn(p, ",:");
+        if (*p == ':') {
+            size_t hi = parse_size(++p);
+            if (hi < lo) {
+                return -1;
+            }
+            p += strcspn(p, ",");
+            for (size_t s = lo; s <= hi && n < max; s *= 2) {
+                sizes[n++] = s;
+            }
+        } else if (n < max) {
+            sizes[n++] = lo;
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return n;
+}
+
+/*
+parse_policies - Parse the -p list
+
+Returns: Number of policies, or -1 on an unknown name.
+*/
+static int parse_policies(const char *text, cache_policy_t *policies) {
+    if (strcasecmp(text, "all") == 0) {
+        for (int i = 0; i < CACHE_POLICY_COUNT; i++) {
+            policies[i] = (cache_policy_t)i;
+        }
+        return CACHE_POLICY_COUNT;
+    }
+    char copy[256];
+    strncpy(copy, text, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+    int n = 0;
+    for (char *save, *name = strtok_r(copy, ",", &save); name != NULL;
+         name = strtok_r(NULL, ",", &save)) {
+        if (n == CACHE_POLICY_COUNT || !cache_policy_parse(name, &policies[n])) {
+            fprintf(stderr, "Unknown cache policy: %s\n", name);
+            return -1;
+        }
+        n++;
+    }
+    return n;
+}
+
+int main(int argc, char *argv[]) {
+    /* Before the first hash: shard choice and sampling follow the seed */
+    setenv("FAST_HASH_SEED", DEFAULT_HASH_SEED, 0);
+
+    const char *prog = argv[0];
+    uint32_t zipf_keys = 0, scan_keys = 0;
+    double alpha = DEFAULT_ZIPF_ALPHA;
+    double scan_fraction = DEFAULT_SCAN_FRACTION;
+    size_t count = DEFAULT_REQUESTS;
+    size_t mean_size = DEFAULT_OBJECT_SIZE;
+    const char *size_list = DEFAULT_SIZES;
+    const char *policy_list = "lru";
+    int threads = 1;
+    bool write_trace = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "z:a:s:f:r:b:wc:p:n:j:")) != -1) {
+        switch (opt) {
+        case 'z': zipf_keys = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'a': alpha = atof(optarg); break;
+        case 's': scan_keys = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'f': scan_fraction = atof(optarg); break;
+        case 'r': count = parse_size(optarg); break;
+        case 'b': mean_size = parse_size(optarg); break;
+        case 'w': write_trace = true; break;
+        case 'c': size_list = optarg; break;
+        case 'p': policy_list = optarg; break;
+        case 'n': num_shards = atoi(optarg); break;
+        case 'j': threads = atoi(optarg); break;
+        default:
+            print_usage(prog);
+            return 1;
+        }
+    }
+    const char *trace_file = optind < argc ? argv[optind] : NULL;
+    if ((trace_file == NULL) == (zipf_keys == 0 && scan_keys == 0) || count == 0 ||
+        mean_size == 0 || alpha <= 0 || scan_fraction < 0 || scan_fraction > 1 ||
+        threads < 1 || num_shards < 0 || num_shards > CACHE_MAX_SHARDS) {
+        print_usage(prog);
+        return 1;
+    }
+
+    size_t sizes[MAX_CONFIGS];
+    cache_policy_t policies[CACHE_POLICY_COUNT];
+    int num_sizes = parse_sizes(size_list, sizes, MAX_CONFIGS);
+    int num_policies = parse_policies(policy_list, policies);
+    if (num_sizes <= 0 || num_policies <= 0) {
+        if (num_sizes <= 0) {
+            fprintf(stderr, "Invalid cache sizes: %s\n", size_list);
+        }
+        return 1;
+    }
+
+    sim_trace_t trace;
+    if (!trace_init(&trace)) {
+        perror("trace");
+        return 1;
+    }
+    double start = now_sec();
+    int rc = trace_file != NULL ? trace_load(&trace, trace_file)
+                                : trace_generate(&trace, zipf_keys, alpha, scan_keys,
+                                                 scan_fraction, count, mean_size);
+    if (rc < 0 || trace.num_requests == 0) {
+        fprintf(stderr, "No requests to replay\n");
+        trace_free(&trace);
+        return 1;
+    }
+    if (write_trace) {
+        trace_write(&trace, stdout);
+        trace_free(&trace);
+        return 0;
+    }
+
+    uint64_t unique_bytes = 0;
+    uint32_t *seen_size = calloc(trace.num_keys, sizeof(uint32_t));
+    if (seen_size != NULL) {
+        for (size_t n = 0; n < trace.num_requests; n++) {
+            seen_size[trace.requests[n].key] = trace.requests[n].size;
+        }
+        for (uint32_t k = 0; k < trace.num_keys; k++) {
+            unique_bytes += seen_size[k];
+        }
+        free(seen_size);
+    }
+    char unique[32], requested[32];
+    format_size(unique, sizeof(unique), (double)unique_bytes);
+    format_size(requested, sizeof(requested), (double)trace.requested_bytes);
+    printf("Trace: %zu requests, %u objects (%s), %s requested, loaded in %.2f s\n",
+           trace.num_requests, trace.num_keys, unique, requested, now_sec() - start);
+    if (trace.has_ts && trace.last_ts > trace.first_ts) {
+        printf("Span: %.1f s of traffic (%.0f requests/s)\n", trace.last_ts - trace.first_ts,
+               trace.num_requests / (trace.last_ts - trace.first_ts));
+    }
+    if (trace.skipped > 0) {
+        printf("Skipped %zu malformed lines\n", trace.skipped);
+    }
+    printf("Hash seed: %#llx (FAST_HASH_SEED)\n", (unsigned long long)fast_hash_seed());
+
+    int num_configs = 0;
+    sim_config_t *configs = calloc((size_t)num_sizes * num_policies, sizeof(sim_config_t));
+    if (configs == NULL) {
+        perror("calloc configs");
+        trace_free(&trace);
+        return 1;
+    }
+    for (int p = 0; p < num_policies; p++) {
+        for (int s = 0; s < num_sizes; s++) {
+            configs[num_configs].policy = policies[p];
+            configs[num_configs].max_size = sizes[s];
+            num_configs++;
+        }
+    }
+
+    sim_jobs_t jobs = { &trace, configs, num_configs, 0 };
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    int started = 0;
+    for (int i = 0; workers != NULL && i < threads; i++) {
+        if (pthread_create(&workers[i], NULL, replay_worker, &jobs) == 0) {
+            started++;
+        }
+    }
+    if (started == 0) {
+        replay_worker(&jobs);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+
+    printf("\n%-8s %12s %10s %15s %11s %9s %8s\n", "policy", "cache size", "hit ratio",
+           "byte hit ratio", "evictions", "rejected", "Mreq/s");
+    int failed = 0;
+    for (int i = 0; i < num_configs; i++) {
+        sim_config_t *c = &configs[i];
+        char size[32];
+        format_size(size, sizeof(size), (double)c->max_size);
+        if (c->failed) {
+            printf("%-8s %12s %10s\n", cache_policy_name(c->policy), size, "failed");
+            failed++;
+            continue;
+        }
+        printf("%-8s %12s %9.2f%% %14.2f%% %11lu %9lu %8.2f\n",
+               cache_policy_name(c->policy), size,
+               100.0 * c->hits / trace.num_requests,
+               100.0 * c->hit_bytes / trace.requested_bytes, c->evictions, c->rejected,
+               c->seconds > 0 ? trace.num_requests / c->seconds / 1e6 : 0.0);
+    }
+
+    free(configs);
+    trace_free(&trace);
+    return failed > 0 ? 1 : 0;
+}
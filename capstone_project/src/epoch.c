@@ -0,0 +1,235 @@
+/*
+epoch.c - Epoch-Based Reclamation
+
+Deferred frees for data that readers traverse without a lock.
+
+Key concepts:
+- One global epoch counter. A reader copies it into its own record on
+  entry and clears the record on exit; a full fence after the copy
+  orders the announcement before every load of the section
+- Advancing: the epoch goes from e to e + 1 only when no record is in a
+  section started before e. Once it reaches e + 2, every reader active
+  when an object was retired in e has left, so the object can go
+- Records are per thread, padded to a cache line and never freed; a
+  thread that exits gives its record back for the next new thread
+- Retired objects are appended in epoch order, so reclaiming frees a
+  prefix of the list
+
+Used in Part C (Proxy) through cache.c and cache_index.c.
+*/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/epoch.h"
+
+/* Record value outside a read-side section */
+#define EPOCH_IDLE      0
+
+typedef struct epoch_thread {
+    uint64_t epoch;                 /* Epoch entered, EPOCH_IDLE outside (atomic) */
+    unsigned depth;                 /* Nested sections (owner only) */
+    bool in_use;                    /* Claimed by a live thread (atomic) */
+    struct epoch_thread *next;      /* Registry link */
+} __attribute__((aligned(64))) epoch_thread_t;
+
+/* The global epoch, alone on its line: only writers advance it */
+static struct {
+    uint64_t value;
+} __attribute__((aligned(64))) global_epoch = { 1 };
+
+/* Every record ever created; pushed at the head, never removed */
+static epoch_thread_t *registry;
+
+static pthread_key_t self_key;
+static pthread_once_t self_once = PTHREAD_ONCE_INIT;
+
+/* ============================================================================
+Internal Helper Functions
+============================================================================ */
+
+/*
+record_release - A thread exited: its record is free for another (internal)
+*/
+static void record_release(void *arg) {
+    epoch_thread_t *self = arg;
+    __atomic_store_n(&self->epoch, EPOCH_IDLE, __ATOMIC_RELEASE);
+    __atomic_store_n(&self->in_use, false, __ATOMIC_RELEASE);
+}
+
+static void self_key_init(void) {
+    pthread_key_create(&self_key, record_release);
+}
+
+/*
+self_record - The calling thread's record, claimed or created on first
+use (internal)
+
+Returns: The record, or NULL if none could be allocated.
+*/
+static epoch_thread_t *self_record(void) {
+    pthread_once(&self_once, self_key_init);
+    epoch_thread_t *self = pthread_getspecific(self_key);
+    if (self != NULL) {
+        return self;
+    }
+
+    for (self = __atomic_load_n(&registry, __ATOMIC_ACQUIRE); self != NULL; self = self->next) {
+        bool free_record = false;
+        if (__atomic_compare_exchange_n(&self->in_use, &free_record, true, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    if (self == NULL) {
+        self = aligned_alloc(64, sizeof(epoch_thread_t));
+        if (self == NULL) {
+            perror("epoch record alloc");
+            return NULL;
+        }
+        memset(self, 0, sizeof(*self));
+        self->in_use = true;
+        self->next = __atomic_load_n(&registry, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&registry, &self->next, self, true,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        }
+    }
+    self->depth = 0;
+    pthread_setspecific(self_key, self);
+    return self;
+}
+
+/*
+try_advance - Move the global epoch on if every reader has seen it
+(internal)
+
+Returns: The global epoch afterwards.
+*/
+static uint64_t try_advance(void) {
+    uint64_t epoch = __atomic_load_n(&global_epoch.value, __ATOMIC_SEQ_CST);
+    for (epoch_thread_t *t = __atomic_load_n(&registry, __ATOMIC_ACQUIRE); t != NULL;
+         t = t->next) {
+        uint64_t seen = __atomic_load_n(&t->epoch, __ATOMIC_SEQ_CST);
+        if (seen != EPOCH_IDLE && seen != epoch) {
+            return epoch;
+        }
+    }
+    /* A failed exchange means another writer advanced it: just as good */
+    __atomic_compare_exchange_n(&global_epoch.value, &epoch, epoch + 1, false,
+                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&global_epoch.value, __ATOMIC_SEQ_CST);
+}
+
+/*
+wait_readers - Wait until every current reader has left (internal)
+
+Used when a retired object cannot be queued.
+*/
+static void wait_readers(void) {
+    uint64_t target = __atomic_load_n(&global_epoch.value, __ATOMIC_SEQ_CST) + 2;
+    while (try_advance() < target) {
+        sched_yield();
+    }
+}
+
+/* ============================================================================
+Read-Side Sections
+============================================================================ */
+
+/*
+epoch_enter - Start a read-side section
+*/
+bool epoch_enter(void) {
+    epoch_thread_t *self = self_record();
+    if (self == NULL) {
+        return false;
+    }
+    if (self->depth++ == 0) {
+        uint64_t epoch = __atomic_load_n(&global_epoch.value, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&self->epoch, epoch, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+    return true;
+}
+
+/*
+epoch_exit - End a read-side section
+*/
+void epoch_exit(void) {
+    epoch_thread_t *self = pthread_getspecific(self_key);
+    if (self != NULL && --self->depth == 0) {
+        __atomic_store_n(&self->epoch, EPOCH_IDLE, __ATOMIC_RELEASE);
+    }
+}
+
+/* ============================================================================
+Retiring
+============================================================================ */
+
+/*
+epoch_retire - Free an unlinked object once no reader can hold it
+*/
+void epoch_retire(epoch_list_t *list, void (*free_fn)(void *ptr), void *ptr) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity > 0 ? list->capacity * 2 : EPOCH_RECLAIM_BATCH * 4;
+        epoch_retired_t *items = realloc(list->items, capacity * sizeof(epoch_retired_t));
+        if (items == NULL) {
+            wait_readers();
+            free_fn(ptr);
+            list->freed++;
+            return;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+
+    epoch_retired_t *item = &list->items[list->count++];
+    item->ptr = ptr;
+    item->free_fn = free_fn;
+    item->epoch = __atomic_load_n(&global_epoch.value, __ATOMIC_SEQ_CST);
+
+    if (list->count % EPOCH_RECLAIM_BATCH == 0) {
+        epoch_reclaim(list);
+    }
+}
+
+/*
+epoch_reclaim - Free the retired objects no reader can hold any more
+
+Two advances are attempted: with no reader in the way, the whole list
+is then free to go at once.
+*/
+size_t epoch_reclaim(epoch_list_t *list) {
+    if (list->count == 0) {
+        return 0;
+    }
+    try_advance();
+    uint64_t epoch = try_advance();
+
+    size_t done = 0;
+    while (done < list->count && list->items[done].epoch + 2 <= epoch) {
+        list->items[done].free_fn(list->items[done].ptr);
+        done++;
+    }
+    list->count -= done;
+    memmove(list->items, list->items + done, list->count * sizeof(epoch_retired_t));
+    list->freed += done;
+    return done;
+}
+
+/*
+epoch_drain - Free every retired object of a list and the list itself
+*/
+void epoch_drain(epoch_list_t *list) {
+    for (size_t i = 0; i < list->count; i++) {
+        list->items[i].free_fn(list->items[i].ptr);
+    }
+    list->freed += list->count;
+    free(list->items);
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
@@ -0,0 +1,367 @@
+/*
+fast_hash.c - Seeded 64-bit Hashing
+
+wyhash for short inputs, an xxh3-style lane accumulator for long ones.
+
+Key concepts:
+- mum (multiply and fold): the 128-bit product of two 64-bit words,
+  high half XORed into low half. One multiply mixes every input bit
+  into every output bit, where djb2 needs a multiply per byte
+- Short inputs: 16 bytes per step; over 48 bytes, three chains run side
+  by side so their multiplies overlap in the pipeline. Inputs of 16
+  bytes or less are read with at most four overlapping loads, no loop
+- Long inputs: eight lanes each take one 64-bit word per 64-byte
+  stripe (AVX2 when the CPU has it, else SSE2, else plain C). The word
+  XORed with a key word is split into 32-bit halves that are multiplied
+  together, and the raw word is added to the neighbouring lane so no
+  input bit is lost to the multiply. Every 1 KB the lanes are
+  scrambled; at the end they are folded with mum
+- Key words: a fixed table with the seed added, so a new seed costs a
+  few additions rather than a key schedule
+- The seed comes from the OS random source once per process (getrandom
+  on Linux, arc4random_buf on macOS and the BSDs), unless the
+  FAST_HASH_SEED environment variable fixes it to reproduce a run
+
+Used in Part C (Proxy) through cache.c, neg_cache.c and prefetch.c, and
+by compute_file_hash.
+*/
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/random.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_PATH
+#endif
+#include "../include/fast_hash.h"
+
+#define P0      0xA0761D6478BD642FULL
+#define P1      0xE7037ED1A0B428DBULL
+#define P2      0x8EBC6AF09C88C6E3ULL
+#define P3      0x589965CC75374CC3ULL
+#define PRIME32 0x9E3779B1U
+
+#define LANES               8
+#define STRIPE              64                  /* Bytes per lane update */
+#define STRIPES_PER_BLOCK   16                  /* Scramble every 1 KB */
+#define KEY_WORDS           (STRIPES_PER_BLOCK + LANES)
+
+/* Stripe s is keyed by words s .. s + 7; the scramble by the last 8 */
+static const uint64_t key_table[KEY_WORDS] = {
+    0x1001A6625A1298A1ULL, 0x8DBB5B2A6E20AF8EULL, 0x921F54D17423C60DULL,
+    0x41E6CB0657EDA214ULL, 0x62F56770832F8DD1ULL, 0x9D956D44647555EFULL,
+    0xCB8A8A870A78FE60ULL, 0xA89BC4466B24F3EDULL, 0xF515F5FB060E9290ULL,
+    0x00290F121A3A8BEEULL, 0xF15179064388D4EBULL, 0xCAD08BECF72FCC47ULL,
+    0xB94EBA887B470AF1ULL, 0x0256B88B8BF3BAEBULL, 0xD0D27379EADAF943ULL,
+    0x50C9B05BE613B789ULL, 0x6D7DB5AB914C2672ULL, 0x3CDCA6343AE45B70ULL,
+    0x8392680F85F4FF0FULL, 0x713565335BECCE23ULL, 0x3DF6E978F52FFF01ULL,
+    0x8F9A22020883FF27ULL, 0xB77BC3295FC96C7FULL, 0x5A7BDE3DB006A47FULL,
+};
+
+static uint64_t process_seed;
+static pthread_once_t seed_once = PTHREAD_ONCE_INIT;
+
+/* ============================================================================
+Internal Helper Functions
+============================================================================ */
+
+static uint64_t read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/*
+mum - 128-bit product of a and b, folded to 64 bits (internal)
+*/
+static uint64_t mum(uint64_t a, uint64_t b) {
+    __uint128_t r = (__uint128_t)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+/*
+hash_short - wyhash of an input below FAST_HASH_LONG bytes (internal)
+*/
+static uint64_t hash_short(const uint8_t *p, size_t len, uint64_t seed) {
+    seed ^= mum(seed ^ P0, P1);
+    uint64_t a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            /* Two 4-byte reads from each end; they overlap below 8 bytes */
+            size_t mid = (len >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + mid);
+            b = (read32(p + len - 4) << 32) | read32(p + len - 4 - mid);
+        } else if (len > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = mum(read64(p) ^ P1, read64(p + 8) ^ seed);
+                see1 = mum(read64(p + 16) ^ P2, read64(p + 24) ^ see1);
+                see2 = mum(read64(p + 32) ^ P3, read64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = mum(read64(p) ^ P1, read64(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = read64(p + i - 16);
+        b = read64(p + i - 8);
+    }
+
+    __uint128_t r = (__uint128_t)(a ^ P1) * (b ^ seed);
+    return mum((uint64_t)r ^ P0 ^ len, (uint64_t)(r >> 64) ^ P1);
+}
+
+#ifdef __SSE2__
+
+/*
+lane_pair - One stripe's update of two lanes (internal)
+
+_mm_mul_epu32 multiplies the low halves of both 64-bit lanes at once.
+*/
+static inline __m128i lane_pair(__m128i acc, const uint8_t *data, const uint64_t *key) {
+    __m128i d = _mm_loadu_si128((const __m128i *)data);
+    __m128i keyed = _mm_xor_si128(d, _mm_loadu_si128((const __m128i *)key));
+    __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+    __m128i swapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+    return _mm_add_epi64(acc, _mm_add_epi64(product, swapped));
+}
+
+/*
+accumulate - Feed nstripes stripes into the lanes (internal)
+
+Stripe s is keyed by key[s .. s + 7]. Two lanes per register, and the
+four registers are named so that they stay in registers.
+*/
+static void accumulate(uint64_t *acc, const uint8_t *p, size_t nstripes, const uint64_t *key) {
+    __m128i a0 = _mm_load_si128((const __m128i *)acc);
+    __m128i a1 = _mm_load_si128((const __m128i *)acc + 1);
+    __m128i a2 = _mm_load_si128((const __m128i *)acc + 2);
+    __m128i a3 = _mm_load_si128((const __m128i *)acc + 3);
+    for (size_t s = 0; s < nstripes; s++) {
+        const uint8_t *stripe = p + s * STRIPE;
+        a0 = lane_pair(a0, stripe, key + s);
+        a1 = lane_pair(a1, stripe + 16, key + s + 2);
+        a2 = lane_pair(a2, stripe + 32, key + s + 4);
+        a3 = lane_pair(a3, stripe + 48, key + s + 6);
+    }
+    _mm_store_si128((__m128i *)acc, a0);
+    _mm_store_si128((__m128i *)acc + 1, a1);
+    _mm_store_si128((__m128i *)acc + 2, a2);
+    _mm_store_si128((__m128i *)acc + 3, a3);
+}
+
+/*
+scramble - Mix each lane's high bits down and multiply (internal)
+*/
+static void scramble(uint64_t *acc, const uint64_t *key) {
+    const __m128i prime = _mm_set1_epi32((int)PRIME32);
+    for (int i = 0; i < LANES / 2; i++) {
+        __m128i a = _mm_load_si128((const __m128i *)acc + i);
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i *)key + i));
+        __m128i lo = _mm_mul_epu32(a, prime);
+        __m128i hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+        _mm_store_si128((__m128i *)acc + i, _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+    }
+}
+
+#else
+
+static void accumulate(uint64_t *acc, const uint8_t *p, size_t nstripes, const uint64_t *key) {
+    for (size_t s = 0; s < nstripes; s++) {
+        const uint8_t *stripe = p + s * STRIPE;
+        for (int i = 0; i < LANES; i++) {
+            uint64_t data = read64(stripe + 8 * i);
+            uint64_t keyed = data ^ key[s + i];
+            acc[i ^ 1] += data;
+            acc[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+        }
+    }
+}
+
+static void scramble(uint64_t *acc, const uint64_t *key) {
+    for (int i = 0; i < LANES; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= key[i];
+        acc[i] = a * PRIME32;
+    }
+}
+
+#endif
+
+#ifdef HAVE_AVX2_PATH
+
+/*
+accumulate_avx2 - accumulate() with four lanes per register (internal)
+
+Compiled for AVX2 whatever the build flags, and only called when the
+CPU has it. Each 128-bit half does exactly what the SSE2 version does,
+so the hash does not depend on the path.
+*/
+__attribute__((target("avx2")))
+static void accumulate_avx2(uint64_t *acc, const uint8_t *p, size_t nstripes,
+                            const uint64_t *key) {
+    __m256i a0 = _mm256_loadu_si256((const __m256i *)acc);
+    __m256i a1 = _mm256_loadu_si256((const __m256i *)acc + 1);
+    for (size_t s = 0; s < nstripes; s++) {
+        const __m256i *stripe = (const __m256i *)(p + s * STRIPE);
+        for (int half = 0; half < 2; half++) {
+            __m256i d = _mm256_loadu_si256(stripe + half);
+            __m256i keyed = _mm256_xor_si256(d, _mm256_loadu_si256((const __m256i *)(key + s + 4 * half)));
+            __m256i product = _mm256_mul_epu32(keyed, _mm256_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+            __m256i swapped = _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+            __m256i sum = _mm256_add_epi64(product, swapped);
+            if (half == 0) {
+                a0 = _mm256_add_epi64(a0, sum);
+            } else {
+                a1 = _mm256_add_epi64(a1, sum);
+            }
+        }
+    }
+    _mm256_storeu_si256((__m256i *)acc, a0);
+    _mm256_storeu_si256((__m256i *)acc + 1, a1);
+}
+
+#endif
+
+/*
+hash_long - Lane accumulator for inputs of FAST_HASH_LONG bytes or more
+(internal)
+*/
+static uint64_t hash_long(const uint8_t *p, size_t len, uint64_t seed) {
+    uint64_t key[KEY_WORDS];
+    for (int i = 0; i < KEY_WORDS; i++) {
+        key[i] = (i & 1) ? key_table[i] - seed : key_table[i] + seed;
+    }
+    uint64_t acc[LANES] __attribute__((aligned(16))) = {
+        PRIME32, P0, P1, P2, P3, seed, ~seed, len
+    };
+
+    void (*feed)(uint64_t *, const uint8_t *, size_t, const uint64_t *) = accumulate;
+#ifdef HAVE_AVX2_PATH
+    if (__builtin_cpu_supports("avx2")) {
+        feed = accumulate_avx2;
+    }
+#endif
+
+    size_t block = STRIPE * STRIPES_PER_BLOCK;
+    size_t nblocks = (len - 1) / block;
+    for (size_t b = 0; b < nblocks; b++) {
+        feed(acc, p + b * block, STRIPES_PER_BLOCK, key);
+        scramble(acc, key + STRIPES_PER_BLOCK);
+    }
+
+    /* 1 .. block bytes left: whole stripes, then the last 64 bytes */
+    size_t rest = len - nblocks * block;
+    accumulate(acc, p + nblocks * block, (rest - 1) / STRIPE, key);
+    accumulate(acc, p + len - STRIPE, 1, key + STRIPES_PER_BLOCK - LANES + 1);
+
+    uint64_t h = len * P1 ^ seed;
+    for (int i = 0; i < LANES; i += 2) {
+        h += mum(acc[i] ^ key[STRIPES_PER_BLOCK + i], acc[i + 1] ^ key[STRIPES_PER_BLOCK + i + 1]);
+    }
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    return h ^ (h >> 32);
+}
+
+/*
+os_random - Fill a buffer from the OS random source (internal)
+
+Returns: false if there is none, or it is not ready yet
+*/
+static bool os_random(void *buf, size_t len) {
+#if defined(__linux__)
+    return getrandom(buf, len, GRND_NONBLOCK) == (ssize_t)len;
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
+      defined(__NetBSD__) || defined(__DragonFly__)
+    arc4random_buf(buf, len);
+    return true;
+#else
+    (void)buf;
+    (void)len;
+    return false;
+#endif
+}
+
+/*
+seed_init - Draw the process seed, or read it from FAST_HASH_SEED (internal)
+
+Falls back on the clock, pid and a stack address (randomized by ASLR) if
+the OS source is unavailable: weaker, but still unknown to a client
+ahead of time.
+*/
+static void seed_init(void) {
+    const char *fixed = getenv("FAST_HASH_SEED");
+    if (fixed != NULL && *fixed != '\0') {
+        process_seed = strtoull(fixed, NULL, 0);
+        return;
+    }
+
+    uint64_t seed;
+    if (!os_random(&seed, sizeof(seed))) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        seed = mum((uint64_t)ts.tv_sec ^ P2 ^ (uint64_t)(uintptr_t)&ts,
+                   (uint64_t)ts.tv_nsec ^ ((uint64_t)getpid() << 32));
+    }
+    process_seed = seed;
+}
+
+/* ============================================================================
+Hashing
+============================================================================ */
+
+/*
+fast_hash - Hash a buffer
+*/
+uint64_t fast_hash(const void *data, size_t len, uint64_t seed) {
+    if (len >= FAST_HASH_LONG) {
+        return hash_long(data, len, seed);
+    }
+    return hash_short(data, len, seed);
+}
+
+/*
+fast_hash_seed - This process's random seed
+*/
+uint64_t fast_hash_seed(void) {
+    pthread_once(&seed_once, seed_init);
+    return process_seed;
+}
+
+/*
+fast_hash_str - Hash a string with the process seed
+*/
+uint64_t fast_hash_str(const char *str) {
+    return fast_hash(str, strlen(str), fast_hash_seed());
+}
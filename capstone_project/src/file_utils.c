@@ -15,6 +15,7 @@ traversal attacks!
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include "../include/fast_hash.h"
 #include "../include/file_utils.h"
 
 /* ============================================================================
@@ -165,6 +166,28 @@ int is_regular_file(const char *filepath) {
     return 0;  /* Placeholder */
 }
 
+/*
+get_file_version - Get modification time (ns) and size in one stat()
+*/
+int get_file_version(const char *filepath, int64_t *mtime_ns, size_t *size) {
+    if (filepath == NULL || mtime_ns == NULL || size == NULL) {
+        return -1;
+    }
+
+    struct stat st;
+    if (stat(filepath, &st) < 0 || !S_ISREG(st.st_mode)) {
+        return -1;
+    }
+
+#ifdef __APPLE__
+    *mtime_ns = (int64_t)st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+    *mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+    *size = (size_t)st.st_size;
+    return 0;
+}
+
 /* ============================================================================
 File I/O Functions
 ============================================================================ */
@@ -231,31 +254,14 @@ Cache Support Functions
 ============================================================================ */
 
 /*
-compute_file_hash - Simple hash function for file paths
+compute_file_hash - Hash function for file paths
 
-Uses djb2 algorithm - simple but effective for strings.
+Seeded per process (fast_hash.c). djb2 (hash * 33 + c, from 5381) is the
+textbook choice, but it takes one multiply per byte, and with its fixed
+start value anyone can compute colliding paths in advance.
 */
 unsigned long compute_file_hash(const char *path) {
-    /*
-     * TODO: Implement djb2 hash
-     *
-     * The djb2 hash algorithm:
-     *
-     * unsigned long hash = 5381;
-     * int c;
-     * while ((c = *path++)) {
-     *     hash = ((hash << 5) + hash) + c;  // hash * 33 + c
-     * }
-     * return hash;
-     *
-     * This produces a reasonably distributed hash value.
-     */
-
-    (void)path;
-
-    /* YOUR CODE HERE */
-
-    return 0;  /* Placeholder */
+    return fast_hash_str(path);
 }
 
 /*
@@ -0,0 +1,164 @@
+/*
+freq_sketch.c - Count-Min Frequency Sketch
+
+Approximate per-key access counts for the cache's W-TinyLFU admission
+policy.
+
+Key concepts:
+- Count-min: each key increments one counter in each of several rows;
+  collisions only ever add, so the minimum over the rows is the best
+  estimate
+- Conservative update: only the counters equal to that minimum are
+  incremented, which keeps collisions from inflating other keys
+- Aging (the "reset" of TinyLFU): halving every counter periodically
+  turns the counts into a recency-weighted frequency
+
+Used in Part C (Proxy) through cache.c.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/freq_sketch.h"
+
+/* Per-row seeds; odd so that multiplying by them is a bijection */
+static const uint64_t ROW_SEEDS[FREQ_SKETCH_DEPTH] = {
+    0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL,
+    0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL
+};
+
+/* ============================================================================
+Internal Helper Functions
+============================================================================ */
+
+/*
+counter_index - Counter used by row for a key (internal)
+*/
+static uint32_t counter_index(const freq_sketch_t *sketch, int row, uint64_t hash) {
+    uint64_t h = (hash + ROW_SEEDS[row]) * ROW_SEEDS[row];
+    h ^= h >> 32;
+    return (uint32_t)row * sketch->width + ((uint32_t)h & (sketch->width - 1));
+}
+
+/*
+age - Halve every counter (internal)
+*/
+static void age(freq_sketch_t *sketch) {
+    size_t total = (size_t)sketch->width * FREQ_SKETCH_DEPTH;
+    for (size_t i = 0; i < total; i++) {
+        sketch->counters[i] >>= 1;
+    }
+    sketch->additions /= 2;
+    sketch->resets++;
+}
+
+/* ============================================================================
+Lifecycle
+============================================================================ */
+
+/*
+freq_sketch_create - Create a sketch
+*/
+freq_sketch_t *freq_sketch_create(uint32_t width) {
+    if (width == 0 || width > (1u << 30)) {
+        fprintf(stderr, "freq_sketch_create: invalid width %u\n", width);
+        return NULL;
+    }
+
+    uint32_t rounded = 1;
+    while (rounded < width) {
+        rounded <<= 1;
+    }
+
+    freq_sketch_t *sketch = calloc(1, sizeof(freq_sketch_t));
+    if (sketch == NULL) {
+        perror("calloc freq_sketch");
+        return NULL;
+    }
+
+    sketch->counters = calloc((size_t)rounded * FREQ_SKETCH_DEPTH, sizeof(uint8_t));
+    if (sketch->counters == NULL) {
+        perror("calloc freq_sketch counters");
+        free(sketch);
+        return NULL;
+    }
+
+    sketch->width = rounded;
+    sketch->sample_size = rounded * FREQ_SKETCH_SAMPLE_MULT;
+    return sketch;
+}
+
+/*
+freq_sketch_destroy - Free a sketch
+*/
+void freq_sketch_destroy(freq_sketch_t *sketch) {
+    if (sketch == NULL) {
+        return;
+    }
+    free(sketch->counters);
+    free(sketch);
+}
+
+/* ============================================================================
+Operations
+============================================================================ */
+
+/*
+freq_sketch_increment - Record one access to a key
+*/
+void freq_sketch_increment(freq_sketch_t *sketch, uint64_t hash) {
+    if (sketch == NULL) {
+        return;
+    }
+
+    uint32_t index[FREQ_SKETCH_DEPTH];
+    uint8_t min = FREQ_SKETCH_MAX;
+    for (int row = 0; row < FREQ_SKETCH_DEPTH; row++) {
+        index[row] = counter_index(sketch, row, hash);
+        if (sketch->counters[index[row]] < min) {
+            min = sketch->counters[index[row]];
+        }
+    }
+    if (min == FREQ_SKETCH_MAX) {
+        return;  /* Saturated - also does not count towards aging */
+    }
+
+    for (int row = 0; row < FREQ_SKETCH_DEPTH; row++) {
+        if (sketch->counters[index[row]] == min) {
+            sketch->counters[index[row]]++;
+        }
+    }
+
+    if (++sketch->additions >= sketch->sample_size) {
+        age(sketch);
+    }
+}
+
+/*
+freq_sketch_estimate - Estimated recent accesses of a key
+*/
+uint8_t freq_sketch_estimate(const freq_sketch_t *sketch, uint64_t hash) {
+    if (sketch == NULL) {
+        return 0;
+    }
+
+    uint8_t min = FREQ_SKETCH_MAX;
+    for (int row = 0; row < FREQ_SKETCH_DEPTH; row++) {
+        uint8_t count = sketch->counters[counter_index(sketch, row, hash)];
+        if (count < min) {
+            min = count;
+        }
+    }
+    return min;
+}
+
+/*
+freq_sketch_clear - Forget all frequencies
+*/
+void freq_sketch_clear(freq_sketch_t *sketch) {
+    if (sketch == NULL) {
+        return;
+    }
+    memset(sketch->counters, 0, (size_t)sketch->width * FREQ_SKETCH_DEPTH);
+    sketch->additions = 0;
+}
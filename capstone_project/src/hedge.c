@@ -0,0 +1,199 @@
+/*
+hedge.c - Hedged Backend Request Bookkeeping
+
+Decides when the proxy should send a duplicate request to a second
+backend replica, and keeps the duplicate rate bounded.
+
+Key concepts:
+- p95 of recent latencies as the hedge delay: only the slowest ~5% of
+  requests would be hedged even without a budget
+- Token bucket: each request adds max_ratio tokens, each hedge costs 1,
+  so a backend-wide slowdown cannot double the load on the replicas
+
+Used in Part C (Proxy).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/hedge.h"
+
+/* ============================================================================
+Internal Helper Functions
+============================================================================ */
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+recompute_p95 - Sort a copy of the window and take the 95th percentile
+
+Called at most once every HEDGE_RECOMPUTE_EVERY samples, under lock.
+*/
+static void recompute_p95(hedge_t *h) {
+    uint32_t sorted[HEDGE_WINDOW];
+    memcpy(sorted, h->samples, h->num_samples * sizeof(uint32_t));
+    qsort(sorted, h->num_samples, sizeof(uint32_t), compare_u32);
+
+    int index = (h->num_samples * 95) / 100;
+    if (index >= h->num_samples) {
+        index = h->num_samples - 1;
+    }
+    h->p95_us = sorted[index];
+    h->since_recompute = 0;
+}
+
+/* ============================================================================
+Lifecycle
+============================================================================ */
+
+/*
+hedge_create - Create hedging state
+*/
+hedge_t *hedge_create(double max_ratio, uint32_t default_delay_ms) {
+    if (max_ratio <= 0.0 || max_ratio > 1.0) {
+        fprintf(stderr, "hedge_create: max_ratio must be in (0, 1]\n");
+        return NULL;
+    }
+
+    hedge_t *h = calloc(1, sizeof(hedge_t));
+    if (h == NULL) {
+        perror("calloc hedge");
+        return NULL;
+    }
+
+    h->max_ratio = max_ratio;
+    h->default_delay_ms = default_delay_ms;
+    pthread_mutex_init(&h->lock, NULL);
+    return h;
+}
+
+/*
+hedge_destroy - Free hedging state
+*/
+void hedge_destroy(hedge_t *h) {
+    if (h == NULL) {
+        return;
+    }
+    pthread_mutex_destroy(&h->lock);
+    free(h);
+}
+
+/* ============================================================================
+Operations
+============================================================================ */
+
+/*
+hedge_begin_request - Note a backend fetch and get the hedge delay
+*/
+uint32_t hedge_begin_request(hedge_t *h) {
+    if (h == NULL) {
+        return DEFAULT_HEDGE_DELAY_MS;
+    }
+
+    pthread_mutex_lock(&h->lock);
+
+    h->requests++;
+    h->tokens += h->max_ratio;
+    if (h->tokens > HEDGE_MAX_TOKENS) {
+        h->tokens = HEDGE_MAX_TOKENS;
+    }
+
+    uint32_t delay_ms = h->default_delay_ms;
+    if (h->num_samples >= HEDGE_MIN_SAMPLES) {
+        delay_ms = (h->p95_us + 999) / 1000;  /* round up to whole ms */
+        if (delay_ms == 0) {
+            delay_ms = 1;
+        }
+    }
+
+    pthread_mutex_unlock(&h->lock);
+    return delay_ms;
+}
+
+/*
+hedge_try_acquire - Spend budget on one hedge
+*/
+bool hedge_try_acquire(hedge_t *h) {
+    if (h == NULL) {
+        return false;
+    }
+
+    pthread_mutex_lock(&h->lock);
+
+    bool ok = h->tokens >= 1.0;
+    if (ok) {
+        h->tokens -= 1.0;
+        h->hedges_sent++;
+    } else {
+        h->hedges_denied++;
+    }
+
+    pthread_mutex_unlock(&h->lock);
+    return ok;
+}
+
+/*
+hedge_record_latency - Add one backend response time
+*/
+void hedge_record_latency(hedge_t *h, uint64_t latency_us) {
+    if (h == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&h->lock);
+
+    h->samples[h->next_sample] = latency_us > UINT32_MAX ? UINT32_MAX : (uint32_t)latency_us;
+    h->next_sample = (h->next_sample + 1) % HEDGE_WINDOW;
+    if (h->num_samples < HEDGE_WINDOW) {
+        h->num_samples++;
+    }
+
+    /* Recompute right when the window becomes usable, then periodically */
+    if (++h->since_recompute >= HEDGE_RECOMPUTE_EVERY ||
+        h->num_samples == HEDGE_MIN_SAMPLES) {
+        recompute_p95(h);
+    }
+
+    pthread_mutex_unlock(&h->lock);
+}
+
+/*
+hedge_record_win - The hedged duplicate answered first
+*/
+void hedge_record_win(hedge_t *h) {
+    if (h == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&h->lock);
+    h->hedges_won++;
+    pthread_mutex_unlock(&h->lock);
+}
+
+/* ============================================================================
+Statistics
+============================================================================ */
+
+/*
+hedge_get_stats - Get hedging statistics
+*/
+void hedge_get_stats(hedge_t *h, hedge_stats_t *stats) {
+    if (h == NULL || stats == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&h->lock);
+
+    stats->requests = h->requests;
+    stats->hedges_sent = h->hedges_sent;
+    stats->hedges_won = h->hedges_won;
+    stats->hedges_denied = h->hedges_denied;
+    stats->p95_us = h->p95_us;
+    stats->hedge_rate = (h->requests > 0) ? (double)h->hedges_sent / h->requests : 0.0;
+
+    pthread_mutex_unlock(&h->lock);
+}
@@ -0,0 +1,279 @@
+/*
+lz.c - Byte-Oriented LZ Compression
+
+Block codec for cached payloads, in the LZ4 family.
+
+Key concepts:
+- Greedy parsing: at each position the last position with the same
+  four bytes (one hash table slot, no chains) is the only candidate. It
+  compresses less than a full search, but compresses fast and keeps the
+  format simple enough to decode with plain copies
+- Skipping: every 32 positions without a match the step grows by one
+  byte, so text is scanned densely while random data is crossed in a
+  fraction of the time and rejected early by the capacity check
+- Matches end LAST_LITERALS bytes before the input does; the block
+  always ends with a literal-only sequence, which is how the decoder
+  knows it is done
+
+Used in Part C (Proxy) through cache.c.
+*/
+
+#include <string.h>
+#include "../include/lz.h"
+
+#define HASH_BITS       12
+#define HASH_SIZE       (1 << HASH_BITS)
+#define MAX_OFFSET      65535
+#define SKIP_SHIFT      5
+#define LAST_LITERALS   5
+
+/* ============================================================================
+Internal Helper Functions
+============================================================================ */
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hash4(uint32_t seq) {
+    return (seq * 2654435761U) >> (32 - HASH_BITS);
+}
+
+/*
+match_length - Length of the common prefix of a and b, at most max
+(internal)
+*/
+static size_t match_length(const uint8_t *a, const uint8_t *b, size_t max) {
+    size_t len = 0;
+    while (len + 8 <= max && read64(a + len) == read64(b + len)) {
+        len += 8;
+    }
+    while (len < max && a[len] == b[len]) {
+        len++;
+    }
+    return len;
+}
+
+/*
+put_length - Write the extra length bytes of a nibble that overflowed
+(internal)
+*/
+static uint8_t *put_length(uint8_t *op, size_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t)length;
+    return op;
+}
+
+/*
+emit - Append one sequence; offset 0 means literals only (internal)
+
+@return: New output position, or NULL if it does not fit before end
+*/
+static uint8_t *emit(uint8_t *op, const uint8_t *end, const uint8_t *literals,
+                     size_t lit_len, size_t offset, size_t match_len) {
+    size_t extra = match_len - (offset != 0 ? LZ_MIN_MATCH : 0);
+    size_t need = 1 + lit_len / 255 + 1 + lit_len + 2 + extra / 255 + 1;
+    if (need > (size_t)(end - op)) {
+        return NULL;
+    }
+
+    uint8_t *token = op++;
+    *token = (uint8_t)((lit_len < 15 ? lit_len : 15) << 4);
+    if (lit_len >= 15) {
+        op = put_length(op, lit_len - 15);
+    }
+    memcpy(op, literals, lit_len);
+    op += lit_len;
+
+    if (offset != 0) {
+        *op++ = (uint8_t)(offset & 0xFF);
+        *op++ = (uint8_t)(offset >> 8);
+        *token |= (uint8_t)(extra < 15 ? extra : 15);
+        if (extra >= 15) {
+            op = put_length(op, extra - 15);
+        }
+    }
+    return op;
+}
+
+/*
+get_length - Read the extra length bytes of a nibble that overflowed
+(internal)
+*/
+static bool get_length(const uint8_t **ip, const uint8_t *end, size_t *length) {
+    uint8_t b;
+    do {
+        if (*ip >= end) {
+            return false;
+        }
+        b = *(*ip)++;
+        *length += b;
+    } while (b == 255);
+    return true;
+}
+
+/* ============================================================================
+Compression
+============================================================================ */
+
+/*
+lz_bound - Largest block lz_compress() can produce
+*/
+size_t lz_bound(size_t size) {
+    return LZ_HEADER_SIZE + size + size / 255 + 16;
+}
+
+/*
+lz_compress - Compress a buffer into a block
+*/
+size_t lz_compress(const void *src, size_t size, void *dst, size_t capacity) {
+    const uint8_t *in = src;
+    uint8_t *out = dst;
+    const uint8_t *end = out + capacity;
+    if (size > LZ_MAX_INPUT || capacity < LZ_HEADER_SIZE) {
+        return 0;
+    }
+
+    uint32_t header = (uint32_t)size;
+    uint8_t bytes[LZ_HEADER_SIZE] = {
+        (uint8_t)header, (uint8_t)(header >> 8), (uint8_t)(header >> 16), (uint8_t)(header >> 24)
+    };
+    memcpy(out, bytes, LZ_HEADER_SIZE);
+    uint8_t *op = out + LZ_HEADER_SIZE;
+
+    uint32_t table[HASH_SIZE];
+    memset(table, 0, sizeof(table));
+
+    size_t anchor = 0;
+    size_t pos = 0;
+    size_t limit = size > LZ_MIN_MATCH + LAST_LITERALS ? size - LZ_MIN_MATCH - LAST_LITERALS : 0;
+    unsigned misses = 0;
+
+    while (pos < limit) {
+        uint32_t seq = read32(in + pos);
+        uint32_t slot = hash4(seq);
+        size_t candidate = table[slot];
+        table[slot] = (uint32_t)pos;
+
+        if (candidate >= pos || pos - candidate > MAX_OFFSET || read32(in + candidate) != seq) {
+            pos += 1 + (misses++ >> SKIP_SHIFT);
+            continue;
+        }
+
+        /* Extend backwards over literals that also match */
+        while (pos > anchor && candidate > 0 && in[pos - 1] == in[candidate - 1]) {
+            pos--;
+            candidate--;
+        }
+        size_t length = LZ_MIN_MATCH +
+                        match_length(in + pos + LZ_MIN_MATCH, in + candidate + LZ_MIN_MATCH,
+                                     size - LAST_LITERALS - pos - LZ_MIN_MATCH);
+
+        op = emit(op, end, in + anchor, pos - anchor, pos - candidate, length);
+        if (op == NULL) {
+            return 0;
+        }
+        pos += length;
+        anchor = pos;
+        misses = 0;
+        if (pos - 2 < limit) {
+            table[hash4(read32(in + pos - 2))] = (uint32_t)(pos - 2);
+        }
+    }
+
+    op = emit(op, end, in + anchor, size - anchor, 0, 0);
+    return op != NULL ? (size_t)(op - out) : 0;
+}
+
+/* ============================================================================
+Decompression
+============================================================================ */
+
+/*
+lz_decoded_size - Decoded length announced by a block
+*/
+size_t lz_decoded_size(const void *block, size_t size) {
+    const uint8_t *p = block;
+    if (size < LZ_HEADER_SIZE) {
+        return SIZE_MAX;
+    }
+    return (size_t)p[0] | (size_t)p[1] << 8 | (size_t)p[2] << 16 | (size_t)p[3] << 24;
+}
+
+/*
+lz_decompress - Decode a block
+*/
+bool lz_decompress(const void *block, size_t size, void *dst) {
+    size_t decoded = lz_decoded_size(block, size);
+    if (decoded == SIZE_MAX) {
+        return false;
+    }
+    const uint8_t *ip = (const uint8_t *)block + LZ_HEADER_SIZE;
+    const uint8_t *end = (const uint8_t *)block + size;
+    uint8_t *start = dst;
+    uint8_t *op = start;
+    uint8_t *op_end = start + decoded;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !get_length(&ip, end, &lit_len)) {
+            return false;
+        }
+        if (lit_len > (size_t)(end - ip) || lit_len > (size_t)(op_end - op)) {
+            return false;
+        }
+        if (lit_len <= 16 && end - ip >= 16 && op_end - op >= 16) {
+            /* Short run: a fixed 16-byte copy beats a variable one */
+            memcpy(op, ip, 16);
+        } else {
+            memcpy(op, ip, lit_len);
+        }
+        op += lit_len;
+        ip += lit_len;
+        if (ip == end) {
+            break;
+        }
+
+        if (end - ip < 2) {
+            return false;
+        }
+        size_t offset = (size_t)ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        size_t match_len = token & 15;
+        if (match_len == 15 && !get_length(&ip, end, &match_len)) {
+            return false;
+        }
+        match_len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(op - start) ||
+            match_len > (size_t)(op_end - op)) {
+            return false;
+        }
+
+        const uint8_t *match = op - offset;
+        if (offset >= 16 && match_len <= 16 && op_end - op >= 16) {
+            memcpy(op, match, 16);
+        } else if (offset >= match_len) {
+            memcpy(op, match, match_len);
+        } else {
+            /* Overlapping copy repeats the last 'offset' bytes */
+            for (size_t i = 0; i < match_len; i++) {
+                op[i] = match[i];
+            }
+        }
+        op += match_len;
+    }
+    return op == op_end;
+}
@@ -0,0 +1,318 @@
+/*
+mrc.c - Online Miss-Ratio Curve Estimation (SHARDS)
+
+Key concepts:
+- A key is sampled iff the top MRC_SAMPLE_BITS bits of its mixed hash
+  are below the threshold; the rate R is threshold / 2^MRC_SAMPLE_BITS
+- Each tracked key carries the stamp of its last access. The tree holds
+  the key's bytes at that stamp, so the bytes of keys accessed since are
+  tracked_bytes - prefix(stamp); divided by R they estimate the bytes of
+  all keys accessed since
+- Stamps only grow. When they run out, the live keys are renumbered
+  1..n in stamp order (a rebuild); the same rebuild drops the keys above
+  a lowered threshold
+
+Used in Part C (cache.c).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/mrc.h"
+
+#define SAMPLE_SPACE    (1u << MRC_SAMPLE_BITS)
+#define KEY_SLOTS       (2 * MRC_MAX_KEYS)
+#define STAMPS          (4 * MRC_MAX_KEYS)
+
+/* Share of MRC_MAX_KEYS kept when the threshold is lowered, in eighths */
+#define KEEP_8THS       7
+
+/* ============================================================================
+Internal Helper Functions
+============================================================================ */
+
+static uint32_t sample_value(uint64_t hash) {
+    return (uint32_t)((hash * 0xD6E8FEB86659FD93ULL) >> (64 - MRC_SAMPLE_BITS));
+}
+
+static void tree_add(mrc_t *mrc, uint32_t stamp, uint64_t delta) {
+    for (uint32_t i = stamp; i <= mrc->stamps; i += i & -i) {
+        mrc->tree[i] += delta;
+    }
+}
+
+static uint64_t tree_prefix(const mrc_t *mrc, uint32_t stamp) {
+    uint64_t sum = 0;
+    for (uint32_t i = stamp; i > 0; i -= i & -i) {
+        sum += mrc->tree[i];
+    }
+    return sum;
+}
+
+/*
+find_key - Slot of a key, or the empty slot where it belongs (internal)
+*/
+static mrc_key_t *find_key(mrc_t *mrc, uint64_t hash) {
+    uint32_t i = (uint32_t)(hash >> 7) & mrc->key_mask;
+    while (mrc->keys[i].hash != 0 && mrc->keys[i].hash != hash) {
+        i = (i + 1) & mrc->key_mask;
+    }
+    return &mrc->keys[i];
+}
+
+static int by_stamp(const void *a, const void *b) {
+    uint32_t x = ((const mrc_key_t *)a)->stamp, y = ((const mrc_key_t *)b)->stamp;
+    return (x > y) - (x < y);
+}
+
+static int by_sample_value(const void *a, const void *b) {
+    uint32_t x = sample_value(((const mrc_key_t *)a)->hash);
+    uint32_t y = sample_value(((const mrc_key_t *)b)->hash);
+    return (x > y) - (x < y);
+}
+
+/*
+rebuild - Renumber the keys below 'threshold' 1..n and drop the rest
+(internal)
+
+Lowering the threshold rescales the histogram to the new rate, so
+requests counted before and after weigh the same.
+*/
+static void rebuild(mrc_t *mrc, uint32_t threshold) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i <= mrc->key_mask; i++) {
+        if (mrc->keys[i].hash != 0 && sample_value(mrc->keys[i].hash) < threshold) {
+            mrc->scratch[n++] = mrc->keys[i];
+        }
+    }
+    qsort(mrc->scratch, n, sizeof(mrc_key_t), by_stamp);
+
+    memset(mrc->keys, 0, (mrc->key_mask + 1) * sizeof(mrc_key_t));
+    memset(mrc->tree, 0, (mrc->stamps + 1) * sizeof(uint64_t));
+    mrc->tracked_bytes = 0;
+    for (uint32_t s = 1; s <= n; s++) {
+        mrc_key_t *key = find_key(mrc, mrc->scratch[s - 1].hash);
+        *key = mrc->scratch[s - 1];
+        key->stamp = s;
+        mrc->tree[s] = key->bytes;
+        mrc->tracked_bytes += key->bytes;
+    }
+    /* Fenwick tree from the per-stamp values in O(stamps) */
+    for (uint32_t i = 1; i <= mrc->stamps; i++) {
+        uint32_t parent = i + (i & -i);
+        if (parent <= mrc->stamps) {
+            mrc->tree[parent] += mrc->tree[i];
+        }
+    }
+    mrc->num_keys = n;
+    mrc->next_stamp = n + 1;
+
+    if (threshold < mrc->threshold) {
+        double scale = (double)threshold / mrc->threshold;
+        for (int b = 0; b < MRC_BUCKETS; b++) {
+            mrc->hist[b] *= scale;
+        }
+        mrc->far *= scale;
+        mrc->cold *= scale;
+        mrc->total *= scale;
+        __atomic_store_n(&mrc->threshold, threshold, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+shrink - Lower the threshold until KEEP_8THS of MRC_MAX_KEYS keys remain
+(internal)
+*/
+static void shrink(mrc_t *mrc) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i <= mrc->key_mask; i++) {
+        if (mrc->keys[i].hash != 0) {
+            mrc->scratch[n++] = mrc->keys[i];
+        }
+    }
+    qsort(mrc->scratch, n, sizeof(mrc_key_t), by_sample_value);
+    uint32_t threshold = sample_value(mrc->scratch[MRC_MAX_KEYS * KEEP_8THS / 8].hash);
+    rebuild(mrc, threshold > 0 ? threshold : 1);
+}
+
+/*
+track - The key's entry, added at a new stamp if it is not tracked
+(internal, caller holds the lock)
+*/
+static mrc_key_t *track(mrc_t *mrc, uint64_t hash, bool *added) {
+    if (mrc->next_stamp > mrc->stamps) {
+        rebuild(mrc, mrc->threshold);
+    }
+    mrc_key_t *key = find_key(mrc, hash);
+    *added = key->hash == 0;
+    if (*added) {
+        key->hash = hash;
+        key->bytes = 0;
+        key->stamp = mrc->next_stamp++;
+        mrc->num_keys++;
+    }
+    return key;
+}
+
+/* ============================================================================
+Lifecycle
+============================================================================ */
+
+/*
+mrc_create - Create an estimator
+*/
+mrc_t *mrc_create(size_t reference_size) {
+    mrc_t *mrc = calloc(1, sizeof(mrc_t));
+    if (mrc == NULL) {
+        perror("calloc mrc");
+        return NULL;
+    }
+    pthread_mutex_init(&mrc->lock, NULL);
+    mrc->keys = calloc(KEY_SLOTS, sizeof(mrc_key_t));
+    mrc->tree = calloc(STAMPS + 1, sizeof(uint64_t));
+    mrc->scratch = malloc((MRC_MAX_KEYS + 1) * sizeof(mrc_key_t));
+    if (mrc->keys == NULL || mrc->tree == NULL || mrc->scratch == NULL) {
+        perror("calloc mrc");
+        mrc_destroy(mrc);
+        return NULL;
+    }
+    mrc->threshold = SAMPLE_SPACE / MRC_START_RATE_DIV;
+    mrc->key_mask = KEY_SLOTS - 1;
+    mrc->stamps = STAMPS;
+    mrc->next_stamp = 1;
+    mrc->bucket_bytes = reference_size * MRC_SPAN / MRC_BUCKETS;
+    if (mrc->bucket_bytes == 0) {
+        mrc->bucket_bytes = 1;
+    }
+    return mrc;
+}
+
+/*
+mrc_destroy - Free an estimator
+*/
+void mrc_destroy(mrc_t *mrc) {
+    if (mrc == NULL) {
+        return;
+    }
+    pthread_mutex_destroy(&mrc->lock);
+    free(mrc->keys);
+    free(mrc->tree);
+    free(mrc->scratch);
+    free(mrc);
+}
+
+/* ============================================================================
+Recording
+============================================================================ */
+
+/*
+mrc_access - Record a request for a key
+*/
+void mrc_access(mrc_t *mrc, uint64_t hash) {
+    if (hash == 0 || !mrc_sampled(mrc, hash)) {
+        return;
+    }
+    pthread_mutex_lock(&mrc->lock);
+    if (!mrc_sampled(mrc, hash)) {
+        /* The threshold dropped meanwhile */
+        pthread_mutex_unlock(&mrc->lock);
+        return;
+    }
+
+    bool added;
+    mrc_key_t *key = track(mrc, hash, &added);
+    if (added) {
+        mrc->cold += 1;
+    } else {
+        /* Bytes of the keys accessed since, scaled up to every key */
+        uint64_t since = mrc->tracked_bytes - tree_prefix(mrc, key->stamp);
+        double distance = (double)since * SAMPLE_SPACE / mrc->threshold + key->bytes;
+        double bucket = distance / mrc->bucket_bytes;
+        if (bucket < MRC_BUCKETS) {
+            mrc->hist[(int)bucket] += 1;
+        } else {
+            mrc->far += 1;
+        }
+        tree_add(mrc, key->stamp, -key->bytes);
+        key->stamp = mrc->next_stamp++;
+        tree_add(mrc, key->stamp, key->bytes);
+    }
+    mrc->total += 1;
+    mrc->samples++;
+    if (mrc->num_keys > MRC_MAX_KEYS) {
+        shrink(mrc);
+    }
+    pthread_mutex_unlock(&mrc->lock);
+}
+
+/*
+mrc_update - Record the bytes a key now takes
+*/
+void mrc_update(mrc_t *mrc, uint64_t hash, size_t bytes) {
+    if (hash == 0 || !mrc_sampled(mrc, hash)) {
+        return;
+    }
+    pthread_mutex_lock(&mrc->lock);
+    if (!mrc_sampled(mrc, hash)) {
+        /* The threshold dropped meanwhile */
+        pthread_mutex_unlock(&mrc->lock);
+        return;
+    }
+
+    bool added;
+    mrc_key_t *key = track(mrc, hash, &added);
+    tree_add(mrc, key->stamp, bytes - key->bytes);
+    mrc->tracked_bytes += bytes - key->bytes;
+    key->bytes = bytes;
+    if (mrc->num_keys > MRC_MAX_KEYS) {
+        shrink(mrc);
+    }
+    pthread_mutex_unlock(&mrc->lock);
+}
+
+/* ============================================================================
+Reading
+============================================================================ */
+
+/*
+mrc_hit_rate - Predicted LRU hit rate of a cache of a given size
+
+The bucket the size falls in counts in proportion to the part of it
+below the size. The histogram is in requests at the current rate (the
+threshold rescales it), so 'requests' times the rate is what it would
+hold with a representative sample; the difference goes to bucket 0.
+*/
+double mrc_hit_rate(mrc_t *mrc, size_t size, unsigned long requests,
+                    unsigned long *samples) {
+    pthread_mutex_lock(&mrc->lock);
+    double position = (double)size / mrc->bucket_bytes;
+    double hits = 0.0;
+    for (int b = 0; b < MRC_BUCKETS && b < position; b++) {
+        hits += mrc->hist[b] * (position - b < 1.0 ? position - b : 1.0);
+    }
+    double total = mrc->total;
+    if (requests > 0 && total > 0) {
+        double expected = (double)requests * mrc->threshold / SAMPLE_SPACE;
+        hits += (expected - total) * (position < 1.0 ? position : 1.0);
+        total = expected;
+    }
+    double rate = total > 0 ? hits / total : 0.0;
+    if (samples != NULL) {
+        *samples = mrc->samples;
+    }
+    pthread_mutex_unlock(&mrc->lock);
+    return rate < 0.0 ? 0.0 : rate > 1.0 ? 1.0 : rate;
+}
+
+/*
+mrc_reset - Forget the histogram (tracked keys are kept)
+*/
+void mrc_reset(mrc_t *mrc) {
+    pthread_mutex_lock(&mrc->lock);
+    memset(mrc->hist, 0, sizeof(mrc->hist));
+    mrc->far = 0;
+    mrc->cold = 0;
+    mrc->total = 0;
+    mrc->samples = 0;
+    pthread_mutex_unlock(&mrc->lock);
+}
@@ -0,0 +1,351 @@
+/*
+neg_cache.c - Negative Cache Implementation
+
+Remembers paths the backend answered with FILE_NOT_FOUND, so the proxy
+can reply immediately instead of forwarding every request for a
+missing file.
+
+Key concepts:
+- Hash table for O(1) lookup
+- Two LRU segments (probation / protected) to resist key floods
+- Lazy TTL expiry on lookup, using a monotonic clock
+
+Used in Part C (Proxy).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/fast_hash.h"
+#include "../include/neg_cache.h"
+
+/* Number of hash buckets (prime number for better distribution) */
+#define NEG_NUM_BUCKETS     1021
+
+/* ============================================================================
+Internal Helper Functions
+============================================================================ */
+
+/*
+now_ms - Current monotonic time in milliseconds
+*/
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static int neg_hash(neg_cache_t *nc, const char *key) {
+    return fast_hash_str(key) % nc->num_buckets;
+}
+
+static neg_segment_list_t *segment_of(neg_cache_t *nc, neg_entry_t *entry) {
+    return entry->segment == NEG_SEG_PROTECTED ? &nc->protected_seg : &nc->probation;
+}
+
+/*
+find_entry - Find an entry by key (internal, no locking)
+*/
+static neg_entry_t *find_entry(neg_cache_t *nc, const char *key) {
+    neg_entry_t *entry = nc->buckets[neg_hash(nc, key)];
+    while (entry != NULL) {
+        if (strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+        entry = entry->hash_next;
+    }
+    return NULL;
+}
+
+/* ============================================================================
+Segment List Management
+============================================================================ */
+
+static void list_unlink(neg_segment_list_t *list, neg_entry_t *entry) {
+    if (entry->lru_prev != NULL) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        list->head = entry->lru_next;
+    }
+    if (entry->lru_next != NULL) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        list->tail = entry->lru_prev;
+    }
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+    list->count--;
+}
+
+static void list_push_front(neg_segment_list_t *list, neg_entry_t *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = list->head;
+    if (list->head != NULL) {
+        list->head->lru_prev = entry;
+    }
+    list->head = entry;
+    if (list->tail == NULL) {
+        list->tail = entry;
+    }
+    list->count++;
+}
+
+/*
+unlink_from_hash - Remove entry from its bucket chain (internal)
+*/
+static void unlink_from_hash(neg_cache_t *nc, neg_entry_t *entry) {
+    neg_entry_t **link = &nc->buckets[neg_hash(nc, entry->key)];
+    while (*link != NULL) {
+        if (*link == entry) {
+            *link = entry->hash_next;
+            entry->hash_next = NULL;
+            return;
+        }
+        link = &(*link)->hash_next;
+    }
+}
+
+/*
+drop_entry - Remove entry from hash and its segment, then free it
+*/
+static void drop_entry(neg_cache_t *nc, neg_entry_t *entry) {
+    unlink_from_hash(nc, entry);
+    list_unlink(segment_of(nc, entry), entry);
+    free(entry);
+}
+
+/*
+trim_probation - Evict probation tail until it fits its capacity
+*/
+static void trim_probation(neg_cache_t *nc) {
+    while (nc->probation.count > nc->probation.capacity && nc->probation.tail != NULL) {
+        drop_entry(nc, nc->probation.tail);
+        nc->evictions++;
+    }
+}
+
+/*
+promote - Move a probation entry into the protected segment
+
+If protected is full, its LRU entry is demoted back to probation
+(not dropped), which in turn may push out a probation entry.
+*/
+static void promote(neg_cache_t *nc, neg_entry_t *entry) {
+    list_unlink(&nc->probation, entry);
+    entry->segment = NEG_SEG_PROTECTED;
+    list_push_front(&nc->protected_seg, entry);
+    nc->promotions++;
+
+    if (nc->protected_seg.count > nc->protected_seg.capacity) {
+        neg_entry_t *victim = nc->protected_seg.tail;
+        list_unlink(&nc->protected_seg, victim);
+        victim->segment = NEG_SEG_PROBATION;
+        list_push_front(&nc->probation, victim);
+        trim_probation(nc);
+    }
+}
+
+/* ============================================================================
+Cache Lifecycle
+============================================================================ */
+
+/*
+neg_cache_create - Create a negative cache
+*/
+neg_cache_t *neg_cache_create(int max_entries, uint32_t ttl_ms) {
+    if (max_entries < 2) {
+        fprintf(stderr, "neg_cache_create: need at least 2 entries\n");
+        return NULL;
+    }
+
+    neg_cache_t *nc = calloc(1, sizeof(neg_cache_t));
+    if (nc == NULL) {
+        perror("calloc neg_cache");
+        return NULL;
+    }
+
+    nc->num_buckets = NEG_NUM_BUCKETS;
+    nc->buckets = calloc(nc->num_buckets, sizeof(neg_entry_t *));
+    if (nc->buckets == NULL) {
+        perror("calloc neg_cache buckets");
+        free(nc);
+        return NULL;
+    }
+
+    nc->protected_seg.capacity = (int)((long)max_entries * NEG_CACHE_PROTECTED_PCT / 100);
+    if (nc->protected_seg.capacity < 1) {
+        nc->protected_seg.capacity = 1;
+    }
+    nc->probation.capacity = max_entries - nc->protected_seg.capacity;
+    if (nc->probation.capacity < 1) {
+        nc->probation.capacity = 1;
+        nc->protected_seg.capacity = max_entries - 1;
+    }
+    nc->ttl_ms = ttl_ms;
+
+    if (pthread_mutex_init(&nc->lock, NULL) != 0) {
+        free(nc->buckets);
+        free(nc);
+        return NULL;
+    }
+
+    return nc;
+}
+
+/*
+neg_cache_destroy - Destroy the cache and free all memory
+*/
+void neg_cache_destroy(neg_cache_t *nc) {
+    if (nc == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < nc->num_buckets; i++) {
+        neg_entry_t *entry = nc->buckets[i];
+        while (entry != NULL) {
+            neg_entry_t *next = entry->hash_next;
+            free(entry);
+            entry = next;
+        }
+    }
+
+    free(nc->buckets);
+    pthread_mutex_destroy(&nc->lock);
+    free(nc);
+}
+
+/* ============================================================================
+Cache Operations
+============================================================================ */
+
+/*
+neg_cache_lookup - Check whether a path is known to be missing
+*/
+bool neg_cache_lookup(neg_cache_t *nc, const char *key) {
+    if (nc == NULL || key == NULL) {
+        return false;
+    }
+
+    pthread_mutex_lock(&nc->lock);
+
+    neg_entry_t *entry = find_entry(nc, key);
+    if (entry != NULL && entry->expires_ms <= now_ms()) {
+        drop_entry(nc, entry);
+        nc->expirations++;
+        entry = NULL;
+    }
+
+    if (entry == NULL) {
+        nc->misses++;
+        pthread_mutex_unlock(&nc->lock);
+        return false;
+    }
+
+    nc->hits++;
+    if (entry->segment == NEG_SEG_PROBATION) {
+        promote(nc, entry);
+    } else {
+        list_unlink(&nc->protected_seg, entry);
+        list_push_front(&nc->protected_seg, entry);
+    }
+
+    pthread_mutex_unlock(&nc->lock);
+    return true;
+}
+
+/*
+neg_cache_insert - Record that a path is missing
+*/
+bool neg_cache_insert(neg_cache_t *nc, const char *key) {
+    if (nc == NULL || key == NULL) {
+        return false;
+    }
+
+    if (strlen(key) >= NEG_CACHE_MAX_KEY_LEN) {
+        return false;
+    }
+
+    pthread_mutex_lock(&nc->lock);
+
+    uint64_t expires = now_ms() + nc->ttl_ms;
+
+    /* Existing entry: refresh TTL, keep its segment */
+    neg_entry_t *entry = find_entry(nc, key);
+    if (entry != NULL) {
+        entry->expires_ms = expires;
+        pthread_mutex_unlock(&nc->lock);
+        return true;
+    }
+
+    entry = calloc(1, sizeof(neg_entry_t));
+    if (entry == NULL) {
+        pthread_mutex_unlock(&nc->lock);
+        return false;
+    }
+
+    strncpy(entry->key, key, NEG_CACHE_MAX_KEY_LEN - 1);
+    entry->expires_ms = expires;
+    entry->segment = NEG_SEG_PROBATION;
+
+    int bucket = neg_hash(nc, key);
+    entry->hash_next = nc->buckets[bucket];
+    nc->buckets[bucket] = entry;
+
+    list_push_front(&nc->probation, entry);
+    nc->inserts++;
+
+    /* New keys can only ever push out other probation entries */
+    trim_probation(nc);
+
+    pthread_mutex_unlock(&nc->lock);
+    return true;
+}
+
+/*
+neg_cache_remove - Forget a negative entry
+*/
+bool neg_cache_remove(neg_cache_t *nc, const char *key) {
+    if (nc == NULL || key == NULL) {
+        return false;
+    }
+
+    pthread_mutex_lock(&nc->lock);
+
+    neg_entry_t *entry = find_entry(nc, key);
+    if (entry != NULL) {
+        drop_entry(nc, entry);
+    }
+
+    pthread_mutex_unlock(&nc->lock);
+    return entry != NULL;
+}
+
+/* ============================================================================
+Statistics
+============================================================================ */
+
+/*
+neg_cache_get_stats - Get negative cache statistics
+*/
+void neg_cache_get_stats(neg_cache_t *nc, neg_cache_stats_t *stats) {
+    if (nc == NULL || stats == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&nc->lock);
+
+    stats->hits = nc->hits;
+    stats->misses = nc->misses;
+    stats->inserts = nc->inserts;
+    stats->expirations = nc->expirations;
+    stats->evictions = nc->evictions;
+    stats->promotions = nc->promotions;
+    stats->probation_entries = nc->probation.count;
+    stats->protected_entries = nc->protected_seg.count;
+
+    unsigned long total = nc->hits + nc->misses;
+    stats->hit_rate = (total > 0) ? (double)nc->hits / total : 0.0;
+
+    pthread_mutex_unlock(&nc->lock);
+}
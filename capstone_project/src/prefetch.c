@@ -0,0 +1,339 @@
+/*
+prefetch.c - Access-Pattern Prefetcher Implementation
+
+Learns "after X, Y follows within T ms" from the proxy's request stream
+and suggests files to pull into the cache ahead of time.
+
+Key concepts:
+- Direct-mapped predictor table (fixed memory, newer keys replace older)
+- Per predecessor, a few successor counters; the weakest is replaced
+  when a new successor shows up (space-saving style)
+- Counts are halved periodically so old patterns fade out
+- Token bucket on bytes to cap prefetch traffic
+
+Used in Part C (Proxy).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/fast_hash.h"
+#include "../include/prefetch.h"
+
+/* Halve all counts of a node once its total reaches this value */
+#define PREFETCH_AGING_LIMIT    1024
+
+/* ============================================================================
+Internal Helper Functions
+============================================================================ */
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void copy_key(char *dst, const char *src) {
+    strncpy(dst, src, PREFETCH_MAX_KEY_LEN - 1);
+    dst[PREFETCH_MAX_KEY_LEN - 1] = '\0';
+}
+
+/* ============================================================================
+Outstanding Prefetch Tracking
+============================================================================ */
+
+static uint64_t use_horizon_ms(prefetcher_t *pf) {
+    return (uint64_t)pf->window_ms * PREFETCH_USE_FACTOR;
+}
+
+static void mark_wasted(prefetcher_t *pf, prefetch_outstanding_t *slot) {
+    pf->wasted++;
+    pf->wasted_bytes += slot->bytes;
+    slot->key[0] = '\0';
+}
+
+/*
+outstanding_add - Start tracking a completed prefetch
+
+A colliding unused prefetch is counted as wasted.
+*/
+static void outstanding_add(prefetcher_t *pf, const char *key, size_t bytes, uint64_t now) {
+    prefetch_outstanding_t *slot = &pf->outstanding[fast_hash_str(key) % PREFETCH_OUTSTANDING];
+    if (slot->key[0] != '\0' && strcmp(slot->key, key) != 0) {
+        mark_wasted(pf, slot);
+    }
+    copy_key(slot->key, key);
+    slot->bytes = bytes;
+    slot->fetched_ms = now;
+}
+
+/*
+outstanding_use - A client requested key; credit a pending prefetch
+*/
+static void outstanding_use(prefetcher_t *pf, const char *key, uint64_t now) {
+    prefetch_outstanding_t *slot = &pf->outstanding[fast_hash_str(key) % PREFETCH_OUTSTANDING];
+    if (slot->key[0] == '\0' || strcmp(slot->key, key) != 0) {
+        return;
+    }
+    if (now - slot->fetched_ms > use_horizon_ms(pf)) {
+        mark_wasted(pf, slot);
+        return;
+    }
+    pf->used++;
+    slot->key[0] = '\0';
+}
+
+/*
+retire_expired - Count prefetches past the use horizon as wasted
+*/
+static void retire_expired(prefetcher_t *pf, uint64_t now) {
+    for (int i = 0; i < PREFETCH_OUTSTANDING; i++) {
+        prefetch_outstanding_t *slot = &pf->outstanding[i];
+        if (slot->key[0] != '\0' && now - slot->fetched_ms > use_horizon_ms(pf)) {
+            mark_wasted(pf, slot);
+        }
+    }
+}
+
+/* ============================================================================
+Learning and Prediction
+============================================================================ */
+
+/*
+learn - Record one observed transition from -> to
+*/
+static void learn(prefetcher_t *pf, const char *from, const char *to) {
+    prefetch_node_t *node = &pf->nodes[fast_hash_str(from) % PREFETCH_TABLE_SIZE];
+
+    /* Direct-mapped: a different predecessor takes over the slot */
+    if (strcmp(node->key, from) != 0) {
+        memset(node, 0, sizeof(*node));
+        copy_key(node->key, from);
+    }
+
+    node->total++;
+
+    prefetch_succ_t *weakest = &node->succ[0];
+    bool found = false;
+    for (int i = 0; i < PREFETCH_MAX_SUCCESSORS && !found; i++) {
+        prefetch_succ_t *s = &node->succ[i];
+        if (s->key[0] != '\0' && strcmp(s->key, to) == 0) {
+            s->count++;
+            found = true;
+        } else if (s->count < weakest->count) {
+            weakest = s;
+        }
+    }
+
+    /* New successor replaces the weakest (or an empty) slot */
+    if (!found) {
+        copy_key(weakest->key, to);
+        weakest->count = 1;
+    }
+
+    if (node->total >= PREFETCH_AGING_LIMIT) {
+        node->total /= 2;
+        for (int i = 0; i < PREFETCH_MAX_SUCCESSORS; i++) {
+            node->succ[i].count /= 2;
+        }
+    }
+}
+
+/*
+predict - Copy confident successors of key into out
+*/
+static int predict(prefetcher_t *pf, const char *key,
+                   char out[][PREFETCH_MAX_KEY_LEN], int max_out) {
+    prefetch_node_t *node = &pf->nodes[fast_hash_str(key) % PREFETCH_TABLE_SIZE];
+    if (strcmp(node->key, key) != 0 || node->total == 0) {
+        return 0;
+    }
+
+    int n = 0;
+    for (int i = 0; i < PREFETCH_MAX_SUCCESSORS && n < max_out; i++) {
+        prefetch_succ_t *s = &node->succ[i];
+        if (s->key[0] == '\0' || s->count < PREFETCH_MIN_COUNT) {
+            continue;
+        }
+        if ((uint64_t)s->count * 100 < (uint64_t)node->total * PREFETCH_MIN_CONFIDENCE) {
+            continue;
+        }
+        copy_key(out[n++], s->key);
+    }
+    return n;
+}
+
+/* ============================================================================
+Lifecycle
+============================================================================ */
+
+/*
+prefetcher_create - Create a prefetcher
+*/
+prefetcher_t *prefetcher_create(uint32_t window_ms, size_t budget_bytes_per_sec,
+                                int max_inflight) {
+    if (window_ms == 0 || max_inflight <= 0) {
+        fprintf(stderr, "prefetcher_create: invalid configuration\n");
+        return NULL;
+    }
+
+    prefetcher_t *pf = calloc(1, sizeof(prefetcher_t));
+    if (pf == NULL) {
+        perror("calloc prefetcher");
+        return NULL;
+    }
+    pthread_mutex_init(&pf->lock, NULL);
+
+    pf->nodes = calloc(PREFETCH_TABLE_SIZE, sizeof(prefetch_node_t));
+    pf->clients = calloc(PREFETCH_CLIENT_SLOTS, sizeof(prefetch_client_t));
+    pf->outstanding = calloc(PREFETCH_OUTSTANDING, sizeof(prefetch_outstanding_t));
+    if (pf->nodes == NULL || pf->clients == NULL || pf->outstanding == NULL) {
+        perror("calloc prefetcher tables");
+        prefetcher_destroy(pf);
+        return NULL;
+    }
+
+    pf->window_ms = window_ms;
+    pf->budget_bytes_per_sec = budget_bytes_per_sec;
+    pf->max_inflight = max_inflight;
+    pf->tokens = (double)budget_bytes_per_sec;
+    pf->last_refill_ms = now_ms();
+
+    return pf;
+}
+
+/*
+prefetcher_destroy - Free the prefetcher
+*/
+void prefetcher_destroy(prefetcher_t *pf) {
+    if (pf == NULL) {
+        return;
+    }
+    free(pf->nodes);
+    free(pf->clients);
+    free(pf->outstanding);
+    pthread_mutex_destroy(&pf->lock);
+    free(pf);
+}
+
+/* ============================================================================
+Operations
+============================================================================ */
+
+/*
+prefetcher_record - Feed one client request and get predictions
+*/
+int prefetcher_record(prefetcher_t *pf, uint32_t client_id, const char *key,
+                      char out[][PREFETCH_MAX_KEY_LEN], int max_out) {
+    if (pf == NULL || key == NULL || strlen(key) >= PREFETCH_MAX_KEY_LEN) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&pf->lock);
+
+    uint64_t now = now_ms();
+    outstanding_use(pf, key, now);
+
+    prefetch_client_t *c = &pf->clients[client_id % PREFETCH_CLIENT_SLOTS];
+    if (c->used && c->client_id == client_id &&
+        now - c->when_ms <= pf->window_ms && strcmp(c->key, key) != 0) {
+        learn(pf, c->key, key);
+    }
+    c->used = true;
+    c->client_id = client_id;
+    c->when_ms = now;
+    copy_key(c->key, key);
+
+    int n = (out != NULL) ? predict(pf, key, out, max_out) : 0;
+
+    pthread_mutex_unlock(&pf->lock);
+    return n;
+}
+
+/*
+prefetcher_begin - Ask the budget whether a prefetch may start
+*/
+bool prefetcher_begin(prefetcher_t *pf) {
+    if (pf == NULL) {
+        return false;
+    }
+
+    pthread_mutex_lock(&pf->lock);
+
+    /* Refill the token bucket; burst is capped at one second of budget */
+    uint64_t now = now_ms();
+    pf->tokens += (double)(now - pf->last_refill_ms) * pf->budget_bytes_per_sec / 1000.0;
+    if (pf->tokens > (double)pf->budget_bytes_per_sec) {
+        pf->tokens = (double)pf->budget_bytes_per_sec;
+    }
+    pf->last_refill_ms = now;
+
+    bool ok = pf->tokens > 0 && pf->inflight < pf->max_inflight;
+    if (ok) {
+        pf->inflight++;
+        pf->issued++;
+    } else {
+        pf->skipped_budget++;
+    }
+
+    pthread_mutex_unlock(&pf->lock);
+    return ok;
+}
+
+/*
+prefetcher_complete - Report the outcome of a prefetch
+*/
+void prefetcher_complete(prefetcher_t *pf, const char *key, size_t bytes, bool stored) {
+    if (pf == NULL || key == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pf->lock);
+
+    if (pf->inflight > 0) {
+        pf->inflight--;
+    }
+    /* Size is only known afterwards, so the bucket may go negative */
+    pf->tokens -= (double)bytes;
+
+    if (stored) {
+        pf->completed++;
+        pf->bytes_prefetched += bytes;
+        if (strlen(key) < PREFETCH_MAX_KEY_LEN) {
+            outstanding_add(pf, key, bytes, now_ms());
+        }
+    }
+
+    pthread_mutex_unlock(&pf->lock);
+}
+
+/* ============================================================================
+Statistics
+============================================================================ */
+
+/*
+prefetcher_get_stats - Get prefetcher statistics
+*/
+void prefetcher_get_stats(prefetcher_t *pf, prefetch_stats_t *stats) {
+    if (pf == NULL || stats == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pf->lock);
+
+    retire_expired(pf, now_ms());
+
+    stats->issued = pf->issued;
+    stats->completed = pf->completed;
+    stats->used = pf->used;
+    stats->wasted = pf->wasted;
+    stats->skipped_budget = pf->skipped_budget;
+    stats->bytes_prefetched = pf->bytes_prefetched;
+    stats->wasted_bytes = pf->wasted_bytes;
+
+    unsigned long resolved = pf->used + pf->wasted;
+    stats->accuracy = (resolved > 0) ? (double)pf->used / resolved : 0.0;
+
+    pthread_mutex_unlock(&pf->lock);
+}
@@ -15,9 +15,7 @@ This is similar to what you'll implement in GIOS Project 1!
 #include "../include/protocol.h"
 
 /* ============================================================================
-TODO: Implement these functions
-
-Study the protocol format carefully:
+Protocol format:
 
 Request:  GETFILE GET /path/to/file\r\n\r\n
 Response: GETFILE OK 12345\r\n\r\n<file_content>
@@ -25,12 +23,305 @@ Response: GETFILE OK 12345\r\n\r\n<file_content>
           GETFILE ERROR\r\n\r\n
           GETFILE INVALID\r\n\r\n
 
+Either side may add one "VALIDATOR <mtime_ns> <size>\r\n" line before the
+final blank line (see protocol.h). A request may also list the content
+codings the client decodes ("ACCEPT-ENCODING lz"), and a response whose
+body uses one names it ("ENCODING lz <decoded_length>"). A "RANGE a b"
+line asks for b bytes from offset a in a request, and describes a body
+starting at offset a of a b-byte file in a response.
+
 Key challenges:
 1. Handling partial headers (network may split data)
 2. Validating format strictly
 3. Extracting path and content length correctly
 ============================================================================ */
 
+#define PREFIX          PROTOCOL_NAME " "
+#define PREFIX_LEN      (sizeof(PREFIX) - 1)
+#define METHOD_GET      "GET "
+#define METHOD_GET_LEN  (sizeof(METHOD_GET) - 1)
+
+/*
+find_line_end - Find the next "\r\n" in [start, end)
+
+Returns pointer to '\r', or NULL if not found.
+*/
+static const char *find_line_end(const char *start, const char *end) {
+    for (const char *p = start; p + 1 < end; p++) {
+        if (p[0] == '\r' && p[1] == '\n') {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/*
+parse_validator_line - Parse "VALIDATOR <mtime_ns> <size>"
+
+The line runs from start to end (exclusive, no \r\n).
+Returns 0 on success, -1 if the line is malformed.
+*/
+static int parse_validator_line(const char *start, const char *end,
+                                gf_validator_t *validator) {
+    char line[128];
+    size_t len = (size_t)(end - start);
+    if (len >= sizeof(line)) {
+        return -1;
+    }
+    memcpy(line, start, len);
+    line[len] = '\0';
+
+    long long mtime_ns;
+    unsigned long long size;
+    char tag[16];
+    char extra;
+    if (sscanf(line, "%15s %lld %llu %c", tag, &mtime_ns, &size, &extra) != 3 ||
+        strcmp(tag, VALIDATOR_TAG) != 0) {
+        return -1;
+    }
+
+    validator->mtime_ns = mtime_ns;
+    validator->size = size;
+    return 0;
+}
+
+/*
+parse_accept_line - Parse "ACCEPT-ENCODING <coding> ..."
+
+Sets *accept_lz if "lz" is listed; other codings are ignored, so a
+client may list codings this side does not know.
+Returns 0 on success, -1 if the line is malformed.
+*/
+static int parse_accept_line(const char *start, const char *end, int *accept_lz) {
+    size_t tag_len = sizeof(ACCEPT_ENCODING_TAG) - 1;
+    if ((size_t)(end - start) <= tag_len + 1 ||
+        strncmp(start, ACCEPT_ENCODING_TAG " ", tag_len + 1) != 0) {
+        return -1;
+    }
+    const char *p = start + tag_len + 1;
+    while (p < end) {
+        const char *word = p;
+        while (p < end && *p != ' ') {
+            p++;
+        }
+        if ((size_t)(p - word) == sizeof(ENCODING_LZ) - 1 &&
+            strncmp(word, ENCODING_LZ, sizeof(ENCODING_LZ) - 1) == 0) {
+            *accept_lz = 1;
+        }
+        if (p < end) {
+            p++;
+        }
+    }
+    return 0;
+}
+
+/*
+parse_encoding_line - Parse "ENCODING lz <decoded_length>"
+
+Only "lz" is known: a body in any other coding cannot be read.
+Returns 0 on success, -1 if the line is malformed.
+*/
+static int parse_encoding_line(const char *start, const char *end, size_t *decoded_length) {
+    char line[128];
+    size_t len = (size_t)(end - start);
+    if (len >= sizeof(line)) {
+        return -1;
+    }
+    memcpy(line, start, len);
+    line[len] = '\0';
+
+    char tag[16];
+    char coding[16];
+    unsigned long long length;
+    char extra;
+    if (sscanf(line, "%15s %15s %llu %c", tag, coding, &length, &extra) != 3 ||
+        strcmp(tag, ENCODING_TAG) != 0 || strcmp(coding, ENCODING_LZ) != 0) {
+        return -1;
+    }
+    *decoded_length = (size_t)length;
+    return 0;
+}
+
+/*
+parse_range_line - Parse "RANGE <a> <b>"
+
+Returns 0 on success, -1 if the line is malformed.
+*/
+static int parse_range_line(const char *start, const char *end, uint64_t *a, uint64_t *b) {
+    char line[128];
+    size_t len = (size_t)(end - start);
+    if (len >= sizeof(line)) {
+        return -1;
+    }
+    memcpy(line, start, len);
+    line[len] = '\0';
+
+    /* %llu would take "-1" and wrap it */
+    if (memchr(line, '-', len) != NULL) {
+        return -1;
+    }
+
+    char tag[16];
+    unsigned long long first, second;
+    char extra;
+    if (sscanf(line, "%15s %llu %llu %c", tag, &first, &second, &extra) != 3 ||
+        strcmp(tag, RANGE_TAG) != 0) {
+        return -1;
+    }
+    *a = first;
+    *b = second;
+    return 0;
+}
+
+/*
+Optional header lines a parser accepts; NULL pointers mark lines not
+allowed on that side (ACCEPT-ENCODING only in requests, ENCODING only in
+responses). RANGE means (offset, length) in a request and (offset,
+file size) in a response.
+*/
+typedef struct {
+    int *has_validator;
+    gf_validator_t *validator;
+    int *accept_lz;
+    int *lz_encoded;
+    size_t *decoded_length;
+    int *has_range;
+    uint64_t *range_a;
+    uint64_t *range_b;
+} extra_lines_t;
+
+/*
+line_has_tag - Does the line [start, end) start with "tag "? (internal)
+*/
+static int line_has_tag(const char *start, const char *end, const char *tag) {
+    size_t tag_len = strlen(tag);
+    return (size_t)(end - start) > tag_len && strncmp(start, tag, tag_len) == 0 &&
+           start[tag_len] == ' ';
+}
+
+/*
+parse_extra_lines - Parse header lines after the first one
+
+[start, end) covers everything after the first "\r\n" up to (but not
+including) the final "\r\n" of the header delimiter.
+Returns 0 on success, -1 on an unknown or malformed line.
+*/
+static int parse_extra_lines(const char *start, const char *end, const extra_lines_t *out) {
+    *out->has_validator = 0;
+    *out->has_range = 0;
+    if (out->accept_lz != NULL) {
+        *out->accept_lz = 0;
+    }
+    if (out->lz_encoded != NULL) {
+        *out->lz_encoded = 0;
+        *out->decoded_length = 0;
+    }
+    while (start < end) {
+        const char *line_end = find_line_end(start, end + LINE_DELIM_LEN);
+        if (line_end == NULL || line_end > end) {
+            line_end = end;
+        }
+        if (line_has_tag(start, line_end, VALIDATOR_TAG)) {
+            if (parse_validator_line(start, line_end, out->validator) < 0) {
+                return -1;
+            }
+            *out->has_validator = 1;
+        } else if (out->accept_lz != NULL && line_has_tag(start, line_end, ACCEPT_ENCODING_TAG)) {
+            if (parse_accept_line(start, line_end, out->accept_lz) < 0) {
+                return -1;
+            }
+        } else if (out->lz_encoded != NULL && line_has_tag(start, line_end, ENCODING_TAG)) {
+            if (parse_encoding_line(start, line_end, out->decoded_length) < 0) {
+                return -1;
+            }
+            *out->lz_encoded = 1;
+        } else if (line_has_tag(start, line_end, RANGE_TAG)) {
+            if (parse_range_line(start, line_end, out->range_a, out->range_b) < 0) {
+                return -1;
+            }
+            *out->has_range = 1;
+        } else {
+            return -1;
+        }
+        start = line_end + LINE_DELIM_LEN;
+    }
+    return 0;
+}
+
+/*
+append_validator - Append "VALIDATOR m s\r\n" at buffer + len
+
+Returns the new length, or -1 on overflow.
+*/
+static int append_validator(char *buffer, size_t buflen, int len,
+                            const gf_validator_t *validator) {
+    int n = snprintf(buffer + len, buflen - len, "%s %lld %llu%s",
+                     VALIDATOR_TAG, (long long)validator->mtime_ns,
+                     (unsigned long long)validator->size, LINE_DELIM);
+    if (n < 0 || (size_t)n >= buflen - len) {
+        return -1;
+    }
+    return len + n;
+}
+
+/*
+create_response_header - Status line plus the optional lines
+
+decoded_length 0 means no ENCODING line; range (offset, file size) is
+NULL for no RANGE line. Both only go with OK / CACHED.
+*/
+static int create_response_header(char *buffer, size_t buflen, gf_status_t status,
+                                   size_t content_length, const gf_validator_t *validator,
+                                   size_t decoded_length, const uint64_t *range) {
+    if (buffer == NULL || buflen == 0 || (unsigned)status >= NUM_STATUS_CODES) {
+        return -1;
+    }
+
+    int len;
+    if (status == STATUS_OK || status == STATUS_CACHED) {
+        len = snprintf(buffer, buflen, "%s%s %zu%s", PREFIX,
+                       gf_status_to_string(status), content_length, LINE_DELIM);
+    } else {
+        len = snprintf(buffer, buflen, "%s%s%s", PREFIX,
+                       gf_status_to_string(status), LINE_DELIM);
+    }
+    if (len < 0 || (size_t)len >= buflen) {
+        return -1;
+    }
+
+    if (validator != NULL) {
+        len = append_validator(buffer, buflen, len, validator);
+        if (len < 0) {
+            return -1;
+        }
+    }
+
+    if (decoded_length != 0 && (status == STATUS_OK || status == STATUS_CACHED)) {
+        int n = snprintf(buffer + len, buflen - len, "%s %s %zu%s", ENCODING_TAG,
+                         ENCODING_LZ, decoded_length, LINE_DELIM);
+        if (n < 0 || (size_t)n >= buflen - len) {
+            return -1;
+        }
+        len += n;
+    }
+
+    if (range != NULL && (status == STATUS_OK || status == STATUS_CACHED)) {
+        int n = snprintf(buffer + len, buflen - len, "%s %llu %llu%s", RANGE_TAG,
+                         (unsigned long long)range[0], (unsigned long long)range[1],
+                         LINE_DELIM);
+        if (n < 0 || (size_t)n >= buflen - len) {
+            return -1;
+        }
+        len += n;
+    }
+
+    if ((size_t)len + LINE_DELIM_LEN >= buflen) {
+        return -1;
+    }
+    memcpy(buffer + len, LINE_DELIM, LINE_DELIM_LEN + 1);
+    return len + LINE_DELIM_LEN;
+}
+
 /*
 gf_find_header_end - Find the end of header delimiter
 
@@ -38,64 +329,51 @@ Searches for "\r\n\r\n" in the buffer.
 Returns position AFTER the delimiter, or 0 if not found.
 */
 size_t gf_find_header_end(const char *buffer, size_t buflen) {
-    /*
-     * TODO: Implement this function
-     *
-     * Hints:
-     * - Use memmem() if available (GNU extension), or implement manually
-     * - Search for HEADER_DELIM ("\r\n\r\n")
-     * - Return position after delimiter (offset + HEADER_DELIM_LEN)
-     * - Return 0 if delimiter not found
-     *
-     * Example:
-     *   buffer = "GETFILE GET /test\r\n\r\n"
-     *   returns 21 (position after \r\n\r\n)
-     */
-
-    (void)buffer;  /* Remove when implemented */
-    (void)buflen;
-
-    /* YOUR CODE HERE */
-
-    return 0;  /* Placeholder */
+    if (buffer == NULL || buflen < HEADER_DELIM_LEN) {
+        return 0;
+    }
+
+    for (size_t i = 0; i + HEADER_DELIM_LEN <= buflen; i++) {
+        if (memcmp(buffer + i, HEADER_DELIM, HEADER_DELIM_LEN) == 0) {
+            return i + HEADER_DELIM_LEN;
+        }
+    }
+    return 0;
 }
 
 /*
 gf_status_to_string - Convert status code to string
 */
 const char *gf_status_to_string(gf_status_t status) {
-    /*
-     * TODO: Implement this function
-     *
-     * Return the string representation of the status code.
-     * Use the STATUS_STRINGS array defined in protocol.h.
-     */
-
-    (void)status;
-
-    /* YOUR CODE HERE */
-
-    return "UNKNOWN";  /* Placeholder */
+    if ((unsigned)status >= NUM_STATUS_CODES) {
+        return "UNKNOWN";
+    }
+    return STATUS_STRINGS[status];
 }
 
 /*
 gf_string_to_status - Convert string to status code
 */
 gf_status_t gf_string_to_status(const char *str) {
-    /*
-     * TODO: Implement this function
-     *
-     * Compare str with each entry in STATUS_STRINGS.
-     * Return STATUS_INVALID if no match.
-     *
-     * Use strcmp() for comparison.
-     */
-
-    (void)str;
-
-    /* YOUR CODE HERE */
+    if (str == NULL) {
+        return STATUS_INVALID;
+    }
+    for (size_t i = 0; i < NUM_STATUS_CODES; i++) {
+        if (strcmp(str, STATUS_STRINGS[i]) == 0) {
+            return (gf_status_t)i;
+        }
+    }
+    return STATUS_INVALID;
+}
 
-    return STATUS_INVALID;  /* Placeholder */
+/*
+gf_validator_equal - Compare two validators
+*/
+int gf_validator_equal(const gf_validator_t *a, const gf_validator_t *b) {
+    if (a == NULL || b == NULL) {
+        return 0;
+    }
+    return a->mtime_ns == b->mtime_ns && a->size == b->size;
 }
 
 /*
@@ -104,69 +382,114 @@ gf_create_request - Build a GETFILE request string
 Format: "GETFILE GET /path\r\n\r\n"
 */
 int gf_create_request(char *buffer, size_t buflen, const char *path) {
-    /*
-     * TODO: Implement this function
-     *
-     * Steps:
-     * 1. Validate inputs (buffer, path not NULL, buflen > 0)
-     * 2. Check path starts with '/'
-     * 3. Use snprintf to build: "GETFILE GET %s\r\n\r\n"
-     * 4. Check for buffer overflow (snprintf return value)
-     * 5. Return number of bytes written (not including null terminator)
-     *
-     * Example:
-     *   path = "/test.txt"
-     *   buffer = "GETFILE GET /test.txt\r\n\r\n"
-     *   returns 25
-     */
-
     if (buffer == NULL || path == NULL || buflen == 0) {
         return -1;
     }
 
-    /* YOUR CODE HERE */
+    if (path[0] != '/') {
+        return -1;
+    }
+
+    int n = snprintf(buffer, buflen, "%s%s%s%s", PREFIX, METHOD_GET, path, HEADER_DELIM);
+    if (n < 0 || (size_t)n >= buflen) {
+        return -1;
+    }
+    return n;
+}
+
+/*
+gf_create_conditional_request - Build a GETFILE request with a validator
+
+Format: "GETFILE GET /path\r\nVALIDATOR <mtime_ns> <size>\r\n\r\n"
+*/
+int gf_create_conditional_request(char *buffer, size_t buflen, const char *path,
+                                  const gf_validator_t *validator) {
+    if (buffer == NULL || path == NULL || buflen == 0 || path[0] != '/') {
+        return -1;
+    }
+    if (validator == NULL) {
+        return gf_create_request(buffer, buflen, path);
+    }
+
+    int len = snprintf(buffer, buflen, "%s%s%s%s", PREFIX, METHOD_GET, path, LINE_DELIM);
+    if (len < 0 || (size_t)len >= buflen) {
+        return -1;
+    }
+    len = append_validator(buffer, buflen, len, validator);
+    if (len < 0 || (size_t)len + LINE_DELIM_LEN >= buflen) {
+        return -1;
+    }
+    memcpy(buffer + len, LINE_DELIM, LINE_DELIM_LEN + 1);
+    return len + LINE_DELIM_LEN;
+}
+
+/*
+gf_create_lz_request - Build a GETFILE request that accepts lz bodies
+
+Format: "GETFILE GET /path\r\n[VALIDATOR ...\r\n]ACCEPT-ENCODING lz\r\n\r\n"
+*/
+int gf_create_lz_request(char *buffer, size_t buflen, const char *path,
+                         const gf_validator_t *validator) {
+    if (buffer == NULL || path == NULL || buflen == 0 || path[0] != '/') {
+        return -1;
+    }
+
+    int len = snprintf(buffer, buflen, "%s%s%s%s", PREFIX, METHOD_GET, path, LINE_DELIM);
+    if (len < 0 || (size_t)len >= buflen) {
+        return -1;
+    }
+    if (validator != NULL) {
+        len = append_validator(buffer, buflen, len, validator);
+        if (len < 0) {
+            return -1;
+        }
+    }
+    int n = snprintf(buffer + len, buflen - len, "%s %s%s", ACCEPT_ENCODING_TAG,
+                     ENCODING_LZ, HEADER_DELIM);
+    if (n < 0 || (size_t)n >= buflen - len) {
+        return -1;
+    }
+    return len + n;
+}
+
+/*
+gf_create_range_request - Build a GETFILE request for a byte range
 
-    return -1;  /* Placeholder */
+Format: "GETFILE GET /path\r\n[VALIDATOR ...\r\n]RANGE <offset> <length>\r\n\r\n"
+*/
+int gf_create_range_request(char *buffer, size_t buflen, const char *path,
+                            uint64_t offset, uint64_t length,
+                            const gf_validator_t *validator) {
+    if (buffer == NULL || path == NULL || buflen == 0 || path[0] != '/') {
+        return -1;
+    }
+
+    int len = snprintf(buffer, buflen, "%s%s%s%s", PREFIX, METHOD_GET, path, LINE_DELIM);
+    if (len < 0 || (size_t)len >= buflen) {
+        return -1;
+    }
+    if (validator != NULL) {
+        len = append_validator(buffer, buflen, len, validator);
+        if (len < 0) {
+            return -1;
+        }
+    }
+    int n = snprintf(buffer + len, buflen - len, "%s %llu %llu%s", RANGE_TAG,
+                     (unsigned long long)offset, (unsigned long long)length, HEADER_DELIM);
+    if (n < 0 || (size_t)n >= buflen - len) {
+        return -1;
+    }
+    return len + n;
 }
 
 /*
 gf_parse_request - Parse a GETFILE request
 
 Expected format: "GETFILE GET /path\r\n\r\n"
+(optionally with VALIDATOR, ACCEPT-ENCODING and RANGE lines before the
+blank line)
 */
 int gf_parse_request(const char *buffer, size_t buflen, gf_request_t *request) {
-    /*
-     * TODO: Implement this function
-     *
-     * This is the most complex function - parse carefully!
-     *
-     * Steps:
-     * 1. Initialize request->valid = 0
-     * 2. Find header end (\r\n\r\n) - if not found, return 0 (incomplete)
-     * 3. Verify "GETFILE " prefix (must match exactly, with space)
-     * 4. Verify "GET " method (must match exactly, with space)
-     * 5. Extract path (everything after "GET " until "\r\n")
-     * 6. Validate path (starts with '/', reasonable length)
-     * 7. Copy path to request->path
-     * 8. Set request->valid = 1
-     * 9. Return number of bytes consumed (header_end position)
-     *
-     * Error handling:
-     * - If header incomplete: return 0
-     * - If format invalid: set request->valid = 0, return -1
-     *
-     * Hints:
-     * - Use strncmp() for prefix matching
-     * - Use memcpy() to copy path (don't include \r\n)
-     * - Null-terminate the path!
-     *
-     * Example:
-     *   buffer = "GETFILE GET /test.txt\r\n\r\n"
-     *   request->path = "/test.txt"
-     *   request->valid = 1
-     *   returns 25
-     */
-
     if (buffer == NULL || request == NULL) {
         return -1;
     }
@@ -174,10 +497,50 @@ int gf_parse_request(const char *buffer, size_t buflen, gf_request_t *request) {
     request->valid = 0;
     request->path[0] = '\0';
     request->path_len = 0;
+    request->has_validator = 0;
+    request->accept_lz = 0;
+    request->has_range = 0;
+
+    size_t header_end = gf_find_header_end(buffer, buflen);
+    if (header_end == 0) {
+        return 0;  /* Incomplete */
+    }
+
+    /* Everything before the final "\r\n" of the delimiter */
+    const char *end = buffer + header_end - LINE_DELIM_LEN;
+
+    if (header_end < PREFIX_LEN + METHOD_GET_LEN ||
+        strncmp(buffer, PREFIX, PREFIX_LEN) != 0 ||
+        strncmp(buffer + PREFIX_LEN, METHOD_GET, METHOD_GET_LEN) != 0) {
+        return -1;
+    }
+
+    const char *path = buffer + PREFIX_LEN + METHOD_GET_LEN;
+    const char *path_end = find_line_end(path, end + LINE_DELIM_LEN);
+    size_t path_len = (size_t)(path_end - path);
+
+    if (path_len == 0 || path_len >= MAX_PATH_LEN || path[0] != '/') {
+        return -1;
+    }
+    if (memchr(path, '\0', path_len) != NULL) {
+        return -1;
+    }
+
+    extra_lines_t extra = { &request->has_validator, &request->validator,
+                            &request->accept_lz, NULL, NULL,
+                            &request->has_range, &request->range_offset,
+                            &request->range_length };
+    if (parse_extra_lines(path_end + LINE_DELIM_LEN, end, &extra) < 0 ||
+        (request->has_range && request->range_length == 0)) {
+        return -1;
+    }
 
-    /* YOUR CODE HERE */
+    memcpy(request->path, path, path_len);
+    request->path[path_len] = '\0';
+    request->path_len = path_len;
+    request->valid = 1;
 
-    return 0;  /* Placeholder - incomplete */
+    return (int)header_end;
 }
 
 /*
@@ -187,61 +550,55 @@ Format: "GETFILE OK 12345\r\n\r\n" or "GETFILE FILE_NOT_FOUND\r\n\r\n"
 */
 int gf_create_response_header(char *buffer, size_t buflen,
                                gf_status_t status, size_t content_length) {
-    /*
-     * TODO: Implement this function
-     *
-     * Steps:
-     * 1. Validate inputs
-     * 2. If status is OK or CACHED, include content_length:
-     *    "GETFILE OK 12345\r\n\r\n"
-     * 3. Otherwise, just status:
-     *    "GETFILE FILE_NOT_FOUND\r\n\r\n"
-     * 4. Check for buffer overflow
-     * 5. Return bytes written
-     *
-     * Use gf_status_to_string() to get the status string.
-     */
+    return gf_create_response_header_validated(buffer, buflen, status,
+                                               content_length, NULL);
+}
 
-    if (buffer == NULL || buflen == 0) {
-        return -1;
-    }
+/*
+gf_create_response_header_validated - Build a response header with a validator
+*/
+int gf_create_response_header_validated(char *buffer, size_t buflen,
+                                        gf_status_t status, size_t content_length,
+                                        const gf_validator_t *validator) {
+    return gf_create_response_header_lz(buffer, buflen, status, content_length,
+                                        validator, 0);
+}
+
+/*
+gf_create_response_header_lz - Build a response header, announcing an
+lz body if decoded_length is not 0
+
+Format: "GETFILE CACHED 812\r\n[VALIDATOR ...\r\n]ENCODING lz 4096\r\n\r\n"
+*/
+int gf_create_response_header_lz(char *buffer, size_t buflen,
+                                 gf_status_t status, size_t content_length,
+                                 const gf_validator_t *validator, size_t decoded_length) {
+    return create_response_header(buffer, buflen, status, content_length, validator,
+                                  decoded_length, NULL);
+}
 
-    /* YOUR CODE HERE */
+/*
+gf_create_response_header_range - Build a response header for a byte range
 
-    return -1;  /* Placeholder */
+Format: "GETFILE OK 1000\r\n[VALIDATOR ...\r\n]RANGE <offset> <size>\r\n\r\n"
+*/
+int gf_create_response_header_range(char *buffer, size_t buflen,
+                                    gf_status_t status, size_t content_length,
+                                    const gf_validator_t *validator,
+                                    uint64_t offset, uint64_t total_length) {
+    const uint64_t range[2] = { offset, total_length };
+    return create_response_header(buffer, buflen, status, content_length, validator,
+                                  0, range);
 }
 
 /*
 gf_parse_response_header - Parse a GETFILE response header
 
 Handles: "GETFILE OK 12345\r\n\r\n" and "GETFILE FILE_NOT_FOUND\r\n\r\n"
+(optionally with VALIDATOR, ENCODING and RANGE lines before the blank line)
 */
 int gf_parse_response_header(const char *buffer, size_t buflen,
                               gf_response_t *response) {
-    /*
-     * TODO: Implement this function
-     *
-     * Steps:
-     * 1. Initialize response->header_complete = 0
-     * 2. Find header end - if not found, return 0 (incomplete)
-     * 3. Verify "GETFILE " prefix
-     * 4. Extract status string (next word)
-     * 5. Convert to status code using gf_string_to_status()
-     * 6. If status is OK/CACHED, extract content_length (number after status)
-     * 7. Set response->header_complete = 1
-     * 8. Return header size (bytes consumed)
-     *
-     * Parsing the content length:
-     * - For "GETFILE OK 12345\r\n\r\n"
-     * - Skip "GETFILE OK "
-     * - Read number until "\r\n"
-     * - Use strtoul() or atol()
-     *
-     * Hints:
-     * - Be careful with string manipulation
-     * - Handle missing content_length gracefully
-     */
-
     if (buffer == NULL || response == NULL) {
         return -1;
     }
@@ -249,10 +606,73 @@ int gf_parse_response_header(const char *buffer, size_t buflen,
     response->header_complete = 0;
     response->status = STATUS_INVALID;
     response->content_length = 0;
+    response->has_validator = 0;
+    response->lz_encoded = 0;
+    response->decoded_length = 0;
+    response->has_range = 0;
+
+    size_t header_end = gf_find_header_end(buffer, buflen);
+    if (header_end == 0) {
+        return 0;  /* Incomplete */
+    }
+
+    const char *end = buffer + header_end - LINE_DELIM_LEN;
+
+    if (header_end < PREFIX_LEN || strncmp(buffer, PREFIX, PREFIX_LEN) != 0) {
+        return -1;
+    }
+
+    const char *line = buffer + PREFIX_LEN;
+    const char *line_end = find_line_end(line, end + LINE_DELIM_LEN);
+
+    /* Status word runs until a space or end of line */
+    const char *word_end = line;
+    while (word_end < line_end && *word_end != ' ') {
+        word_end++;
+    }
 
-    /* YOUR CODE HERE */
+    char status_str[32];
+    size_t word_len = (size_t)(word_end - line);
+    if (word_len == 0 || word_len >= sizeof(status_str)) {
+        return -1;
+    }
+    memcpy(status_str, line, word_len);
+    status_str[word_len] = '\0';
+
+    response->status = gf_string_to_status(status_str);
+    if (response->status == STATUS_INVALID && strcmp(status_str, "INVALID") != 0) {
+        return -1;
+    }
+
+    if (response->status == STATUS_OK || response->status == STATUS_CACHED) {
+        if (word_end >= line_end || !isdigit((unsigned char)word_end[1])) {
+            return -1;
+        }
+        char *num_end;
+        unsigned long long length = strtoull(word_end + 1, &num_end, 10);
+        if (num_end != line_end) {
+            return -1;
+        }
+        response->content_length = (size_t)length;
+    }
+
+    extra_lines_t extra = { &response->has_validator, &response->validator,
+                            NULL, &response->lz_encoded, &response->decoded_length,
+                            &response->has_range, &response->range_offset,
+                            &response->total_length };
+    if (parse_extra_lines(line_end + LINE_DELIM_LEN, end, &extra) < 0) {
+        return -1;
+    }
+
+    /* The body must lie within the file (a range past its end is empty) */
+    if (response->has_range && response->content_length > 0 &&
+        (response->range_offset >= response->total_length ||
+         response->content_length > response->total_length - response->range_offset)) {
+        return -1;
+    }
 
-    return 0;  /* Placeholder - incomplete */
+    response->header_complete = 1;
+    return (int)header_end;
 }
 
 /* ============================================================================
@@ -9,13 +9,35 @@ Architecture:
              |
           [Cache]
 
-Usage: ./proxy [proxy_port] [server_host] [server_port]
+Usage: ./proxy [-e loops] [-p policy] [-s snapshot] [-d disk_file] [-z] [proxy_port]
+               [server_host] [server_port] [replica_host] [replica_port]
 
 The proxy:
 1. Receives requests from clients
 2. Checks cache for requested file
 3. If cache hit: return cached content
 4. If cache miss: forward request to server, cache response, return to client
+5. FILE_NOT_FOUND answers are remembered briefly in a negative cache
+6. Expired entries are served stale while a conditional GET (validator)
+   revalidates them in the background
+7. A successor predictor prefetches files that usually follow a request
+8. With a replica, backend requests slower than the recent p95 are
+   hedged: the replica gets a duplicate and the first answer wins
+   (blocking mode only; -e refuses a replica)
+
+By default clients are served one at a time with blocking I/O. With -e,
+a few epoll loops run every client and backend connection as a
+non-blocking state machine (cache hits are answered on the loop thread).
+Cache hits are zero-copy: the entry's buffer is pinned and written to the
+socket together with the header in one sendmsg().
+-p picks the cache replacement policy (CLOCK by default, so hits only
+take a shard's read lock).
+With -z, cached files that compress well are stored compressed. Clients
+that send "ACCEPT-ENCODING lz" get them as stored (still zero-copy);
+every other client gets the file decoded.
+Files larger than CACHE_CHUNK_SIZE are cached as chunks, and clients may
+ask for a byte range (RANGE line); a response is assembled from the
+cached chunks plus one backend fetch of the missing ones.
 */
 
 #include <stdio.h>
@@ -24,28 +46,76 @@ The proxy:
 #include <unistd.h>
 #include <signal.h>
 #include <errno.h>
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 #include "../include/protocol.h"
 #include "../include/socket_utils.h"
 #include "../include/file_utils.h"
 #include "../include/cache.h"
+#include "../include/cache_disk.h"
+#include "../include/lz.h"
+#include "../include/neg_cache.h"
+#include "../include/prefetch.h"
+#include "../include/hedge.h"
 
 /* ============================================================================
 Configuration
 ============================================================================ */
 
 #define CACHE_SIZE          (10 * 1024 * 1024)  /* 10 MB cache */
+#define NEG_CACHE_ENTRIES   DEFAULT_NEG_CACHE_ENTRIES
+#define NEG_CACHE_TTL_MS    DEFAULT_NEG_CACHE_TTL_MS   /* missing files re-checked after 5s */
+#define CACHE_TTL_MS        30000   /* entries are fresh for 30s */
+#define CACHE_STALE_MS      60000   /* then served stale for up to 60s while revalidating */
+#define BACKEND_TIMEOUT_MS  5000    /* a backend silent this long has failed */
+#define REVALIDATE_TIMEOUT_MS (2 * BACKEND_TIMEOUT_MS)  /* then another caller retries */
+#define PREFETCH_WINDOW_MS  DEFAULT_PREFETCH_WINDOW_MS
+#define PREFETCH_BUDGET     (1024 * 1024)       /* prefetch at most 1 MB/s */
+#define PREFETCH_INFLIGHT   4                   /* concurrent prefetches */
+#define PREFETCH_FANOUT     2                   /* predictions acted on per request */
+#define HEDGE_RATIO         DEFAULT_HEDGE_RATIO /* hedge at most 5% of backend requests */
+#define HEDGE_DELAY_MS      DEFAULT_HEDGE_DELAY_MS
 
 static volatile sig_atomic_t running = 1;
 static int proxy_fd = -1;
 static cache_t *cache = NULL;
+static neg_cache_t *neg_cache = NULL;
+static prefetcher_t *prefetcher = NULL;
+static hedge_t *hedge = NULL;              /* NULL unless a replica is configured */
+
+/* Background fetches still running (waited for at shutdown) */
+static int background_inflight = 0;
+static pthread_mutex_t background_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t background_done = PTHREAD_COND_INITIALIZER;
 
 /* Backend server configuration */
 static char server_host[256] = "localhost";
 static int server_port = DEFAULT_PORT;
+static char replica_host[256] = "";
+static int replica_port = DEFAULT_PORT;
+static cache_policy_t cache_policy = CACHE_POLICY_CLOCK;
+
+/* Cache snapshot restored at startup and written at shutdown (-s) */
+static const char *snapshot_path = NULL;
+
+/* Log file of the disk tier behind the memory cache (-d) */
+static const char *disk_path = NULL;
+
+/* Store compressible files compressed (-z) */
+static int compress_cache = 0;
 
 /* ============================================================================
 Signal Handler
@@ -65,237 +135,2158 @@ Backend Server Communication
 ============================================================================ */
 
 /*
-fetch_from_server - Fetch a file from the backend server
-
-Returns: 0 on success (data and size filled), -1 on error
-On success, caller must free *data!
-*/
-static int fetch_from_server(const char *path, char **data, size_t *size) {
-    /*
-     * TODO: Implement fetching from backend server
-     *
-     * Steps:
-     * 1. Connect to backend server
-     *    int fd = create_client_socket(server_host, server_port);
-     *
-     * 2. Send GETFILE request
-     *    char request[MAX_REQUEST_LEN];
-     *    int len = gf_create_request(request, sizeof(request), path);
-     *    send_all(fd, request, len);
-     *
-     * 3. Receive response header
-     *    char header_buf[MAX_HEADER_LEN];
-     *    recv_until(fd, header_buf, sizeof(header_buf), HEADER_DELIM);
-     *
-     * 4. Parse response
-     *    gf_response_t response;
-     *    gf_parse_response_header(header_buf, n, &response);
-     *
-     * 5. If not OK, return -1
-     *
-     * 6. Receive file content
-     *    *data = malloc(response.content_length);
-     *    recv_all(fd, *data, response.content_length);
-     *    *size = response.content_length;
-     *
-     * 7. Close connection, return 0
-     */
+Result of one backend fetch
+*/
+typedef struct {
+    gf_status_t status;         /* Backend status (STATUS_ERROR on transport failure) */
+    char *data;                 /* File content, only for STATUS_OK (caller frees) */
+    size_t size;                /* Content length */
+    int has_validator;          /* Backend sent a validator */
+    gf_validator_t validator;   /* Version of the file */
+    uint64_t offset;            /* File offset of data (0 unless a RANGE answer) */
+    uint64_t file_size;         /* Size of the whole file */
+    uint32_t fetch_us;          /* How long the fetch took (the refetch cost) */
+} fetch_result_t;
+
+/*
+now_us - Monotonic clock in microseconds (for backend latency)
+*/
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/*
+send_backend_request - Connect to a backend and send a request
+
+Returns: connected socket, or -1 on error.
+*/
+static int send_backend_request(const char *host, int port, const char *request, int len) {
+    int fd = create_client_socket(host, port);
+    if (fd < 0) {
+        return -1;
+    }
+
+    /* A hung backend fails the blocking send/recv instead of holding
+       the thread (and any revalidation it was elected for) forever */
+    struct timeval tv = { BACKEND_TIMEOUT_MS / 1000, (BACKEND_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    if (send_all(fd, request, len) != len) {
+        close_socket(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+wait_for_response - Wait until fd has something to read
+
+Returns: 1 if readable (or closed), 0 on timeout, -1 on error.
+A timeout_ms of -1 waits forever.
+*/
+static int wait_for_response(int fd, int timeout_ms) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    int rc;
+    do {
+        rc = poll(&pfd, 1, timeout_ms);
+    } while (rc < 0 && errno == EINTR && running);
+    return rc;
+}
+
+/*
+race_replica - Hedge a slow primary request to the replica
+
+Waits up to the hedge delay (p95 of recent backend latencies) for the
+primary. If it has not answered and the hedge budget allows, the same
+request goes to the replica and whichever backend answers first wins;
+the other connection is closed, which cancels it. No wait is longer
+than BACKEND_TIMEOUT_MS; on timeout the primary is returned, and its
+receive timeout fails the read.
+
+Returns: the socket to read the response from.
+*/
+static int race_replica(int primary_fd, uint64_t started_us, const char *request, int len) {
+    uint32_t delay_ms = hedge_begin_request(hedge);
+
+    if (wait_for_response(primary_fd, (int)delay_ms) != 0 || !hedge_try_acquire(hedge)) {
+        wait_for_response(primary_fd, BACKEND_TIMEOUT_MS);
+        hedge_record_latency(hedge, now_us() - started_us);
+        return primary_fd;
+    }
+
+    uint64_t hedged_us = now_us();
+    int replica_fd = send_backend_request(replica_host, replica_port, request, len);
+    if (replica_fd < 0) {
+        wait_for_response(primary_fd, BACKEND_TIMEOUT_MS);
+        hedge_record_latency(hedge, now_us() - started_us);
+        return primary_fd;
+    }
+
+    struct pollfd pfds[2] = {
+        { .fd = primary_fd, .events = POLLIN },
+        { .fd = replica_fd, .events = POLLIN },
+    };
+    int winner = -1;
+    while (winner < 0) {
+        int rc = poll(pfds, 2, BACKEND_TIMEOUT_MS);
+        if (rc < 0 && errno == EINTR && running) {
+            continue;
+        }
+        if (rc <= 0) {
+            winner = 0;     /* Error or timeout: the primary's read fails */
+            break;
+        }
+        for (int i = 0; i < 2 && winner < 0; i++) {
+            if (pfds[i].revents & POLLIN) {
+                winner = i;
+            } else if (pfds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                /* A failed backend drops out; keep waiting on the other */
+                pfds[i].fd = -1;
+                if (pfds[1 - i].fd < 0) {
+                    winner = i;
+                }
+            }
+        }
+    }
+
+    if (winner == 1) {
+        hedge_record_win(hedge);
+        hedge_record_latency(hedge, now_us() - hedged_us);
+        close_socket(primary_fd);
+        return replica_fd;
+    }
+    hedge_record_latency(hedge, now_us() - started_us);
+    close_socket(replica_fd);
+    return primary_fd;
+}
+
+/*
+fetch_cost - Microseconds since started_us, as a cache refetch cost
+*/
+static uint32_t fetch_cost(uint64_t started_us) {
+    uint64_t elapsed = now_us() - started_us;
+    return elapsed < UINT32_MAX ? (uint32_t)elapsed : UINT32_MAX;
+}
+
+/*
+fetch_from_server - Fetch a file, or part of it, from the backend server
+
+@param if_validator: Version we already have (NULL for a plain GET)
+@param offset, length: Byte range wanted (length 0 = the whole file)
+
+With a replica configured, slow requests are hedged (see race_replica).
+A backend that ignores RANGE answers with the whole file, which
+result->offset and file_size describe either way.
 
+Returns: 0 if the backend answered OK (data filled) or NOT_MODIFIED,
+-1 otherwise. result->status is always set, so callers can tell
+FILE_NOT_FOUND apart from transport errors.
+On OK, caller must free result->data!
+*/
+static int fetch_from_server(const char *path, const gf_validator_t *if_validator,
+                             uint64_t offset, uint64_t length, fetch_result_t *result) {
     printf("Fetching %s from backend server %s:%d\n", path, server_host, server_port);
 
-    /* YOUR CODE HERE */
+    memset(result, 0, sizeof(*result));
+    result->status = STATUS_ERROR;
+
+    char request[MAX_REQUEST_LEN];
+    int len = length == 0
+              ? gf_create_conditional_request(request, sizeof(request), path, if_validator)
+              : gf_create_range_request(request, sizeof(request), path, offset, length,
+                                        if_validator);
+    if (len < 0) {
+        return -1;
+    }
+
+    uint64_t started_us = now_us();
+    int fd = send_backend_request(server_host, server_port, request, len);
+    if (fd < 0) {
+        return -1;
+    }
+    if (hedge != NULL) {
+        fd = race_replica(fd, started_us, request, len);
+    }
+
+    char header_buf[MAX_HEADER_LEN];
+    ssize_t n = recv_until(fd, header_buf, sizeof(header_buf), HEADER_DELIM);
+    if (n <= 0) {
+        close_socket(fd);
+        return -1;
+    }
+
+    gf_response_t response;
+    int header_len = gf_parse_response_header(header_buf, n, &response);
+    if (header_len <= 0) {
+        close_socket(fd);
+        return -1;
+    }
+
+    result->status = response.status;
+    result->has_validator = response.has_validator;
+    result->validator = response.validator;
+    result->offset = response.has_range ? response.range_offset : 0;
+    result->file_size = response.has_range ? response.total_length : response.content_length;
+
+    if (response.status == STATUS_NOT_MODIFIED) {
+        close_socket(fd);
+        return 0;
+    }
+    if (response.status != STATUS_OK) {
+        close_socket(fd);
+        return -1;
+    }
+
+    char *buf = malloc(response.content_length > 0 ? response.content_length : 1);
+    if (buf == NULL) {
+        close_socket(fd);
+        result->status = STATUS_ERROR;
+        return -1;
+    }
+
+    /* recv_until may have read past the header into the body */
+    size_t have = (size_t)n - header_len;
+    if (have > response.content_length) {
+        have = response.content_length;
+    }
+    memcpy(buf, header_buf + header_len, have);
+
+    if (have < response.content_length) {
+        size_t want = response.content_length - have;
+        if (recv_all(fd, buf + have, want) != (ssize_t)want) {
+            free(buf);
+            close_socket(fd);
+            result->status = STATUS_ERROR;
+            return -1;
+        }
+    }
+
+    close_socket(fd);
+    result->data = buf;
+    result->size = response.content_length;
+    result->fetch_us = fetch_cost(started_us);
+    return 0;
+}
+
+/*
+cache_store - Put a fetched file (or part of it) into the cache with its
+validator, TTL and fetch latency (the cost GDSF weighs)
+
+Files up to CACHE_CHUNK_SIZE are cached whole. Larger files, and any
+range of one, are cached as chunks; a chunk's validator always carries
+the file size, even if the backend sent no validator.
 
-    (void)path;
-    (void)data;
-    (void)size;
+Returns: true if anything was cached
+*/
+static bool cache_store(const char *path, const fetch_result_t *result) {
+    if (result->offset == 0 && result->size == result->file_size &&
+        result->size <= CACHE_CHUNK_SIZE) {
+        cache_validator_t cv = { result->validator.mtime_ns, result->validator.size };
+        return cache_put_cost(cache, path, result->data, result->size,
+                              result->has_validator ? &cv : NULL, CACHE_TTL_MS, result->fetch_us);
+    }
 
-    return -1;  /* Placeholder */
+    cache_validator_t cv = { result->has_validator ? result->validator.mtime_ns : 0,
+                             result->file_size };
+    if (cache_put_chunks(cache, path, result->offset, result->data, result->size, &cv,
+                         CACHE_TTL_MS, result->fetch_us) == 0) {
+        return false;
+    }
+    /* A file is cached whole or in chunks, not both (it grew) */
+    cache_remove(cache, path);
+    return true;
 }
 
 /* ============================================================================
-Request Handling
+Background Fetches
 ============================================================================ */
 
 /*
-send_cached_response - Send cached file to client
+spawn_background - Run fn(job) on a detached thread
+
+Returns 0 on success, -1 if the thread could not be created
+(job is not freed in that case).
 */
-static int send_cached_response(int client_fd, const char *data, size_t size) {
-    /*
-     * TODO: Send a cached response
-     *
-     * Steps:
-     * 1. Create response header with STATUS_CACHED
-     *    gf_create_response_header(header, sizeof(header), STATUS_CACHED, size);
-     * 2. Send header
-     *    send_all(client_fd, header, header_len);
-     * 3. Send data
-     *    send_all(client_fd, data, size);
-     */
+static int spawn_background(void *(*fn)(void *), void *job) {
+    pthread_mutex_lock(&background_lock);
+    background_inflight++;
+    pthread_mutex_unlock(&background_lock);
 
-    (void)client_fd;
-    (void)data;
-    (void)size;
+    pthread_attr_t attr;
+    pthread_t tid;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&tid, &attr, fn, job);
+    pthread_attr_destroy(&attr);
 
-    /* YOUR CODE HERE */
+    if (rc != 0) {
+        pthread_mutex_lock(&background_lock);
+        background_inflight--;
+        pthread_mutex_unlock(&background_lock);
+        return -1;
+    }
+    return 0;
+}
 
-    return -1;  /* Placeholder */
+/*
+background_finished - Called by every background thread before exiting
+*/
+static void background_finished(void) {
+    pthread_mutex_lock(&background_lock);
+    background_inflight--;
+    pthread_cond_broadcast(&background_done);
+    pthread_mutex_unlock(&background_lock);
 }
 
 /*
-handle_proxy_request - Handle a single proxy request
+wait_for_background - Block until no background fetch is running
 */
-static void handle_proxy_request(int client_fd) {
-    /*
-     * TODO: Implement proxy request handling
-     *
-     * This is the core proxy logic!
-     *
-     * Steps:
-     * 1. Receive and parse client request
-     *    char buffer[MAX_HEADER_LEN];
-     *    ssize_t n = recv_until(client_fd, buffer, sizeof(buffer), HEADER_DELIM);
-     *    gf_request_t request;
-     *    gf_parse_request(buffer, n, &request);
-     *
-     * 2. Validate request
-     *    if (!request.valid || !validate_path(request.path)) {
-     *        // Send error response
-     *        return;
-     *    }
-     *
-     * 3. Check cache
-     *    char *data;
-     *    size_t size;
-     *    if (cache_get_copy(cache, request.path, &data, &size)) {
-     *        // CACHE HIT!
-     *        printf("Cache HIT for %s\n", request.path);
-     *        send_cached_response(client_fd, data, size);
-     *        free(data);
-     *        return;
-     *    }
-     *
-     * 4. Cache miss - fetch from backend
-     *    printf("Cache MISS for %s\n", request.path);
-     *    if (fetch_from_server(request.path, &data, &size) < 0) {
-     *        // Send error response to client
-     *        return;
-     *    }
-     *
-     * 5. Cache the response
-     *    cache_put(cache, request.path, data, size);
-     *
-     * 6. Send response to client (use STATUS_OK, not CACHED)
-     *    char header[256];
-     *    gf_create_response_header(header, sizeof(header), STATUS_OK, size);
-     *    send_all(client_fd, header, header_len);
-     *    send_all(client_fd, data, size);
-     *
-     * 7. Cleanup
-     *    free(data);
-     */
-
-    printf("Handling proxy request\n");
-
-    /* YOUR CODE HERE */
-
-    (void)client_fd;
+static void wait_for_background(void) {
+    pthread_mutex_lock(&background_lock);
+    while (background_inflight > 0) {
+        pthread_cond_wait(&background_done, &background_lock);
+    }
+    pthread_mutex_unlock(&background_lock);
 }
 
-/* ============================================================================
-Statistics Display
-============================================================================ */
+/* Chunk number meaning "the whole file" in a revalidation */
+#define WHOLE_FILE  UINT64_MAX
 
-static void print_cache_stats(void) {
-    if (cache == NULL) return;
+typedef struct {
+    char path[MAX_KEY_LEN];
+    uint64_t chunk;             /* Chunk to refresh, or WHOLE_FILE */
+    int has_validator;
+    gf_validator_t validator;
+} revalidate_job_t;
 
-    cache_stats_t stats;
-    cache_get_stats(cache, &stats);
+/*
+revalidate_worker - Refresh one stale entry while clients keep getting it
 
-    printf("\n=== Cache Statistics ===\n");
-    printf("Entries: %d\n", stats.num_entries);
-    printf("Size: %zu / %zu bytes (%.1f%%)\n",
-           stats.current_size, stats.max_size,
-           100.0 * stats.current_size / stats.max_size);
-    printf("Hits: %lu, Misses: %lu, Hit Rate: %.1f%%\n",
-           stats.hits, stats.misses, stats.hit_rate * 100);
-    printf("Evictions: %lu\n", stats.evictions);
-    printf("========================\n");
+Exactly one of these runs per stale key (the cache elects it), so a hot
+stale file causes a single backend request. A stale chunk is refreshed
+with a conditional request for that chunk alone.
+*/
+static void *revalidate_worker(void *arg) {
+    revalidate_job_t *job = arg;
+    fetch_result_t result;
+    char key[MAX_KEY_LEN];
+    const gf_validator_t *validator = job->has_validator ? &job->validator : NULL;
+
+    if (job->chunk == WHOLE_FILE) {
+        snprintf(key, sizeof(key), "%s", job->path);
+        fetch_from_server(job->path, validator, 0, 0, &result);
+    } else {
+        cache_chunk_key(key, sizeof(key), job->path, job->chunk);
+        fetch_from_server(job->path, validator, job->chunk * CACHE_CHUNK_SIZE,
+                          CACHE_CHUNK_SIZE, &result);
+    }
+
+    switch (result.status) {
+    case STATUS_NOT_MODIFIED:
+        cache_revalidated(cache, key, CACHE_TTL_MS);
+        break;
+    case STATUS_OK:
+        /* A failed put leaves the stale entry in place: let the next
+           stale hit try again rather than wait out the timeout */
+        if (!cache_store(job->path, &result)) {
+            cache_revalidate_failed(cache, key);
+        }
+        free(result.data);
+        break;
+    case STATUS_FILE_NOT_FOUND:
+        cache_remove(cache, key);
+        neg_cache_insert(neg_cache, job->path);
+        break;
+    default:
+        cache_revalidate_failed(cache, key);
+        break;
+    }
+
+    free(job);
+    background_finished();
+    return NULL;
 }
 
-/* ============================================================================
-Main Proxy Loop
-============================================================================ */
+/*
+start_revalidation - Launch a background revalidation of a file or chunk
+*/
+static void start_revalidation(const char *path, uint64_t chunk, const cache_validator_t *cv) {
+    revalidate_job_t *job = calloc(1, sizeof(revalidate_job_t));
+    if (job != NULL) {
+        strncpy(job->path, path, sizeof(job->path) - 1);
+        job->chunk = chunk;
+        job->has_validator = (cv->mtime_ns != 0 || cv->size != 0);
+        job->validator.mtime_ns = cv->mtime_ns;
+        job->validator.size = cv->size;
+        if (spawn_background(revalidate_worker, job) == 0) {
+            return;
+        }
+        free(job);
+    }
 
-static int run_proxy(int proxy_port) {
-    /*
-     * TODO: Implement the proxy main loop
-     *
-     * Steps:
-     * 1. Create cache
-     *    cache = cache_create(CACHE_SIZE);
-     *
-     * 2. Create proxy socket
-     *    proxy_fd = create_server_socket(proxy_port, BACKLOG);
-     *
-     * 3. Accept and handle clients
-     *    while (running) {
-     *        int client_fd = accept_client(proxy_fd, ...);
-     *        handle_proxy_request(client_fd);
-     *        close_socket(client_fd);
-     *    }
-     *
-     * 4. Cleanup
-     *    print_cache_stats();
-     *    cache_destroy(cache);
-     *
-     * Note: This is single-threaded. For better performance,
-     * you could add a thread pool (like server_mt).
-     */
+    char key[MAX_KEY_LEN];
+    if (chunk == WHOLE_FILE) {
+        snprintf(key, sizeof(key), "%s", path);
+    } else {
+        cache_chunk_key(key, sizeof(key), path, chunk);
+    }
+    cache_revalidate_failed(cache, key);
+}
 
-    printf("Starting proxy on port %d\n", proxy_port);
-    printf("Backend server: %s:%d\n", server_host, server_port);
+/*
+prefetch_worker - Pull one predicted file into the cache
+*/
+static void *prefetch_worker(void *arg) {
+    char *path = arg;
+    fetch_result_t result;
+    bool stored = false;
+
+    if (fetch_from_server(path, NULL, 0, 0, &result) == 0 && result.status == STATUS_OK) {
+        cache_store(path, &result);
+        stored = true;
+        free(result.data);
+    } else if (result.status == STATUS_FILE_NOT_FOUND) {
+        neg_cache_insert(neg_cache, path);
+    }
 
-    /* YOUR CODE HERE */
+    prefetcher_complete(prefetcher, path, stored ? result.size : 0, stored);
+    free(path);
+    background_finished();
+    return NULL;
+}
 
-    (void)proxy_port;
+/*
+prefetch_successors - Learn from this request and prefetch what usually follows
+*/
+static void prefetch_successors(uint32_t client_id, const char *path) {
+    char predicted[PREFETCH_FANOUT][PREFETCH_MAX_KEY_LEN];
+    int n = prefetcher_record(prefetcher, client_id, path, predicted, PREFETCH_FANOUT);
 
-    return -1;  /* Placeholder */
+    for (int i = 0; i < n; i++) {
+        char chunk_key[MAX_KEY_LEN];
+        if (cache_contains(cache, predicted[i]) ||
+            (cache_chunk_key(chunk_key, sizeof(chunk_key), predicted[i], 0) > 0 &&
+             cache_contains(cache, chunk_key)) ||
+            !prefetcher_begin(prefetcher)) {
+            continue;
+        }
+        char *job = strdup(predicted[i]);
+        if (job == NULL || spawn_background(prefetch_worker, job) < 0) {
+            prefetcher_complete(prefetcher, predicted[i], 0, false);
+            free(job);
+        }
+    }
 }
 
 /* ============================================================================
-Main Entry Point
+Request Handling
 ============================================================================ */
 
-static void print_usage(const char *prog) {
-    fprintf(stderr, "Usage: %s [proxy_port] [server_host] [server_port]\n", prog);
-    fprintf(stderr, "\nDefaults:\n");
-    fprintf(stderr, "  proxy_port:  %d\n", PROXY_PORT);
-    fprintf(stderr, "  server_host: localhost\n");
-    fprintf(stderr, "  server_port: %d\n", DEFAULT_PORT);
+/*
+send_status_response - Send a header-only response (errors, not found)
+*/
+static int send_status_response(int client_fd, gf_status_t status) {
+    char header[256];
+    int header_len = gf_create_response_header(header, sizeof(header), status, 0);
+    if (header_len < 0) {
+        return -1;
+    }
+    return send_all(client_fd, header, header_len) == header_len ? 0 : -1;
 }
 
-int main(int argc, char *argv[]) {
-    int proxy_port = PROXY_PORT;
+/* Most iovec entries handed to one sendmsg() */
+#define SEND_IOV_MAX    64
 
-    /* Parse arguments */
-    if (argc > 1) {
-        proxy_port = atoi(argv[1]);
-        if (proxy_port <= 0 || proxy_port > 65535) {
-            fprintf(stderr, "Invalid proxy port: %s\n", argv[1]);
-            print_usage(argv[0]);
-            return 1;
+/*
+fill_iov - Describe what is left of a response made of 'parts', skipping
+'sent' bytes
+
+Returns: Number of iovec entries used, at most max (0 when everything
+was sent).
+*/
+static int fill_iov(struct iovec *iov, int max, const struct iovec *parts, int num_parts,
+                    size_t sent) {
+    int count = 0;
+    for (int i = 0; i < num_parts && count < max; i++) {
+        if (sent >= parts[i].iov_len) {
+            sent -= parts[i].iov_len;
+            continue;
         }
+        iov[count].iov_base = (char *)parts[i].iov_base + sent;
+        iov[count].iov_len = parts[i].iov_len - sent;
+        count++;
+        sent = 0;
     }
-    if (argc > 2) {
-        strncpy(server_host, argv[2], sizeof(server_host) - 1);
-        server_host[sizeof(server_host) - 1] = '\0';
+    return count;
+}
+
+/*
+send_parts - Send a response made of several buffers
+
+They go out in gathering sendmsg() calls, straight from where they are
+(pinned cache entries on hits).
+*/
+static int send_parts(int client_fd, const struct iovec *parts, int num_parts) {
+    size_t sent = 0;
+    struct iovec iov[SEND_IOV_MAX];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    while ((msg.msg_iovlen = fill_iov(iov, SEND_IOV_MAX, parts, num_parts, sent)) > 0) {
+        ssize_t n = sendmsg(client_fd, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        sent += n;
     }
-    if (argc > 3) {
-        server_port = atoi(argv[3]);
-        if (server_port <= 0 || server_port > 65535) {
-            fprintf(stderr, "Invalid server port: %s\n", argv[3]);
-            return 1;
+    return 0;
+}
+
+/*
+send_data_response - Send a header followed by file content
+
+Header and body go out in one gathering sendmsg(), so the body is sent
+straight from the caller's buffer (a pinned cache entry on hits).
+A decoded_length other than 0 announces an lz body of the file.
+*/
+static int send_data_response(int client_fd, gf_status_t status,
+                              const char *data, size_t size, size_t decoded_length) {
+    char header[256];
+    int header_len = gf_create_response_header_lz(header, sizeof(header), status, size,
+                                                  NULL, decoded_length);
+    if (header_len < 0) {
+        return -1;
+    }
+
+    struct iovec parts[2] = {
+        { .iov_base = header, .iov_len = (size_t)header_len },
+        { .iov_base = (char *)data, .iov_len = size },
+    };
+    return send_parts(client_fd, parts, 2);
+}
+
+/*
+body_decoded_length - ENCODING length for a pinned cache entry (0 if plain)
+*/
+static size_t body_decoded_length(const cache_handle_t *body) {
+    return body->compressed ? lz_decoded_size(body->data, body->size) : 0;
+}
+
+/*
+send_cached_response - Send a pinned cache entry to the client
+*/
+static int send_cached_response(int client_fd, const cache_handle_t *body) {
+    return send_data_response(client_fd, STATUS_CACHED, body->data, body->size,
+                              body_decoded_length(body));
+}
+
+/*
+Outcome of answering a request from the proxy's own caches
+*/
+typedef enum {
+    LOCAL_HIT,
+    LOCAL_NOT_FOUND,
+    LOCAL_MISS
+} local_result_t;
+
+/*
+lookup_local - Try to answer a request without the backend
+
+Lookup order: positive cache, then negative cache.
+Expired entries are served stale while one background fetch revalidates.
+Every request also trains the prefetcher, which may start background
+fetches for files that usually follow this one.
+
+A client that accepts lz bodies gets compressed entries as they are
+stored; for anyone else the cache decodes them.
+
+Returns: LOCAL_HIT (*body pinned, caller calls cache_release),
+LOCAL_NOT_FOUND, or LOCAL_MISS if the backend has to be asked (or the
+file is cached in chunks, see range_lookup).
+*/
+static local_result_t lookup_local(uint32_t client_id, const char *path, int accept_lz,
+                                   cache_handle_t *body) {
+    prefetch_successors(client_id, path);
+
+    cache_validator_t cv;
+    cache_lookup_t lookup = accept_lz ? cache_lookup_acquire_packed(cache, path, body, &cv)
+                                      : cache_lookup_acquire(cache, path, body, &cv);
+    if (lookup != CACHE_LOOKUP_MISS) {
+        /* Stale hits are served immediately; at most one refresh runs */
+        printf("Cache HIT for %s%s\n", path, lookup == CACHE_LOOKUP_FRESH ? "" : " (stale)");
+        if (lookup == CACHE_LOOKUP_REVALIDATE) {
+            start_revalidation(path, WHOLE_FILE, &cv);
         }
+        return LOCAL_HIT;
+    }
+
+    if (neg_cache_lookup(neg_cache, path)) {
+        printf("Negative cache HIT for %s\n", path);
+        return LOCAL_NOT_FOUND;
+    }
+
+    printf("Cache MISS for %s\n", path);
+    return LOCAL_MISS;
+}
+
+/* ============================================================================
+Ranges and Chunked Files
+============================================================================ */
+
+/* Range length meaning "to the end of the file" */
+#define RANGE_TO_END    UINT64_MAX
+
+/*
+A response assembled from pieces of a file: cached chunks (or one whole
+cached entry) are pinned, and whatever was not cached comes from a
+single backend fetch covering all of it. Answers to plain requests for
+files that are not cached whole go through here too, so the client
+never sees the chunks.
+*/
+typedef struct {
+    int ranged;                 /* Client sent RANGE: answer with a RANGE line */
+    uint64_t offset;            /* First byte wanted */
+    uint64_t length;            /* Bytes wanted; clipped once the size is known */
+    int size_known;
+    uint64_t file_size;
+
+    /* Pieces: chunks first .. first + count - 1, or one whole entry */
+    int whole;                  /* The single piece is a whole cached file */
+    uint64_t first;
+    size_t count;
+    cache_handle_t *pieces;     /* buf NULL = not cached, comes from 'fetched' */
+    cache_validator_t version;  /* Version of the pinned pieces */
+
+    int fetches;                /* Backend requests made for this response */
+    fetch_result_t fetched;     /* Backend bytes (data NULL if none) */
+    int owns_fetched;           /* fetched.data is ours to free */
+
+    char header[256];
+    struct iovec *parts;        /* Header, then one slice per piece */
+    int num_parts;
+} range_reply_t;
+
+/*
+range_begin - Start a response for bytes [offset, offset + length)
+*/
+static void range_begin(range_reply_t *reply, int ranged, uint64_t offset, uint64_t length) {
+    memset(reply, 0, sizeof(*reply));
+    reply->ranged = ranged;
+    reply->offset = offset;
+    reply->length = length;
+    reply->first = offset / CACHE_CHUNK_SIZE;
+}
+
+/*
+piece_start - File offset where piece i starts
+*/
+static uint64_t piece_start(const range_reply_t *reply, size_t i) {
+    return reply->whole ? 0 : (reply->first + i) * CACHE_CHUNK_SIZE;
+}
+
+/*
+piece_bounds - File bytes [lo, hi) of the response that piece i provides
+*/
+static void piece_bounds(const range_reply_t *reply, size_t i, uint64_t *lo, uint64_t *hi) {
+    uint64_t start = piece_start(reply, i);
+    uint64_t want_end = reply->offset + reply->length;
+    *lo = start > reply->offset ? start : reply->offset;
+    *hi = reply->whole || start + CACHE_CHUNK_SIZE > want_end ? want_end : start + CACHE_CHUNK_SIZE;
+}
+
+/*
+piece_present - Is piece i pinned, or inside the fetched bytes?
+*/
+static int piece_present(const range_reply_t *reply, size_t i) {
+    if (reply->pieces[i].buf != NULL) {
+        return 1;
+    }
+    uint64_t lo, hi;
+    piece_bounds(reply, i, &lo, &hi);
+    return reply->fetched.data != NULL && lo >= reply->fetched.offset &&
+           hi <= reply->fetched.offset + reply->fetched.size;
+}
+
+/*
+range_set_size - The file size is known: clip the range, size the piece table
+
+Returns: 0 on success, -1 if out of memory.
+*/
+static int range_set_size(range_reply_t *reply, uint64_t file_size) {
+    reply->size_known = 1;
+    reply->file_size = file_size;
+    if (reply->offset >= file_size) {
+        reply->length = 0;
+    } else if (reply->length > file_size - reply->offset) {
+        reply->length = file_size - reply->offset;
+    }
+
+    if (reply->whole) {
+        reply->count = 1;
+    } else {
+        uint64_t end = reply->offset + reply->length;
+        reply->count = reply->length == 0
+                       ? 0 : (size_t)((end + CACHE_CHUNK_SIZE - 1) / CACHE_CHUNK_SIZE - reply->first);
+    }
+    free(reply->pieces);
+    reply->pieces = calloc(reply->count > 0 ? reply->count : 1, sizeof(cache_handle_t));
+    return reply->pieces != NULL ? 0 : -1;
+}
+
+/*
+range_from_entry - Answer a range from a whole cached file (takes the pin)
+*/
+static int range_from_entry(range_reply_t *reply, cache_handle_t *body) {
+    reply->whole = 1;
+    if (range_set_size(reply, body->size) < 0) {
+        cache_release(body);
+        return -1;
+    }
+    reply->pieces[0] = *body;
+    memset(body, 0, sizeof(*body));
+    return 0;
+}
+
+/*
+range_unpin - Release every pinned piece
+*/
+static void range_unpin(range_reply_t *reply) {
+    for (size_t i = 0; i < reply->count; i++) {
+        cache_release(&reply->pieces[i]);
+    }
+}
+
+/*
+range_drop_fetched - Forget the backend bytes
+*/
+static void range_drop_fetched(range_reply_t *reply) {
+    if (reply->owns_fetched) {
+        free(reply->fetched.data);
+    }
+    memset(&reply->fetched, 0, sizeof(reply->fetched));
+    reply->owns_fetched = 0;
+}
+
+/*
+range_release - Free everything a response holds
+*/
+static void range_release(range_reply_t *reply) {
+    if (reply->pieces != NULL) {
+        range_unpin(reply);
+    }
+    free(reply->pieces);
+    free(reply->parts);
+    range_drop_fetched(reply);
+    memset(reply, 0, sizeof(*reply));
+}
+
+/*
+same_version - Do two validators name the same version of a file?
+*/
+static int same_version(const cache_validator_t *a, const cache_validator_t *b) {
+    return a->mtime_ns == b->mtime_ns && a->size == b->size;
+}
+
+/*
+range_lookup - Pin the cached chunks of the range
+
+The chunk holding the first byte tells the file size (its validator);
+if it is not cached, nothing is known and the backend is asked for the
+whole range. Stale chunks are served like stale files, and a chunk of
+another version than the first is treated as missing.
+*/
+static void range_lookup(range_reply_t *reply, const char *path) {
+    cache_handle_t chunk;
+    cache_validator_t cv;
+    cache_lookup_t lookup = cache_lookup_chunk(cache, path, reply->first, &chunk, &cv);
+    if (lookup == CACHE_LOOKUP_MISS) {
+        return;
+    }
+    if (lookup == CACHE_LOOKUP_REVALIDATE) {
+        start_revalidation(path, reply->first, &cv);
+    }
+    if (range_set_size(reply, cv.size) < 0 || reply->count == 0) {
+        cache_release(&chunk);
+        return;
+    }
+    reply->version = cv;
+    reply->pieces[0] = chunk;
+
+    for (size_t i = 1; i < reply->count; i++) {
+        lookup = cache_lookup_chunk(cache, path, reply->first + i, &chunk, &cv);
+        if (lookup == CACHE_LOOKUP_MISS) {
+            continue;
+        }
+        if (lookup == CACHE_LOOKUP_REVALIDATE) {
+            start_revalidation(path, reply->first + i, &cv);
+        }
+        if (same_version(&cv, &reply->version)) {
+            reply->pieces[i] = chunk;
+        } else {
+            cache_release(&chunk);
+        }
+    }
+}
+
+/*
+range_missing - Backend request that would complete the response
+
+@param offset, length: Output - range to fetch (length 0 = the whole file)
+
+Only the span from the first to the last missing chunk is fetched (the
+chunks in between are fetched again rather than making more requests).
+
+Returns: 1 if a fetch is needed, 0 if every piece is present.
+*/
+static int range_missing(const range_reply_t *reply, uint64_t *offset, uint64_t *length) {
+    if (!reply->size_known) {
+        if (!reply->ranged) {
+            *offset = 0;
+            *length = 0;
+            return 1;
+        }
+        /* Whole chunks around the range, so all of them can be cached */
+        *offset = reply->first * CACHE_CHUNK_SIZE;
+        uint64_t end = reply->offset + reply->length;
+        if (end < reply->offset || end > UINT64_MAX - CACHE_CHUNK_SIZE) {
+            *length = UINT64_MAX - *offset;
+        } else {
+            *length = (end + CACHE_CHUNK_SIZE - 1) / CACHE_CHUNK_SIZE * CACHE_CHUNK_SIZE - *offset;
+        }
+        if (*length == 0) {
+            *length = CACHE_CHUNK_SIZE;
+        }
+        return 1;
+    }
+
+    size_t lo = reply->count, hi = 0;
+    for (size_t i = 0; i < reply->count; i++) {
+        if (!piece_present(reply, i)) {
+            if (lo == reply->count) {
+                lo = i;
+            }
+            hi = i;
+        }
+    }
+    if (lo == reply->count) {
+        return 0;
+    }
+    *offset = piece_start(reply, lo);
+    *length = (uint64_t)(hi - lo + 1) * CACHE_CHUNK_SIZE;
+    return 1;
+}
+
+/*
+range_accept - Use a backend answer (status OK) for the missing pieces
+
+The answer is cached first. If it shows that the file changed since the
+pinned chunks were cached, they are dropped; should the answer then not
+cover every missing piece, it is dropped too and the caller fetches
+again (range_missing). With owned set, the reply frees result->data.
+
+Returns: 0 if the response is complete, 1 if another fetch is needed,
+-1 on error.
+*/
+static int range_accept(range_reply_t *reply, const char *path, fetch_result_t *result,
+                        int owned) {
+    cache_store(path, result);
+    cache_count_miss_bytes(cache, result->size);
+    reply->fetches++;
+
+    cache_validator_t fv = { result->has_validator ? result->validator.mtime_ns : 0,
+                             result->file_size };
+    if (!reply->size_known || !same_version(&fv, &reply->version)) {
+        range_unpin(reply);
+        reply->whole = 0;
+        if (range_set_size(reply, result->file_size) < 0) {
+            return -1;
+        }
+        reply->version = fv;
+    }
+
+    range_drop_fetched(reply);
+    reply->fetched = *result;
+    reply->owns_fetched = owned;
+
+    uint64_t offset, length;
+    if (range_missing(reply, &offset, &length)) {
+        range_drop_fetched(reply);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+range_build - Lay out the header and the slices of every piece
+
+Returns: 0 on success, -1 if out of memory or a piece is short.
+*/
+static int range_build(range_reply_t *reply) {
+    gf_status_t status = reply->fetches > 0 ? STATUS_OK : STATUS_CACHED;
+    int header_len = reply->ranged
+                     ? gf_create_response_header_range(reply->header, sizeof(reply->header),
+                                                       status, reply->length, NULL,
+                                                       reply->offset, reply->file_size)
+                     : gf_create_response_header(reply->header, sizeof(reply->header),
+                                                 status, reply->length);
+    reply->parts = calloc(reply->count + 1, sizeof(struct iovec));
+    if (header_len < 0 || reply->parts == NULL) {
+        return -1;
+    }
+    reply->parts[0].iov_base = reply->header;
+    reply->parts[0].iov_len = (size_t)header_len;
+    reply->num_parts = 1;
+
+    for (size_t i = 0; i < reply->count; i++) {
+        const cache_handle_t *piece = &reply->pieces[i];
+        uint64_t start = piece_start(reply, i);
+        uint64_t lo, hi;
+        piece_bounds(reply, i, &lo, &hi);
+        if (lo >= hi) {
+            continue;
+        }
+
+        const char *data;
+        if (piece->buf != NULL) {
+            if (hi - start > piece->size) {
+                return -1;
+            }
+            data = piece->data + (lo - start);
+        } else {
+            data = reply->fetched.data + (lo - reply->fetched.offset);
+        }
+        reply->parts[reply->num_parts].iov_base = (char *)data;
+        reply->parts[reply->num_parts].iov_len = (size_t)(hi - lo);
+        reply->num_parts++;
+    }
+    return 0;
+}
+
+/*
+serve_range - Answer from the pinned pieces plus backend fetches (blocking)
+*/
+static void serve_range(int client_fd, const char *path, range_reply_t *reply) {
+    if (!reply->whole) {
+        range_lookup(reply, path);
+    }
+
+    uint64_t offset, length;
+    while (range_missing(reply, &offset, &length)) {
+        fetch_result_t result;
+        if (reply->fetches == 2) {
+            /* The file keeps changing under us */
+            send_status_response(client_fd, STATUS_ERROR);
+            return;
+        }
+        if (fetch_from_server(path, NULL, offset, length, &result) < 0 ||
+            result.status != STATUS_OK) {
+            if (result.status == STATUS_FILE_NOT_FOUND) {
+                neg_cache_insert(neg_cache, path);
+                send_status_response(client_fd, STATUS_FILE_NOT_FOUND);
+            } else {
+                send_status_response(client_fd, STATUS_ERROR);
+            }
+            return;
+        }
+        if (range_accept(reply, path, &result, 1) < 0) {
+            send_status_response(client_fd, STATUS_ERROR);
+            return;
+        }
+    }
+
+    if (range_build(reply) < 0) {
+        send_status_response(client_fd, STATUS_ERROR);
+        return;
+    }
+    send_parts(client_fd, reply->parts, reply->num_parts);
+}
+
+/*
+handle_proxy_request - Handle a single proxy request
+
+Answers from the caches when possible (lookup_local), otherwise
+fetches from the backend and caches the result. Ranges, and files
+cached in chunks, are answered by serve_range.
+*/
+static void handle_proxy_request(int client_fd, uint32_t client_id) {
+    char buffer[MAX_HEADER_LEN];
+    ssize_t n = recv_until(client_fd, buffer, sizeof(buffer), HEADER_DELIM);
+    if (n <= 0) {
+        return;
+    }
+
+    gf_request_t request;
+    if (gf_parse_request(buffer, n, &request) <= 0 || !request.valid ||
+        !validate_path(request.path)) {
+        send_status_response(client_fd, STATUS_INVALID);
+        return;
+    }
+
+    range_reply_t reply;
+    range_begin(&reply, request.has_range, request.has_range ? request.range_offset : 0,
+                request.has_range ? request.range_length : RANGE_TO_END);
+
+    /* A range is cut out of the file, so it is never sent compressed */
+    cache_handle_t body;
+    switch (lookup_local(client_id, request.path, request.accept_lz && !request.has_range,
+                         &body)) {
+    case LOCAL_HIT:
+        if (!request.has_range) {
+            send_cached_response(client_fd, &body);
+            cache_release(&body);
+            return;
+        }
+        if (range_from_entry(&reply, &body) < 0) {
+            send_status_response(client_fd, STATUS_ERROR);
+            return;
+        }
+        break;
+    case LOCAL_NOT_FOUND:
+        send_status_response(client_fd, STATUS_FILE_NOT_FOUND);
+        return;
+    case LOCAL_MISS:
+        break;
+    }
+
+    serve_range(client_fd, request.path, &reply);
+    range_release(&reply);
+}
+
+/* ============================================================================
+Statistics Display
+============================================================================ */
+
+/*
+process_rss - Resident set size of the proxy (0 if unknown)
+*/
+static size_t process_rss(void) {
+    unsigned long pages_total, pages_resident;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == NULL) {
+        return 0;
+    }
+    int n = fscanf(f, "%lu %lu", &pages_total, &pages_resident);
+    fclose(f);
+    return n == 2 ? pages_resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+}
+
+static void print_cache_stats(void) {
+    if (cache == NULL) return;
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+
+    printf("\n=== Cache Statistics ===\n");
+    printf("Entries: %d (%d shards, %s)\n", stats.num_entries, stats.num_shards,
+           cache_policy_name(stats.policy));
+    printf("Size: %zu / %zu bytes (%.1f%%)\n",
+           stats.current_size, stats.max_size,
+           100.0 * stats.current_size / stats.max_size);
+    size_t rss = process_rss();
+    if (rss > 0 && stats.current_size > 0) {
+        printf("Memory: %zu bytes of slabs mapped, RSS %zu (%.2fx cached size)\n",
+               stats.payload_mapped, rss, (double)rss / stats.current_size);
+    }
+    printf("Hits: %lu, Misses: %lu, Hit Rate: %.1f%%, Byte Hit Rate: %.1f%%\n",
+           stats.hits, stats.misses, stats.hit_rate * 100, stats.byte_hit_rate * 100);
+    if (stats.mrc_samples > 0) {
+        printf("Predicted hit rate at (LRU, %lu samples):", stats.mrc_samples);
+        for (int i = 0; i < CACHE_MRC_POINTS; i += 2) {
+            printf(" %gx %.1f%%", (double)stats.mrc_size[i] / stats.max_size,
+                   stats.mrc_hit_rate[i] * 100);
+        }
+        printf("\n");
+    }
+    printf("Evictions: %lu\n", stats.evictions);
+    if (stats.policy == CACHE_POLICY_TINYLFU) {
+        printf("Admission rejects: %lu\n", stats.admission_rejects);
+    }
+    printf("Stale hits: %lu, Expirations: %lu\n", stats.stale_hits, stats.expirations);
+    if (compress_cache && stats.payload_size > 0) {
+        printf("Compression: %d of %d entries, %zu bytes of files in %zu (%.2fx); "
+               "%lu stored as is\n",
+               stats.compressed_entries, stats.num_entries, stats.payload_size,
+               stats.current_size, (double)stats.payload_size / stats.current_size,
+               stats.compress_skipped);
+    }
+    if (disk_path != NULL) {
+        printf("Disk tier: %zu entries, %zu bytes; %lu hits, %lu writes, %lu dropped\n",
+               stats.disk_entries, stats.disk_bytes, stats.disk_hits, stats.disk_writes,
+               stats.disk_dropped);
+    }
+
+    if (neg_cache != NULL) {
+        neg_cache_stats_t neg;
+        neg_cache_get_stats(neg_cache, &neg);
+        printf("Negative entries: %d protected, %d probation\n",
+               neg.protected_entries, neg.probation_entries);
+        printf("Negative Hits: %lu, Misses: %lu, Hit Rate: %.1f%%\n",
+               neg.hits, neg.misses, neg.hit_rate * 100);
+        printf("Negative Expirations: %lu, Evictions: %lu\n",
+               neg.expirations, neg.evictions);
+    }
+
+    if (prefetcher != NULL) {
+        prefetch_stats_t pf;
+        prefetcher_get_stats(prefetcher, &pf);
+        printf("Prefetches: %lu issued, %lu stored, %lu skipped (budget)\n",
+               pf.issued, pf.completed, pf.skipped_budget);
+        printf("Prefetch accuracy: %.1f%% (%lu used, %lu wasted, %zu wasted bytes)\n",
+               pf.accuracy * 100, pf.used, pf.wasted, pf.wasted_bytes);
+    }
+
+    if (hedge != NULL) {
+        hedge_stats_t hs;
+        hedge_get_stats(hedge, &hs);
+        printf("Hedges: %lu sent (%.1f%% of %lu), %lu won, %lu denied (budget)\n",
+               hs.hedges_sent, hs.hedge_rate * 100, hs.requests,
+               hs.hedges_won, hs.hedges_denied);
+        printf("Backend p95: %.1f ms\n", hs.p95_us / 1000.0);
+    }
+    printf("========================\n");
+}
+
+/* ============================================================================
+Event-Driven Mode (epoll, Linux only)
+============================================================================ */
+
+#ifdef __linux__
+
+#define EVENT_MAX_EVENTS    256     /* events handled per epoll_wait */
+#define EVENT_TICK_MS       200     /* loops re-check 'running' and deadlines this often */
+#define CLIENT_TIMEOUT_MS   10000   /* to send the request, or between response writes */
+#define EVENT_READ_CHUNK    16384   /* bytes read per recv */
+#define EVENT_INITIAL_BUF   512     /* first allocation for a connection buffer */
+
+/*
+Connection states. A connection moves strictly forward:
+READ_REQUEST -> [BACKEND_CONNECT -> BACKEND_SEND -> BACKEND_RECV] -> WRITE_RESPONSE
+Cache and negative-cache hits skip the backend states.
+
+Every state has a deadline (expire_conns). The whole request must arrive
+within CLIENT_TIMEOUT_MS of the accept, so a client trickling bytes cannot
+hold the connection; the backend and response states only time out after
+that long without progress, like the blocking mode's socket timeouts.
+*/
+typedef enum {
+    CONN_READ_REQUEST,
+    CONN_BACKEND_CONNECT,
+    CONN_BACKEND_SEND,
+    CONN_BACKEND_RECV,
+    CONN_WRITE_RESPONSE
+} conn_state_t;
+
+typedef struct event_conn event_conn_t;
+
+/*
+epoll user data: which socket of which connection is ready
+(a NULL conn marks the listening socket)
+*/
+typedef struct {
+    event_conn_t *conn;
+    int is_backend;
+} conn_handle_t;
+
+/*
+Growable byte buffer
+*/
+typedef struct {
+    char *data;
+    size_t len;                 /* Bytes held */
+    size_t cap;                 /* Bytes allocated */
+    size_t sent;                /* Bytes already written out */
+} event_buf_t;
+
+typedef struct event_loop event_loop_t;
+
+struct event_conn {
+    conn_state_t state;
+    event_loop_t *loop;
+    int client_fd;
+    int backend_fd;             /* -1 unless talking to the backend */
+    uint32_t client_id;
+    char *path;                 /* Requested path (owned) */
+    size_t body_len;            /* Backend content length, once parsed */
+    uint64_t fetch_started_us;  /* When the backend request was started */
+    uint64_t deadline_us;       /* Timed out past this (see expire_conns) */
+    size_t body_off;            /* Where the body starts in 'in' */
+    event_buf_t in;             /* Client request, then backend response */
+    event_buf_t out;            /* Backend request, then client response */
+    cache_handle_t body;        /* Pinned cache hit sent after 'out' */
+    range_reply_t *range;       /* Response assembled from pieces, sent instead */
+    conn_handle_t client_h;
+    conn_handle_t backend_h;
+    int closed;                 /* Sockets closed; freed after the current batch */
+    event_conn_t *prev, *next;  /* Loop's connection list (or dead list) */
+};
+
+struct event_loop {
+    pthread_t thread;
+    int epfd;
+    int listen_fd;
+    event_conn_t *conns;        /* Open connections (freed at shutdown) */
+    event_conn_t *dead;         /* Closed during the current batch */
+};
+
+/* Backend address, resolved once when event mode starts */
+static struct sockaddr_storage backend_addr;
+static socklen_t backend_addr_len = 0;
+
+/*
+conn_set_deadline - Time the connection out timeout_ms from now
+*/
+static void conn_set_deadline(event_conn_t *conn, int timeout_ms) {
+    conn->deadline_us = now_us() + (uint64_t)timeout_ms * 1000;
+}
+
+/*
+buf_reserve - Make room for 'extra' more bytes
+*/
+static int buf_reserve(event_buf_t *buf, size_t extra) {
+    if (buf->len + extra <= buf->cap) {
+        return 0;
+    }
+    size_t cap = buf->cap > 0 ? buf->cap : EVENT_INITIAL_BUF;
+    while (cap < buf->len + extra) {
+        cap *= 2;
+    }
+    char *data = realloc(buf->data, cap);
+    if (data == NULL) {
+        return -1;
+    }
+    buf->data = data;
+    buf->cap = cap;
+    return 0;
+}
+
+static void buf_reset(event_buf_t *buf) {
+    free(buf->data);
+    memset(buf, 0, sizeof(*buf));
+}
+
+/*
+resolve_backend - Look up the backend address for non-blocking connects
+*/
+static int resolve_backend(void) {
+    struct addrinfo hints, *res;
+    char port[16];
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(port, sizeof(port), "%d", server_port);
+
+    int rc = getaddrinfo(server_host, port, &hints, &res);
+    if (rc != 0) {
+        fprintf(stderr, "getaddrinfo %s: %s\n", server_host, gai_strerror(rc));
+        return -1;
+    }
+    memcpy(&backend_addr, res->ai_addr, res->ai_addrlen);
+    backend_addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return 0;
+}
+
+/*
+raise_fd_limit - Allow as many open sockets as the hard limit permits
+*/
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+/*
+watch - Add or change the epoll registration of one socket
+*/
+static int watch(event_conn_t *conn, int fd, conn_handle_t *handle, uint32_t events, int op) {
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = handle;
+    return epoll_ctl(conn->loop->epfd, op, fd, &ev);
+}
+
+/*
+set_nonblocking - Put a socket into non-blocking mode
+*/
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+conn_close - Close both sockets and retire the connection
+
+Closing a socket also removes it from the epoll set. The memory is only
+freed after the current batch of events (free_dead), because the other
+socket of the same connection may still have an event queued in it.
+*/
+static void conn_close(event_conn_t *conn) {
+    event_loop_t *loop = conn->loop;
+    if (conn->prev != NULL) {
+        conn->prev->next = conn->next;
+    } else {
+        loop->conns = conn->next;
+    }
+    if (conn->next != NULL) {
+        conn->next->prev = conn->prev;
+    }
+
+    close(conn->client_fd);
+    if (conn->backend_fd >= 0) {
+        close(conn->backend_fd);
+        conn->backend_fd = -1;
+    }
+    conn->closed = 1;
+    conn->prev = NULL;
+    conn->next = loop->dead;
+    loop->dead = conn;
+}
+
+/*
+free_dead - Free connections closed during the last batch
+*/
+static void free_dead(event_loop_t *loop) {
+    while (loop->dead != NULL) {
+        event_conn_t *conn = loop->dead;
+        loop->dead = conn->next;
+        buf_reset(&conn->in);
+        buf_reset(&conn->out);
+        cache_release(&conn->body);
+        if (conn->range != NULL) {
+            range_release(conn->range);
+            free(conn->range);
+        }
+        free(conn->path);
+        free(conn);
+    }
+}
+
+/*
+conn_close_backend - Done with the backend socket
+*/
+static void conn_close_backend(event_conn_t *conn) {
+    if (conn->backend_fd >= 0) {
+        close(conn->backend_fd);
+        conn->backend_fd = -1;
+    }
+}
+
+/*
+conn_drop_range - Forget a response assembled from pieces
+*/
+static void conn_drop_range(event_conn_t *conn) {
+    if (conn->range != NULL) {
+        range_release(conn->range);
+        free(conn->range);
+        conn->range = NULL;
+    }
+}
+
+/*
+conn_write - Send as much of the response as the client accepts
+
+The response is 'out' followed by the pinned body, if any, or else the
+parts of conn->range; out.sent counts bytes of all of them.
+
+Returns: 1 if the connection was closed (done or failed), 0 if waiting.
+*/
+static int conn_write(event_conn_t *conn) {
+    event_buf_t *out = &conn->out;
+    struct iovec own[2] = {
+        { .iov_base = out->data, .iov_len = out->len },
+        { .iov_base = (char *)conn->body.data, .iov_len = conn->body.size },
+    };
+    const struct iovec *parts = own;
+    int num_parts = 2;
+    if (conn->range != NULL) {
+        parts = conn->range->parts;
+        num_parts = conn->range->num_parts;
+    }
+
+    struct iovec iov[SEND_IOV_MAX];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    while ((msg.msg_iovlen = fill_iov(iov, SEND_IOV_MAX, parts, num_parts, out->sent)) > 0) {
+        ssize_t n = sendmsg(conn->client_fd, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            watch(conn, conn->client_fd, &conn->client_h, EPOLLOUT, EPOLL_CTL_MOD);
+            return 0;
+        }
+        if (n < 0) {
+            break;
+        }
+        out->sent += n;
+        conn_set_deadline(conn, CLIENT_TIMEOUT_MS);
+    }
+    conn_close(conn);
+    return 1;
+}
+
+/*
+conn_respond - Queue a response for the client and start writing it
+
+A pinned body (conn->body) is sent after 'data' and counts towards the
+content length; a compressed one is announced with an ENCODING line.
+*/
+static void conn_respond(event_conn_t *conn, gf_status_t status, const char *data, size_t size) {
+    conn_drop_range(conn);
+
+    char header[256];
+    int header_len = gf_create_response_header_lz(header, sizeof(header), status,
+                                                  size + conn->body.size, NULL,
+                                                  body_decoded_length(&conn->body));
+
+    conn_close_backend(conn);
+    buf_reset(&conn->out);
+    if (header_len < 0 || buf_reserve(&conn->out, header_len + size) < 0) {
+        conn_close(conn);
+        return;
+    }
+    memcpy(conn->out.data, header, header_len);
+    if (size > 0) {
+        memcpy(conn->out.data + header_len, data, size);
+    }
+    conn->out.len = header_len + size;
+    conn->state = CONN_WRITE_RESPONSE;
+    conn_set_deadline(conn, CLIENT_TIMEOUT_MS);
+    conn_write(conn);
+}
+
+/*
+conn_respond_pinned - Queue a cache hit without copying its body
+
+Only the header goes into 'out'; the connection owns the pin on 'body'
+until it is freed.
+*/
+static void conn_respond_pinned(event_conn_t *conn, cache_handle_t *body) {
+    conn->body = *body;
+    memset(body, 0, sizeof(*body));
+    conn_respond(conn, STATUS_CACHED, NULL, 0);
+}
+
+/*
+conn_respond_range - Send the response assembled in conn->range
+*/
+static void conn_respond_range(event_conn_t *conn) {
+    if (range_build(conn->range) < 0) {
+        conn_respond(conn, STATUS_ERROR, NULL, 0);
+        return;
+    }
+    conn_close_backend(conn);
+    buf_reset(&conn->out);
+    conn->state = CONN_WRITE_RESPONSE;
+    conn_set_deadline(conn, CLIENT_TIMEOUT_MS);
+    conn_write(conn);
+}
+
+/*
+conn_start_backend - Cache miss: begin a non-blocking backend fetch
+
+@param offset, length: Byte range to fetch (length 0 = the whole file)
+*/
+static void conn_start_backend(event_conn_t *conn, uint64_t offset, uint64_t length) {
+    printf("Fetching %s from backend server %s:%d\n", conn->path, server_host, server_port);
+
+    char request[MAX_REQUEST_LEN];
+    int len = length == 0
+              ? gf_create_request(request, sizeof(request), conn->path)
+              : gf_create_range_request(request, sizeof(request), conn->path, offset, length,
+                                        NULL);
+    int fd = socket(backend_addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (len < 0 || fd < 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        conn_respond(conn, STATUS_ERROR, NULL, 0);
+        return;
+    }
+    conn->backend_fd = fd;
+    conn->fetch_started_us = now_us();
+    conn_set_deadline(conn, BACKEND_TIMEOUT_MS);
+
+    buf_reset(&conn->out);
+    buf_reset(&conn->in);
+    if (buf_reserve(&conn->out, len) < 0) {
+        conn_respond(conn, STATUS_ERROR, NULL, 0);
+        return;
+    }
+    memcpy(conn->out.data, request, len);
+    conn->out.len = len;
+
+    if (connect(fd, (struct sockaddr *)&backend_addr, backend_addr_len) < 0 &&
+        errno != EINPROGRESS) {
+        conn_respond(conn, STATUS_ERROR, NULL, 0);
+        return;
+    }
+
+    /* Ignore the client until the response is ready (errors still reported) */
+    watch(conn, conn->client_fd, &conn->client_h, 0, EPOLL_CTL_MOD);
+    conn->state = CONN_BACKEND_CONNECT;
+    if (watch(conn, fd, &conn->backend_h, EPOLLOUT, EPOLL_CTL_ADD) < 0) {
+        conn_respond(conn, STATUS_ERROR, NULL, 0);
+    }
+}
+
+/*
+conn_continue_range - Fetch what conn->range still lacks, or send it
+*/
+static void conn_continue_range(event_conn_t *conn) {
+    uint64_t offset, length;
+    if (!range_missing(conn->range, &offset, &length)) {
+        conn_respond_range(conn);
+    } else if (conn->range->fetches == 2) {
+        conn_respond(conn, STATUS_ERROR, NULL, 0);  /* the file keeps changing */
+    } else {
+        conn_start_backend(conn, offset, length);
+    }
+}
+
+/*
+conn_read_request - Read the client's request header and dispatch it
+*/
+static void conn_read_request(event_conn_t *conn) {
+    event_buf_t *in = &conn->in;
+    for (;;) {
+        if (buf_reserve(in, EVENT_INITIAL_BUF) < 0) {
+            conn_close(conn);
+            return;
+        }
+        ssize_t n = recv(conn->client_fd, in->data + in->len, in->cap - in->len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (n <= 0) {
+            conn_close(conn);
+            return;
+        }
+        in->len += n;
+        if (gf_find_header_end(in->data, in->len) > 0 || in->len >= MAX_REQUEST_LEN) {
+            break;
+        }
+    }
+
+    if (gf_find_header_end(in->data, in->len) == 0) {
+        if (in->len >= MAX_REQUEST_LEN) {
+            conn_respond(conn, STATUS_INVALID, NULL, 0);
+        }
+        return;  /* wait for the rest of the header */
+    }
+
+    gf_request_t request;
+    if (gf_parse_request(in->data, in->len, &request) <= 0 || !request.valid ||
+        !validate_path(request.path)) {
+        conn_respond(conn, STATUS_INVALID, NULL, 0);
+        return;
+    }
+    conn->path = strdup(request.path);
+    if (conn->path == NULL) {
+        conn_close(conn);
+        return;
+    }
+
+    /* Cache hits are answered right here on the loop thread */
+    cache_handle_t body;
+    local_result_t local = lookup_local(conn->client_id, conn->path,
+                                        request.accept_lz && !request.has_range, &body);
+    if (local == LOCAL_HIT && !request.has_range) {
+        conn_respond_pinned(conn, &body);
+        return;
+    }
+    if (local == LOCAL_NOT_FOUND) {
+        conn_respond(conn, STATUS_FILE_NOT_FOUND, NULL, 0);
+        return;
+    }
+
+    /* A range, or a miss: assembled from chunks and backend fetches */
+    conn->range = malloc(sizeof(range_reply_t));
+    if (conn->range == NULL) {
+        if (local == LOCAL_HIT) {
+            cache_release(&body);
+        }
+        conn_respond(conn, STATUS_ERROR, NULL, 0);
+        return;
+    }
+    range_begin(conn->range, request.has_range, request.has_range ? request.range_offset : 0,
+                request.has_range ? request.range_length : RANGE_TO_END);
+    if (local == LOCAL_HIT) {
+        if (range_from_entry(conn->range, &body) < 0) {
+            conn_respond(conn, STATUS_ERROR, NULL, 0);
+            return;
+        }
+    } else {
+        range_lookup(conn->range, conn->path);
+    }
+    conn_continue_range(conn);
+}
+
+/*
+conn_backend_send - Connected (or connecting): send the request
+*/
+static void conn_backend_send(event_conn_t *conn) {
+    if (conn->state == CONN_BACKEND_CONNECT) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(conn->backend_fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            conn_respond(conn, STATUS_ERROR, NULL, 0);
+            return;
+        }
+        conn->state = CONN_BACKEND_SEND;
+    }
+
+    event_buf_t *out = &conn->out;
+    while (out->sent < out->len) {
+        ssize_t n = send(conn->backend_fd, out->data + out->sent, out->len - out->sent,
+                         MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;  /* still registered for EPOLLOUT */
+        }
+        if (n < 0) {
+            conn_respond(conn, STATUS_ERROR, NULL, 0);
+            return;
+        }
+        out->sent += n;
+    }
+
+    buf_reset(out);
+    conn->state = CONN_BACKEND_RECV;
+    if (watch(conn, conn->backend_fd, &conn->backend_h, EPOLLIN, EPOLL_CTL_MOD) < 0) {
+        conn_respond(conn, STATUS_ERROR, NULL, 0);
+    }
+}
+
+/*
+conn_backend_complete - Whole backend response is in conn->in
+
+The body is sent from conn->in, which is kept until the connection is
+freed.
+*/
+static void conn_backend_complete(event_conn_t *conn, const gf_response_t *response) {
+    fetch_result_t result;
+    memset(&result, 0, sizeof(result));
+    result.status = response->status;
+    result.data = conn->in.data + conn->body_off;
+    result.size = conn->body_len;
+    result.has_validator = response->has_validator;
+    result.validator = response->validator;
+    result.offset = response->has_range ? response->range_offset : 0;
+    result.file_size = response->has_range ? response->total_length : response->content_length;
+    result.fetch_us = fetch_cost(conn->fetch_started_us);
+
+    switch (range_accept(conn->range, conn->path, &result, 0)) {
+    case 0:
+        conn_respond_range(conn);
+        break;
+    case 1:
+        conn_continue_range(conn);
+        break;
+    default:
+        conn_respond(conn, STATUS_ERROR, NULL, 0);
+        break;
+    }
+}
+
+/*
+conn_backend_recv - Read the backend's header, then its body
+*/
+static void conn_backend_recv(event_conn_t *conn) {
+    event_buf_t *in = &conn->in;
+    int eof = 0;
+    for (;;) {
+        if (buf_reserve(in, EVENT_READ_CHUNK) < 0) {
+            conn_respond(conn, STATUS_ERROR, NULL, 0);
+            return;
+        }
+        ssize_t n = recv(conn->backend_fd, in->data + in->len, in->cap - in->len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (n < 0) {
+            conn_respond(conn, STATUS_ERROR, NULL, 0);
+            return;
+        }
+        if (n == 0) {
+            eof = 1;
+            break;
+        }
+        in->len += n;
+        conn_set_deadline(conn, BACKEND_TIMEOUT_MS);
+    }
+
+    gf_response_t response;
+    int header_len = gf_parse_response_header(in->data, in->len, &response);
+    if (header_len < 0 || (header_len == 0 && (eof || in->len >= MAX_HEADER_LEN))) {
+        conn_respond(conn, STATUS_ERROR, NULL, 0);
+        return;
+    }
+    if (header_len == 0) {
+        return;  /* header incomplete */
+    }
+
+    if (response.status == STATUS_FILE_NOT_FOUND) {
+        neg_cache_insert(neg_cache, conn->path);
+        conn_respond(conn, STATUS_FILE_NOT_FOUND, NULL, 0);
+        return;
+    }
+    if (response.status != STATUS_OK) {
+        conn_respond(conn, STATUS_ERROR, NULL, 0);
+        return;
+    }
+
+    conn->body_off = header_len;
+    conn->body_len = response.content_length;
+    if (in->len - header_len >= conn->body_len) {
+        conn_backend_complete(conn, &response);
+    } else if (eof) {
+        conn_respond(conn, STATUS_ERROR, NULL, 0);
+    }
+}
+
+/*
+accept_connections - Accept every pending client on the listening socket
+*/
+static void accept_connections(event_loop_t *loop) {
+    for (;;) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        int fd = accept(loop->listen_fd, (struct sockaddr *)&addr, &addr_len);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;  /* EAGAIN: another loop took it, or nothing left */
+        }
+        if (set_nonblocking(fd) < 0) {
+            close(fd);
+            continue;
+        }
+
+        event_conn_t *conn = calloc(1, sizeof(event_conn_t));
+        if (conn == NULL) {
+            close(fd);
+            continue;
+        }
+        conn->state = CONN_READ_REQUEST;
+        conn->loop = loop;
+        conn->client_fd = fd;
+        conn->backend_fd = -1;
+        conn->client_id = addr.sin_family == AF_INET ? ntohl(addr.sin_addr.s_addr) : 0;
+        conn->client_h.conn = conn;
+        conn->backend_h.conn = conn;
+        conn->backend_h.is_backend = 1;
+        conn_set_deadline(conn, CLIENT_TIMEOUT_MS);
+
+        conn->next = loop->conns;
+        if (loop->conns != NULL) {
+            loop->conns->prev = conn;
+        }
+        loop->conns = conn;
+
+        if (watch(conn, fd, &conn->client_h, EPOLLIN, EPOLL_CTL_ADD) < 0) {
+            conn_close(conn);
+        }
+    }
+}
+
+/*
+handle_event - Advance one connection's state machine
+*/
+static void handle_event(conn_handle_t *handle, uint32_t events) {
+    event_conn_t *conn = handle->conn;
+    if (conn->closed) {
+        return;
+    }
+
+    if (!handle->is_backend) {
+        if (conn->state == CONN_READ_REQUEST && (events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+            conn_read_request(conn);
+        } else if (conn->state == CONN_WRITE_RESPONSE && (events & EPOLLOUT)) {
+            conn_write(conn);
+        } else if (events & (EPOLLHUP | EPOLLERR)) {
+            conn_close(conn);  /* client gone while we were busy */
+        }
+        return;
+    }
+
+    switch (conn->state) {
+    case CONN_BACKEND_CONNECT:
+    case CONN_BACKEND_SEND:
+        conn_backend_send(conn);
+        break;
+    case CONN_BACKEND_RECV:
+        conn_backend_recv(conn);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+expire_conns - Time out connections past their deadline
+
+A stalled backend fetch is answered with an error, as in blocking mode;
+a client that is too slow to send its request or read the response is
+dropped.
+*/
+static void expire_conns(event_loop_t *loop) {
+    uint64_t now = now_us();
+    event_conn_t *conn = loop->conns;
+    while (conn != NULL) {
+        event_conn_t *next = conn->next;  /* conn_close unlinks conn */
+        if (conn->deadline_us <= now) {
+            switch (conn->state) {
+            case CONN_BACKEND_CONNECT:
+            case CONN_BACKEND_SEND:
+            case CONN_BACKEND_RECV:
+                fprintf(stderr, "Backend timed out fetching %s\n", conn->path);
+                conn_respond(conn, STATUS_ERROR, NULL, 0);
+                break;
+            default:
+                conn_close(conn);
+                break;
+            }
+        }
+        conn = next;
+    }
+}
+
+/*
+event_loop_run - Thread body: wait for events and dispatch them
+*/
+static void *event_loop_run(void *arg) {
+    event_loop_t *loop = arg;
+    struct epoll_event events[EVENT_MAX_EVENTS];
+    uint64_t next_expiry_us = 0;
+
+    while (running) {
+        int n = epoll_wait(loop->epfd, events, EVENT_MAX_EVENTS, EVENT_TICK_MS);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                accept_connections(loop);
+            } else {
+                handle_event(events[i].data.ptr, events[i].events);
+            }
+        }
+        if (now_us() >= next_expiry_us) {
+            expire_conns(loop);
+            next_expiry_us = now_us() + EVENT_TICK_MS * 1000;
+        }
+        free_dead(loop);
+    }
+
+    while (loop->conns != NULL) {
+        conn_close(loop->conns);
+    }
+    free_dead(loop);
+    return NULL;
+}
+
+/*
+run_event_loops - Serve clients on num_loops epoll threads
+
+Every loop watches the shared listening socket (EPOLLEXCLUSIVE wakes only
+one of them per connection) and owns the connections it accepted.
+*/
+static int run_event_loops(int listen_fd, int num_loops) {
+    if (resolve_backend() < 0) {
+        return -1;
+    }
+    raise_fd_limit();
+
+    if (set_nonblocking(listen_fd) < 0) {
+        perror("fcntl");
+        return -1;
+    }
+
+    event_loop_t *loops = calloc(num_loops, sizeof(event_loop_t));
+    if (loops == NULL) {
+        perror("calloc event loops");
+        return -1;
+    }
+
+    int started = 0;
+    for (; started < num_loops; started++) {
+        event_loop_t *loop = &loops[started];
+        loop->listen_fd = listen_fd;
+        loop->epfd = epoll_create1(0);
+        if (loop->epfd < 0) {
+            perror("epoll_create1");
+            break;
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.ptr = NULL;
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, listen_fd, &ev) < 0 ||
+            pthread_create(&loop->thread, NULL, event_loop_run, loop) != 0) {
+            perror("event loop setup");
+            close(loop->epfd);
+            break;
+        }
+    }
+
+    if (started < num_loops) {
+        running = 0;
+    } else {
+        printf("Event-driven mode: %d loop(s)\n", num_loops);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(loops[i].thread, NULL);
+        close(loops[i].epfd);
+    }
+    free(loops);
+    return started == num_loops ? 0 : -1;
+}
+
+#endif /* __linux__ */
+
+/* ============================================================================
+Main Proxy Loop
+============================================================================ */
+
+/*
+run_proxy - Set up the caches and serve clients until shutdown
+
+@param event_loops: 0 for the single-threaded blocking loop, otherwise
+                    the number of epoll loops (Linux only)
+*/
+static int run_proxy(int proxy_port, int event_loops) {
+    printf("Starting proxy on port %d\n", proxy_port);
+    printf("Backend server: %s:%d\n", server_host, server_port);
+    if (replica_host[0] != '\0') {
+        printf("Replica server: %s:%d (hedging)\n", replica_host, replica_port);
+    }
+
+    cache = cache_create_with_policy(CACHE_SIZE, 0, cache_policy);
+    if (cache == NULL) {
+        return -1;
+    }
+    cache_set_stale_window(cache, CACHE_STALE_MS);
+    cache_set_revalidate_timeout(cache, REVALIDATE_TIMEOUT_MS);
+    cache_set_compression(cache, compress_cache);
+    if (disk_path != NULL) {
+        if (!cache_attach_disk(cache, disk_path, DEFAULT_DISK_CACHE_SIZE)) {
+            cache_destroy(cache);
+            return -1;
+        }
+        printf("Disk tier: %s (%d MB)\n", disk_path, DEFAULT_DISK_CACHE_SIZE / (1024 * 1024));
+    }
+    cache_start_sweeper(cache, CACHE_SWEEP_INTERVAL_MS);
+    if (snapshot_path != NULL) {
+        long restored = cache_restore(cache, snapshot_path);
+        if (restored >= 0) {
+            printf("Restored %ld cached files from %s\n", restored, snapshot_path);
+        }
+    }
+
+    neg_cache = neg_cache_create(NEG_CACHE_ENTRIES, NEG_CACHE_TTL_MS);
+    if (neg_cache == NULL) {
+        cache_destroy(cache);
+        return -1;
+    }
+
+    prefetcher = prefetcher_create(PREFETCH_WINDOW_MS, PREFETCH_BUDGET, PREFETCH_INFLIGHT);
+    if (prefetcher == NULL) {
+        neg_cache_destroy(neg_cache);
+        cache_destroy(cache);
+        return -1;
+    }
+
+    if (replica_host[0] != '\0') {
+        hedge = hedge_create(HEDGE_RATIO, HEDGE_DELAY_MS);
+        if (hedge == NULL) {
+            prefetcher_destroy(prefetcher);
+            neg_cache_destroy(neg_cache);
+            cache_destroy(cache);
+            return -1;
+        }
+    }
+
+    proxy_fd = create_server_socket(proxy_port, BACKLOG);
+    if (proxy_fd < 0) {
+        hedge_destroy(hedge);
+        prefetcher_destroy(prefetcher);
+        neg_cache_destroy(neg_cache);
+        cache_destroy(cache);
+        return -1;
+    }
+
+    int rc = 0;
+    if (event_loops > 0) {
+#ifdef __linux__
+        rc = run_event_loops(proxy_fd, event_loops);
+#endif
+    } else {
+        /* Single-threaded: one client at a time */
+        while (running) {
+            struct sockaddr_in client_addr;
+            socklen_t addr_len = sizeof(client_addr);
+            int client_fd = accept_client(proxy_fd, (struct sockaddr *)&client_addr, &addr_len);
+            if (client_fd < 0) {
+                if (!running) break;
+                continue;
+            }
+            handle_proxy_request(client_fd, ntohl(client_addr.sin_addr.s_addr));
+            close_socket(client_fd);
+        }
+    }
+
+    if (proxy_fd >= 0) {
+        close_socket(proxy_fd);
+        proxy_fd = -1;
+    }
+    wait_for_background();
+    print_cache_stats();
+    if (snapshot_path != NULL) {
+        long saved = cache_snapshot(cache, snapshot_path);
+        if (saved >= 0) {
+            printf("Saved %ld cached files to %s\n", saved, snapshot_path);
+        }
+    }
+    hedge_destroy(hedge);
+    hedge = NULL;
+    prefetcher_destroy(prefetcher);
+    prefetcher = NULL;
+    neg_cache_destroy(neg_cache);
+    neg_cache = NULL;
+    cache_destroy(cache);
+    cache = NULL;
+    return rc;
+}
+
+/* ============================================================================
+Main Entry Point
+============================================================================ */
+
+static void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-e loops] [-p policy] [-s snapshot] [-d disk_file] [-z] "
+                    "[proxy_port] [server_host] [server_port] [replica_host] [replica_port]\n",
+            prog);
+    fprintf(stderr, "\nOptions:\n");
+    fprintf(stderr, "  -e loops:    event-driven mode with this many epoll loops (Linux;\n"
+                    "               no replica)\n");
+    fprintf(stderr, "  -p policy:   cache policy: lru, clock, tinylfu, arc, 2q, s3fifo, gdsf\n"
+                    "               (default clock)\n");
+    fprintf(stderr, "  -s snapshot: restore the cache from this file at startup, save it at exit\n");
+    fprintf(stderr, "  -d disk_file: keep evicted files in a %d MB log on local disk\n",
+            DEFAULT_DISK_CACHE_SIZE / (1024 * 1024));
+    fprintf(stderr, "  -z:          store cached files compressed when they compress well\n");
+    fprintf(stderr, "\nDefaults:\n");
+    fprintf(stderr, "  proxy_port:  %d\n", PROXY_PORT);
+    fprintf(stderr, "  server_host: localhost\n");
+    fprintf(stderr, "  server_port: %d\n", DEFAULT_PORT);
+    fprintf(stderr, "  replica:     none (no hedging); replica_port defaults to server_port\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *prog = argv[0];
+    int proxy_port = PROXY_PORT;
+    int event_loops = 0;
+
+    /* Parse options */
+    int opt;
+    while ((opt = getopt(argc, argv, "e:p:s:d:z")) != -1) {
+        switch (opt) {
+        case 'e':
+            event_loops = atoi(optarg);
+            if (event_loops <= 0) {
+                fprintf(stderr, "Invalid number of event loops: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'p':
+            if (!cache_policy_parse(optarg, &cache_policy)) {
+                fprintf(stderr, "Unknown cache policy: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 's':
+            snapshot_path = optarg;
+            break;
+        case 'd':
+            disk_path = optarg;
+            break;
+        case 'z':
+            compress_cache = 1;
+            break;
+        default:
+            print_usage(prog);
+            return 1;
+        }
+    }
+#ifndef __linux__
+    if (event_loops > 0) {
+        fprintf(stderr, "Event-driven mode (-e) requires Linux (epoll)\n");
+        return 1;
+    }
+#endif
+
+    /* Positional arguments follow the options */
+    argc -= optind - 1;
+    argv += optind - 1;
+
+    if (argc > 1) {
+        proxy_port = atoi(argv[1]);
+        if (proxy_port <= 0 || proxy_port > 65535) {
+            fprintf(stderr, "Invalid proxy port: %s\n", argv[1]);
+            print_usage(prog);
+            return 1;
+        }
+    }
+    if (argc > 2) {
+        strncpy(server_host, argv[2], sizeof(server_host) - 1);
+        server_host[sizeof(server_host) - 1] = '\0';
+    }
+    if (argc > 3) {
+        server_port = atoi(argv[3]);
+        if (server_port <= 0 || server_port > 65535) {
+            fprintf(stderr, "Invalid server port: %s\n", argv[3]);
+            return 1;
+        }
+    }
+    if (argc > 4) {
+        strncpy(replica_host, argv[4], sizeof(replica_host) - 1);
+        replica_host[sizeof(replica_host) - 1] = '\0';
+        replica_port = server_port;
+    }
+    if (argc > 5) {
+        replica_port = atoi(argv[5]);
+        if (replica_port <= 0 || replica_port > 65535) {
+            fprintf(stderr, "Invalid replica port: %s\n", argv[5]);
+            return 1;
+        }
+    }
+    /* The epoll state machines talk to one backend; they do not hedge */
+    if (event_loops > 0 && replica_host[0] != '\0') {
+        fprintf(stderr, "Hedging with a replica is not supported in event-driven mode (-e)\n");
+        return 1;
     }
 
     /* Set up signal handlers */
@@ -307,7 +2298,7 @@ int main(int argc, char *argv[]) {
     printf("Cache size: %d MB\n", CACHE_SIZE / (1024 * 1024));
     printf("Press Ctrl+C to stop\n\n");
 
-    int result = run_proxy(proxy_port);
+    int result = run_proxy(proxy_port, event_loops);
 
     printf("\nProxy stopped.\n");
     return result;
@@ -0,0 +1,355 @@
+/*
+slab.c - Size-Class Slab Allocator
+
+Payload memory for the cache, carved from large mmap'd slabs instead of
+malloc'd one file at a time.
+
+Key concepts:
+- Size classes: a request is rounded up to the next of 45 chunk sizes
+  (64, 80, 96, 112, 128, 160, ... 128 KB), so chunks of one class are
+  interchangeable and a freed chunk is always reusable by the next file
+  of similar size - the heap cannot fragment into unusable holes
+- Slabs are SLAB_SIZE-aligned, so a chunk's slab header is found by
+  masking its address; each slab keeps its own free list and live count
+- Chunks are carved lazily (bump pointer), so the untouched tail of a new
+  slab costs no RSS
+- A slab that becomes entirely free is unmapped, except for one spare per
+  class whose pages are released with MADV_DONTNEED
+- Freed chunks of SLAB_RELEASE_CHUNK or more give their whole pages back
+  too, so a half-empty slab of large chunks does not stay resident; but
+  only past SLAB_RELEASE_KEEP free bytes in the class, so a hot cache
+  that evicts to make room reuses resident chunks without a madvise
+  and a page refault each time
+
+Used in Part C (Proxy) through cache.c.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../include/slab.h"
+
+/* Bytes reserved for the header at the start of each slab */
+#define SLAB_HEADER     64
+
+struct slab {
+    slab_t *prev, *next;            /* Class's partial list */
+    slab_class_t *cls;
+    void *free;                     /* Freed chunks (next pointer in chunk) */
+    uint32_t live;                  /* Chunks handed out */
+    uint32_t carved;                /* Chunks ever carved (bump pointer) */
+    uint32_t capacity;              /* Chunks that fit in the slab */
+};
+
+/* ============================================================================
+Internal Helper Functions
+============================================================================ */
+
+/*
+class_index - Size class for a request of 'size' bytes (internal)
+
+Returns: Class index, or -1 if the request is above SLAB_MAX_CHUNK.
+*/
+static int class_index(size_t size) {
+    if (size <= SLAB_MIN_CHUNK) {
+        return 0;
+    }
+    if (size > SLAB_MAX_CHUNK) {
+        return -1;
+    }
+    int k = 63 - __builtin_clzll((unsigned long long)(size - 1));
+    size_t base = (size_t)1 << k;
+    size_t step = base / SLAB_CLASSES_PER_DOUBLING;
+    int sub = (int)((size - 1 - base) / step);
+    return (k - 6) * SLAB_CLASSES_PER_DOUBLING + sub + 1;
+}
+
+/*
+class_size - Chunk size of a class (internal)
+*/
+static size_t class_size(int index) {
+    if (index == 0) {
+        return SLAB_MIN_CHUNK;
+    }
+    int j = index - 1;
+    size_t base = (size_t)SLAB_MIN_CHUNK << (j / SLAB_CLASSES_PER_DOUBLING);
+    return base + (size_t)(j % SLAB_CLASSES_PER_DOUBLING + 1) * base / SLAB_CLASSES_PER_DOUBLING;
+}
+
+/*
+page_round - Round up to whole pages (internal)
+*/
+static size_t page_round(size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (size + page - 1) & ~(page - 1);
+}
+
+/*
+map_slab - Map one SLAB_SIZE-aligned slab (internal)
+
+Maps twice the size and trims the unaligned ends.
+*/
+static slab_t *map_slab(slab_class_t *cls) {
+    char *raw = mmap(NULL, 2 * SLAB_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        perror("mmap slab");
+        return NULL;
+    }
+    char *aligned = (char *)(((uintptr_t)raw + SLAB_SIZE - 1) & ~((uintptr_t)SLAB_SIZE - 1));
+    if (aligned > raw) {
+        munmap(raw, aligned - raw);
+    }
+    if (aligned + SLAB_SIZE < raw + 2 * SLAB_SIZE) {
+        munmap(aligned + SLAB_SIZE, raw + 2 * SLAB_SIZE - (aligned + SLAB_SIZE));
+    }
+
+    slab_t *slab = (slab_t *)aligned;
+    slab->prev = slab->next = NULL;
+    slab->cls = cls;
+    slab->free = NULL;
+    slab->live = 0;
+    slab->carved = 0;
+    slab->capacity = (uint32_t)((SLAB_SIZE - SLAB_HEADER) / cls->chunk_size);
+    cls->slabs++;
+    return slab;
+}
+
+/*
+partial_push - Slab gained a free chunk (internal)
+*/
+static void partial_push(slab_class_t *cls, slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = cls->partial;
+    if (cls->partial != NULL) {
+        cls->partial->prev = slab;
+    }
+    cls->partial = slab;
+}
+
+/*
+partial_remove - Slab is full or retired (internal)
+*/
+static void partial_remove(slab_class_t *cls, slab_t *slab) {
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    } else {
+        cls->partial = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+    slab->prev = slab->next = NULL;
+}
+
+/*
+retire_slab - A slab has no live chunks left (internal)
+
+The first one becomes the class's spare (pages given back, mapping kept);
+any further one is unmapped.
+*/
+static void retire_slab(slab_class_t *cls, slab_t *slab) {
+    partial_remove(cls, slab);
+    __atomic_sub_fetch(&cls->free_chunks, slab->carved, __ATOMIC_RELAXED);
+    if (cls->empty == NULL) {
+        slab->free = NULL;
+        slab->carved = 0;
+        madvise((char *)slab + SLAB_HEADER, SLAB_SIZE - SLAB_HEADER, MADV_DONTNEED);
+        cls->empty = slab;
+        return;
+    }
+    munmap(slab, SLAB_SIZE);
+    cls->slabs--;
+}
+
+/* ============================================================================
+Lifecycle
+============================================================================ */
+
+/*
+slab_create - Create an allocator
+*/
+slab_allocator_t *slab_create(void) {
+    slab_allocator_t *alloc = calloc(1, sizeof(slab_allocator_t));
+    if (alloc == NULL) {
+        perror("calloc slab allocator");
+        return NULL;
+    }
+    for (int i = 0; i < SLAB_NUM_CLASSES; i++) {
+        pthread_mutex_init(&alloc->classes[i].lock, NULL);
+        alloc->classes[i].chunk_size = class_size(i);
+    }
+    return alloc;
+}
+
+/*
+release_pages - Give a free chunk's whole pages back to the OS (internal)
+
+The first bytes hold the free-list link, so the first page is kept.
+Must be called while the caller still owns the chunk.
+*/
+static void release_pages(void *ptr, size_t chunk_size) {
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)ptr + sizeof(void *) + page - 1) & ~(page - 1);
+    uintptr_t end = ((uintptr_t)ptr + chunk_size) & ~(page - 1);
+    if (end > start) {
+        madvise((void *)start, end - start, MADV_DONTNEED);
+    }
+}
+
+/*
+slab_destroy - Unmap every slab
+*/
+void slab_destroy(slab_allocator_t *alloc) {
+    if (alloc == NULL) {
+        return;
+    }
+    for (int i = 0; i < SLAB_NUM_CLASSES; i++) {
+        slab_class_t *cls = &alloc->classes[i];
+        while (cls->partial != NULL) {
+            slab_t *slab = cls->partial;
+            cls->partial = slab->next;
+            munmap(slab, SLAB_SIZE);
+        }
+        if (cls->empty != NULL) {
+            munmap(cls->empty, SLAB_SIZE);
+        }
+        pthread_mutex_destroy(&cls->lock);
+    }
+    free(alloc);
+}
+
+/* ============================================================================
+Allocation
+============================================================================ */
+
+/*
+slab_alloc - Allocate 'size' bytes (16-byte aligned)
+*/
+void *slab_alloc(slab_allocator_t *alloc, size_t size) {
+    int index = class_index(size);
+    if (index < 0) {
+        size_t bytes = page_round(size);
+        void *ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            perror("mmap large chunk");
+            return NULL;
+        }
+        __atomic_add_fetch(&alloc->large_bytes, bytes, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&alloc->large_count, 1, __ATOMIC_RELAXED);
+        return ptr;
+    }
+
+    slab_class_t *cls = &alloc->classes[index];
+    pthread_mutex_lock(&cls->lock);
+
+    slab_t *slab = cls->partial;
+    if (slab == NULL) {
+        slab = cls->empty;
+        cls->empty = NULL;
+        if (slab == NULL) {
+            slab = map_slab(cls);
+        }
+        if (slab == NULL) {
+            pthread_mutex_unlock(&cls->lock);
+            return NULL;
+        }
+        partial_push(cls, slab);
+    }
+
+    void *chunk;
+    if (slab->free != NULL) {
+        chunk = slab->free;
+        slab->free = *(void **)chunk;
+        __atomic_sub_fetch(&cls->free_chunks, 1, __ATOMIC_RELAXED);
+    } else {
+        chunk = (char *)slab + SLAB_HEADER + (size_t)slab->carved * cls->chunk_size;
+        slab->carved++;
+    }
+    if (++slab->live == slab->capacity) {
+        partial_remove(cls, slab);
+    }
+    cls->live++;
+
+    pthread_mutex_unlock(&cls->lock);
+    return chunk;
+}
+
+/*
+slab_free - Return an allocation
+*/
+void slab_free(slab_allocator_t *alloc, void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    int index = class_index(size);
+    if (index < 0) {
+        size_t bytes = page_round(size);
+        munmap(ptr, bytes);
+        __atomic_sub_fetch(&alloc->large_bytes, bytes, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&alloc->large_count, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    slab_t *slab = (slab_t *)((uintptr_t)ptr & ~((uintptr_t)SLAB_SIZE - 1));
+    slab_class_t *cls = slab->cls;
+    /* Read without the lock: a free racing with this one may tip the
+       class over the mark a chunk late, which is harmless */
+    if (cls->chunk_size >= SLAB_RELEASE_CHUNK &&
+        __atomic_load_n(&cls->free_chunks, __ATOMIC_RELAXED) * cls->chunk_size >=
+            SLAB_RELEASE_KEEP) {
+        release_pages(ptr, cls->chunk_size);
+    }
+    pthread_mutex_lock(&cls->lock);
+
+    bool was_full = slab->live == slab->capacity;
+    *(void **)ptr = slab->free;
+    slab->free = ptr;
+    slab->live--;
+    cls->live--;
+    __atomic_add_fetch(&cls->free_chunks, 1, __ATOMIC_RELAXED);
+
+    if (was_full) {
+        partial_push(cls, slab);
+    }
+    if (slab->live == 0) {
+        retire_slab(cls, slab);
+    }
+
+    pthread_mutex_unlock(&cls->lock);
+}
+
+/*
+slab_chunk_size - Memory really used by an allocation of 'size' bytes
+*/
+size_t slab_chunk_size(size_t size) {
+    int index = class_index(size);
+    return index < 0 ? page_round(size) : class_size(index);
+}
+
+/* ============================================================================
+Statistics
+============================================================================ */
+
+/*
+slab_get_stats - Snapshot allocator statistics
+*/
+void slab_get_stats(slab_allocator_t *alloc, slab_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < SLAB_NUM_CLASSES; i++) {
+        slab_class_t *cls = &alloc->classes[i];
+        pthread_mutex_lock(&cls->lock);
+        stats->slabs += cls->slabs;
+        stats->used_bytes += cls->live * cls->chunk_size;
+        pthread_mutex_unlock(&cls->lock);
+    }
+    stats->mapped_bytes = stats->slabs * SLAB_SIZE +
+                          __atomic_load_n(&alloc->large_bytes, __ATOMIC_RELAXED);
+    stats->used_bytes += __atomic_load_n(&alloc->large_bytes, __ATOMIC_RELAXED);
+    stats->large_allocs = __atomic_load_n(&alloc->large_count, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,123 @@
+/*
+stat_counters.c - Per-Thread Statistics Counters
+
+Counters that threads bump without sharing a cache line.
+
+Key concepts:
+- Layout: slot s, counter i lives at slots[s * stride + i]; stride is a
+  whole number of cache lines and the array is line aligned, so no two
+  slots share a line
+- A thread's slot number is handed out once from a global ticket; the
+  thread keeps it in a thread-local. The first nslots threads of a
+  process get distinct slots in every group, the later ones wrap
+- Merging is the reader's job: it walks nslots lines, which is cheap
+  next to the cost of making every request write a shared line
+
+Used in Part B (thread_pool.c) and Part C (cache.c).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/stat_counters.h"
+
+#define COUNTERS_PER_LINE   (STAT_COUNTERS_LINE / sizeof(uint64_t))
+
+/* Next slot number to hand out */
+static unsigned next_slot;
+
+/* The calling thread's slot number plus one; 0 until its first add */
+__thread unsigned stat_counters_slot_plus1;
+
+/* ============================================================================
+Internal Helper Functions
+============================================================================ */
+
+/*
+slot_count - Slots for a new group: one per CPU, as a power of two
+(internal)
+*/
+static unsigned slot_count(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    unsigned n = STAT_COUNTERS_MIN_SLOTS;
+    while (n < STAT_COUNTERS_MAX_SLOTS && (long)n < cpus) {
+        n *= 2;
+    }
+    return n;
+}
+
+/* ============================================================================
+Lifecycle
+============================================================================ */
+
+/*
+stat_counters_init - Allocate a group of zeroed counters
+*/
+bool stat_counters_init(stat_counters_t *counters, unsigned ncounters) {
+    memset(counters, 0, sizeof(*counters));
+    if (ncounters == 0) {
+        return false;
+    }
+
+    unsigned stride = (ncounters + COUNTERS_PER_LINE - 1) / COUNTERS_PER_LINE * COUNTERS_PER_LINE;
+    unsigned nslots = slot_count();
+    size_t bytes = (size_t)nslots * stride * sizeof(uint64_t);
+    uint64_t *slots = aligned_alloc(STAT_COUNTERS_LINE, bytes);
+    if (slots == NULL) {
+        perror("stat counters alloc");
+        return false;
+    }
+    memset(slots, 0, bytes);
+
+    counters->slots = slots;
+    counters->ncounters = ncounters;
+    counters->stride = stride;
+    counters->nslots = nslots;
+    return true;
+}
+
+/*
+stat_counters_destroy - Free a group
+*/
+void stat_counters_destroy(stat_counters_t *counters) {
+    free(counters->slots);
+    memset(counters, 0, sizeof(*counters));
+}
+
+/* ============================================================================
+Counting
+============================================================================ */
+
+/*
+stat_counters_assign_slot - Give the calling thread its slot number
+*/
+unsigned stat_counters_assign_slot(void) {
+    unsigned slot = __atomic_fetch_add(&next_slot, 1, __ATOMIC_RELAXED);
+    stat_counters_slot_plus1 = slot + 1;
+    return slot;
+}
+
+/*
+stat_counters_sum - Total of one counter over every slot
+*/
+uint64_t stat_counters_sum(const stat_counters_t *counters, unsigned id) {
+    uint64_t total = 0;
+    for (unsigned s = 0; s < counters->nslots; s++) {
+        total += __atomic_load_n(&counters->slots[(size_t)s * counters->stride + id],
+                                 __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+/*
+stat_counters_reset - Set every counter of a group to zero
+*/
+void stat_counters_reset(stat_counters_t *counters) {
+    for (unsigned s = 0; s < counters->nslots; s++) {
+        for (unsigned i = 0; i < counters->ncounters; i++) {
+            __atomic_store_n(&counters->slots[(size_t)s * counters->stride + i], 0,
+                             __ATOMIC_RELAXED);
+        }
+    }
+}
@@ -35,9 +35,9 @@ thread_pool_t *thread_pool_create(int num_threads) {
      * 1. Validate num_threads > 0
      * 2. Allocate thread_pool_t structure
      * 3. Create work queue using work_queue_create()
-     * 4. Initialize mutexes (lock, stats_lock)
+     * 4. Initialize the mutex (lock)
      * 5. Allocate thread array: malloc(num_threads * sizeof(pthread_t))
-     * 6. Initialize statistics (tasks_completed = 0, active_workers = 0)
+     * 6. Initialize statistics (stat_counters_init, all counters 0)
      * 7. Set shutdown = false
      * 8. Create worker threads:
      *    for (int i = 0; i < num_threads; i++) {
@@ -70,8 +70,10 @@ thread_pool_t *thread_pool_create(int num_threads) {
     pool->num_threads = 0;
     pool->queue = NULL;
     pool->shutdown = false;
-    pool->tasks_completed = 0;
-    pool->active_workers = 0;
+    if (!stat_counters_init(&pool->stats, THREAD_POOL_STAT_COUNT)) {
+        free(pool);
+        return NULL;
+    }
 
     /* YOUR CODE HERE */
 
@@ -118,7 +120,7 @@ void thread_pool_destroy(thread_pool_t *pool) {
      *        pthread_join(pool->threads[i], NULL);
      *    }
      * 5. Destroy work queue
-     * 6. Destroy mutexes
+     * 6. Destroy the mutex and the statistics counters
      * 7. Free thread array
      * 8. Free pool structure
      *
@@ -133,6 +135,7 @@ void thread_pool_destroy(thread_pool_t *pool) {
 
     /* YOUR CODE HERE */
 
+    stat_counters_destroy(&pool->stats);
     free(pool);
 }
 
@@ -194,10 +197,8 @@ void *worker_function(void *arg) {
      *           break;  // Queue signaled shutdown
      *       }
      *
-     *       // Update statistics (thread-safe)
-     *       pthread_mutex_lock(&pool->stats_lock);
-     *       pool->active_workers++;
-     *       pthread_mutex_unlock(&pool->stats_lock);
+     *       // Update statistics (thread-safe: each worker has its own slot)
+     *       stat_counters_inc(&pool->stats, THREAD_POOL_STAT_ACTIVE);
      *
      *       // Handle the client request
      *       handle_client_request(client_fd);
@@ -206,10 +207,8 @@ void *worker_function(void *arg) {
      *       close(client_fd);
      *
      *       // Update statistics
-     *       pthread_mutex_lock(&pool->stats_lock);
-     *       pool->active_workers--;
-     *       pool->tasks_completed++;
-     *       pthread_mutex_unlock(&pool->stats_lock);
+     *       stat_counters_dec(&pool->stats, THREAD_POOL_STAT_ACTIVE);
+     *       stat_counters_inc(&pool->stats, THREAD_POOL_STAT_TASKS);
      *   }
      *
      *   return NULL;
@@ -226,55 +225,72 @@ void *worker_function(void *arg) {
     return NULL;
 }
 
+/*
+send_status_response - Send a header-only response (errors, not modified)
+*/
+static void send_status_response(int client_fd, gf_status_t status,
+                                 const gf_validator_t *validator) {
+    char header[256];
+    int len = gf_create_response_header_validated(header, sizeof(header),
+                                                  status, 0, validator);
+    if (len > 0) {
+        send_all(client_fd, header, len);
+    }
+}
+
 /*
 handle_client_request - Process a single client request
 
-This is the actual file serving logic.
+This is the actual file serving logic. Every OK response carries the
+file's validator; a conditional request whose validator still matches
+is answered with NOT_MODIFIED and no content.
 */
 static void handle_client_request(int client_fd) {
-    /*
-     * TODO: Implement this function
-     *
-     * This is where you handle the GETFILE protocol!
-     *
-     * Steps:
-     * 1. Receive request (use recv_until for header)
-     * 2. Parse request using gf_parse_request()
-     * 3. Validate path using validate_path()
-     * 4. Build full path using build_full_path()
-     * 5. Check if file exists
-     * 6. Get file size
-     * 7. Send response header using gf_create_response_header()
-     * 8. If OK, send file content using send_file()
-     *
-     * Error cases:
-     * - Invalid request: send GETFILE INVALID
-     * - Path validation fails: send GETFILE INVALID
-     * - File not found: send GETFILE FILE_NOT_FOUND
-     * - Other errors: send GETFILE ERROR
-     *
-     * Example flow:
-     *   char buffer[MAX_HEADER_LEN];
-     *   gf_request_t request;
-     *
-     *   // Receive header
-     *   ssize_t n = recv_until(client_fd, buffer, sizeof(buffer), HEADER_DELIM);
-     *   if (n <= 0) return;
-     *
-     *   // Parse request
-     *   if (gf_parse_request(buffer, n, &request) <= 0 || !request.valid) {
-     *       send_error_response(client_fd, STATUS_INVALID);
-     *       return;
-     *   }
-     *
-     *   // Validate and serve file...
-     */
+    char buffer[MAX_HEADER_LEN];
+    gf_request_t request;
 
-    (void)client_fd;
+    ssize_t n = recv_until(client_fd, buffer, sizeof(buffer), HEADER_DELIM);
+    if (n <= 0) {
+        return;
+    }
 
-    /* YOUR CODE HERE */
+    if (gf_parse_request(buffer, n, &request) <= 0 || !request.valid ||
+        !validate_path(request.path)) {
+        send_status_response(client_fd, STATUS_INVALID, NULL);
+        return;
+    }
+
+    char filepath[MAX_PATH_LEN];
+    if (build_full_path(filepath, sizeof(filepath), FILE_ROOT, request.path) < 0) {
+        send_status_response(client_fd, STATUS_ERROR, NULL);
+        return;
+    }
+
+    gf_validator_t validator;
+    size_t file_size;
+    if (!file_exists(filepath) ||
+        get_file_version(filepath, &validator.mtime_ns, &file_size) < 0) {
+        send_status_response(client_fd, STATUS_FILE_NOT_FOUND, NULL);
+        return;
+    }
+    validator.size = file_size;
+
+    if (request.has_validator && gf_validator_equal(&request.validator, &validator)) {
+        send_status_response(client_fd, STATUS_NOT_MODIFIED, &validator);
+        return;
+    }
 
-    printf("Handled client request\n");
+    char header[256];
+    int header_len = gf_create_response_header_validated(header, sizeof(header),
+                                                         STATUS_OK, file_size,
+                                                         &validator);
+    if (header_len < 0 || send_all(client_fd, header, header_len) != header_len) {
+        return;
+    }
+
+    if (send_file(client_fd, filepath, NULL) < 0) {
+        fprintf(stderr, "Error sending %s\n", request.path);
+    }
 }
 
 /* ============================================================================
@@ -285,22 +301,20 @@ Statistics
 thread_pool_get_stats - Get thread pool statistics
 */
 void thread_pool_get_stats(thread_pool_t *pool, int *tasks_completed, int *active_workers) {
-    /*
-     * TODO: Implement this function
-     *
-     * Thread-safe read of statistics.
-     *
-     * pthread_mutex_lock(&pool->stats_lock);
-     * if (tasks_completed) *tasks_completed = pool->tasks_completed;
-     * if (active_workers) *active_workers = pool->active_workers;
-     * pthread_mutex_unlock(&pool->stats_lock);
-     */
-
     if (pool == NULL) {
         if (tasks_completed) *tasks_completed = 0;
         if (active_workers) *active_workers = 0;
         return;
     }
 
-    /* YOUR CODE HERE */
+    /* Local counters + final merge: the workers never take a lock */
+    if (tasks_completed) {
+        *tasks_completed = (int)stat_counters_sum(&pool->stats, THREAD_POOL_STAT_TASKS);
+    }
+    if (active_workers) {
+        /* Slots are read one by one with no lock, while workers update
+           theirs: a worker starting or finishing meanwhile may or may not
+           be counted, so this is a recent value rather than an exact one */
+        *active_workers = (int)stat_counters_sum(&pool->stats, THREAD_POOL_STAT_ACTIVE);
+    }
 }
@@ -1,7 +1,8 @@
 /*
 test_cache.c - Unit Tests for Cache Implementation
 
-Tests the LRU cache operations.
+Tests the LRU cache operations and the proxy components around it
+(negative cache, prefetcher, hedging).
 
 Compile: make test_cache
 Run: ./test_cache
@@ -10,8 +11,27 @@ Run: ./test_cache
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <pthread.h>
+#include <time.h>
+#include <math.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/wait.h>
 #include "../include/cache.h"
+#include "../include/cache_sim.h"
+#include "../include/freq_sketch.h"
+#include "../include/slab.h"
+#include "../include/cache_index.h"
+#include "../include/epoch.h"
+#include "../include/stat_counters.h"
+#include "../include/cache_disk.h"
+#include "../include/lz.h"
+#include "../include/fast_hash.h"
+#include "../include/mrc.h"
+#include "../include/neg_cache.h"
+#include "../include/prefetch.h"
+#include "../include/hedge.h"
 
 /* ============================================================================
 Test Utilities
@@ -358,11 +378,3664 @@ static void test_cache_concurrent(void) {
     PASS();
 }
 
+/* ============================================================================
+Sharding Tests
+============================================================================ */
+
+static void test_cache_sharded_basic(void) {
+    TEST(cache_sharded_basic);
+
+    cache_t *cache = cache_create_sharded(64 * 1024, 8);  /* 8 KB per shard */
+    ASSERT(cache != NULL, "Should create sharded cache");
+    ASSERT(cache_create_sharded(1024, 0) == NULL, "Should reject 0 shards");
+
+    char key[64];
+    char data[100];
+    memset(data, 'x', sizeof(data));
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "/file%d", i);
+        ASSERT(cache_put(cache, key, data, sizeof(data)), "Put should succeed");
+    }
+
+    int used_shards = 0;
+    for (int i = 0; i < cache->num_shards; i++) {
+        if (cache->shards[i].num_entries > 0) {
+            used_shards++;
+        }
+    }
+    ASSERT(used_shards == 8, "Keys should spread over all shards");
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.num_entries == 200, "Stats should sum all shards");
+    size_t charged = 0;
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "/file%d", i);
+        charged += cache_entry_charge(key, sizeof(data));
+    }
+    ASSERT(stats.current_size == charged, "Sizes should sum all shards");
+    ASSERT(stats.num_shards == 8, "Stats should report the shard count");
+
+    /* Larger than one shard's budget, though smaller than the whole cache */
+    char *big = calloc(1, 16 * 1024);
+    ASSERT(big != NULL, "Should allocate test data");
+    ASSERT(!cache_put(cache, "/big", big, 16 * 1024), "Should reject entry above shard budget");
+    free(big);
+
+    cache_destroy(cache);
+    PASS();
+}
+
+static void test_cache_default_shards(void) {
+    TEST(cache_default_shards);
+
+    cache_t *small = cache_create(1024);
+    cache_t *large = cache_create(64 * 1024 * 1024);
+    ASSERT(small != NULL && large != NULL, "Should create caches");
+    ASSERT(small->num_shards == 1, "Small caches should stay a single LRU");
+    ASSERT(large->num_shards == DEFAULT_CACHE_SHARDS, "Large caches should be sharded");
+
+    cache_destroy(small);
+    cache_destroy(large);
+    PASS();
+}
+
+/* ============================================================================
+Sharding Benchmark
+============================================================================ */
+
+#define BENCH_KEYS          4096
+#define BENCH_OPS           20000   /* per thread */
+#define BENCH_MAX_THREADS   64
+#define ZIPF_TRACE_LEN      200000
+
+typedef struct {
+    cache_t *cache;
+    unsigned int seed;
+    const int *trace;           /* Zipf key trace (gets only), NULL = uniform 90/10 */
+    unsigned long gets;
+} bench_arg_t;
+
+static unsigned int xorshift32(unsigned int *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+static void *bench_worker(void *arg) {
+    bench_arg_t *b = arg;
+    char key[32];
+    char data[64] = "benchmark payload";
+    unsigned int x = b->seed;
+
+    for (int i = 0; i < BENCH_OPS; i++) {
+        xorshift32(&x);
+        if (b->trace != NULL) {
+            snprintf(key, sizeof(key), "/bench/%d", b->trace[(b->seed + i) % ZIPF_TRACE_LEN]);
+            cache_get(b->cache, key, NULL, NULL);
+            b->gets++;
+            continue;
+        }
+        snprintf(key, sizeof(key), "/bench/%u", x % BENCH_KEYS);
+        if (x % 10 == 0) {
+            cache_put(b->cache, key, data, sizeof(data));
+        } else {
+            cache_get(b->cache, key, NULL, NULL);
+            b->gets++;
+        }
+    }
+    return NULL;
+}
+
+/*
+bench_run - Ops per second with num_threads threads
+
+Uniform keys with 90% get / 10% put, or gets replaying a Zipf trace.
+*/
+static double bench_run(cache_t *cache, int num_threads, const int *trace,
+                        unsigned long *gets) {
+    pthread_t threads[BENCH_MAX_THREADS];
+    bench_arg_t args[BENCH_MAX_THREADS];
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < num_threads; i++) {
+        args[i].cache = cache;
+        args[i].seed = 2463534242u + i * 7919;
+        args[i].trace = trace;
+        args[i].gets = 0;
+        pthread_create(&threads[i], NULL, bench_worker, &args[i]);
+    }
+    *gets = 0;
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+        *gets += args[i].gets;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return (double)num_threads * BENCH_OPS / secs;
+}
+
+static void test_cache_shard_scaling(void) {
+    TEST(cache_shard_scaling);
+
+    cache_t *single = cache_create_sharded(64 * 1024 * 1024, 1);
+    cache_t *sharded = cache_create_sharded(64 * 1024 * 1024, DEFAULT_CACHE_SHARDS);
+    ASSERT(single != NULL && sharded != NULL, "Should create caches");
+
+    /* Pre-fill so every get is a hit */
+    char key[32];
+    char data[64] = "benchmark payload";
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        snprintf(key, sizeof(key), "/bench/%d", i);
+        cache_put(single, key, data, sizeof(data));
+        cache_put(sharded, key, data, sizeof(data));
+    }
+
+    printf("\n    threads   1 shard (Mops/s)   %d shards (Mops/s)\n", DEFAULT_CACHE_SHARDS);
+    for (int t = 1; t <= BENCH_MAX_THREADS; t *= 2) {
+        unsigned long gets_single, gets_sharded;
+        cache_reset_stats(single);
+        cache_reset_stats(sharded);
+        double ops_single = bench_run(single, t, NULL, &gets_single);
+        double ops_sharded = bench_run(sharded, t, NULL, &gets_sharded);
+        printf("    %7d   %16.2f   %17.2f\n", t, ops_single / 1e6, ops_sharded / 1e6);
+
+        cache_stats_t s1, s2;
+        cache_get_stats(single, &s1);
+        cache_get_stats(sharded, &s2);
+        ASSERT(s1.hits == gets_single && s1.misses == 0, "Every get should hit (1 shard)");
+        ASSERT(s2.hits == gets_sharded && s2.misses == 0, "Every get should hit (sharded)");
+    }
+    printf("  ");
+
+    cache_destroy(single);
+    cache_destroy(sharded);
+    PASS();
+}
+
+/* ============================================================================
+CLOCK Policy Tests
+============================================================================ */
+
+static void test_cache_clock_second_chance(void) {
+    TEST(cache_clock_second_chance);
+
+    char data[100] = {0};
+    cache_t *cache = cache_create_with_policy(3 * cache_entry_charge("/a", sizeof(data)), 1,
+                                              CACHE_POLICY_CLOCK);
+    ASSERT(cache != NULL, "Should create CLOCK cache");
+
+    cache_put(cache, "/a", data, sizeof(data));
+    cache_put(cache, "/b", data, sizeof(data));
+    cache_put(cache, "/c", data, sizeof(data));
+
+    /* /a is referenced, so the hand passes it and takes /b */
+    ASSERT(cache_get(cache, "/a", NULL, NULL), "Should hit /a");
+    cache_put(cache, "/d", data, sizeof(data));
+
+    ASSERT(cache_contains(cache, "/a"), "/a should get a second chance");
+    ASSERT(!cache_contains(cache, "/b"), "/b should be evicted");
+    ASSERT(cache_contains(cache, "/c") && cache_contains(cache, "/d"), "Others should remain");
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.evictions == 1 && stats.num_entries == 3, "One eviction expected");
+    ASSERT(stats.policy == CACHE_POLICY_CLOCK, "Stats should report the policy");
+
+    cache_destroy(cache);
+    PASS();
+}
+
+static void test_cache_clock_expiry(void) {
+    TEST(cache_clock_expiry);
+
+    cache_t *cache = cache_create_with_policy(1024 * 1024, 1, CACHE_POLICY_CLOCK);
+    ASSERT(cache != NULL, "Should create CLOCK cache");
+    cache_set_stale_window(cache, 10000);
+
+    cache_validator_t v = { 42, 5 };
+    ASSERT(cache_put_validated(cache, "/f", "hello", 5, &v, 1), "Put should succeed");
+    usleep(5 * 1000);
+
+    /* Expired entries leave the read-locked path and are handled as before */
+    char *data;
+    size_t size;
+    cache_validator_t out;
+    ASSERT(cache_lookup_copy(cache, "/f", &data, &size, &out) == CACHE_LOOKUP_REVALIDATE,
+           "Expired entry should be served stale with one revalidator");
+    free(data);
+    ASSERT(out.mtime_ns == 42, "Validator should be returned");
+    ASSERT(cache_lookup_copy(cache, "/f", &data, &size, NULL) == CACHE_LOOKUP_STALE,
+           "Second caller should only get the stale copy");
+    free(data);
+
+    ASSERT(cache_revalidated(cache, "/f", CACHE_TTL_NONE), "Revalidate should succeed");
+    ASSERT(cache_lookup_copy(cache, "/f", &data, &size, NULL) == CACHE_LOOKUP_FRESH,
+           "Revalidated entry should be fresh");
+    free(data);
+
+    cache_destroy(cache);
+    PASS();
+}
+
+/*
+zipf_trace - Fill trace with key indices drawn from Zipf(s) over num_keys
+*/
+static void zipf_trace(int *trace, int len, int num_keys, double s, unsigned int seed) {
+    double *cdf = malloc(num_keys * sizeof(double));
+    double sum = 0.0;
+    for (int i = 0; i < num_keys; i++) {
+        sum += 1.0 / pow(i + 1, s);
+        cdf[i] = sum;
+    }
+
+    unsigned int x = seed;
+    for (int n = 0; n < len; n++) {
+        double u = (double)xorshift32(&x) / 4294967296.0 * sum;
+        int lo = 0, hi = num_keys - 1;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (cdf[mid] < u) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        trace[n] = lo;
+    }
+    free(cdf);
+}
+
+/*
+replay_hit_ratio - Single-threaded read-through replay of a trace
+*/
+static double replay_hit_ratio(cache_policy_t policy, const int *trace, int len, int entries) {
+    char key[32];
+    char data[100] = {0};
+    cache_t *cache = cache_create_with_policy(entries * cache_entry_charge("/bench/1000", sizeof(data)), 1, policy);
+
+    for (int i = 0; i < len; i++) {
+        snprintf(key, sizeof(key), "/bench/%d", trace[i]);
+        if (!cache_get(cache, key, NULL, NULL)) {
+            cache_put(cache, key, data, sizeof(data));
+        }
+    }
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    cache_destroy(cache);
+    return stats.hit_rate;
+}
+
+static void test_cache_clock_vs_lru_zipf(void) {
+    TEST(cache_clock_vs_lru_zipf);
+
+    int *trace = malloc(ZIPF_TRACE_LEN * sizeof(int));
+    ASSERT(trace != NULL, "Should allocate trace");
+    zipf_trace(trace, ZIPF_TRACE_LEN, BENCH_KEYS, 0.99, 12345);
+
+    printf("\n    Zipf(0.99) over %d keys, hit ratio:\n", BENCH_KEYS);
+    printf("    entries      LRU    CLOCK\n");
+    int sizes[] = { 64, 256, 1024 };
+    for (int i = 0; i < 3; i++) {
+        double lru = replay_hit_ratio(CACHE_POLICY_LRU, trace, ZIPF_TRACE_LEN, sizes[i]);
+        double clk = replay_hit_ratio(CACHE_POLICY_CLOCK, trace, ZIPF_TRACE_LEN, sizes[i]);
+        printf("    %7d   %5.1f%%   %5.1f%%\n", sizes[i], lru * 100, clk * 100);
+        if (clk < lru - 0.05) {
+            free(trace);
+            FAIL("CLOCK hit ratio should be close to LRU");
+            return;
+        }
+    }
+
+    /* Hit throughput on one shard, so the lock is the only difference */
+    cache_t *lru = cache_create_with_policy(64 * 1024 * 1024, 1, CACHE_POLICY_LRU);
+    cache_t *clk = cache_create_with_policy(64 * 1024 * 1024, 1, CACHE_POLICY_CLOCK);
+    char key[32];
+    char data[64] = "benchmark payload";
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        snprintf(key, sizeof(key), "/bench/%d", i);
+        cache_put(lru, key, data, sizeof(data));
+        cache_put(clk, key, data, sizeof(data));
+    }
+
+    printf("    threads   LRU hits (Mops/s)   CLOCK hits (Mops/s)\n");
+    for (int t = 1; t <= BENCH_MAX_THREADS; t *= 4) {
+        unsigned long gets;
+        double ops_lru = bench_run(lru, t, trace, &gets);
+        double ops_clk = bench_run(clk, t, trace, &gets);
+        printf("    %7d   %17.2f   %19.2f\n", t, ops_lru / 1e6, ops_clk / 1e6);
+    }
+    printf("  ");
+
+    cache_destroy(lru);
+    cache_destroy(clk);
+    free(trace);
+    PASS();
+}
+
+/* ============================================================================
+Lock-Free Read Tests
+============================================================================ */
+
+typedef struct {
+    volatile int entered;
+    volatile int leave;
+} epoch_reader_t;
+
+static void *epoch_reader(void *arg) {
+    epoch_reader_t *r = arg;
+    epoch_enter();
+    r->entered = 1;
+    while (!r->leave) {
+        usleep(1000);
+    }
+    epoch_exit();
+    return NULL;
+}
+
+static void count_free(void *ptr) {
+    (*(int *)ptr)++;
+}
+
+static void test_epoch_defers_free(void) {
+    TEST(epoch_defers_free);
+
+    epoch_list_t list = {0};
+    int freed = 0;
+
+    /* No reader: the next reclaim frees it */
+    epoch_retire(&list, count_free, &freed);
+    epoch_reclaim(&list);
+    ASSERT(freed == 1 && list.count == 0, "Unread object should be freed");
+
+    epoch_reader_t r = {0, 0};
+    pthread_t thread;
+    pthread_create(&thread, NULL, epoch_reader, &r);
+    while (!r.entered) {
+        usleep(1000);
+    }
+    epoch_retire(&list, count_free, &freed);
+    for (int i = 0; i < 10; i++) {
+        epoch_reclaim(&list);
+    }
+    ASSERT(freed == 1 && list.count == 1, "Must wait for the reader inside its section");
+
+    r.leave = 1;
+    pthread_join(thread, NULL);
+    epoch_reclaim(&list);
+    ASSERT(freed == 2 && list.count == 0, "Freed once the reader has left");
+
+    /* Nested sections end with the outermost exit */
+    epoch_enter();
+    epoch_enter();
+    epoch_exit();
+    epoch_retire(&list, count_free, &freed);
+    epoch_reclaim(&list);
+    ASSERT(freed == 2, "Still inside the outer section");
+    epoch_exit();
+    epoch_reclaim(&list);
+    ASSERT(freed == 3, "Outer exit ends the section");
+
+    epoch_drain(&list);
+    PASS();
+}
+
+static void test_cache_lockfree_hit_unlocked(void) {
+    TEST(cache_lockfree_hit_unlocked);
+
+    cache_t *cache = cache_create_with_policy(1024 * 1024, 1, CACHE_POLICY_CLOCK);
+    ASSERT(cache != NULL, "Should create CLOCK cache");
+    cache_put(cache, "/a", "hello", 5);
+    cache_validator_t v = { 123456789, 5 };
+    cache_put_validated(cache, "/v", "world", 5, &v, CACHE_TTL_NONE);
+
+    /* A hit must not need the lock at all, not even to read */
+    pthread_rwlock_wrlock(&cache->shards[0].lock);
+    char *data = NULL;
+    size_t size = 0;
+    bool hit = cache_get_copy(cache, "/a", &data, &size);
+    cache_handle_t h, hv;
+    bool pinned = cache_acquire(cache, "/a", &h);
+    cache_validator_t got = { 0, 0 }, none = { 1, 1 };
+    cache_lookup_t fresh = cache_lookup_acquire(cache, "/v", &hv, &got);
+    cache_handle_t hn;
+    cache_lookup_t fresh_none = cache_lookup_acquire(cache, "/a", &hn, &none);
+    pthread_rwlock_unlock(&cache->shards[0].lock);
+
+    ASSERT(hit && size == 5 && memcmp(data, "hello", 5) == 0, "Hit while write-locked");
+    ASSERT(pinned && h.size == 5, "Pinned hit while write-locked");
+    ASSERT(fresh == CACHE_LOOKUP_FRESH && got.mtime_ns == v.mtime_ns && got.size == v.size,
+           "Validated lookup while write-locked");
+    ASSERT(fresh_none == CACHE_LOOKUP_FRESH && none.mtime_ns == 0 && none.size == 0,
+           "Unknown validator reported as zero");
+    free(data);
+    cache_release(&h);
+    cache_release(&hv);
+    cache_release(&hn);
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.hits == 4, "Lock-free hits are counted");
+
+    /* LRU hits reorder the list, so they keep the lock */
+    cache_t *lru = cache_create_sharded(1024 * 1024, 1);
+    ASSERT(!lru->shards[0].lockfree_reads, "LRU cannot read lock-free");
+    cache_destroy(lru);
+    cache_destroy(cache);
+    PASS();
+}
+
+#define CHURN_READERS   4
+#define LF_KEYS         2000
+
+typedef struct {
+    cache_t *cache;
+    volatile int *stop;
+    unsigned long hits;
+    int corrupt;
+    bool validated;                 /* Look up with the validator too */
+} lf_reader_t;
+
+/*
+lf_payload - Payload of version v of key k: the first bytes name both
+*/
+static size_t lf_payload(char *buf, int k, int v) {
+    size_t size = 64 + (size_t)(k * 37 + v * 11) % 900;
+    memset(buf, 'a' + (k + v) % 26, size);
+    snprintf(buf, 32, "%d:%d:", k, v);
+    return size;
+}
+
+static void *lf_reader(void *arg) {
+    lf_reader_t *r = arg;
+    unsigned int x = 99 + (unsigned int)(size_t)r;
+    char key[32];
+    char expect[1024];
+
+    while (!*r->stop) {
+        int k = (int)(xorshift32(&x) % LF_KEYS);
+        snprintf(key, sizeof(key), "/lf/%d", k);
+        char *data;
+        size_t size;
+        cache_validator_t v;
+        if (r->validated ? cache_lookup_copy(r->cache, key, &data, &size, &v) == CACHE_LOOKUP_MISS
+                         : !cache_get_copy(r->cache, key, &data, &size)) {
+            continue;
+        }
+        int got_k, got_v;
+        if (sscanf(data, "%d:%d:", &got_k, &got_v) != 2 || got_k != k ||
+            lf_payload(expect, k, got_v) != size || memcmp(expect, data, size) != 0 ||
+            (r->validated && (v.mtime_ns != got_v || v.size != size))) {
+            r->corrupt = 1;
+        }
+        free(data);
+        r->hits++;
+    }
+    return NULL;
+}
+
+static void test_cache_lockfree_churn(void) {
+    TEST(cache_lockfree_churn);
+
+    /* Small budget: puts keep evicting, replacing and resizing under the readers */
+    cache_t *cache = cache_create_with_policy(256 * 1024, 2, CACHE_POLICY_CLOCK);
+    volatile int stop = 0;
+    lf_reader_t readers[CHURN_READERS];
+    pthread_t threads[CHURN_READERS];
+    for (int i = 0; i < CHURN_READERS; i++) {
+        readers[i] = (lf_reader_t){ cache, &stop, 0, 0, i % 2 == 1 };
+        pthread_create(&threads[i], NULL, lf_reader, &readers[i]);
+    }
+
+    char payload[1024];
+    char key[32];
+    unsigned int x = 4242;
+    for (int v = 0; v < 60000; v++) {
+        int k = (int)(xorshift32(&x) % LF_KEYS);
+        snprintf(key, sizeof(key), "/lf/%d", k);
+        if (v % 97 == 0) {
+            cache_remove(cache, key);
+        } else {
+            size_t size = lf_payload(payload, k, v);
+            cache_validator_t cv = { v, size };
+            cache_put_validated(cache, key, payload, size, &cv, CACHE_TTL_NONE);
+        }
+        if (v % 20000 == 19999) {
+            cache_clear(cache);
+        }
+    }
+    stop = 1;
+
+    unsigned long hits = 0;
+    int corrupt = 0;
+    for (int i = 0; i < CHURN_READERS; i++) {
+        pthread_join(threads[i], NULL);
+        hits += readers[i].hits;
+        corrupt |= readers[i].corrupt;
+    }
+    cache_destroy(cache);
+
+    ASSERT(!corrupt, "Every hit must return one whole version of its own key, "
+                     "with that version's validator");
+    ASSERT(hits > 0, "Readers should have hit");
+    PASS();
+}
+
+static void test_cache_lockfree_read_scaling(void) {
+    TEST(cache_lockfree_read_scaling);
+
+    int *trace = malloc(ZIPF_TRACE_LEN * sizeof(int));
+    ASSERT(trace != NULL, "Should allocate trace");
+    zipf_trace(trace, ZIPF_TRACE_LEN, BENCH_KEYS, 0.99, 777);
+
+    /* One shard, so every thread hits the same lock word (or none) */
+    cache_t *cache = cache_create_with_policy(64 * 1024 * 1024, 1, CACHE_POLICY_CLOCK);
+    char key[32];
+    char data[64] = "benchmark payload";
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        snprintf(key, sizeof(key), "/bench/%d", i);
+        cache_put(cache, key, data, sizeof(data));
+    }
+
+    printf("\n    threads   read lock (Mops/s)   lock-free (Mops/s)\n");
+    for (int t = 1; t <= BENCH_MAX_THREADS; t *= 2) {
+        unsigned long gets_locked, gets_free;
+        cache_set_lockfree_reads(cache, false);
+        double locked = bench_run(cache, t, trace, &gets_locked);
+        cache_set_lockfree_reads(cache, true);
+        cache_reset_stats(cache);
+        double lockfree = bench_run(cache, t, trace, &gets_free);
+        printf("    %7d   %18.2f   %18.2f\n", t, locked / 1e6, lockfree / 1e6);
+
+        cache_stats_t stats;
+        cache_get_stats(cache, &stats);
+        if (stats.hits != gets_free || stats.misses != 0) {
+            cache_destroy(cache);
+            free(trace);
+            FAIL("Every lock-free get should hit");
+            return;
+        }
+    }
+    printf("  ");
+
+    cache_destroy(cache);
+    free(trace);
+    PASS();
+}
+
+/* ============================================================================
+Statistics Counter Tests
+============================================================================ */
+
+#define COUNTER_THREADS     8
+#define COUNTER_ADDS        100000  /* per thread */
+
+typedef struct {
+    stat_counters_t *counters;
+    int index;
+} counter_arg_t;
+
+static void *counter_worker(void *arg) {
+    counter_arg_t *c = arg;
+    for (int i = 0; i < COUNTER_ADDS; i++) {
+        stat_counters_inc(c->counters, 0);
+        stat_counters_add(c->counters, 1, 3);
+        /* Gauge: even threads raise it, odd threads take it back down */
+        if (c->index % 2 == 0) {
+            stat_counters_inc(c->counters, 2);
+        } else {
+            stat_counters_dec(c->counters, 2);
+        }
+    }
+    return NULL;
+}
+
+static void test_stat_counters_merge(void) {
+    TEST(stat_counters_merge);
+
+    stat_counters_t counters;
+    ASSERT(stat_counters_init(&counters, 3), "Should create counters");
+    ASSERT(counters.stride % (STAT_COUNTERS_LINE / sizeof(uint64_t)) == 0,
+           "Slots should be whole cache lines");
+    ASSERT((uintptr_t)counters.slots % STAT_COUNTERS_LINE == 0, "Slots should be line aligned");
+    ASSERT((counters.nslots & (counters.nslots - 1)) == 0 &&
+           counters.nslots >= STAT_COUNTERS_MIN_SLOTS, "Slot count should be a power of two");
+
+    pthread_t threads[COUNTER_THREADS];
+    counter_arg_t args[COUNTER_THREADS];
+    for (int i = 0; i < COUNTER_THREADS; i++) {
+        args[i] = (counter_arg_t){ &counters, i };
+        pthread_create(&threads[i], NULL, counter_worker, &args[i]);
+    }
+    for (int i = 0; i < COUNTER_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    uint64_t total = (uint64_t)COUNTER_THREADS * COUNTER_ADDS;
+    ASSERT(stat_counters_sum(&counters, 0) == total, "No increment should be lost");
+    ASSERT(stat_counters_sum(&counters, 1) == 3 * total, "No add should be lost");
+    ASSERT(stat_counters_sum(&counters, 2) == 0, "Gauge should net out across slots");
+
+    stat_counters_reset(&counters);
+    ASSERT(stat_counters_sum(&counters, 0) == 0 && stat_counters_sum(&counters, 1) == 0,
+           "Reset should clear every slot");
+
+    stat_counters_destroy(&counters);
+    stat_counters_destroy(&counters);
+    PASS();
+}
+
+static void test_cache_stats_concurrent(void) {
+    TEST(cache_stats_concurrent);
+
+    /* LRU hits count under the write lock, CLOCK hits under none */
+    cache_policy_t policies[] = { CACHE_POLICY_LRU, CACHE_POLICY_CLOCK };
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        cache_t *cache = cache_create_with_policy(16 * 1024 * 1024, 4, policies[p]);
+        ASSERT(cache != NULL, "Should create cache");
+        char key[32];
+        char data[64] = "benchmark payload";
+        for (int i = 0; i < BENCH_KEYS; i++) {
+            snprintf(key, sizeof(key), "/bench/%d", i);
+            cache_put(cache, key, data, sizeof(data));
+        }
+        cache_reset_stats(cache);
+
+        unsigned long gets;
+        bench_run(cache, COUNTER_THREADS, NULL, &gets);
+
+        cache_stats_t stats;
+        cache_get_stats(cache, &stats);
+        bool exact = stats.hits == gets && stats.misses == 0 &&
+                     stats.hit_bytes == (uint64_t)gets * sizeof(data);
+        cache_destroy(cache);
+        ASSERT(exact, "Every hit from every thread should be counted once");
+    }
+    PASS();
+}
+
+static uint64_t shared_counter __attribute__((aligned(64)));
+static pthread_mutex_t shared_counter_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+    int mode;                       /* 0 = mutex, 1 = shared atomic, 2 = per thread */
+    stat_counters_t *counters;
+} counter_bench_t;
+
+static void *counter_bench_worker(void *arg) {
+    counter_bench_t *b = arg;
+    for (int i = 0; i < COUNTER_ADDS; i++) {
+        if (b->mode == 0) {
+            pthread_mutex_lock(&shared_counter_lock);
+            shared_counter++;
+            pthread_mutex_unlock(&shared_counter_lock);
+        } else if (b->mode == 1) {
+            __atomic_fetch_add(&shared_counter, 1, __ATOMIC_RELAXED);
+        } else {
+            stat_counters_inc(b->counters, 0);
+        }
+    }
+    return NULL;
+}
+
+/*
+counter_bench_run - Increments per second with num_threads threads
+*/
+static double counter_bench_run(int mode, stat_counters_t *counters, int num_threads) {
+    pthread_t threads[BENCH_MAX_THREADS];
+    counter_bench_t arg = { mode, counters };
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < num_threads; i++) {
+        pthread_create(&threads[i], NULL, counter_bench_worker, &arg);
+    }
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return (double)num_threads * COUNTER_ADDS / secs;
+}
+
+static void test_stat_counters_scaling(void) {
+    TEST(stat_counters_scaling);
+
+    stat_counters_t counters;
+    ASSERT(stat_counters_init(&counters, 1), "Should create counters");
+
+    printf("\n    threads   mutex (Mops/s)   atomic (Mops/s)   per-thread (Mops/s)\n");
+    for (int t = 1; t <= BENCH_MAX_THREADS; t *= 4) {
+        shared_counter = 0;
+        double locked = counter_bench_run(0, NULL, t);
+        double atomic = counter_bench_run(1, NULL, t);
+        stat_counters_reset(&counters);
+        double local = counter_bench_run(2, &counters, t);
+        printf("    %7d   %14.2f   %15.2f   %19.2f\n", t, locked / 1e6, atomic / 1e6, local / 1e6);
+
+        uint64_t expected = (uint64_t)t * COUNTER_ADDS;
+        if (shared_counter != 2 * expected || stat_counters_sum(&counters, 0) != expected) {
+            stat_counters_destroy(&counters);
+            FAIL("Every increment should be counted");
+            return;
+        }
+    }
+    printf("  ");
+
+    stat_counters_destroy(&counters);
+    PASS();
+}
+
+/* ============================================================================
+W-TinyLFU Tests
+============================================================================ */
+
+static void test_freq_sketch_basic(void) {
+    TEST(freq_sketch_basic);
+
+    freq_sketch_t *sketch = freq_sketch_create(1000);
+    ASSERT(sketch != NULL, "Should create sketch");
+    ASSERT(sketch->width == 1024, "Width should round up to a power of two");
+
+    for (int i = 0; i < 5; i++) {
+        freq_sketch_increment(sketch, 42);
+    }
+    for (int i = 0; i < 20; i++) {
+        freq_sketch_increment(sketch, 7);
+    }
+    ASSERT(freq_sketch_estimate(sketch, 42) >= 5, "Estimate never undercounts");
+    ASSERT(freq_sketch_estimate(sketch, 7) == FREQ_SKETCH_MAX, "Counters saturate");
+    ASSERT(freq_sketch_estimate(sketch, 12345) <= 1, "Unseen key should be ~0");
+
+    /* Enough distinct keys to reach the sample size halves everything */
+    for (uint64_t k = 1000; sketch->resets == 0; k++) {
+        freq_sketch_increment(sketch, k);
+    }
+    ASSERT(freq_sketch_estimate(sketch, 7) <= FREQ_SKETCH_MAX / 2 + 1, "Aging should halve counts");
+
+    freq_sketch_destroy(sketch);
+    PASS();
+}
+
+/*
+hot_set_survivors - Warm a hot set, run a one-off scan, count hot keys left
+*/
+static int hot_set_survivors(cache_policy_t policy, unsigned long *rejects) {
+    char key[32];
+    char data[100] = {0};
+    cache_t *cache = cache_create_with_policy(100 * cache_entry_charge("/scan/100", sizeof(data)), 1, policy);
+
+    /* 50 hot keys, read-through, several rounds */
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i < 50; i++) {
+            snprintf(key, sizeof(key), "/hot/%d", i);
+            if (!cache_get(cache, key, NULL, NULL)) {
+                cache_put(cache, key, data, sizeof(data));
+            }
+        }
+    }
+
+    /* One client walks 1000 files once */
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "/scan/%d", i);
+        if (!cache_get(cache, key, NULL, NULL)) {
+            cache_put(cache, key, data, sizeof(data));
+        }
+    }
+
+    int survivors = 0;
+    for (int i = 0; i < 50; i++) {
+        snprintf(key, sizeof(key), "/hot/%d", i);
+        survivors += cache_contains(cache, key);
+    }
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    *rejects = stats.admission_rejects;
+    cache_destroy(cache);
+    return survivors;
+}
+
+static void test_cache_tinylfu_scan_resistance(void) {
+    TEST(cache_tinylfu_scan_resistance);
+
+    unsigned long lru_rejects, tlfu_rejects;
+    int lru = hot_set_survivors(CACHE_POLICY_LRU, &lru_rejects);
+    int tlfu = hot_set_survivors(CACHE_POLICY_TINYLFU, &tlfu_rejects);
+
+    ASSERT(lru == 0, "A scan flushes the whole hot set under LRU");
+    ASSERT(tlfu == 50, "W-TinyLFU should keep the hot set");
+    ASSERT(lru_rejects == 0, "LRU never rejects");
+    ASSERT(tlfu_rejects >= 900, "Scan keys beyond free space should be rejected");
+
+    PASS();
+}
+
+static void test_cache_tinylfu_basic(void) {
+    TEST(cache_tinylfu_basic);
+
+    cache_t *cache = cache_create_with_policy(1024 * 1024, 0, CACHE_POLICY_TINYLFU);
+    ASSERT(cache != NULL, "Should create W-TinyLFU cache");
+
+    ASSERT(cache_put(cache, "/a", "alpha", 5), "Put should succeed");
+    ASSERT(cache_put(cache, "/a", "alphabet", 8), "Update should succeed");
+
+    char *data;
+    size_t size;
+    ASSERT(cache_get(cache, "/a", &data, &size) && size == 8, "Should see the update");
+    ASSERT(cache_remove(cache, "/a"), "Remove should succeed");
+    ASSERT(!cache_get(cache, "/a", NULL, NULL), "Removed entry should miss");
+
+    cache_put(cache, "/b", "beta", 4);
+    cache_clear(cache);
+    ASSERT(!cache_contains(cache, "/b"), "Clear should empty the cache");
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.policy == CACHE_POLICY_TINYLFU, "Stats should report the policy");
+    ASSERT(stats.current_size == 0 && stats.num_entries == 0, "Sizes should be reset");
+
+    cache_policy_t parsed;
+    ASSERT(cache_policy_parse("tinylfu", &parsed) && parsed == CACHE_POLICY_TINYLFU,
+           "Policy name should parse");
+
+    cache_destroy(cache);
+    PASS();
+}
+
+/*
+scan_mixed_trace - Zipf traffic with a 2000-file scan after every 20000 requests
+
+Returns a malloc'd trace and its length in *len.
+*/
+static int *scan_mixed_trace(int *len) {
+    *len = ZIPF_TRACE_LEN + (ZIPF_TRACE_LEN / 20000) * 2000;
+    int *trace = malloc(*len * sizeof(int));
+    if (trace == NULL) {
+        return NULL;
+    }
+    zipf_trace(trace, ZIPF_TRACE_LEN, BENCH_KEYS, 0.99, 777);
+
+    memmove(trace + *len - ZIPF_TRACE_LEN, trace, ZIPF_TRACE_LEN * sizeof(int));
+    int out = 0, in = *len - ZIPF_TRACE_LEN, next_scan_key = BENCH_KEYS;
+    for (int i = 0; i < ZIPF_TRACE_LEN; i++) {
+        trace[out++] = trace[in++];
+        if ((i + 1) % 20000 == 0) {
+            for (int j = 0; j < 2000; j++) {
+                trace[out++] = next_scan_key++;
+            }
+        }
+    }
+    return trace;
+}
+
+static void test_cache_tinylfu_zipf_with_scans(void) {
+    TEST(cache_tinylfu_zipf_with_scans);
+
+    int len;
+    int *trace = scan_mixed_trace(&len);
+    ASSERT(trace != NULL, "Should allocate trace");
+
+    printf("\n    Zipf(0.99) + scans, hit ratio:\n");
+    printf("    entries      LRU    CLOCK   W-TinyLFU\n");
+    int sizes[] = { 64, 256, 1024 };
+    bool better = true;
+    for (int i = 0; i < 3; i++) {
+        double lru = replay_hit_ratio(CACHE_POLICY_LRU, trace, len, sizes[i]);
+        double clk = replay_hit_ratio(CACHE_POLICY_CLOCK, trace, len, sizes[i]);
+        double tlfu = replay_hit_ratio(CACHE_POLICY_TINYLFU, trace, len, sizes[i]);
+        printf("    %7d   %5.1f%%   %5.1f%%   %8.1f%%\n",
+               sizes[i], lru * 100, clk * 100, tlfu * 100);
+        better = better && tlfu > lru;
+    }
+    printf("  ");
+    free(trace);
+
+    ASSERT(better, "W-TinyLFU should beat LRU when scans are mixed in");
+    PASS();
+}
+
+/* ============================================================================
+Policy Interface Tests
+============================================================================ */
+
+/*
+check_shard - Segment lists agree with the shard's size and entry count
+*/
+static bool check_shard(cache_shard_t *shard) {
+    size_t bytes = 0, listed = 0;
+    int entries = 0;
+    for (int i = 0; i < CACHE_SEGMENTS; i++) {
+        size_t list_bytes = 0;
+        for (cache_entry_t *e = shard->segments[i].head; e != NULL;
+             e = cache_entry_at(shard, e->lru_next)) {
+            if (e->segment != i) {
+                return false;
+            }
+            list_bytes += e->size;
+            entries++;
+        }
+        if (list_bytes != shard->segments[i].bytes) {
+            return false;
+        }
+        listed += list_bytes;
+    }
+    bytes = shard->current_size;
+    return listed == bytes && entries == shard->num_entries && bytes <= shard->max_size;
+}
+
+static void test_cache_policy_invariants(void) {
+    TEST(cache_policy_invariants);
+
+    char key[32];
+    char data[256] = {0};
+
+    for (int p = 0; p < CACHE_POLICY_COUNT; p++) {
+        cache_t *cache = cache_create_with_policy(4000, 1, (cache_policy_t)p);
+        ASSERT(cache != NULL, "Should create every policy");
+
+        unsigned int x = 99 + p;
+        for (int i = 0; i < 20000; i++) {
+            xorshift32(&x);
+            snprintf(key, sizeof(key), "/k/%u", (x >> 8) % 300);
+            switch (x % 8) {
+            case 0:
+                cache_remove(cache, key);
+                break;
+            case 1:
+            case 2:
+            case 3:
+                cache_put(cache, key, data, 1 + (x >> 20) % sizeof(data));
+                break;
+            default:
+                if (!cache_get(cache, key, NULL, NULL)) {
+                    cache_put(cache, key, data, 1 + (x >> 20) % sizeof(data));
+                }
+                break;
+            }
+            if (i % 97 == 0 && !check_shard(&cache->shards[0])) {
+                printf("(%s) ", cache_policy_name(p));
+                cache_destroy(cache);
+                FAIL("Lists, sizes and counts should agree");
+                return;
+            }
+            if (i == 10000) {
+                cache_clear(cache);
+            }
+        }
+
+        while (cache_evict_lru(&cache->shards[0])) {
+        }
+        ASSERT(cache->shards[0].num_entries == 0, "Evicting repeatedly should empty the shard");
+
+        cache_destroy(cache);
+    }
+    PASS();
+}
+
+static void test_cache_policy_ghost_hits(void) {
+    TEST(cache_policy_ghost_hits);
+
+    /* ARC, 2Q and S3-FIFO all put a recently evicted key in list 1 */
+    cache_policy_t ghosted[] = { CACHE_POLICY_ARC, CACHE_POLICY_2Q, CACHE_POLICY_S3FIFO };
+    char data[100] = {0};
+
+    for (int i = 0; i < 3; i++) {
+        cache_t *cache = cache_create_with_policy(3 * cache_entry_charge("/a", sizeof(data)), 1,
+                                                  ghosted[i]);
+        cache_put(cache, "/a", data, sizeof(data));
+        cache_put(cache, "/b", data, sizeof(data));
+        cache_put(cache, "/c", data, sizeof(data));
+        cache_put(cache, "/d", data, sizeof(data));
+        ASSERT(!cache_contains(cache, "/a"), "Oldest key should be evicted");
+
+        cache_put(cache, "/a", data, sizeof(data));
+        cache_entry_t *head = cache->shards[0].segments[1].head;
+        ASSERT(head != NULL && strcmp(head->key, "/a") == 0,
+               "A key remembered by a ghost list should skip the first list");
+
+        cache_put(cache, "/e", data, sizeof(data));
+        ASSERT(cache_contains(cache, "/a"), "Returning key should outlive new keys");
+        cache_destroy(cache);
+    }
+    PASS();
+}
+
+static void test_cache_policy_scan_resistance(void) {
+    TEST(cache_policy_scan_resistance);
+
+    printf("\n    Hot keys (of 50) left after a 1000-file scan:\n    ");
+    int survivors[CACHE_POLICY_COUNT];
+    for (int p = 0; p < CACHE_POLICY_COUNT; p++) {
+        unsigned long rejects;
+        survivors[p] = hot_set_survivors((cache_policy_t)p, &rejects);
+        printf("%s %d  ", cache_policy_name(p), survivors[p]);
+    }
+    printf("\n  ");
+
+    ASSERT(survivors[CACHE_POLICY_ARC] == 50, "ARC keeps keys hit twice in T2");
+    ASSERT(survivors[CACHE_POLICY_S3FIFO] == 50, "S3-FIFO moves hit keys to main");
+    PASS();
+}
+
+/*
+shifting_trace - Recency-heavy trace: a 300-key working set that drifts
+*/
+static void shifting_trace(int *trace, int len) {
+    unsigned int x = 4242;
+    for (int i = 0; i < len; i++) {
+        trace[i] = i / 200 + xorshift32(&x) % 300;
+    }
+}
+
+static void test_cache_policy_comparison(void) {
+    TEST(cache_policy_comparison);
+
+    int scan_len;
+    int *zipf = malloc(ZIPF_TRACE_LEN * sizeof(int));
+    int *shift = malloc(ZIPF_TRACE_LEN * sizeof(int));
+    int *scan = scan_mixed_trace(&scan_len);
+    ASSERT(zipf != NULL && shift != NULL && scan != NULL, "Should allocate traces");
+    zipf_trace(zipf, ZIPF_TRACE_LEN, BENCH_KEYS, 0.99, 12345);
+    shifting_trace(shift, ZIPF_TRACE_LEN);
+
+    struct {
+        const char *name;
+        const int *trace;
+        int len;
+    } traces[] = {
+        { "zipf", zipf, ZIPF_TRACE_LEN },
+        { "zipf+scan", scan, scan_len },
+        { "shifting", shift, ZIPF_TRACE_LEN },
+    };
+    double ratio[3][CACHE_POLICY_COUNT];
+
+    printf("\n    Hit ratio at 256 entries:\n    %-10s", "trace");
+    for (int p = 0; p < CACHE_POLICY_COUNT; p++) {
+        printf("%9s", cache_policy_name(p));
+    }
+    printf("\n");
+    for (int t = 0; t < 3; t++) {
+        printf("    %-10s", traces[t].name);
+        for (int p = 0; p < CACHE_POLICY_COUNT; p++) {
+            ratio[t][p] = replay_hit_ratio((cache_policy_t)p, traces[t].trace, traces[t].len, 256);
+            printf("%8.1f%%", ratio[t][p] * 100);
+        }
+        printf("\n");
+    }
+    printf("  ");
+
+    free(zipf);
+    free(shift);
+    free(scan);
+
+    /* Every scan-resistant policy should beat LRU once scans are mixed in */
+    ASSERT(ratio[1][CACHE_POLICY_ARC] > ratio[1][CACHE_POLICY_LRU], "ARC should beat LRU");
+    ASSERT(ratio[1][CACHE_POLICY_2Q] > ratio[1][CACHE_POLICY_LRU], "2Q should beat LRU");
+    ASSERT(ratio[1][CACHE_POLICY_S3FIFO] > ratio[1][CACHE_POLICY_LRU], "S3-FIFO should beat LRU");
+    PASS();
+}
+
+/* ============================================================================
+GDSF Tests
+============================================================================ */
+
+static void test_cache_gdsf_prefers_small(void) {
+    TEST(cache_gdsf_prefers_small);
+
+    /* Ten small files read now and then, and a stream of large ones read once */
+    static char data[20 * 1024];
+    char key[32];
+    int kept[2];
+    cache_policy_t policies[] = { CACHE_POLICY_LRU, CACHE_POLICY_GDSF };
+
+    for (int p = 0; p < 2; p++) {
+        cache_t *cache = cache_create_with_policy(64 * 1024, 1, policies[p]);
+        for (int round = 0; round < 20; round++) {
+            for (int i = 0; i < 10; i++) {
+                snprintf(key, sizeof(key), "/small/%d", i);
+                if (!cache_get(cache, key, NULL, NULL)) {
+                    cache_put(cache, key, data, 1024);
+                }
+            }
+            for (int j = 0; j < 3; j++) {
+                snprintf(key, sizeof(key), "/large/%d.%d", round, j);
+                cache_put(cache, key, data, sizeof(data));
+            }
+        }
+        kept[p] = 0;
+        for (int i = 0; i < 10; i++) {
+            snprintf(key, sizeof(key), "/small/%d", i);
+            kept[p] += cache_contains(cache, key);
+        }
+        cache_destroy(cache);
+    }
+
+    ASSERT(kept[1] == 10, "GDSF keeps every small file");
+    ASSERT(kept[0] < 10, "LRU lets the large files push small ones out");
+    PASS();
+}
+
+static void test_cache_gdsf_cost(void) {
+    TEST(cache_gdsf_cost);
+
+    /* Same size, one hit each: the slow-to-fetch half stays */
+    char data[1000] = {0};
+    char key[32];
+    cache_t *cache = cache_create_with_policy(20 * cache_entry_charge("/slow/00", sizeof(data)),
+                                              1, CACHE_POLICY_GDSF);
+    for (int i = 0; i < 40; i++) {
+        snprintf(key, sizeof(key), i % 2 ? "/slow/%02d" : "/fast/%02d", i);
+        cache_put_cost(cache, key, data, sizeof(data), NULL, CACHE_TTL_NONE,
+                       i % 2 ? 50000 : 200);
+    }
+
+    int slow = 0;
+    for (int i = 1; i < 40; i += 2) {
+        snprintf(key, sizeof(key), "/slow/%02d", i);
+        slow += cache_contains(cache, key);
+    }
+    ASSERT(slow == 20, "Every expensive file survives");
+
+    /* Hits keep a cheap file in, too */
+    for (int round = 0; round < 5; round++) {
+        cache_get(cache, "/slow/39", NULL, NULL);
+        cache_put_cost(cache, "/fast/hot", data, sizeof(data), NULL, CACHE_TTL_NONE, 200);
+        for (int i = 0; i < 10; i++) {
+            cache_get(cache, "/fast/hot", NULL, NULL);
+        }
+    }
+    ASSERT(cache_contains(cache, "/fast/hot"), "A file hit often outweighs its low cost");
+
+    cache_destroy(cache);
+    PASS();
+}
+
+static void test_cache_byte_hit_ratio(void) {
+    TEST(cache_byte_hit_ratio);
+
+    char data[3000] = {0};
+    cache_t *cache = cache_create(1024 * 1024);
+    cache_put(cache, "/big", data, 3000);
+    cache_put(cache, "/small", data, 100);
+    cache_get(cache, "/big", NULL, NULL);
+    cache_get(cache, "/big", NULL, NULL);
+    for (int i = 0; i < 4; i++) {
+        cache_get(cache, "/small", NULL, NULL);
+    }
+    cache_get(cache, "/missing", NULL, NULL);
+    cache_count_miss_bytes(cache, 500);
+    /* A prefetch: put, but nobody waited for it */
+    cache_put(cache, "/prefetched", data, 2000);
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.hit_bytes == 6400 && stats.put_bytes == 5100 && stats.miss_bytes == 500,
+           "Bytes hit, put and fetched for misses");
+    ASSERT(fabs(stats.byte_hit_rate - 6400.0 / 6900.0) < 1e-9,
+           "Byte hit rate weighs hits against reported misses only");
+    ASSERT(fabs(stats.hit_rate - 6.0 / 7.0) < 1e-9, "Object hit rate counts files");
+
+    cache_reset_stats(cache);
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.hit_bytes == 0 && stats.put_bytes == 0 && stats.miss_bytes == 0,
+           "Reset clears byte counters");
+    cache_destroy(cache);
+    PASS();
+}
+
+static void test_cache_put_sized(void) {
+    TEST(cache_put_sized);
+
+    /* The same puts, with and without payloads, end in the same state */
+    static char data[8192];
+    cache_t *real = cache_create_with_policy(64 * 1024, 1, CACHE_POLICY_LRU);
+    cache_t *sized = cache_create_with_policy(64 * 1024, 1, CACHE_POLICY_LRU);
+    char key[32];
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "/file%d", i % 40);
+        size_t size = 100 + (size_t)(i * 997) % 8000;
+        ASSERT(cache_put(real, key, data, size), "Real put");
+        ASSERT(cache_put_sized(sized, key, size), "Sized put");
+    }
+    cache_stats_t rs, ss;
+    cache_get_stats(real, &rs);
+    cache_get_stats(sized, &ss);
+    ASSERT(rs.current_size == ss.current_size && rs.num_entries == ss.num_entries &&
+           rs.evictions == ss.evictions && rs.put_bytes == ss.put_bytes,
+           "Sized puts are charged and evicted like real ones");
+
+    cache_handle_t handle;
+    snprintf(key, sizeof(key), "/file%d", 99 % 40);
+    ASSERT(cache_acquire(sized, key, &handle), "Sized entry is found");
+    ASSERT(handle.size == 100 + (size_t)(99 * 997) % 8000, "Lookup reports the size");
+    cache_release(&handle);
+    ASSERT(!cache_put_sized(sized, "/huge", 1024 * 1024), "Oversized entry is refused");
+
+    cache_destroy(real);
+    cache_destroy(sized);
+    PASS();
+}
+
+/*
+sized_file - Size and fetch cost of a trace key: mostly small files, a
+few large ones; cost is a round trip plus transfer time
+*/
+static size_t sized_file(int key, uint32_t *cost_us) {
+    unsigned int x = (unsigned int)key * 2654435761u + 1;
+    xorshift32(&x);
+    size_t size = 200 + ((size_t)1 << (xorshift32(&x) % 15));   /* 200 B .. 16 KB */
+    *cost_us = 500 + (uint32_t)(size / 100);
+    return size;
+}
+
+static void test_cache_gdsf_comparison(void) {
+    TEST(cache_gdsf_comparison);
+
+    int *trace = malloc(ZIPF_TRACE_LEN * sizeof(int));
+    static char data[17 * 1024];
+    ASSERT(trace != NULL, "Should allocate trace");
+    zipf_trace(trace, ZIPF_TRACE_LEN, BENCH_KEYS, 0.8, 777);
+
+    cache_policy_t policies[] = { CACHE_POLICY_LRU, CACHE_POLICY_CLOCK, CACHE_POLICY_GDSF };
+    double hit[3], byte_hit[3], us[3];
+    char key[32];
+    printf("\n    Zipf(0.8), 200 B - 16 KB files, 1 MB cache:\n"
+           "    policy   object hits   byte hits   ns/op\n");
+    for (int p = 0; p < 3; p++) {
+        cache_t *cache = cache_create_with_policy(1024 * 1024, 1, policies[p]);
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < ZIPF_TRACE_LEN; i++) {
+            snprintf(key, sizeof(key), "/sized/%d", trace[i]);
+            if (!cache_get(cache, key, NULL, NULL)) {
+                uint32_t cost;
+                size_t size = sized_file(trace[i], &cost);
+                cache_count_miss_bytes(cache, size);
+                cache_put_cost(cache, key, data, size, NULL, CACHE_TTL_NONE, cost);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        us[p] = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) /
+                ZIPF_TRACE_LEN;
+        cache_stats_t stats;
+        cache_get_stats(cache, &stats);
+        hit[p] = stats.hit_rate;
+        byte_hit[p] = stats.byte_hit_rate;
+        printf("    %-8s %10.1f%% %10.1f%% %7.0f\n", cache_policy_name(policies[p]),
+               hit[p] * 100, byte_hit[p] * 100, us[p]);
+        cache_destroy(cache);
+    }
+    printf("  ");
+    free(trace);
+
+    ASSERT(hit[2] > hit[0] + 0.05, "GDSF should beat LRU on object hits");
+    PASS();
+}
+
+/* ============================================================================
+Pinned Read Tests
+============================================================================ */
+
+static void test_cache_acquire_basic(void) {
+    TEST(cache_acquire_basic);
+
+    cache_t *cache = cache_create(1024 * 1024);
+    cache_put(cache, "/a", "version one", 11);
+
+    cache_handle_t h1;
+    ASSERT(cache_acquire(cache, "/a", &h1), "Acquire should hit");
+    ASSERT(h1.size == 11 && memcmp(h1.data, "version one", 11) == 0, "Data should match");
+
+    /* Replacing the entry does not touch the pinned buffer */
+    cache_put(cache, "/a", "version two!", 12);
+    cache_handle_t h2;
+    ASSERT(cache_acquire(cache, "/a", &h2), "Acquire should hit again");
+    ASSERT(h2.size == 12 && memcmp(h2.data, "version two!", 12) == 0, "Should see new data");
+    ASSERT(memcmp(h1.data, "version one", 11) == 0, "Old handle keeps old data");
+
+    /* Removal, clear and even destroy wait for the last release */
+    cache_remove(cache, "/a");
+    cache_clear(cache);
+    cache_destroy(cache);
+    ASSERT(memcmp(h2.data, "version two!", 12) == 0, "Pinned data outlives the cache");
+
+    cache_release(&h1);
+    cache_release(&h2);
+    ASSERT(h1.data == NULL && h2.buf == NULL, "Release should clear the handle");
+
+    cache = cache_create_with_policy(1024 * 1024, 0, CACHE_POLICY_CLOCK);
+    cache_handle_t h3;
+    ASSERT(!cache_acquire(cache, "/missing", &h3), "Miss should return false");
+    cache_put_validated(cache, "/v", "data", 4, NULL, CACHE_TTL_NONE);
+    ASSERT(cache_lookup_acquire(cache, "/v", &h3, NULL) == CACHE_LOOKUP_FRESH,
+           "Freshness-aware acquire should hit (read-locked path)");
+    ASSERT(h3.size == 4 && memcmp(h3.data, "data", 4) == 0, "Data should match");
+    cache_release(&h3);
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.hits == 1 && stats.misses == 1, "Acquire counts hits and misses");
+    cache_destroy(cache);
+    PASS();
+}
+
+#define PIN_PAYLOAD     4096
+
+typedef struct {
+    cache_t *cache;
+    volatile int *stop;
+    unsigned long hits;
+    int corrupt;
+} pin_reader_t;
+
+/*
+pin_reader - Pin, check every byte is the same version, release
+*/
+static void *pin_reader(void *arg) {
+    pin_reader_t *r = arg;
+    while (!*r->stop) {
+        cache_handle_t h;
+        if (!cache_acquire(r->cache, "/hot", &h)) {
+            continue;
+        }
+        for (size_t i = 1; i < h.size; i++) {
+            if (h.data[i] != h.data[0]) {
+                r->corrupt = 1;
+            }
+        }
+        cache_release(&h);
+        r->hits++;
+    }
+    return NULL;
+}
+
+static void test_cache_acquire_concurrent(void) {
+    TEST(cache_acquire_concurrent);
+
+    /* Small cache: the filler puts keep evicting /hot under the readers */
+    cache_t *cache = cache_create_with_policy(4 * PIN_PAYLOAD, 1, CACHE_POLICY_CLOCK);
+    volatile int stop = 0;
+    pin_reader_t readers[4];
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        readers[i] = (pin_reader_t){ cache, &stop, 0, 0 };
+        pthread_create(&threads[i], NULL, pin_reader, &readers[i]);
+    }
+
+    char payload[PIN_PAYLOAD];
+    char key[32];
+    for (int v = 0; v < 20000; v++) {
+        memset(payload, 'a' + v % 26, sizeof(payload));
+        cache_put(cache, "/hot", payload, sizeof(payload));
+        snprintf(key, sizeof(key), "/fill/%d", v % 8);
+        cache_put(cache, key, payload, sizeof(payload));
+    }
+    stop = 1;
+
+    int corrupt = 0;
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+        corrupt |= readers[i].corrupt;
+    }
+    cache_destroy(cache);
+
+    ASSERT(!corrupt, "Pinned buffers must never change under a reader");
+    PASS();
+}
+
+static void test_cache_acquire_vs_copy(void) {
+    TEST(cache_acquire_vs_copy);
+
+    size_t size = 1024 * 1024;
+    char *file = calloc(1, size);
+    cache_t *cache = cache_create_sharded(16 * 1024 * 1024, 1);
+    cache_put(cache, "/large.bin", file, size);
+    free(file);
+
+    int rounds = 2000;
+    volatile char sink = 0;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < rounds; i++) {
+        char *data;
+        size_t len;
+        cache_get_copy(cache, "/large.bin", &data, &len);
+        sink ^= data[len - 1];
+        free(data);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double copy_us = ((end.tv_sec - start.tv_sec) * 1e6 +
+                      (end.tv_nsec - start.tv_nsec) / 1e3) / rounds;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < rounds; i++) {
+        cache_handle_t h;
+        cache_acquire(cache, "/large.bin", &h);
+        sink ^= h.data[h.size - 1];
+        cache_release(&h);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double pin_us = ((end.tv_sec - start.tv_sec) * 1e6 +
+                     (end.tv_nsec - start.tv_nsec) / 1e3) / rounds;
+    (void)sink;
+
+    printf("\n    1 MB hit: get_copy %.1f us, acquire/release %.2f us\n  ", copy_us, pin_us);
+    cache_destroy(cache);
+
+    ASSERT(pin_us < copy_us, "Pinning should be cheaper than copying 1 MB");
+    PASS();
+}
+
+/* ============================================================================
+Batched Operation Tests
+============================================================================ */
+
+static void test_cache_get_many_basic(void) {
+    TEST(cache_get_many_basic);
+
+    cache_policy_t policies[] = { CACHE_POLICY_LRU, CACHE_POLICY_CLOCK };
+    for (int p = 0; p < 2; p++) {
+        cache_t *cache = cache_create_with_policy(4 * 1024 * 1024, 4, policies[p]);
+        cache_set_compression(cache, true);
+        char key[32], payload[1024];
+        for (int i = 0; i < 100; i++) {
+            snprintf(key, sizeof(key), "/k/%d", i);
+            memset(payload, 'a' + i % 26, sizeof(payload));
+            cache_put(cache, key, payload, i % 2 ? sizeof(payload) : 16);
+        }
+
+        /* Hits, misses, a repeated key and a NULL key, across every shard */
+        char names[70][32];
+        const char *keys[70];
+        for (int i = 0; i < 70; i++) {
+            snprintf(names[i], sizeof(names[i]), "/k/%d", i % 7 == 6 ? 1000 + i : i * 3 % 100);
+            keys[i] = names[i];
+        }
+        keys[5] = keys[4];
+        keys[9] = NULL;
+
+        cache_handle_t handles[70];
+        size_t hits = cache_get_many(cache, keys, 70, handles);
+        size_t expected = 0;
+        for (int i = 0; i < 70; i++) {
+            cache_handle_t single;
+            bool hit = keys[i] != NULL && cache_acquire(cache, keys[i], &single);
+            ASSERT(hit == (handles[i].buf != NULL), "Batch and single gets should agree");
+            if (hit) {
+                ASSERT(handles[i].size == single.size && !handles[i].compressed &&
+                       memcmp(handles[i].data, single.data, single.size) == 0,
+                       "Batch hit should see the same (decoded) data");
+                cache_release(&single);
+                expected++;
+            }
+            cache_release(&handles[i]);
+        }
+        ASSERT(hits == expected && hits == 59, "Hit count should match");
+
+        cache_stats_t stats;
+        cache_get_stats(cache, &stats);
+        ASSERT(stats.hits == 2 * 59 && stats.misses == 2 * 10,
+               "Batch gets count hits and misses like single gets");
+        cache_destroy(cache);
+    }
+    PASS();
+}
+
+static void test_cache_put_many_basic(void) {
+    TEST(cache_put_many_basic);
+
+    cache_t *cache = cache_create_sharded(1024 * 1024, 8);
+    char names[200][32];
+    char long_key[MAX_KEY_LEN + 8];
+    memset(long_key, 'x', sizeof(long_key) - 1);
+    long_key[sizeof(long_key) - 1] = '\0';
+    const char *keys[200], *data[200];
+    size_t sizes[200];
+    for (int i = 0; i < 200; i++) {
+        snprintf(names[i], sizeof(names[i]), "/p/%d", i % 150);
+        keys[i] = names[i];
+        data[i] = i < 150 ? "old" : "new";
+        sizes[i] = 3;
+    }
+    keys[7] = long_key;
+    keys[157] = NULL;
+
+    ASSERT(cache_put_many(cache, keys, data, sizes, 200) == 198, "Skipped keys not stored");
+    char *value;
+    size_t size;
+    ASSERT(cache_get(cache, "/p/60", &value, &size) && memcmp(value, "old", 3) == 0,
+           "Entry put once");
+    ASSERT(cache_get(cache, "/p/20", &value, &size) && memcmp(value, "new", 3) == 0,
+           "Later put of a repeated key wins");
+    ASSERT(!cache_contains(cache, "/p/7"), "Skipped key not stored");
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.num_entries == 149, "One entry per distinct key");
+    cache_destroy(cache);
+    PASS();
+}
+
+#define BATCH_BENCH_KEYS    65536
+#define BATCH_BENCH_GETS    (1 << 19)
+
+static void test_cache_get_many_bench(void) {
+    TEST(cache_get_many_bench);
+
+    cache_t *cache = cache_create_sharded(256 * 1024 * 1024, 16);
+    char (*names)[16] = malloc(BATCH_BENCH_KEYS * sizeof(*names));
+    for (int i = 0; i < BATCH_BENCH_KEYS; i++) {
+        snprintf(names[i], sizeof(names[i]), "/b/%d", i);
+        cache_put(cache, names[i], names[i], 16);
+    }
+    const char **trace = malloc(BATCH_BENCH_GETS * sizeof(*trace));
+    unsigned int x = 4242;
+    for (int i = 0; i < BATCH_BENCH_GETS; i++) {
+        trace[i] = names[xorshift32(&x) % BATCH_BENCH_KEYS];
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < BATCH_BENCH_GETS; i++) {
+        cache_handle_t h;
+        cache_acquire(cache, trace[i], &h);
+        cache_release(&h);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double single_ns = ((end.tv_sec - start.tv_sec) * 1e9 +
+                        (end.tv_nsec - start.tv_nsec)) / BATCH_BENCH_GETS;
+
+    printf("\n    ns/key: acquire %.0f, get_many at batch", single_ns);
+    double best_ns = single_ns;
+    cache_handle_t handles[256];
+    for (int batch = 1; batch <= 256; batch *= 2) {
+        size_t hits = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < BATCH_BENCH_GETS; i += batch) {
+            hits += cache_get_many(cache, trace + i, batch, handles);
+            for (int j = 0; j < batch; j++) {
+                cache_release(&handles[j]);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double ns = ((end.tv_sec - start.tv_sec) * 1e9 +
+                     (end.tv_nsec - start.tv_nsec)) / BATCH_BENCH_GETS;
+        printf(" %d: %.0f%s", batch, ns, batch < 256 ? "," : "");
+        ASSERT(hits == BATCH_BENCH_GETS, "Every key should hit");
+        if (batch >= 16 && ns < best_ns) {
+            best_ns = ns;
+        }
+    }
+    printf("\n  ");
+    free(trace);
+    free(names);
+    cache_destroy(cache);
+
+    ASSERT(best_ns < single_ns, "Large batches should cost less per key than single gets");
+    PASS();
+}
+
+/* ============================================================================
+Key Index Tests
+============================================================================ */
+
+typedef struct index_item {
+    char key[64];
+    unsigned long hash;
+    struct index_item *next;        /* Chained-table baseline only */
+} index_item_t;
+
+static bool index_item_match(const void *item, const void *key) {
+    return strcmp(((const index_item_t *)item)->key, key) == 0;
+}
+
+/*
+make_index_items - n items with keys "/index/<i>"
+*/
+static index_item_t *make_index_items(int n) {
+    index_item_t *items = malloc((size_t)n * sizeof(index_item_t));
+    for (int i = 0; i < n; i++) {
+        snprintf(items[i].key, sizeof(items[i].key), "/index/%d", i);
+        items[i].hash = cache_hash(items[i].key);
+        items[i].next = NULL;
+    }
+    return items;
+}
+
+static void test_cache_index_basic(void) {
+    TEST(cache_index_basic);
+
+    int n = 100000;
+    index_item_t *items = make_index_items(n);
+    cache_index_t index;
+    ASSERT(cache_index_init(&index, 16), "Should init index");
+
+    for (int i = 0; i < n; i++) {
+        ASSERT(cache_index_insert(&index, items[i].hash, &items[i]), "Insert");
+    }
+    ASSERT(index.count == (size_t)n && index.resizes >= 10, "Index should have grown");
+    for (int i = 0; i < n; i++) {
+        if (cache_index_find(&index, items[i].hash, index_item_match, items[i].key) != &items[i]) {
+            FAIL("Every key should be found");
+            return;
+        }
+    }
+    ASSERT(cache_index_find(&index, cache_hash("/nope"), index_item_match, "/nope") == NULL,
+           "Absent key");
+
+    /* Remove the even keys; odd ones stay reachable past the tombstones */
+    for (int i = 0; i < n; i += 2) {
+        ASSERT(cache_index_remove(&index, items[i].hash, &items[i]), "Remove");
+    }
+    ASSERT(!cache_index_remove(&index, items[0].hash, &items[0]), "Double remove");
+    for (int i = 0; i < n; i++) {
+        void *found = cache_index_find(&index, items[i].hash, index_item_match, items[i].key);
+        if (found != (i % 2 ? &items[i] : NULL)) {
+            FAIL("Only odd keys should remain");
+            return;
+        }
+    }
+
+    /* Equal hashes: told apart by the match callback */
+    index_item_t twins[2] = { { "/twin/a", 42, NULL }, { "/twin/b", 42, NULL } };
+    cache_index_insert(&index, 42, &twins[0]);
+    cache_index_insert(&index, 42, &twins[1]);
+    ASSERT(cache_index_find(&index, 42, index_item_match, "/twin/b") == &twins[1] &&
+           cache_index_find(&index, 42, index_item_match, "/twin/a") == &twins[0],
+           "Hash collisions resolved by key");
+    cache_index_remove(&index, 42, &twins[0]);
+    ASSERT(cache_index_find(&index, 42, index_item_match, "/twin/b") == &twins[1], "Twin kept");
+
+    cache_index_clear(&index);
+    ASSERT(index.count == 0 &&
+           cache_index_find(&index, items[1].hash, index_item_match, items[1].key) == NULL,
+           "Clear empties the index");
+    cache_index_destroy(&index);
+    free(items);
+    PASS();
+}
+
+static void test_cache_index_incremental_resize(void) {
+    TEST(cache_index_incremental_resize);
+
+    int n = 4096;
+    index_item_t *items = make_index_items(n);
+    cache_index_t index;
+    cache_index_init(&index, 16);
+
+    int mid_resize_checks = 0;
+    for (int i = 0; i < n; i++) {
+        unsigned long resizes = index.resizes;
+        cache_index_insert(&index, items[i].hash, &items[i]);
+        if (index.resizes == resizes || index.old == NULL) {
+            continue;
+        }
+        /* A resize just started: the old table is drained gradually */
+        ASSERT(index.old->used > 0 || index.old->capacity <= 2 * CACHE_INDEX_GROUP,
+               "Old table should not be drained in one go");
+        for (int j = 0; j <= i; j++) {
+            if (cache_index_find(&index, items[j].hash, index_item_match, items[j].key) !=
+                &items[j]) {
+                FAIL("Keys must stay visible while the tables are split");
+                return;
+            }
+        }
+        mid_resize_checks++;
+    }
+    ASSERT(mid_resize_checks >= 5, "Should have observed several resizes");
+
+    /* Removing keys that still live in the old table */
+    cache_index_t split;
+    cache_index_init(&split, 16);
+    for (int i = 0; i < 512; i++) {
+        cache_index_insert(&split, items[i].hash, &items[i]);
+    }
+    while (split.old == NULL) {
+        cache_index_insert(&split, items[split.count].hash, &items[split.count]);
+    }
+    size_t count = split.count;
+    for (size_t i = 0; i < count; i++) {
+        ASSERT(cache_index_remove(&split, items[i].hash, &items[i]), "Remove from either table");
+        ASSERT(cache_index_find(&split, items[i].hash, index_item_match, items[i].key) == NULL,
+               "A removed key must not reappear from the other table");
+    }
+    ASSERT(split.count == 0, "Everything removed");
+
+    cache_index_destroy(&split);
+    cache_index_destroy(&index);
+    free(items);
+    PASS();
+}
+
+/*
+chained_find - Lookup in the old fixed 1021-bucket chained table
+*/
+static index_item_t *chained_find(index_item_t **buckets, const char *key, unsigned long hash) {
+    for (index_item_t *item = buckets[hash % 1021]; item != NULL; item = item->next) {
+        if (strcmp(item->key, key) == 0) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+static void test_cache_index_lookup_bench(void) {
+    TEST(cache_index_lookup_bench);
+
+    int sizes[] = { 1000, 100000, 1000000 };
+    printf("\n    entries   index (ns/lookup)   chained 1021 buckets (ns/lookup)\n");
+    for (int s = 0; s < 3; s++) {
+        int n = sizes[s];
+        index_item_t *items = make_index_items(n);
+        cache_index_t index;
+        cache_index_init(&index, 16);
+        index_item_t **buckets = calloc(1021, sizeof(index_item_t *));
+        for (int i = 0; i < n; i++) {
+            cache_index_insert(&index, items[i].hash, &items[i]);
+            items[i].next = buckets[items[i].hash % 1021];
+            buckets[items[i].hash % 1021] = &items[i];
+        }
+
+        struct timespec start, end;
+        unsigned int x = 99;
+        int lookups = 1000000;
+        int found = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < lookups; i++) {
+            index_item_t *item = &items[xorshift32(&x) % n];
+            found += cache_index_find(&index, item->hash, index_item_match, item->key) == item;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double index_ns = ((end.tv_sec - start.tv_sec) * 1e9 +
+                           (end.tv_nsec - start.tv_nsec)) / lookups;
+
+        /* Chains hold n / 1021 entries each: fewer lookups keep this short */
+        int chained_lookups = n <= 1000 ? 1000000 : 20000000 / (n / 1021);
+        x = 99;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < chained_lookups; i++) {
+            index_item_t *item = &items[xorshift32(&x) % n];
+            found += chained_find(buckets, item->key, item->hash) == item;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double chained_ns = ((end.tv_sec - start.tv_sec) * 1e9 +
+                             (end.tv_nsec - start.tv_nsec)) / chained_lookups;
+
+        printf("    %7d   %17.1f   %32.1f\n", n, index_ns, chained_ns);
+        cache_index_destroy(&index);
+        free(buckets);
+        free(items);
+        ASSERT(found == lookups + chained_lookups, "Every lookup should hit");
+        if (n >= 100000) {
+            ASSERT(index_ns < chained_ns, "Index should beat long chains");
+        }
+    }
+    printf("  ");
+    PASS();
+}
+
+/*
+test_cache_entry_footprint - Metadata bytes per entry and lookup cost at
+200k small entries (the old layout used 616 bytes + a bucket pointer)
+*/
+static void test_cache_entry_footprint(void) {
+    TEST(cache_entry_footprint);
+
+    const int n = 200000;
+    char key[64];
+    char data[64];
+    memset(data, 'f', sizeof(data));
+    cache_t *cache = cache_create_sharded((size_t)n * 256, 1);
+    for (int i = 0; i < n; i++) {
+        snprintf(key, sizeof(key), "/static/images/file_%06d.png", i);
+        cache_put(cache, key, data, sizeof(data));
+    }
+    cache_shard_t *shard = &cache->shards[0];
+    ASSERT(shard->num_entries == n, "Everything should fit");
+
+    /* Entry table + index slots, plus what buf adds to the payload's chunk */
+    size_t table = (size_t)shard->num_blocks * sizeof(cache_entry_block_t) +
+                   shard->index.cur->capacity * (1 + sizeof(cache_index_slot_t));
+    double per_entry = (double)table / n + (double)shard->current_size / n - sizeof(data);
+
+    struct timespec start, end;
+    unsigned int x = 7;
+    int gets = 1000000;
+    int hits = 0;
+    char *out;
+    size_t out_size;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < gets; i++) {
+        snprintf(key, sizeof(key), "/static/images/file_%06d.png", (int)(xorshift32(&x) % n));
+        hits += cache_get(cache, key, &out, &out_size);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / gets;
+
+    printf("(%zu B entry, %.0f B metadata/entry, %.0f ns/get) ",
+           sizeof(cache_entry_t), per_entry, ns);
+    cache_destroy(cache);
+    ASSERT(hits == gets, "Every get should hit");
+    ASSERT(sizeof(cache_entry_t) == 64, "Hot fields fit one cache line");
+    ASSERT(per_entry < 256, "Metadata should be a fraction of the old 616 bytes");
+    PASS();
+}
+
+/* ============================================================================
+Slab Allocator Tests
+============================================================================ */
+
+static void test_slab_size_classes(void) {
+    TEST(slab_size_classes);
+
+    ASSERT(slab_chunk_size(1) == 64 && slab_chunk_size(64) == 64, "Smallest class is 64");
+    ASSERT(slab_chunk_size(65) == 80 && slab_chunk_size(129) == 160, "Four classes per doubling");
+    ASSERT(slab_chunk_size(SLAB_MAX_CHUNK) == SLAB_MAX_CHUNK, "Largest class");
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    ASSERT(slab_chunk_size(SLAB_MAX_CHUNK + 1) == SLAB_MAX_CHUNK + page,
+           "Larger requests are page-rounded");
+    for (size_t size = 1; size <= SLAB_MAX_CHUNK; size += 97) {
+        size_t chunk = slab_chunk_size(size);
+        if (chunk < size || (size > 64 && chunk > size + size / 4 + 16) || chunk % 16 != 0) {
+            FAIL("Chunk must fit, waste at most a quarter, and stay 16-byte aligned");
+            return;
+        }
+    }
+    PASS();
+}
+
+static void test_slab_reuse_and_release(void) {
+    TEST(slab_reuse_and_release);
+
+    slab_allocator_t *alloc = slab_create();
+    ASSERT(alloc != NULL, "Should create allocator");
+
+    enum { COUNT = 5000 };
+    static char *ptrs[COUNT];
+    for (int i = 0; i < COUNT; i++) {
+        ptrs[i] = slab_alloc(alloc, 1000);
+        ASSERT(ptrs[i] != NULL && ((uintptr_t)ptrs[i] & 15) == 0, "Aligned allocation");
+        memset(ptrs[i], i & 0xff, 1000);
+    }
+    for (int i = 0; i < COUNT; i++) {
+        if (ptrs[i][0] != (char)(i & 0xff) || ptrs[i][999] != (char)(i & 0xff)) {
+            FAIL("Chunks must not overlap");
+            return;
+        }
+    }
+
+    slab_stats_t stats;
+    slab_get_stats(alloc, &stats);
+    ASSERT(stats.used_bytes == COUNT * slab_chunk_size(1000), "Used bytes counts chunks");
+    ASSERT(stats.slabs == 5, "1000-byte chunks: 1023 per slab");
+
+    /* Freed chunks are handed out again before a new slab is mapped */
+    slab_free(alloc, ptrs[7], 1000);
+    char *again = slab_alloc(alloc, 1000);
+    ASSERT(again == ptrs[7], "Free chunk should be reused");
+
+    void *large = slab_alloc(alloc, 3 * SLAB_MAX_CHUNK);
+    ASSERT(large != NULL, "Large allocation should be mapped");
+    memset(large, 1, 3 * SLAB_MAX_CHUNK);
+    slab_get_stats(alloc, &stats);
+    ASSERT(stats.large_allocs == 1, "Large allocation counted");
+    slab_free(alloc, large, 3 * SLAB_MAX_CHUNK);
+
+    for (int i = 0; i < COUNT; i++) {
+        slab_free(alloc, ptrs[i], 1000);
+    }
+    slab_get_stats(alloc, &stats);
+    ASSERT(stats.used_bytes == 0 && stats.large_allocs == 0, "Everything freed");
+    ASSERT(stats.slabs == 1, "Empty slabs are unmapped, one spare kept");
+
+    slab_destroy(alloc);
+    PASS();
+}
+
+static void test_slab_release_high_water(void) {
+    TEST(slab_release_high_water);
+
+    slab_allocator_t *alloc = slab_create();
+    ASSERT(alloc != NULL, "Should create allocator");
+
+    /* 32 KB chunks, one slab; the last stays live so the slab is not retired */
+    enum { COUNT = 20, CHUNK = 32 * 1024 };
+    char *ptrs[COUNT];
+    for (int i = 0; i < COUNT; i++) {
+        ptrs[i] = slab_alloc(alloc, CHUNK);
+        ASSERT(ptrs[i] != NULL, "Should allocate");
+        memset(ptrs[i], 0xAB, CHUNK);
+    }
+    for (int i = 0; i < COUNT - 1; i++) {
+        slab_free(alloc, ptrs[i], CHUNK);
+    }
+
+    int kept = SLAB_RELEASE_KEEP / CHUNK;
+    ASSERT((unsigned char)ptrs[0][CHUNK / 2] == 0xAB &&
+           (unsigned char)ptrs[kept - 1][CHUNK / 2] == 0xAB,
+           "Below the mark, freed chunks keep their pages");
+    ASSERT(ptrs[kept][CHUNK / 2] == 0 && ptrs[COUNT - 2][CHUNK / 2] == 0,
+           "Past the mark, freed pages go back to the OS");
+
+    slab_free(alloc, ptrs[COUNT - 1], CHUNK);
+    slab_destroy(alloc);
+    PASS();
+}
+
+/*
+rss_bytes - Resident set size of this process
+*/
+static size_t rss_bytes(void) {
+    unsigned long pages_total = 0, pages_resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == NULL) {
+        return 0;
+    }
+    if (fscanf(f, "%lu %lu", &pages_total, &pages_resident) != 2) {
+        pages_resident = 0;
+    }
+    fclose(f);
+    return pages_resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+#define CHURN_BUDGET    (32 * 1024 * 1024)
+#define CHURN_KEYS      20000
+#define CHURN_PUTS      40000
+
+/*
+churn_size - Log-uniform file size between 256 B and 256 KB
+*/
+static size_t churn_size(unsigned int *x) {
+    double u = (xorshift32(x) % 1000000) / 1e6;
+    return (size_t)(256.0 * pow(1024.0, u));
+}
+
+/*
+churn_cache - Fill and churn a cache; returns RSS growth / current_size
+*/
+static double churn_cache(double *mapped_ratio) {
+    size_t rss_before = rss_bytes();
+    cache_t *cache = cache_create(CHURN_BUDGET);
+    char *payload = calloc(1, 256 * 1024 + 1);
+    char key[32];
+    unsigned int x = 777;
+
+    for (int i = 0; i < CHURN_PUTS; i++) {
+        snprintf(key, sizeof(key), "/churn/%u", xorshift32(&x) % CHURN_KEYS);
+        cache_put(cache, key, payload, churn_size(&x));
+    }
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    double ratio = (double)(rss_bytes() - rss_before) / stats.current_size;
+    *mapped_ratio = (double)stats.payload_mapped / stats.current_size;
+    free(payload);
+    cache_destroy(cache);
+    return ratio;
+}
+
+/*
+churn_malloc - The same churn with exact-size malloc'd buffers, as the
+cache did before the slab allocator
+
+Victims are picked at random: once hits reorder the LRU list, entries
+are no longer evicted in the order they were allocated.
+*/
+static double churn_malloc(void) {
+    size_t rss_before = rss_bytes();
+    char **bufs = calloc(CHURN_KEYS, sizeof(char *));
+    size_t *sizes = calloc(CHURN_KEYS, sizeof(size_t));
+    int *live = malloc(CHURN_KEYS * sizeof(int));
+    int num_live = 0;
+    size_t current = 0;
+    unsigned int x = 777;
+
+    for (int i = 0; i < CHURN_PUTS; i++) {
+        int k = xorshift32(&x) % CHURN_KEYS;
+        size_t size = churn_size(&x);
+        if (bufs[k] != NULL) {
+            free(bufs[k]);
+            current -= sizes[k];
+        } else {
+            live[num_live++] = k;
+        }
+        bufs[k] = malloc(size);
+        memset(bufs[k], 0, size);
+        sizes[k] = size;
+        current += size;
+        while (current > CHURN_BUDGET) {
+            int slot = xorshift32(&x) % num_live;
+            int victim = live[slot];
+            if (victim == k) {
+                continue;
+            }
+            free(bufs[victim]);
+            bufs[victim] = NULL;
+            current -= sizes[victim];
+            live[slot] = live[--num_live];
+        }
+    }
+
+    double ratio = (double)(rss_bytes() - rss_before) / current;
+    for (int k = 0; k < CHURN_KEYS; k++) {
+        free(bufs[k]);
+    }
+    free(bufs);
+    free(sizes);
+    free(live);
+    return ratio;
+}
+
+static void test_slab_churn_rss(void) {
+    TEST(slab_churn_rss);
+
+    /* Each run in its own child so the two heaps cannot share pages */
+    double results[3];
+    for (int run = 0; run < 2; run++) {
+        int fds[2];
+        ASSERT(pipe(fds) == 0, "pipe");
+        pid_t pid = fork();
+        ASSERT(pid >= 0, "fork");
+        if (pid == 0) {
+            double out[2] = {0, 0};
+            out[0] = run == 0 ? churn_cache(&out[1]) : churn_malloc();
+            ssize_t n = write(fds[1], out, sizeof(out));
+            _exit(n == sizeof(out) ? 0 : 1);
+        }
+        double in[2];
+        ssize_t n = read(fds[0], in, sizeof(in));
+        close(fds[0]);
+        close(fds[1]);
+        waitpid(pid, NULL, 0);
+        ASSERT(n == sizeof(in), "child result");
+        if (run == 0) {
+            results[0] = in[0];
+            results[1] = in[1];
+        } else {
+            results[2] = in[0];
+        }
+    }
+
+    printf("\n    %d puts, 256 B - 256 KB, %d MB budget: RSS/current_size "
+           "slab %.2f (%.2f mapped), malloc %.2f\n  ",
+           CHURN_PUTS, CHURN_BUDGET >> 20, results[0], results[1], results[2]);
+
+    ASSERT(results[0] < 1.2, "Resident memory should stay close to the charged size");
+    PASS();
+}
+
+/* ============================================================================
+TTL / Revalidation Tests
+============================================================================ */
+
+static void test_cache_ttl_expiry(void) {
+    TEST(cache_ttl_expiry);
+
+    cache_t *cache = cache_create(1024 * 1024);
+    ASSERT(cache != NULL, "Should create cache");
+
+    cache_put_validated(cache, "/short", "Data", 4, NULL, 20);   /* 20 ms */
+    cache_put(cache, "/forever", "Data", 4);
+
+    char *data;
+    size_t size;
+    ASSERT(cache_get_copy(cache, "/short", &data, &size), "Fresh entry should hit");
+    free(data);
+
+    usleep(50 * 1000);
+    ASSERT(!cache_get_copy(cache, "/short", &data, &size), "Expired entry should miss");
+    ASSERT(cache_get_copy(cache, "/forever", &data, &size), "No-TTL entry should stay");
+    free(data);
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.expirations == 1, "Should count one expiration");
+    ASSERT(stats.num_entries == 1, "Expired entry should be dropped");
+
+    cache_destroy(cache);
+    PASS();
+}
+
+static void test_cache_stale_while_revalidate(void) {
+    TEST(cache_stale_while_revalidate);
+
+    cache_t *cache = cache_create(1024 * 1024);
+    ASSERT(cache != NULL, "Should create cache");
+    cache_set_stale_window(cache, 10000);
+
+    cache_validator_t v = { 123, 4 };
+    cache_put_validated(cache, "/f", "Data", 4, &v, 10);
+    usleep(30 * 1000);
+
+    char *data;
+    size_t size;
+    cache_validator_t got;
+
+    /* First caller after expiry is elected to revalidate */
+    cache_lookup_t r1 = cache_lookup_copy(cache, "/f", &data, &size, &got);
+    ASSERT(r1 == CACHE_LOOKUP_REVALIDATE, "First stale lookup should revalidate");
+    ASSERT(got.mtime_ns == 123 && got.size == 4, "Should return validator");
+    free(data);
+
+    /* Everyone else is served the stale copy without fetching */
+    cache_lookup_t r2 = cache_lookup_copy(cache, "/f", &data, &size, NULL);
+    ASSERT(r2 == CACHE_LOOKUP_STALE, "Concurrent stale lookup should not revalidate");
+    free(data);
+
+    /* NOT_MODIFIED: entry becomes fresh again */
+    ASSERT(cache_revalidated(cache, "/f", 10000), "Should refresh entry");
+    cache_lookup_t r3 = cache_lookup_copy(cache, "/f", &data, &size, NULL);
+    ASSERT(r3 == CACHE_LOOKUP_FRESH, "Revalidated entry should be fresh");
+    free(data);
+
+    cache_destroy(cache);
+    PASS();
+}
+
+static void test_cache_stale_window_bound(void) {
+    TEST(cache_stale_window_bound);
+
+    cache_t *cache = cache_create(1024 * 1024);
+    ASSERT(cache != NULL, "Should create cache");
+    cache_set_stale_window(cache, 10);
+
+    cache_put_validated(cache, "/f", "Data", 4, NULL, 10);
+    usleep(50 * 1000);
+
+    char *data;
+    size_t size;
+    ASSERT(cache_lookup_copy(cache, "/f", &data, &size, NULL) == CACHE_LOOKUP_MISS,
+           "Entry past the stale window should miss");
+
+    /* A revalidation that never finishes does not extend the window */
+    cache_set_stale_window(cache, 40);
+    cache_put_validated(cache, "/g", "Data", 4, NULL, 10);
+    cache_put_validated(cache, "/h", "Data", 4, NULL, 10);
+    usleep(20 * 1000);
+    ASSERT(cache_lookup_copy(cache, "/g", &data, &size, NULL) == CACHE_LOOKUP_REVALIDATE,
+           "Stale lookup should revalidate");
+    free(data);
+    ASSERT(cache_lookup_copy(cache, "/h", &data, &size, NULL) == CACHE_LOOKUP_REVALIDATE,
+           "Stale lookup should revalidate");
+    free(data);
+    usleep(50 * 1000);
+    ASSERT(cache_lookup_copy(cache, "/g", &data, &size, NULL) == CACHE_LOOKUP_MISS,
+           "Entry past the stale window should miss while revalidating");
+    ASSERT(cache_expire(cache) == 1 && !cache_contains(cache, "/h"),
+           "Sweep should reclaim a revalidating entry past its window");
+
+    cache_destroy(cache);
+    PASS();
+}
+
+static void test_cache_revalidate_timeout(void) {
+    TEST(cache_revalidate_timeout);
+
+    cache_t *cache = cache_create(1024 * 1024);
+    ASSERT(cache != NULL, "Should create cache");
+    cache_set_stale_window(cache, 10000);
+    cache_set_revalidate_timeout(cache, 30);
+
+    cache_put_validated(cache, "/f", "Data", 4, NULL, 10);
+    usleep(20 * 1000);
+
+    char *data;
+    size_t size;
+    ASSERT(cache_lookup_copy(cache, "/f", &data, &size, NULL) == CACHE_LOOKUP_REVALIDATE,
+           "First stale lookup should revalidate");
+    free(data);
+    ASSERT(cache_lookup_copy(cache, "/f", &data, &size, NULL) == CACHE_LOOKUP_STALE,
+           "Revalidation in flight: serve stale");
+    free(data);
+
+    /* The elected caller hung: the next lookup takes over */
+    usleep(50 * 1000);
+    ASSERT(cache_lookup_copy(cache, "/f", &data, &size, NULL) == CACHE_LOOKUP_REVALIDATE,
+           "Lookup past the deadline should revalidate again");
+    free(data);
+    ASSERT(cache_lookup_copy(cache, "/f", &data, &size, NULL) == CACHE_LOOKUP_STALE,
+           "The new revalidation is in flight");
+    free(data);
+
+    cache_destroy(cache);
+    PASS();
+}
+static void test_cache_expire_sweep(void) {
+    TEST(cache_expire_sweep);
+
+    char key[32];
+    cache_t *cache = cache_create_sharded(16 * 1024 * 1024, 4);
+    ASSERT(cache != NULL, "Should create cache");
+
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "/short/%d", i);
+        cache_put_ttl(cache, key, "Data", 4, 30);
+        snprintf(key, sizeof(key), "/long/%d", i);
+        cache_put_ttl(cache, key, "Data", 4, 400);
+        snprintf(key, sizeof(key), "/forever/%d", i);
+        cache_put(cache, key, "Data", 4);
+    }
+    /* Beyond the wheel's span, and TTLs changed or dropped before expiry */
+    cache_put_ttl(cache, "/far", "Data", 4, UINT32_MAX);
+    cache_put_ttl(cache, "/short/0", "Data", 4, CACHE_TTL_NONE);
+    cache_put_ttl(cache, "/short/1", "Data", 4, 400);
+    cache_remove(cache, "/short/2");
+
+    ASSERT(cache_expire(cache) == 0, "Nothing is due yet");
+    usleep(80 * 1000);
+    ASSERT(cache_expire(cache) == 997, "Expired short entries are reclaimed without lookups");
+    ASSERT(cache_expire(cache) == 0, "Reclaimed once");
+
+    usleep(400 * 1000);
+    ASSERT(cache_expire(cache) == 1001, "Long entries follow");
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.num_entries == 1002, "No-TTL, far and re-put entries stay");
+    ASSERT(stats.expirations == 1998, "Sweeps count as expirations");
+    ASSERT(cache_contains(cache, "/far") && cache_contains(cache, "/short/0"), "Kept");
+
+    /* Within the stale window an entry may still be served, so it stays */
+    cache_set_stale_window(cache, 100);
+    cache_put_ttl(cache, "/stale", "Data", 4, 10);
+    usleep(50 * 1000);
+    ASSERT(cache_expire(cache) == 0, "Still inside the stale window");
+    usleep(100 * 1000);
+    ASSERT(cache_expire(cache) == 1, "Reclaimed after the stale window");
+
+    cache_clear(cache);
+    cache_set_stale_window(cache, 0);
+    cache_put_ttl(cache, "/after-clear", "Data", 4, 10);
+    usleep(30 * 1000);
+    ASSERT(cache_expire(cache) == 1, "The wheel works after a clear");
+
+    cache_destroy(cache);
+    PASS();
+}
+
+static void test_cache_sweeper_thread(void) {
+    TEST(cache_sweeper_thread);
+
+    char key[32];
+    cache_t *cache = cache_create(4 * 1024 * 1024);
+    ASSERT(cache_start_sweeper(cache, 10), "Should start the sweeper");
+    ASSERT(cache_start_sweeper(cache, 10), "Starting twice is harmless");
+
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "/tmp/%d", i);
+        cache_put_ttl(cache, key, "Data", 4, 20);
+    }
+    cache_put(cache, "/kept", "Data", 4);
+    usleep(200 * 1000);
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.num_entries == 1, "The sweeper reclaims expired entries on its own");
+    ASSERT(stats.expirations == 500, "Every expired entry counted");
+    ASSERT(stats.misses == 0, "No lookups were needed");
+
+    cache_stop_sweeper(cache);
+    cache_put_ttl(cache, "/late", "Data", 4, 10);
+    usleep(50 * 1000);
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.num_entries == 2, "A stopped sweeper reclaims nothing");
+
+    ASSERT(cache_start_sweeper(cache, 0), "Restart with the default interval");
+    cache_destroy(cache);  /* stops it */
+    PASS();
+}
+
+/*
+test_cache_expire_cost - Reclaiming a few expired entries among many live
+ones: the wheel versus a scan of every entry
+*/
+static void test_cache_expire_cost(void) {
+    TEST(cache_expire_cost);
+
+    const int live = 200000, expiring = 1000;
+    char key[48];
+    cache_t *cache = cache_create_sharded((size_t)(live + expiring) * 256, 1);
+    for (int i = 0; i < live; i++) {
+        snprintf(key, sizeof(key), "/live/%d", i);
+        cache_put_ttl(cache, key, "Data", 4, 3600 * 1000);
+    }
+    for (int i = 0; i < expiring; i++) {
+        snprintf(key, sizeof(key), "/expiring/%d", i);
+        cache_put_ttl(cache, key, "Data", 4, 20);
+    }
+    usleep(40 * 1000);
+
+    /* What a sweeper without the wheel has to do: look at every entry */
+    struct timespec start, end;
+    cache_shard_t *shard = &cache->shards[0];
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+    int due = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_rwlock_rdlock(&shard->lock);
+    for (cache_entry_t *e = shard->segments[0].head; e != NULL;
+         e = cache_entry_at(shard, e->lru_next)) {
+        due += e->expires_ms != CACHE_TTL_NONE && e->expires_ms <= now;
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double scan_us = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / 1e3;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t freed = cache_expire(cache);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double wheel_us = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / 1e3;
+
+    printf("(%d of %d due: wheel %.0f us, full scan %.0f us) ",
+           expiring, live + expiring, wheel_us, scan_us);
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    cache_destroy(cache);
+    ASSERT(due == expiring && freed == (size_t)expiring, "Exactly the expired entries go");
+    ASSERT(stats.num_entries == live, "Live entries stay");
+    ASSERT(wheel_us < scan_us, "The wheel should only touch what expired");
+    PASS();
+}
+
+/* ============================================================================
+Snapshot Tests
+============================================================================ */
+
+static void snapshot_path(char *path, size_t len) {
+    snprintf(path, len, "/tmp/test_cache_snapshot.%d", (int)getpid());
+}
+
+static void test_cache_snapshot_roundtrip(void) {
+    TEST(cache_snapshot_roundtrip);
+
+    char path[64], key[32], data[64];
+    snapshot_path(path, sizeof(path));
+    cache_t *cache = cache_create_with_policy(1024 * 1024, 1, CACHE_POLICY_LRU);
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "/k/%d", i);
+        int len = snprintf(data, sizeof(data), "data-%d-%.*s", i, i % 40, "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+        cache_validator_t v = { 1000 + i, (uint64_t)len };
+        cache_put_validated(cache, key, data, len, i % 2 ? &v : NULL, i % 3 ? 60000 : CACHE_TTL_NONE);
+    }
+    char *out;
+    size_t size;
+    ASSERT(cache_get(cache, "/k/0", &out, &size), "Touch /k/0: most recently used");
+    cache_put_ttl(cache, "/expired", "old", 3, 1);
+    usleep(10 * 1000);
+
+    ASSERT(cache_snapshot(cache, path) == 101, "Every entry written");
+    cache_destroy(cache);
+
+    cache = cache_create_with_policy(1024 * 1024, 1, CACHE_POLICY_LRU);
+    ASSERT(cache_restore(cache, path) == 101, "Every entry restored");
+    cache_shard_t *shard = &cache->shards[0];
+    ASSERT(strcmp(shard->segments[0].tail->key, "/k/1") == 0 ||
+           strcmp(cache_entry_at(shard, shard->segments[0].tail->lru_prev)->key, "/k/1") == 0,
+           "Recency kept: /k/1 is among the least recently used");
+    ASSERT(strcmp(cache_entry_at(shard, shard->segments[0].head->lru_next)->key, "/k/0") == 0 ||
+           strcmp(shard->segments[0].head->key, "/k/0") == 0, "/k/0 stays near the head");
+
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "/k/%d", i);
+        int len = snprintf(data, sizeof(data), "data-%d-%.*s", i, i % 40, "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+        cache_validator_t v;
+        if (cache_lookup_copy(cache, key, &out, &size, &v) != CACHE_LOOKUP_FRESH) {
+            FAIL("Restored entries are fresh");
+            return;
+        }
+        bool same = size == (size_t)len && memcmp(out, data, size) == 0 &&
+                    (i % 2 ? v.mtime_ns == 1000 + i : v.mtime_ns == 0);
+        free(out);
+        if (!same) {
+            FAIL("Payload and validator survive");
+            return;
+        }
+    }
+    ASSERT(!cache_get(cache, "/expired", &out, &size), "Expired entries stay expired");
+    cache_destroy(cache);
+
+    /* A smaller cache gets the hottest entries; cached keys win */
+    cache = cache_create_with_policy(10 * cache_entry_charge("/k/10", 20), 1, CACHE_POLICY_LRU);
+    cache_put(cache, "/k/0", "new", 3);
+    long restored = cache_restore(cache, path);
+    ASSERT(restored > 0 && restored < 10, "Only what fits is restored");
+    ASSERT(cache_get(cache, "/k/0", &out, &size) && size == 3 && memcmp(out, "new", 3) == 0,
+           "An entry cached before the restore is newer");
+    ASSERT(cache_contains(cache, "/k/99") && !cache_contains(cache, "/k/1"),
+           "Recently used entries are chosen over old ones");
+    cache_destroy(cache);
+
+    unlink(path);
+    PASS();
+}
+
+static void test_cache_restore_lazy(void) {
+    TEST(cache_restore_lazy);
+
+    const int files = 512;
+    const size_t file_size = 64 * 1024;
+    char path[64], key[32];
+    snapshot_path(path, sizeof(path));
+    char *data = malloc(file_size);
+
+    cache_t *cache = cache_create_sharded(64 * 1024 * 1024, 4);
+    for (int i = 0; i < files; i++) {
+        snprintf(key, sizeof(key), "/big/%d", i);
+        memset(data, 'a' + i % 26, file_size);
+        cache_put(cache, key, data, file_size);
+    }
+    ASSERT(cache_snapshot(cache, path) == files, "Snapshot written");
+    cache_destroy(cache);
+
+    struct timespec start, end;
+    size_t rss_before = rss_bytes();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    cache = cache_create_sharded(64 * 1024 * 1024, 4);
+    long restored = cache_restore(cache, path);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    size_t rss_restored = rss_bytes() - rss_before;
+    double restore_ms = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / 1e6;
+    ASSERT(restored == files, "Everything restored");
+
+    cache_handle_t handle;
+    bool ok = true;
+    for (int i = 0; i < files; i++) {
+        snprintf(key, sizeof(key), "/big/%d", i);
+        if (!cache_acquire(cache, key, &handle)) {
+            ok = false;
+            break;
+        }
+        ok = ok && handle.size == file_size && handle.data[0] == 'a' + i % 26 &&
+             handle.data[file_size - 1] == 'a' + i % 26;
+        cache_release(&handle);
+    }
+    size_t rss_read = rss_bytes() - rss_before;
+    printf("(%.0f MB: restore %.1f ms, +%zu KB RSS; after reading +%zu MB) ",
+           files * file_size / 1048576.0, restore_ms, rss_restored / 1024, rss_read / 1048576);
+    ASSERT(ok, "Payloads are served from the snapshot");
+    ASSERT(rss_restored < files * file_size / 16, "Restoring must not read the payloads");
+
+    /* A pinned restored payload outlives the cache */
+    ASSERT(cache_acquire(cache, "/big/7", &handle), "Pin one");
+    cache_destroy(cache);
+    ASSERT(handle.data[file_size / 2] == 'a' + 7, "Still mapped after cache_destroy");
+    cache_release(&handle);
+
+    /* Written under another hash seed (hash_check, at offset 40, differs):
+       the hashes are recomputed from the keys, still not the payloads */
+    uint64_t hash_check;
+    int fd = open(path, O_RDWR);
+    ASSERT(fd >= 0 && pread(fd, &hash_check, 8, 40) == 8, "Read the hash check");
+    hash_check ^= 1;
+    bool patched = pwrite(fd, &hash_check, 8, 40) == 8;
+    close(fd);
+    ASSERT(patched, "Patch the hash check");
+    rss_before = rss_bytes();
+    cache = cache_create_sharded(64 * 1024 * 1024, 4);
+    restored = cache_restore(cache, path);
+    rss_restored = rss_bytes() - rss_before;
+    printf("(other seed: +%zu KB RSS) ", rss_restored / 1024);
+    ASSERT(restored == files && cache_contains(cache, "/big/7"),
+           "Everything restored under the current hashes");
+    ASSERT(rss_restored < files * file_size / 16, "Rehashing must not read the payloads");
+    cache_destroy(cache);
+
+    free(data);
+    unlink(path);
+    PASS();
+}
+
+static void test_cache_restore_rejects_bad_files(void) {
+    TEST(cache_restore_rejects_bad_files);
+
+    char path[64];
+    snapshot_path(path, sizeof(path));
+    cache_t *cache = cache_create(1024 * 1024);
+    unlink(path);
+    ASSERT(cache_restore(cache, path) == -1, "Missing file");
+
+    cache_put(cache, "/a", "Data", 4);
+    cache_put(cache, "/b", "Data", 4);
+    ASSERT(cache_snapshot(cache, path) == 2, "Snapshot written");
+    ASSERT(truncate(path, 100) == 0, "Truncate it");
+    cache_t *other = cache_create(1024 * 1024);
+    ASSERT(cache_restore(other, path) == -1, "Truncated file");
+
+    FILE *f = fopen(path, "w");
+    fputs("definitely not a cache snapshot, but long enough to have a header", f);
+    fclose(f);
+    ASSERT(cache_restore(other, path) == -1, "Garbage");
+
+    /* Well-formed file, one field of the first record or its buffer
+       image corrupted at a time */
+    enum { REC_OFFSET, BUF_FLAGS, BUF_SIZE, BUF_KEY, CORRUPTIONS };
+    const char *what[CORRUPTIONS] = {
+        "Record offset that wraps", "Buffer not marked mapped",
+        "Buffer size disagreeing with the record", "Key without terminator"
+    };
+    for (int c = 0; c < CORRUPTIONS; c++) {
+        ASSERT(cache_snapshot(cache, path) == 2, "Snapshot written");
+        int fd = open(path, O_RDWR);
+        uint64_t table_offset, offset;
+        cache_buf_t buf;
+        /* snapshot_header_t: magic, version, policy, count, table_offset;
+           snapshot_record_t: hash, offset, ... */
+        ASSERT(pread(fd, &table_offset, 8, 24) == 8 &&
+               pread(fd, &offset, 8, (off_t)table_offset + 8) == 8 &&
+               pread(fd, &buf, sizeof(buf), (off_t)offset) == (ssize_t)sizeof(buf),
+               "Read the first record");
+        bool patched = false;
+        if (c == REC_OFFSET) {
+            uint64_t huge = UINT64_MAX - 15;
+            patched = pwrite(fd, &huge, 8, (off_t)table_offset + 8) == 8;
+        } else if (c == BUF_KEY) {
+            char junk[16];
+            memset(junk, 'x', sizeof(junk));
+            patched = pwrite(fd, junk, buf.key_len, (off_t)(offset + sizeof(buf))) == buf.key_len;
+        } else {
+            if (c == BUF_FLAGS) {
+                buf.flags = 0;
+            } else {
+                buf.size += 1000;
+            }
+            patched = pwrite(fd, &buf, sizeof(buf), (off_t)offset) == (ssize_t)sizeof(buf);
+        }
+        close(fd);
+        ASSERT(patched, "Corrupt the first record");
+        ASSERT(cache_restore(other, path) == -1, what[c]);
+    }
+
+    cache_stats_t stats;
+    cache_get_stats(other, &stats);
+    ASSERT(stats.num_entries == 0, "Nothing restored from bad files");
+
+    cache_destroy(other);
+    cache_destroy(cache);
+    unlink(path);
+    PASS();
+}
+
+static void test_cache_restore_gdsf_priority(void) {
+    TEST(cache_restore_gdsf_priority);
+
+    char path[64], key[32], data[1000];
+    snapshot_path(path, sizeof(path));
+    memset(data, 'g', sizeof(data));
+    size_t max_size = 64 * 1024;
+    cache_t *cache = cache_create_with_policy(max_size, 1, CACHE_POLICY_GDSF);
+    cache_put(cache, "/hot", data, sizeof(data));
+    for (int i = 0; i < 10; i++) {
+        ASSERT(cache_contains(cache, "/hot"), "Hot file cached");
+        char *out;
+        size_t size;
+        cache_get(cache, "/hot", &out, &size);
+    }
+    for (int i = 0; i < 40; i++) {
+        snprintf(key, sizeof(key), "/cold/%d", i);
+        cache_put(cache, key, data, sizeof(data));
+    }
+    ASSERT(cache_snapshot(cache, path) > 0, "Snapshot written");
+    cache_destroy(cache);
+
+    /* A cacheful of new one-hit files: the restored hit count keeps
+       /hot's priority above theirs */
+    cache = cache_create_with_policy(max_size, 1, CACHE_POLICY_GDSF);
+    ASSERT(cache_restore(cache, path) == 41, "Every entry restored");
+    for (int i = 0; i < 80; i++) {
+        snprintf(key, sizeof(key), "/new/%d", i);
+        cache_put(cache, key, data, sizeof(data));
+    }
+    ASSERT(cache_contains(cache, "/hot"), "Restored hot file should outlive one-hit files");
+    ASSERT(!cache_contains(cache, "/cold/0"), "Restored cold files are evicted");
+
+    cache_destroy(cache);
+    unlink(path);
+    PASS();
+}
+
+/* ============================================================================
+Disk Tier Tests
+============================================================================ */
+
+static void disk_path(char *path, size_t len) {
+    snprintf(path, len, "/tmp/test_cache_disk.%d", (int)getpid());
+}
+
+/* Contents of test file i: size and bytes both depend on i */
+static size_t disk_file(int i, char *data) {
+    size_t size = 512 + (size_t)(i % 7) * 300;
+    for (size_t j = 0; j < size; j++) {
+        data[j] = (char)('A' + (i + j) % 23);
+    }
+    return size;
+}
+
+static void test_cache_disk_log(void) {
+    TEST(cache_disk_log);
+
+    char path[64];
+    disk_path(path, sizeof(path));
+    cache_disk_t *disk = cache_disk_open(path, 2 * CACHE_DISK_SEGMENT_SIZE);
+    ASSERT(disk != NULL, "Open");
+
+    char record[4096], back[4096];
+    memset(record, 'r', sizeof(record));
+    cache_disk_loc_t first, loc;
+    ASSERT(cache_disk_append(disk, record, 16, record + 16, sizeof(record) - 16, &first),
+           "Append");
+    ASSERT(!cache_disk_find(disk, 1, &loc), "Not visible before insert");
+    ASSERT(cache_disk_insert(disk, 1, &first), "Insert");
+    ASSERT(cache_disk_find(disk, 1, &loc) && loc.length == sizeof(record), "Found");
+    ASSERT(cache_disk_read(disk, &loc, back) && memcmp(back, record, sizeof(record)) == 0,
+           "Read back");
+
+    /* Fill both segments: the head comes back to the first one */
+    for (uint64_t h = 2; h < 2 + 2 * CACHE_DISK_SEGMENT_SIZE / sizeof(record); h++) {
+        cache_disk_append(disk, record, 16, record + 16, sizeof(record) - 16, &loc);
+        cache_disk_insert(disk, h, &loc);
+    }
+    ASSERT(!cache_disk_find(disk, 1, &loc), "Reused segment's records are forgotten");
+    ASSERT(!cache_disk_read(disk, &first, back), "A stale location is refused");
+    ASSERT(!cache_disk_insert(disk, 1, &first), "So is indexing it");
+
+    cache_disk_stats_t stats;
+    cache_disk_get_stats(disk, &stats);
+    ASSERT(stats.reclaimed > 0 && stats.bytes <= stats.capacity, "Reclaimed, within capacity");
+    ASSERT(cache_disk_remove(disk, 2 + CACHE_DISK_SEGMENT_SIZE / sizeof(record) + 5, NULL),
+           "Remove");
+
+    cache_disk_close(disk);
+    ASSERT(access(path, F_OK) != 0, "Log file removed on close");
+    PASS();
+}
+
+static void test_cache_disk_tier(void) {
+    TEST(cache_disk_tier);
+
+    const int files = 400;
+    char path[64], key[32], data[4096], *out;
+    size_t size;
+    disk_path(path, sizeof(path));
+
+    /* Room for about 30 files in memory */
+    cache_t *cache = cache_create_with_policy(64 * 1024, 1, CACHE_POLICY_LRU);
+    ASSERT(cache_attach_disk(cache, path, 64 * 1024 * 1024), "Attach");
+    for (int i = 0; i < files; i++) {
+        snprintf(key, sizeof(key), "/disk/%d", i);
+        size_t n = disk_file(i, data);
+        cache_validator_t v = { i, n };
+        cache_put_validated(cache, key, data, n, i % 2 ? &v : NULL, CACHE_TTL_NONE);
+    }
+    cache_flush_disk(cache);
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.disk_writes > 0 &&
+           stats.num_entries + stats.disk_writes + stats.disk_dropped == (unsigned long)files,
+           "Each evicted entry is written once (or dropped if the writer lags)");
+    ASSERT(stats.disk_entries > 0 && stats.disk_entries + stats.num_entries <= (size_t)files,
+           "A key is in one tier at a time");
+    cache_reset_stats(cache);
+
+    bool ok = true;
+    for (int i = 0; i < files && ok; i++) {
+        snprintf(key, sizeof(key), "/disk/%d", i);
+        size_t n = disk_file(i, data);
+        cache_validator_t v;
+        cache_lookup_t r = cache_lookup_copy(cache, key, &out, &size, &v);
+        bool dropped = r == CACHE_LOOKUP_MISS && stats.disk_dropped > 0;
+        if (!dropped) {
+            ok = r == CACHE_LOOKUP_FRESH && size == n && memcmp(out, data, n) == 0 &&
+                 (i % 2 ? v.mtime_ns == i : v.mtime_ns == 0);
+            free(out);
+        }
+    }
+    ASSERT(ok, "Every file comes back with its payload and validator");
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.disk_hits > 0 && stats.hits >= stats.disk_hits, "Promotions count as hits");
+
+    /* A promoted entry is no longer on disk; a put or remove drops the copy */
+    cache_flush_disk(cache);
+    ASSERT(cache_get_copy(cache, "/disk/0", &out, &size), "Promote /disk/0");
+    free(out);
+    cache_put(cache, "/disk/0", "new", 3);
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "/filler/%d", i);
+        cache_put(cache, key, data, 1000);
+    }
+    cache_flush_disk(cache);
+    ASSERT(cache_get_copy(cache, "/disk/0", &out, &size) && size == 3 && memcmp(out, "new", 3) == 0,
+           "The newer version comes back from disk");
+    free(out);
+    ASSERT(cache_remove(cache, "/disk/1"), "Remove /disk/1 (in either tier)");
+    for (int i = 100; i < 200; i++) {
+        snprintf(key, sizeof(key), "/filler/%d", i);
+        cache_put(cache, key, data, 1000);
+    }
+    cache_flush_disk(cache);
+    ASSERT(!cache_contains(cache, "/disk/1") && !cache_get(cache, "/disk/1", &out, &size),
+           "A removed key is not resurrected from disk");
+
+    cache_clear(cache);
+    ASSERT(!cache_get(cache, "/filler/5", &out, &size), "Clear empties the disk tier too");
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.disk_entries == 0, "No disk entries after clear");
+
+    cache_destroy(cache);
+    ASSERT(access(path, F_OK) != 0, "Log removed with the cache");
+    PASS();
+}
+
+/*
+Readers racing the writer: every answer is either a miss or the exact file
+*/
+typedef struct {
+    cache_t *cache;
+    int files;
+    int seed;
+    bool corrupt;
+} disk_reader_arg_t;
+
+static void *disk_reader(void *arg) {
+    disk_reader_arg_t *a = arg;
+    uint32_t x = (uint32_t)a->seed;
+    char key[32], data[4096];
+    cache_handle_t handle;
+    for (int op = 0; op < 20000; op++) {
+        int i = (int)(xorshift32(&x) % (uint32_t)a->files);
+        snprintf(key, sizeof(key), "/race/%d", i);
+        size_t n = disk_file(i, data);
+        if (op % 4 == 0) {
+            cache_put(a->cache, key, data, n);
+        } else if (cache_acquire(a->cache, key, &handle)) {
+            if (handle.size != n || memcmp(handle.data, data, n) != 0) {
+                a->corrupt = true;
+            }
+            cache_release(&handle);
+        }
+    }
+    return NULL;
+}
+
+static void test_cache_disk_tier_concurrent(void) {
+    TEST(cache_disk_tier_concurrent);
+
+    char path[64];
+    disk_path(path, sizeof(path));
+    cache_t *cache = cache_create_with_policy(256 * 1024, 4, CACHE_POLICY_CLOCK);
+    /* Two segments, well below the working set: segments get reused */
+    ASSERT(cache_attach_disk(cache, path, 2 * CACHE_DISK_SEGMENT_SIZE), "Attach");
+
+    pthread_t threads[4];
+    disk_reader_arg_t args[4];
+    for (int t = 0; t < 4; t++) {
+        args[t] = (disk_reader_arg_t){ cache, 20000, t + 1, false };
+        pthread_create(&threads[t], NULL, disk_reader, &args[t]);
+    }
+    bool corrupt = false;
+    for (int t = 0; t < 4; t++) {
+        pthread_join(threads[t], NULL);
+        corrupt = corrupt || args[t].corrupt;
+    }
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    ASSERT(!corrupt, "No torn or mismatched payloads");
+    ASSERT(stats.disk_hits > 0, "Disk tier used");
+    cache_destroy(cache);
+    PASS();
+}
+
+/* ============================================================================
+Hash Tests
+============================================================================ */
+
+/* The hash the cache used before fast_hash, for comparison */
+static unsigned long djb2(const char *str) {
+    unsigned long hash = 5381;
+    int c;
+    while ((c = *str++)) {
+        hash = ((hash << 5) + hash) + c;
+    }
+    return hash;
+}
+
+static void test_fast_hash_basic(void) {
+    TEST(fast_hash_basic);
+
+    size_t max = 3 * FAST_HASH_LONG + 100;
+    char *buf = malloc(max + 8);
+    char *copy = malloc(max + 8);
+    ASSERT(buf != NULL && copy != NULL, "Should allocate buffers");
+    unsigned int x = 12345;
+    for (size_t i = 0; i < max + 8; i++) {
+        buf[i] = (char)xorshift32(&x);
+    }
+
+    bool stable = true, distinct = true, unaligned = true, seeded = true;
+    uint64_t prev = fast_hash(buf, 0, 7);
+    for (size_t len = 1; len <= max; len++) {
+        uint64_t h = fast_hash(buf, len, 7);
+        stable &= h == fast_hash(buf, len, 7);
+        distinct &= h != prev;      /* Every prefix, across both paths */
+        seeded &= h != fast_hash(buf, len, 8);
+        /* Same bytes at another alignment */
+        memcpy(copy + len % 8, buf, len);
+        unaligned &= h == fast_hash(copy + len % 8, len, 7);
+        prev = h;
+    }
+    free(buf);
+    free(copy);
+    ASSERT(stable, "Same input and seed should give the same hash");
+    ASSERT(distinct, "Prefixes of one buffer should hash apart");
+    ASSERT(seeded, "Another seed should give another hash");
+    ASSERT(unaligned, "Hash should not depend on alignment");
+
+    ASSERT(fast_hash_seed() == fast_hash_seed(), "Process seed should be fixed");
+    ASSERT(fast_hash_str("/a/b") == fast_hash("/a/b", 4, fast_hash_seed()),
+           "String hash should use the process seed");
+    ASSERT(cache_hash("/a/b") == fast_hash_str("/a/b"), "Cache keys should use fast_hash");
+    PASS();
+}
+
+static void test_fast_hash_distribution(void) {
+    TEST(fast_hash_distribution);
+
+    /* Near-identical paths: djb2 sends these to neighbouring values */
+    enum { KEYS = 65536, BUCKETS = 1024 };
+    int *low = calloc(BUCKETS, sizeof(int));
+    int *high = calloc(BUCKETS, sizeof(int));
+    ASSERT(low != NULL && high != NULL, "Should allocate buckets");
+
+    char key[64];
+    double flipped = 0;
+    for (int i = 0; i < KEYS; i++) {
+        int len = snprintf(key, sizeof(key), "/static/images/photo_%06d.jpg", i);
+        uint64_t h = fast_hash(key, len, 99);
+        low[h % BUCKETS]++;
+        high[h >> 54]++;
+
+        /* Avalanche: one flipped input bit should flip half the output */
+        key[i % len] ^= (char)(1 << (i % 7));
+        flipped += __builtin_popcountll(h ^ fast_hash(key, len, 99));
+    }
+
+    /* Chi-square over 1023 degrees of freedom stays well under 1300 */
+    double expected = (double)KEYS / BUCKETS, chi_low = 0, chi_high = 0;
+    for (int b = 0; b < BUCKETS; b++) {
+        chi_low += (low[b] - expected) * (low[b] - expected) / expected;
+        chi_high += (high[b] - expected) * (high[b] - expected) / expected;
+    }
+    free(low);
+    free(high);
+    double avalanche = flipped / KEYS;
+    printf("\n    chi-square low bits %.0f, high bits %.0f; %.1f of 64 bits flip per input bit\n  ",
+           chi_low, chi_high, avalanche);
+    ASSERT(chi_low < 1300 && chi_high < 1300, "Buckets should fill evenly");
+    ASSERT(avalanche > 31 && avalanche < 33, "Every input bit should reach every output bit");
+    PASS();
+}
+
+static void test_fast_hash_speed(void) {
+    TEST(fast_hash_speed);
+
+    /* Request paths are mostly 20-100 bytes; the long ones show the lanes */
+    size_t lengths[] = { 16, 32, 64, 128, 256, 4096, 65536 };
+    size_t max = 65536;
+    char *path = malloc(max + 1);
+    ASSERT(path != NULL, "Should allocate path");
+    for (size_t i = 0; i < max; i++) {
+        path[i] = "/abcdefghijklmnopqrstuvwxyz0123456789_."[i % 39];
+    }
+
+    printf("\n    length   djb2 (ns)   fast_hash (ns)   speedup\n");
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        size_t len = lengths[l];
+        path[len] = '\0';
+        long rounds = 40000000 / (long)(len + 32);
+        volatile uint64_t sink = 0;
+        struct timespec start, mid, end;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (long r = 0; r < rounds; r++) {
+            path[1] = (char)('a' + r % 26);
+            sink += djb2(path);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &mid);
+        for (long r = 0; r < rounds; r++) {
+            path[1] = (char)('a' + r % 26);
+            sink += fast_hash_str(path);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        (void)sink;
+
+        double slow = ((mid.tv_sec - start.tv_sec) * 1e9 + (mid.tv_nsec - start.tv_nsec)) / rounds;
+        double fast = ((end.tv_sec - mid.tv_sec) * 1e9 + (end.tv_nsec - mid.tv_nsec)) / rounds;
+        printf("    %6zu   %9.1f   %14.1f   %6.1fx\n", len, slow, fast, slow / fast);
+        path[len] = "/abcdefghijklmnopqrstuvwxyz0123456789_."[len % 39];
+    }
+    printf("  ");
+
+    free(path);
+    PASS();
+}
+
+/* ============================================================================
+Miss-Ratio Curve Tests
+============================================================================ */
+
+static void test_mrc_exact_when_unsampled(void) {
+    TEST(mrc_exact_when_unsampled);
+
+    /* Every key sampled: distances are exact LRU stack distances */
+    mrc_t *mrc = mrc_create(4096);
+    ASSERT(mrc != NULL, "Should create estimator");
+    mrc->threshold = 1u << MRC_SAMPLE_BITS;
+
+    /* a b c a: 'a' comes back after b and c, i.e. at 3 x 1000 bytes */
+    uint64_t a = 101, b = 202, c = 303;
+    mrc_access(mrc, a);
+    mrc_update(mrc, a, 1000);
+    mrc_access(mrc, b);
+    mrc_update(mrc, b, 1000);
+    mrc_access(mrc, c);
+    mrc_update(mrc, c, 1000);
+    mrc_access(mrc, a);
+
+    unsigned long samples;
+    ASSERT(mrc_hit_rate(mrc, 2900, 0, &samples) == 0.0, "2900 bytes cannot hold a b c");
+    ASSERT(fabs(mrc_hit_rate(mrc, 3072, 0, NULL) - 0.25) < 1e-9, "3072 bytes hit once in 4");
+    ASSERT(samples == 4, "Every request was sampled");
+
+    mrc_reset(mrc);
+    ASSERT(mrc_hit_rate(mrc, 3072, 0, NULL) == 0.0, "Reset forgets the histogram");
+    mrc_access(mrc, a);
+    ASSERT(fabs(mrc_hit_rate(mrc, 1024, 0, NULL) - 1.0) < 1e-9, "Tracked keys survive a reset");
+    mrc_destroy(mrc);
+    PASS();
+}
+
+static void test_mrc_prediction(void) {
+    TEST(mrc_prediction);
+
+    /* One cache predicts; LRU caches of the predicted sizes replay the
+       same requests. Only the second half counts, after the warm-up */
+    enum { KEYS = 20000, REQUESTS = 300000 };
+    int *trace = malloc(REQUESTS * sizeof(int));
+    ASSERT(trace != NULL, "Should allocate trace");
+    zipf_trace(trace, REQUESTS, KEYS, 0.8, 7);
+
+    size_t max_size = 16 * 1024 * 1024;
+    cache_t *cache = cache_create_with_policy(max_size, 1, CACHE_POLICY_LRU);
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    const int points[] = { 0, 2, 4, 6, 8 };
+    cache_t *replay[5];
+    for (int p = 0; p < 5; p++) {
+        replay[p] = cache_create_with_policy(stats.mrc_size[points[p]], 1, CACHE_POLICY_LRU);
+    }
+
+    char key[32];
+    for (int i = 0; i < REQUESTS; i++) {
+        if (i == REQUESTS / 2) {
+            cache_reset_stats(cache);
+            for (int p = 0; p < 5; p++) {
+                cache_reset_stats(replay[p]);
+            }
+        }
+        snprintf(key, sizeof(key), "/mrc/%d", trace[i]);
+        size_t size = 500 + (size_t)trace[i] * 2654435761u % 8000;
+        for (int p = -1; p < 5; p++) {
+            cache_t *c = p < 0 ? cache : replay[p];
+            cache_handle_t handle;
+            if (cache_acquire(c, key, &handle)) {
+                cache_release(&handle);
+            } else {
+                cache_put_sized(c, key, size);
+            }
+        }
+    }
+
+    cache_get_stats(cache, &stats);
+    printf("(%lu samples)\n      size    predicted   actual\n", stats.mrc_samples);
+    double worst = 0.0, mean = 0.0;
+    for (int p = 0; p < 5; p++) {
+        cache_stats_t actual;
+        cache_get_stats(replay[p], &actual);
+        double predicted = stats.mrc_hit_rate[points[p]];
+        printf("    %5.2fx    %6.1f%%    %6.1f%%\n", (double)stats.mrc_size[points[p]] / max_size,
+               predicted * 100, actual.hit_rate * 100);
+        worst = fmax(worst, fabs(predicted - actual.hit_rate));
+        mean += fabs(predicted - actual.hit_rate) / 5;
+        cache_destroy(replay[p]);
+    }
+    printf("  ");
+    ASSERT(stats.mrc_samples > 0 && stats.mrc_samples < REQUESTS / 8,
+           "Only a sample of the requests is tracked");
+    ASSERT(cache->mrc->threshold == (1u << MRC_SAMPLE_BITS) / MRC_START_RATE_DIV,
+           "20000 keys fit the sample at the start rate");
+    /* ~1250 of the keys are sampled, so which hot keys fall in the sample
+       moves the curve by several points from seed to seed; main() fixes
+       the seed, which makes the sample and the error reproducible */
+    ASSERT(mean < 0.03 && worst < 0.035, "Predicted hit rates should be close to LRU's");
+
+    cache_destroy(cache);
+    free(trace);
+    PASS();
+}
+
+static void test_mrc_fixed_size(void) {
+    TEST(mrc_fixed_size);
+
+    /* Far more distinct keys than MRC_MAX_KEYS at the start rate */
+    mrc_t *mrc = mrc_create(1024 * 1024);
+    ASSERT(mrc != NULL, "Should create estimator");
+    uint32_t start = mrc->threshold;
+    unsigned int x = 99;
+    for (int i = 0; i < 64 * MRC_MAX_KEYS * MRC_START_RATE_DIV; i++) {
+        uint64_t hash = ((uint64_t)xorshift32(&x) << 32) | xorshift32(&x);
+        mrc_access(mrc, hash);
+        mrc_update(mrc, hash, 100);
+    }
+    ASSERT(mrc->threshold < start / 8, "The sampling rate should drop");
+    ASSERT(mrc->num_keys <= MRC_MAX_KEYS, "Tracked keys should stay bounded");
+
+    /* Only cold misses so far: nothing would hit at any size */
+    ASSERT(mrc_hit_rate(mrc, 4 * 1024 * 1024, 0, NULL) == 0.0, "A scan never hits");
+    mrc_destroy(mrc);
+    PASS();
+}
+
+/* ============================================================================
+Compression Tests
+============================================================================ */
+
+/* Text file i (access-log lines): compresses about as well as real logs */
+static size_t text_file(int i, char *data, size_t size) {
+    unsigned int x = 2463534242u + (unsigned int)i;
+    size_t len = 0;
+    while (len < size) {
+        char line[128];
+        int n = snprintf(line, sizeof(line),
+                         "2026-10-18T12:%02u:%02u host%u GET /static/page_%u.html 200 %u\n",
+                         xorshift32(&x) % 60, xorshift32(&x) % 60, xorshift32(&x) % 8,
+                         xorshift32(&x) % 500, xorshift32(&x) % 100000);
+        size_t take = len + (size_t)n <= size ? (size_t)n : size - len;
+        memcpy(data + len, line, take);
+        len += take;
+    }
+    return size;
+}
+
+static void test_lz_roundtrip(void) {
+    TEST(lz_roundtrip);
+
+    size_t size = 256 * 1024;
+    char *text = malloc(size), *noise = malloc(size), *back = malloc(size);
+    char *block = malloc(lz_bound(size));
+    text_file(1, text, size);
+    unsigned int x = 7;
+    for (size_t i = 0; i < size; i++) {
+        noise[i] = (char)xorshift32(&x);
+    }
+
+    size_t packed = lz_compress(text, size, block, lz_bound(size));
+    ASSERT(packed > 0 && packed < size / 2, "Text compresses");
+    ASSERT(lz_decoded_size(block, packed) == size, "Header holds the size");
+    ASSERT(lz_decompress(block, packed, back) && memcmp(back, text, size) == 0, "Text round-trips");
+
+    ASSERT(lz_compress(noise, size, block, size * 7 / 8) == 0, "Noise gives up at the capacity");
+    packed = lz_compress(noise, size, block, lz_bound(size));
+    ASSERT(packed > 0 && packed <= lz_bound(size), "Noise fits the bound");
+    ASSERT(lz_decompress(block, packed, back) && memcmp(back, noise, size) == 0,
+           "Noise round-trips");
+
+    /* Runs (overlapping matches), tiny and empty inputs */
+    memset(text, 'z', 1000);
+    packed = lz_compress(text, 1000, block, lz_bound(1000));
+    ASSERT(packed < 32 && lz_decompress(block, packed, back) && memcmp(back, text, 1000) == 0,
+           "A run becomes one match");
+    for (size_t n = 0; n < 16; n++) {
+        packed = lz_compress("abcabcabcabcabcab", n, block, lz_bound(n));
+        ASSERT(packed > 0 && lz_decompress(block, packed, back) && memcmp(back, "abcabcabcabcabcab", n) == 0,
+               "Short inputs round-trip");
+    }
+
+    /* Corrupt blocks are refused, never overrun */
+    packed = lz_compress(text, 1000, block, lz_bound(1000));
+    ASSERT(!lz_decompress(block, packed - 1, back), "Truncated block");
+    block[0] ^= 1;
+    ASSERT(!lz_decompress(block, packed, back), "Wrong decoded size");
+    block[0] ^= 1;
+    block[LZ_HEADER_SIZE + 2] = (char)0xFF;
+    ASSERT(!lz_decompress(block, packed, back), "Offset before the start");
+    ASSERT(!lz_decompress(block, 2, back), "Shorter than a header");
+
+    free(text);
+    free(noise);
+    free(back);
+    free(block);
+    PASS();
+}
+
+static void test_cache_compression(void) {
+    TEST(cache_compression);
+
+    size_t size = 64 * 1024;
+    char *text = malloc(size), *noise = malloc(size), *out;
+    size_t len;
+    text_file(2, text, size);
+    unsigned int x = 11;
+    for (size_t i = 0; i < size; i++) {
+        noise[i] = (char)xorshift32(&x);
+    }
+
+    cache_t *cache = cache_create_with_policy(4 * 1024 * 1024, 1, CACHE_POLICY_CLOCK);
+    cache_set_compression(cache, true);
+    cache_validator_t v = { 5, size };
+    ASSERT(cache_put_validated(cache, "/log.txt", text, size, &v, CACHE_TTL_NONE), "Put text");
+    ASSERT(cache_put(cache, "/noise.bin", noise, size), "Put noise");
+    ASSERT(cache_put(cache, "/tiny", "tiny tiny tiny tiny", 19), "Put tiny");
+
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.compressed_entries == 1, "Only the text is compressed");
+    ASSERT(stats.compress_skipped == 1, "The noise was rejected by its sample");
+    ASSERT(stats.payload_size == 2 * size + 19, "Payload counts decoded bytes");
+    ASSERT(stats.current_size < cache_entry_charge("/log.txt", size) / 2 +
+                                cache_entry_charge("/noise.bin", size) +
+                                cache_entry_charge("/tiny", 19),
+           "The text is charged compressed");
+
+    /* Every lookup returns the file */
+    ASSERT(cache_get(cache, "/log.txt", &out, &len) && len == size &&
+           memcmp(out, text, size) == 0, "cache_get decodes");
+    ASSERT(cache_get_copy(cache, "/log.txt", &out, &len) && len == size &&
+           memcmp(out, text, size) == 0, "cache_get_copy decodes");
+    free(out);
+    cache_handle_t h;
+    ASSERT(cache_acquire(cache, "/log.txt", &h) && h.size == size && !h.compressed &&
+           memcmp(h.data, text, size) == 0, "cache_acquire decodes");
+    cache_release(&h);
+    cache_validator_t got;
+    ASSERT(cache_lookup_acquire(cache, "/log.txt", &h, &got) == CACHE_LOOKUP_FRESH &&
+           memcmp(h.data, text, size) == 0 && got.size == size, "cache_lookup_acquire decodes");
+    cache_release(&h);
+
+    /* ...except the packed lookup, which hands out the block */
+    ASSERT(cache_lookup_acquire_packed(cache, "/log.txt", &h, NULL) == CACHE_LOOKUP_FRESH &&
+           h.compressed && h.size < size / 2, "Packed lookup returns the block");
+    char *back = malloc(size);
+    ASSERT(lz_decoded_size(h.data, h.size) == size && lz_decompress(h.data, h.size, back) &&
+           memcmp(back, text, size) == 0, "The block decodes to the file");
+    cache_release(&h);
+    ASSERT(cache_lookup_acquire_packed(cache, "/noise.bin", &h, NULL) == CACHE_LOOKUP_FRESH &&
+           !h.compressed && h.size == size, "Uncompressed entries come back as they are");
+    cache_release(&h);
+
+    /* A snapshot keeps entries compressed */
+    char path[64];
+    snapshot_path(path, sizeof(path));
+    ASSERT(cache_snapshot(cache, path) == 3, "Snapshot");
+    cache_t *restored = cache_create_with_policy(4 * 1024 * 1024, 1, CACHE_POLICY_CLOCK);
+    ASSERT(cache_restore(restored, path) == 3, "Restore");
+    cache_stats_t rstats;
+    cache_get_stats(restored, &rstats);
+    ASSERT(rstats.compressed_entries == 1 && rstats.current_size == stats.current_size &&
+           rstats.payload_size == stats.payload_size, "Restored with the same footprint");
+    ASSERT(cache_get_copy(restored, "/log.txt", &out, &len) && len == size &&
+           memcmp(out, text, size) == 0, "Restored entry decodes");
+    free(out);
+    cache_destroy(restored);
+    unlink(path);
+
+    /* So does the disk tier */
+    disk_path(path, sizeof(path));
+    cache_t *small = cache_create_with_policy(64 * 1024, 1, CACHE_POLICY_LRU);
+    cache_set_compression(small, true);
+    ASSERT(cache_attach_disk(small, path, 16 * 1024 * 1024), "Attach");
+    cache_put(small, "/log.txt", text, size);
+    for (int i = 0; i < 40; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "/evict/%d", i);
+        cache_put(small, key, noise, 4096);
+    }
+    cache_flush_disk(small);
+    ASSERT(cache_get_copy(small, "/log.txt", &out, &len) && len == size &&
+           memcmp(out, text, size) == 0, "Decoded after a trip to disk");
+    free(out);
+    cache_get_stats(small, &stats);
+    ASSERT(stats.disk_hits == 1 && stats.compressed_entries == 1, "Promoted still compressed");
+    cache_destroy(small);
+
+    free(back);
+    free(text);
+    free(noise);
+    cache_destroy(cache);
+    PASS();
+}
+
+/* Hit (get_copy) cost in ns, averaged over the keys that hit */
+static double hit_ns(cache_t *cache, int files, int rounds) {
+    char key[32], *out;
+    size_t len;
+    long hits = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < files; i++) {
+            snprintf(key, sizeof(key), "/logs/%d", i);
+            if (cache_get_copy(cache, key, &out, &len)) {
+                free(out);
+                hits++;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) /
+           (hits > 0 ? (double)hits : 1.0);
+}
+
+static void test_cache_compression_capacity(void) {
+    TEST(cache_compression_capacity);
+
+    const int files = 400;
+    const size_t size = 16 * 1024;
+    char key[32], *data = malloc(size);
+    cache_t *plain = cache_create_with_policy(2 * 1024 * 1024, 1, CACHE_POLICY_CLOCK);
+    cache_t *packed = cache_create_with_policy(2 * 1024 * 1024, 1, CACHE_POLICY_CLOCK);
+    cache_set_compression(packed, true);
+
+    struct timespec start, end;
+    double put_ns[2] = { 0, 0 };
+    for (int i = 0; i < files; i++) {
+        snprintf(key, sizeof(key), "/logs/%d", i);
+        text_file(i, data, size);
+        for (int c = 0; c < 2; c++) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            cache_put(c == 0 ? plain : packed, key, data, size);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            put_ns[c] += (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+        }
+    }
+
+    double plain_hit = hit_ns(plain, files, 5);
+    double packed_hit = hit_ns(packed, files, 5);
+    cache_stats_t ps, cs;
+    cache_get_stats(plain, &ps);
+    cache_get_stats(packed, &cs);
+
+    printf("\n    2 MB budget, %d x 16 KB logs: plain %d files (%.1f MB), lz %d files "
+           "(%.1f MB, %.2fx)\n    put %.1f / %.1f us, get_copy hit %.1f / %.1f us\n  ",
+           files, ps.num_entries, ps.payload_size / 1048576.0, cs.num_entries,
+           cs.payload_size / 1048576.0, (double)cs.payload_size / cs.current_size,
+           put_ns[0] / files / 1e3, put_ns[1] / files / 1e3,
+           plain_hit / 1e3, packed_hit / 1e3);
+
+    ASSERT(cs.compressed_entries == cs.num_entries, "Every log is stored compressed");
+    ASSERT(cs.num_entries >= 2 * ps.num_entries, "Compression at least doubles what fits");
+    ASSERT(cs.current_size <= cs.max_size && ps.current_size <= ps.max_size,
+           "Both stay within budget");
+
+    free(data);
+    cache_destroy(plain);
+    cache_destroy(packed);
+    PASS();
+}
+
+/* ============================================================================
+Chunked File Tests
+============================================================================ */
+
+static void chunk_file(char *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (char)(i * 7 + i / CACHE_CHUNK_SIZE);
+    }
+}
+
+static void test_cache_chunks_put_get(void) {
+    TEST(cache_chunks_put_get);
+
+    const size_t size = 3 * CACHE_CHUNK_SIZE + 1000;
+    char *data = malloc(size);
+    char *out = malloc(size);
+    chunk_file(data, size);
+    cache_t *cache = cache_create(8 * 1024 * 1024);
+    cache_validator_t v = { 77, size };
+
+    char key[64];
+    ASSERT(cache_chunk_key(key, sizeof(key), "/big", 3) > 0 && strcmp(key, "#3:/big") == 0,
+           "Chunk key names index and path");
+    ASSERT(cache_put_chunks(cache, "/big", 1, data, size, &v, CACHE_TTL_NONE, 0) == 0,
+           "Unaligned offset is rejected");
+
+    /* A partial chunk at the end of the data is not stored */
+    ASSERT(cache_put_chunks(cache, "/big", CACHE_CHUNK_SIZE, data + CACHE_CHUNK_SIZE,
+                            CACHE_CHUNK_SIZE + 10, &v, CACHE_TTL_NONE, 0) == 1,
+           "Only the complete chunk is stored");
+    ASSERT(cache_put_chunks(cache, "/big", 0, data, size, &v, CACHE_TTL_NONE, 0) == 4,
+           "Whole file is four chunks");
+    ASSERT(!cache_get(cache, "/big", NULL, NULL), "The file itself is not an entry");
+
+    cache_handle_t chunk;
+    cache_validator_t cv;
+    ASSERT(cache_lookup_chunk(cache, "/big", 3, &chunk, &cv) == CACHE_LOOKUP_FRESH,
+           "Last chunk is cached");
+    ASSERT(chunk.size == 1000 && memcmp(chunk.data, data + 3 * CACHE_CHUNK_SIZE, 1000) == 0,
+           "Last chunk is short");
+    ASSERT(cv.mtime_ns == 77 && cv.size == size, "Chunk carries the file's validator");
+    cache_release(&chunk);
+
+    ASSERT(cache_get_range(cache, "/big", CACHE_CHUNK_SIZE - 10, 100, out, &cv) == 100 &&
+           memcmp(out, data + CACHE_CHUNK_SIZE - 10, 100) == 0,
+           "Range across a chunk boundary");
+    ASSERT(cache_get_range(cache, "/big", 0, size, out, NULL) == size &&
+           memcmp(out, data, size) == 0, "Whole file from chunks");
+    ASSERT(cache_get_range(cache, "/big", size - 500, 1000, out, NULL) == 500 &&
+           memcmp(out, data + size - 500, 500) == 0, "Range is clipped at the end of file");
+    ASSERT(cache_get_range(cache, "/big", size, 10, out, NULL) == 0, "Nothing past the end");
+
+    free(data);
+    free(out);
+    cache_destroy(cache);
+    PASS();
+}
+
+static void test_cache_chunks_partial_residency(void) {
+    TEST(cache_chunks_partial_residency);
+
+    /* A 4 MB file through a 1 MB cache: only some chunks stay */
+    const int chunks = 16;
+    const size_t size = (size_t)chunks * CACHE_CHUNK_SIZE;
+    char *data = malloc(size);
+    char *out = malloc(CACHE_CHUNK_SIZE);
+    chunk_file(data, size);
+    cache_t *cache = cache_create_with_policy(1024 * 1024, 1, CACHE_POLICY_LRU);
+    cache_validator_t v = { 1, size };
+
+    ASSERT(cache_put_chunks(cache, "/movie", 0, data, size, &v, CACHE_TTL_NONE, 0) == 16,
+           "Every chunk is admitted on its own");
+    cache_stats_t stats;
+    cache_get_stats(cache, &stats);
+    ASSERT(stats.current_size <= stats.max_size, "Cache stays within budget");
+
+    int resident = 0;
+    for (int i = 0; i < chunks; i++) {
+        cache_handle_t chunk;
+        if (cache_lookup_chunk(cache, "/movie", i, &chunk, NULL) != CACHE_LOOKUP_MISS) {
+            resident++;
+            cache_release(&chunk);
+        }
+    }
+    ASSERT(resident >= 2 && resident <= 4, "Eviction drops whole chunks, keeps some");
+
+    cache_handle_t last;
+    ASSERT(cache_lookup_chunk(cache, "/movie", chunks - 1, &last, NULL) == CACHE_LOOKUP_FRESH,
+           "Most recent chunk survives");
+    cache_release(&last);
+    size_t offset = (size_t)(chunks - 1) * CACHE_CHUNK_SIZE + 100;
+    ASSERT(cache_get_range(cache, "/movie", offset, 1000, out, NULL) == 1000 &&
+           memcmp(out, data + offset, 1000) == 0, "Resident chunk serves its ranges");
+    ASSERT(cache_get_range(cache, "/movie", 0, 1000, out, NULL) == 0,
+           "Evicted chunk does not");
+
+    free(data);
+    free(out);
+    cache_destroy(cache);
+    PASS();
+}
+
+static void test_cache_chunks_versions(void) {
+    TEST(cache_chunks_versions);
+
+    const size_t size = 2 * CACHE_CHUNK_SIZE;
+    char *data = malloc(size);
+    char *out = malloc(size);
+    chunk_file(data, size);
+    cache_t *cache = cache_create(4 * 1024 * 1024);
+    cache_validator_t v1 = { 1, size }, v2 = { 2, size };
+
+    /* Chunk 1 was cached after the file changed */
+    cache_put_chunks(cache, "/f", 0, data, CACHE_CHUNK_SIZE, &v1, CACHE_TTL_NONE, 0);
+    cache_put_chunks(cache, "/f", CACHE_CHUNK_SIZE, data + CACHE_CHUNK_SIZE,
+                     CACHE_CHUNK_SIZE, &v2, CACHE_TTL_NONE, 0);
+
+    cache_validator_t cv;
+    ASSERT(cache_get_range(cache, "/f", 0, size, out, &cv) == CACHE_CHUNK_SIZE,
+           "Copy stops at a chunk of another version");
+    ASSERT(cv.mtime_ns == 1, "Reports the version it copied");
+    ASSERT(cache_get_range(cache, "/f", CACHE_CHUNK_SIZE, 10, out, &cv) == 10 &&
+           cv.mtime_ns == 2, "Each version is usable on its own");
+
+    /* Stale chunks are not copied */
+    cache_put_chunks(cache, "/f", 0, data, size, &v2, 20, 0);
+    usleep(60 * 1000);
+    ASSERT(cache_get_range(cache, "/f", 0, 10, out, NULL) == 0, "Stale chunk ends the copy");
+
+    free(data);
+    free(out);
+    cache_destroy(cache);
+    PASS();
+}
+
+/* ============================================================================
+Negative Cache Tests
+============================================================================ */
+
+static void test_neg_cache_basic(void) {
+    TEST(neg_cache_basic);
+
+    neg_cache_t *nc = neg_cache_create(16, 10000);
+    ASSERT(nc != NULL, "Should create negative cache");
+
+    ASSERT(!neg_cache_lookup(nc, "/missing"), "Empty cache should miss");
+    ASSERT(neg_cache_insert(nc, "/missing"), "Should insert");
+    ASSERT(neg_cache_lookup(nc, "/missing"), "Should hit after insert");
+    ASSERT(neg_cache_remove(nc, "/missing"), "Should remove");
+    ASSERT(!neg_cache_lookup(nc, "/missing"), "Should miss after remove");
+
+    neg_cache_stats_t stats;
+    neg_cache_get_stats(nc, &stats);
+    ASSERT(stats.hits == 1, "Should count one hit");
+    ASSERT(stats.misses == 2, "Should count two misses");
+
+    neg_cache_destroy(nc);
+    PASS();
+}
+
+static void test_neg_cache_ttl(void) {
+    TEST(neg_cache_ttl);
+
+    neg_cache_t *nc = neg_cache_create(16, 20);  /* 20 ms TTL */
+    ASSERT(nc != NULL, "Should create negative cache");
+
+    neg_cache_insert(nc, "/gone");
+    ASSERT(neg_cache_lookup(nc, "/gone"), "Fresh entry should hit");
+
+    usleep(50 * 1000);
+    ASSERT(!neg_cache_lookup(nc, "/gone"), "Expired entry should miss");
+
+    neg_cache_stats_t stats;
+    neg_cache_get_stats(nc, &stats);
+    ASSERT(stats.expirations == 1, "Should count the expiration");
+    ASSERT(stats.probation_entries + stats.protected_entries == 0,
+           "Expired entry should be dropped");
+
+    neg_cache_destroy(nc);
+    PASS();
+}
+
+static void test_neg_cache_flood_resistance(void) {
+    TEST(neg_cache_flood_resistance);
+
+    neg_cache_t *nc = neg_cache_create(10, 10000);
+    ASSERT(nc != NULL, "Should create negative cache");
+
+    /* A reused missing key gets promoted to the protected segment */
+    neg_cache_insert(nc, "/favicon.ico");
+    ASSERT(neg_cache_lookup(nc, "/favicon.ico"), "Should hit");
+
+    /* Flood with unique keys, each seen only once */
+    char key[64];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "/scan/%d", i);
+        neg_cache_insert(nc, key);
+    }
+
+    ASSERT(neg_cache_lookup(nc, "/favicon.ico"), "Protected entry should survive flood");
+
+    neg_cache_stats_t stats;
+    neg_cache_get_stats(nc, &stats);
+    ASSERT(stats.probation_entries + stats.protected_entries <= 10,
+           "Should stay within capacity");
+    ASSERT(stats.evictions > 0, "Flood should evict probation entries");
+
+    neg_cache_destroy(nc);
+    PASS();
+}
+
+/* ============================================================================
+Prefetcher Tests
+============================================================================ */
+
+static void test_prefetch_learns_successor(void) {
+    TEST(prefetch_learns_successor);
+
+    prefetcher_t *pf = prefetcher_create(1000, 1024 * 1024, 4);
+    ASSERT(pf != NULL, "Should create prefetcher");
+
+    char out[2][PREFETCH_MAX_KEY_LEN];
+
+    /* Client 1 repeatedly fetches index then its asset, with another
+     * client's requests interleaved in between */
+    for (int i = 0; i < 3; i++) {
+        prefetcher_record(pf, 1, "/index.html", NULL, 0);
+        prefetcher_record(pf, 2, "/noise", NULL, 0);
+        prefetcher_record(pf, 1, "/style.css", NULL, 0);
+    }
+
+    int n = prefetcher_record(pf, 1, "/index.html", out, 2);
+    ASSERT(n == 1, "Should predict exactly one successor");
+    ASSERT(strcmp(out[0], "/style.css") == 0, "Should predict /style.css");
+
+    n = prefetcher_record(pf, 3, "/noise", out, 2);
+    ASSERT(n == 0, "Client 2 never followed /noise with anything");
+
+    prefetcher_destroy(pf);
+    PASS();
+}
+
+static void test_prefetch_window(void) {
+    TEST(prefetch_window);
+
+    prefetcher_t *pf = prefetcher_create(10, 1024 * 1024, 4);  /* 10 ms window */
+    ASSERT(pf != NULL, "Should create prefetcher");
+
+    char out[2][PREFETCH_MAX_KEY_LEN];
+    for (int i = 0; i < 3; i++) {
+        prefetcher_record(pf, 1, "/a", NULL, 0);
+        usleep(30 * 1000);
+        prefetcher_record(pf, 1, "/b", NULL, 0);
+        usleep(30 * 1000);
+    }
+
+    ASSERT(prefetcher_record(pf, 1, "/a", out, 2) == 0,
+           "Transitions slower than the window should not be learned");
+
+    prefetcher_destroy(pf);
+    PASS();
+}
+
+static void test_prefetch_budget_and_accuracy(void) {
+    TEST(prefetch_budget_and_accuracy);
+
+    prefetcher_t *pf = prefetcher_create(1000, 1000, 8);  /* 1000 bytes/s */
+    ASSERT(pf != NULL, "Should create prefetcher");
+
+    ASSERT(prefetcher_begin(pf), "Budget should allow first prefetch");
+    prefetcher_complete(pf, "/used", 600, true);
+    ASSERT(prefetcher_begin(pf), "Budget should allow second prefetch");
+    prefetcher_complete(pf, "/unused", 600, true);
+    ASSERT(!prefetcher_begin(pf), "Budget should now be exhausted");
+
+    /* A client asks for one of the two prefetched files */
+    prefetcher_record(pf, 7, "/used", NULL, 0);
+
+    prefetch_stats_t stats;
+    prefetcher_get_stats(pf, &stats);
+    ASSERT(stats.issued == 2, "Should count two prefetches");
+    ASSERT(stats.skipped_budget == 1, "Should count one budget skip");
+    ASSERT(stats.used == 1, "Should credit the used prefetch");
+    ASSERT(stats.bytes_prefetched == 1200, "Should count prefetched bytes");
+
+    prefetcher_destroy(pf);
+    PASS();
+}
+
+/* ============================================================================
+Hedging Tests
+============================================================================ */
+
+static void test_hedge_delay_tracks_p95(void) {
+    TEST(hedge_delay_tracks_p95);
+
+    hedge_t *h = hedge_create(0.05, 50);
+    ASSERT(h != NULL, "Should create hedging state");
+    ASSERT(hedge_begin_request(h) == 50, "Should use default delay without samples");
+
+    /* 95 fast responses (1 ms) and 5 slow ones (100 ms) */
+    for (int i = 0; i < 100; i++) {
+        hedge_record_latency(h, (i % 20 == 0) ? 100000 : 1000);
+    }
+    uint32_t delay = hedge_begin_request(h);
+    ASSERT(delay >= 1 && delay <= 100, "Delay should come from the latency window");
+
+    for (int i = 0; i < 200; i++) {
+        hedge_record_latency(h, 2000);
+    }
+    ASSERT(hedge_begin_request(h) == 2, "Delay should follow the p95 (2 ms)");
+
+    hedge_destroy(h);
+    PASS();
+}
+
+static void test_hedge_budget(void) {
+    TEST(hedge_budget);
+
+    hedge_t *h = hedge_create(0.05, 50);
+    ASSERT(h != NULL, "Should create hedging state");
+
+    /* Every request is slow: the budget alone limits hedging */
+    for (int i = 0; i < 1000; i++) {
+        hedge_begin_request(h);
+        hedge_try_acquire(h);
+    }
+
+    hedge_stats_t stats;
+    hedge_get_stats(h, &stats);
+    ASSERT(stats.requests == 1000, "Should count requests");
+    ASSERT(stats.hedges_sent <= 50, "Hedges should stay within 5% of requests");
+    ASSERT(stats.hedges_sent >= 45, "Budget should allow about 5% hedges");
+    ASSERT(stats.hedges_denied == 1000 - stats.hedges_sent, "Rest should be denied");
+
+    hedge_destroy(h);
+    PASS();
+}
+
 /* ============================================================================
 Main
 ============================================================================ */
 
 int main(void) {
+    /* Hash-dependent results (sampling, collisions) repeat run to run */
+    setenv("FAST_HASH_SEED", "1", 1);
     printf("=== Cache Tests ===\n\n");
 
     printf("Testing cache creation:\n");
@@ -391,6 +4064,122 @@ int main(void) {
     printf("\nTesting concurrent access:\n");
     test_cache_concurrent();
 
+    printf("\nTesting sharding:\n");
+    test_cache_sharded_basic();
+    test_cache_default_shards();
+    test_cache_shard_scaling();
+
+    printf("\nTesting CLOCK policy:\n");
+    test_cache_clock_second_chance();
+    test_cache_clock_expiry();
+    test_cache_clock_vs_lru_zipf();
+
+    printf("\nTesting lock-free reads:\n");
+    test_epoch_defers_free();
+    test_cache_lockfree_hit_unlocked();
+    test_cache_lockfree_churn();
+    test_cache_lockfree_read_scaling();
+
+    printf("\nTesting statistics counters:\n");
+    test_stat_counters_merge();
+    test_cache_stats_concurrent();
+    test_stat_counters_scaling();
+
+    printf("\nTesting W-TinyLFU:\n");
+    test_freq_sketch_basic();
+    test_cache_tinylfu_basic();
+    test_cache_tinylfu_scan_resistance();
+    test_cache_tinylfu_zipf_with_scans();
+
+    printf("\nTesting policy interface:\n");
+    test_cache_policy_invariants();
+    test_cache_policy_ghost_hits();
+    test_cache_policy_scan_resistance();
+    test_cache_policy_comparison();
+
+    printf("\nTesting GDSF:\n");
+    test_cache_gdsf_prefers_small();
+    test_cache_gdsf_cost();
+    test_cache_byte_hit_ratio();
+    test_cache_put_sized();
+    test_cache_gdsf_comparison();
+
+    printf("\nTesting pinned reads:\n");
+    test_cache_acquire_basic();
+    test_cache_acquire_concurrent();
+    test_cache_acquire_vs_copy();
+
+    printf("\nTesting batched operations:\n");
+    test_cache_get_many_basic();
+    test_cache_put_many_basic();
+    test_cache_get_many_bench();
+
+    printf("\nTesting key index:\n");
+    test_cache_index_basic();
+    test_cache_index_incremental_resize();
+    test_cache_index_lookup_bench();
+    test_cache_entry_footprint();
+
+    printf("\nTesting slab allocator:\n");
+    test_slab_size_classes();
+    test_slab_reuse_and_release();
+    test_slab_release_high_water();
+    test_slab_churn_rss();
+
+    printf("\nTesting TTL and revalidation:\n");
+    test_cache_ttl_expiry();
+    test_cache_stale_while_revalidate();
+    test_cache_stale_window_bound();
+    test_cache_revalidate_timeout();
+    test_cache_expire_sweep();
+    test_cache_sweeper_thread();
+    test_cache_expire_cost();
+
+    printf("\nTesting snapshots:\n");
+    test_cache_snapshot_roundtrip();
+    test_cache_restore_lazy();
+    test_cache_restore_rejects_bad_files();
+    test_cache_restore_gdsf_priority();
+
+    printf("\nTesting disk tier:\n");
+    test_cache_disk_log();
+    test_cache_disk_tier();
+    test_cache_disk_tier_concurrent();
+
+    printf("\nTesting hashing:\n");
+    test_fast_hash_basic();
+    test_fast_hash_distribution();
+    test_fast_hash_speed();
+
+    printf("\nTesting miss-ratio curve:\n");
+    test_mrc_exact_when_unsampled();
+    test_mrc_prediction();
+    test_mrc_fixed_size();
+
+    printf("\nTesting compression:\n");
+    test_lz_roundtrip();
+    test_cache_compression();
+    test_cache_compression_capacity();
+
+    printf("\nTesting chunked files:\n");
+    test_cache_chunks_put_get();
+    test_cache_chunks_partial_residency();
+    test_cache_chunks_versions();
+
+    printf("\nTesting negative cache:\n");
+    test_neg_cache_basic();
+    test_neg_cache_ttl();
+    test_neg_cache_flood_resistance();
+
+    printf("\nTesting prefetcher:\n");
+    test_prefetch_learns_successor();
+    test_prefetch_window();
+    test_prefetch_budget_and_accuracy();
+
+    printf("\nTesting hedging:\n");
+    test_hedge_delay_tracks_p95();
+    test_hedge_budget();
+
     printf("\n=== Results ===\n");
     printf("%d/%d tests passed\n", tests_passed, tests_run);
 
@@ -279,6 +279,190 @@ static void test_status_conversion(void) {
     PASS();
 }
 
+/* ============================================================================
+Tests for validators / conditional requests
+============================================================================ */
+
+static void test_response_validator_roundtrip(void) {
+    TEST(response_validator_roundtrip);
+
+    char buffer[256];
+    gf_validator_t v = { 1700000000123456789LL, 4096 };
+    int len = gf_create_response_header_validated(buffer, sizeof(buffer),
+                                                  STATUS_OK, 4096, &v);
+    ASSERT(len > 0, "Should create validated header");
+    ASSERT(strcmp(buffer, "GETFILE OK 4096\r\nVALIDATOR 1700000000123456789 4096\r\n\r\n") == 0,
+           "Should append VALIDATOR line");
+
+    gf_response_t parsed;
+    int consumed = gf_parse_response_header(buffer, len, &parsed);
+    ASSERT(consumed == len, "Should consume whole header");
+    ASSERT(parsed.status == STATUS_OK, "Should parse OK status");
+    ASSERT(parsed.content_length == 4096, "Should parse content length");
+    ASSERT(parsed.has_validator, "Should see validator");
+    ASSERT(gf_validator_equal(&parsed.validator, &v), "Validator should round-trip");
+    PASS();
+}
+
+static void test_conditional_request_roundtrip(void) {
+    TEST(conditional_request_roundtrip);
+
+    char buffer[256];
+    gf_validator_t v = { 42, 7 };
+    int len = gf_create_conditional_request(buffer, sizeof(buffer), "/a.txt", &v);
+    ASSERT(len > 0, "Should create conditional request");
+
+    gf_request_t parsed;
+    int consumed = gf_parse_request(buffer, len, &parsed);
+    ASSERT(consumed == len, "Should consume whole request");
+    ASSERT(parsed.valid, "Should be valid");
+    ASSERT(strcmp(parsed.path, "/a.txt") == 0, "Path should not include validator");
+    ASSERT(parsed.has_validator, "Should see validator");
+    ASSERT(gf_validator_equal(&parsed.validator, &v), "Validator should round-trip");
+    PASS();
+}
+
+static void test_parse_not_modified(void) {
+    TEST(parse_not_modified);
+
+    const char *response = "GETFILE NOT_MODIFIED\r\nVALIDATOR 5 6\r\n\r\n";
+    gf_response_t parsed;
+
+    int consumed = gf_parse_response_header(response, strlen(response), &parsed);
+    ASSERT(consumed > 0, "Should return bytes consumed");
+    ASSERT(parsed.status == STATUS_NOT_MODIFIED, "Should parse NOT_MODIFIED");
+    ASSERT(parsed.has_validator && parsed.validator.size == 6, "Should parse validator");
+
+    const char *bad = "GETFILE OK 5\r\nBOGUS 1 2\r\n\r\n";
+    ASSERT(gf_parse_response_header(bad, strlen(bad), &parsed) == -1,
+           "Should reject unknown header line");
+    PASS();
+}
+
+/* ============================================================================
+Tests for content coding (lz)
+============================================================================ */
+
+static void test_lz_request_roundtrip(void) {
+    TEST(lz_request_roundtrip);
+
+    char buffer[256];
+    gf_validator_t v = { 42, 7 };
+    int len = gf_create_lz_request(buffer, sizeof(buffer), "/a.txt", &v);
+    ASSERT(len > 0, "Should create request");
+    ASSERT(strcmp(buffer, "GETFILE GET /a.txt\r\nVALIDATOR 42 7\r\n"
+                          "ACCEPT-ENCODING lz\r\n\r\n") == 0,
+           "Should append ACCEPT-ENCODING line");
+
+    gf_request_t parsed;
+    ASSERT(gf_parse_request(buffer, len, &parsed) == len, "Should consume whole request");
+    ASSERT(parsed.accept_lz, "Should see lz accepted");
+    ASSERT(parsed.has_validator && gf_validator_equal(&parsed.validator, &v),
+           "Validator should still round-trip");
+
+    const char *plain = "GETFILE GET /a.txt\r\n\r\n";
+    ASSERT(gf_parse_request(plain, strlen(plain), &parsed) > 0 && !parsed.accept_lz,
+           "Plain request should not accept lz");
+
+    const char *other = "GETFILE GET /a.txt\r\nACCEPT-ENCODING zstd lz\r\n\r\n";
+    ASSERT(gf_parse_request(other, strlen(other), &parsed) > 0 && parsed.accept_lz,
+           "Should find lz among other codings");
+    const char *unknown = "GETFILE GET /a.txt\r\nACCEPT-ENCODING zstd\r\n\r\n";
+    ASSERT(gf_parse_request(unknown, strlen(unknown), &parsed) > 0 && !parsed.accept_lz,
+           "Unknown codings are ignored");
+    PASS();
+}
+
+static void test_lz_response_roundtrip(void) {
+    TEST(lz_response_roundtrip);
+
+    char buffer[256];
+    int len = gf_create_response_header_lz(buffer, sizeof(buffer), STATUS_CACHED,
+                                           812, NULL, 4096);
+    ASSERT(len > 0, "Should create header");
+    ASSERT(strcmp(buffer, "GETFILE CACHED 812\r\nENCODING lz 4096\r\n\r\n") == 0,
+           "Should append ENCODING line");
+
+    gf_response_t parsed;
+    ASSERT(gf_parse_response_header(buffer, len, &parsed) == len, "Should consume header");
+    ASSERT(parsed.content_length == 812, "Length is the block size");
+    ASSERT(parsed.lz_encoded && parsed.decoded_length == 4096, "Should see the coding");
+
+    len = gf_create_response_header_lz(buffer, sizeof(buffer), STATUS_OK, 10, NULL, 0);
+    ASSERT(strcmp(buffer, "GETFILE OK 10\r\n\r\n") == 0, "No ENCODING line when plain");
+    ASSERT(gf_parse_response_header(buffer, len, &parsed) == len && !parsed.lz_encoded,
+           "Plain response should not be lz");
+
+    const char *bad = "GETFILE OK 5\r\nENCODING gzip 10\r\n\r\n";
+    ASSERT(gf_parse_response_header(bad, strlen(bad), &parsed) == -1,
+           "Should reject a body in an unknown coding");
+    const char *misplaced = "GETFILE OK 5\r\nACCEPT-ENCODING lz\r\n\r\n";
+    ASSERT(gf_parse_response_header(misplaced, strlen(misplaced), &parsed) == -1,
+           "ACCEPT-ENCODING belongs in requests");
+    PASS();
+}
+
+/* ============================================================================
+Tests for byte ranges
+============================================================================ */
+
+static void test_range_request_roundtrip(void) {
+    TEST(range_request_roundtrip);
+
+    char buffer[256];
+    int len = gf_create_range_request(buffer, sizeof(buffer), "/big.iso", 262144, 524288, NULL);
+    ASSERT(len > 0, "Should create request");
+    ASSERT(strcmp(buffer, "GETFILE GET /big.iso\r\nRANGE 262144 524288\r\n\r\n") == 0,
+           "Should append RANGE line");
+
+    gf_request_t parsed;
+    ASSERT(gf_parse_request(buffer, len, &parsed) == len, "Should consume whole request");
+    ASSERT(parsed.has_range && parsed.range_offset == 262144 && parsed.range_length == 524288,
+           "Should see the range");
+
+    gf_validator_t v = { 42, 7 };
+    len = gf_create_range_request(buffer, sizeof(buffer), "/big.iso", 0, 10, &v);
+    ASSERT(gf_parse_request(buffer, len, &parsed) == len && parsed.has_range &&
+           parsed.has_validator && gf_validator_equal(&parsed.validator, &v),
+           "Range and validator combine");
+
+    const char *plain = "GETFILE GET /a.txt\r\n\r\n";
+    ASSERT(gf_parse_request(plain, strlen(plain), &parsed) > 0 && !parsed.has_range,
+           "Plain request has no range");
+    const char *negative = "GETFILE GET /a.txt\r\nRANGE -1 10\r\n\r\n";
+    ASSERT(gf_parse_request(negative, strlen(negative), &parsed) == -1,
+           "Should reject a negative offset");
+    const char *empty = "GETFILE GET /a.txt\r\nRANGE 5 0\r\n\r\n";
+    ASSERT(gf_parse_request(empty, strlen(empty), &parsed) == -1,
+           "Should reject an empty range");
+    PASS();
+}
+
+static void test_range_response_roundtrip(void) {
+    TEST(range_response_roundtrip);
+
+    char buffer[256];
+    int len = gf_create_response_header_range(buffer, sizeof(buffer), STATUS_CACHED, 1000,
+                                              NULL, 5000, 1048576);
+    ASSERT(len > 0, "Should create header");
+    ASSERT(strcmp(buffer, "GETFILE CACHED 1000\r\nRANGE 5000 1048576\r\n\r\n") == 0,
+           "Should append RANGE line");
+
+    gf_response_t parsed;
+    ASSERT(gf_parse_response_header(buffer, len, &parsed) == len, "Should consume header");
+    ASSERT(parsed.content_length == 1000, "Length is the range's");
+    ASSERT(parsed.has_range && parsed.range_offset == 5000 && parsed.total_length == 1048576,
+           "Should see offset and file size");
+
+    const char *whole = "GETFILE OK 10\r\n\r\n";
+    ASSERT(gf_parse_response_header(whole, strlen(whole), &parsed) > 0 && !parsed.has_range,
+           "Whole-file answer has no range");
+    const char *past = "GETFILE OK 10\r\nRANGE 95 100\r\n\r\n";
+    ASSERT(gf_parse_response_header(past, strlen(past), &parsed) == -1,
+           "Should reject a range past the end of the file");
+    PASS();
+}
+
 /* ============================================================================
 Main
 ============================================================================ */
@@ -315,6 +499,19 @@ int main(void) {
     printf("\nTesting status conversions:\n");
     test_status_conversion();
 
+    printf("\nTesting validators:\n");
+    test_response_validator_roundtrip();
+    test_conditional_request_roundtrip();
+    test_parse_not_modified();
+
+    printf("\nTesting content coding:\n");
+    test_lz_request_roundtrip();
+    test_lz_response_roundtrip();
+
+    printf("\nTesting byte ranges:\n");
+    test_range_request_roundtrip();
+    test_range_response_roundtrip();
+
     printf("\n=== Results ===\n");
     printf("%d/%d tests passed\n", tests_passed, tests_run);
 
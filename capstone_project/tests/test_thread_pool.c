@@ -244,6 +244,7 @@ static void test_thread_pool_stats(void) {
 
     /* Initially should have 0 tasks and 0 active */
     /* (Workers are waiting on queue) */
+    ASSERT(tasks == 0 && active == 0, "Fresh pool should report no work");
 
     thread_pool_destroy(pool);
     PASS();